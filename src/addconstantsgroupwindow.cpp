@@ -21,6 +21,7 @@
 // ---------------------------------------------------------------------------
 
 #include "addconstantsgroupwindow.h"
+#include "constants.h"
 #include "ui_addconstantsgroupwindow.h"
 
 addConstantsGroupWindow::addConstantsGroupWindow(QWidget *parent) :
@@ -40,13 +41,11 @@ void addConstantsGroupWindow::accept() {
 
     QString groupName = le->text();
 
-    auto *group = new struct constantsGroup;
-    group->name = groupName;
-    group->map = new QMap<quint64, QString>;
-
-    constantsGroups.insert(nextNewGroup, *group);
-
-    nextNewGroup++;
+    if (constantsGroups.add(groupName) == CONSTANTS_GROUP_NONE) {
+        QMessageBox::warning(this, QStringLiteral("Add Group"),
+                             QStringLiteral("Too many constants groups!"));
+        return;
+    }
 
     setResult(QDialog::Accepted);
     hide();
@@ -0,0 +1,186 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#include "addresspairs.h"
+#include "disassembler.h"
+#include "flowgraph.h"
+#include "profiler.h"
+#include "symbollibrary.h"
+
+bool mnemonicIn(const QString &inst, const char *list) {
+    return (QStringLiteral(" ") + QLatin1String(list) + QStringLiteral(" "))
+                .contains(QStringLiteral(" ") + inst + QStringLiteral(" "));
+}
+
+// ---------------------------------------------------------------------------
+// ONE BLOCK
+
+struct knownvalue {
+    quint16 value;
+    quint64 source;                     // relpos of the immediate
+    int size;                           // 0 if unknown
+};
+
+struct foundpair {
+    quint64 low, high;                  // relpos of the immediates
+    quint16 value;
+};
+
+struct foundpointer {
+    quint64 operand;
+    quint16 value;
+};
+
+static bool inSomeSegment(quint64 address) {
+    for (const auto &s : qAsConst(segments))
+        if (address >= s.start && address <= s.end)
+            return true;
+    return false;
+}
+
+// clearing a 16-bit counter stores two immediates as well, so their value
+// must point into a segment or already have a name
+
+static bool isAddress(const struct segment &s, quint64 address) {
+    return inSomeSegment(address) || s.localLabels.contains(address)
+        || globalLabels.contains(address) || symbolLibraries.contains(address);
+}
+
+static void scanBlock(const struct segment &s, const struct basicblock &block,
+                      QVector<struct foundpair> &pairs,
+                      QVector<struct foundpointer> &pointers) {
+    struct knownvalue regs[32] = {};
+    QMap<quint64, struct knownvalue> zeropage;
+    quint64 size = s.end - s.start + 1;
+
+    for (int i = block.firstLine; i < block.firstLine + block.lines; i++) {
+        quint64 relpos = s.disassembly.at(i).address - s.start;
+        if (relpos >= size || (s.datatypes[relpos] != DT_CODE &&
+                               s.datatypes[relpos] != DT_UNDEFINED_CODE))
+            continue;
+
+        struct insneffect e;
+        Disassembler->effectAt(relpos, e);
+
+        if (e.pointer >= 0 && regs[e.pointer].size == 2)
+            pointers.append({ regs[e.pointer].source, regs[e.pointer].value });
+
+        if (e.store >= 0 && regs[e.store].size == e.storeSize) {
+            const struct knownvalue &k = regs[e.store];
+
+            if (k.size == 2 && inSomeSegment(k.value)) {
+                pointers.append({ k.source, k.value });
+            } else if (k.size == 1 && e.address < 0xff) {
+                zeropage.insert(e.address, k);
+
+                auto low = zeropage.constFind(e.address - 1);
+                auto high = zeropage.constFind(e.address + 1);
+                if (e.address > 0 && low != zeropage.constEnd() &&
+                        low->source != k.source) {
+                    quint16 value = low->value | k.value << 8;
+                    if (isAddress(s, value))
+                        pairs.append({ low->source, k.source, value });
+                }
+                if (high != zeropage.constEnd() && high->source != k.source) {
+                    quint16 value = k.value | high->value << 8;
+                    if (isAddress(s, value))
+                        pairs.append({ k.source, high->source, value });
+                }
+            }
+        } else if (e.store >= 0) {
+            for (int b = 0; b < qMax(e.storeSize, 1); b++)
+                zeropage.remove(e.address + b);
+        }
+
+        if (e.memory == MEMORY_ADDRESS)
+            zeropage.remove(e.address);
+        else if (e.memory == MEMORY_ANY)
+            zeropage.clear();
+
+        for (int r = 0; r < 32; r++)
+            if (e.clobbered & (1U << r))
+                regs[r].size = 0;
+
+        if (e.copyTo >= 0)
+            regs[e.copyTo] = regs[e.copyFrom];
+
+        if (e.load >= 0) {
+            quint16 value = s.data[e.operand];
+            if (e.loadSize == 2)
+                value |= s.data[e.operand+1] << 8;
+            regs[e.load] = { value, e.operand, e.loadSize };
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// ONE SEGMENT
+
+static bool addLabel(struct segment &s, quint64 address,
+                     bool generateLocalLabels) {
+    if (  s.localLabels.contains(address) || globalLabels.contains(address)
+       || symbolLibraries.contains(address))
+        return false;
+
+    QString label = QStringLiteral("L%1").arg(address, 4, 16, QChar('0'));
+    if (Disassembler->toUpper)
+        label = label.toUpper();
+
+    if (generateLocalLabels)
+        s.localLabels.insert(address, label);
+    else
+        globalLabels.insert(address, label);
+    return true;
+}
+
+void resolveAddressPairs(bool generateLocalLabels,
+                         struct addresspairresult *result) {
+    ProfileScope scope("resolveAddressPairs");
+    struct segment &s = segments[currentSegment];
+    QVector<struct foundpair> pairs;
+    QVector<struct foundpointer> pointers;
+
+    if (!s.flow || s.flow->key() != s.listingKey || s.disassembly.isEmpty())
+        return;                         // no listing, or one from before
+
+    for (int b = 0; b < s.flow->size(); b++)
+        scanBlock(s, s.flow->block(b), pairs, pointers);
+
+    for (const auto &p : qAsConst(pairs)) {
+        if (s.flags[p.low] || s.flags[p.high])
+            continue;
+        s.flags[p.low] = FLAG_LOW_BYTE;
+        s.flags[p.high] = FLAG_HIGH_BYTE;
+        s.lowbytes.insert(p.low, p.value);
+        s.highbytes.insert(p.high, p.value);
+        result->pairs++;
+        result->labels += addLabel(s, p.value, generateLocalLabels);
+    }
+
+    for (const auto &p : qAsConst(pointers)) {
+        if (s.flags[p.operand])
+            continue;
+        s.flags[p.operand] = FLAG_USE_LABEL;
+        result->pointers++;
+        result->labels += addLabel(s, p.value, generateLocalLabels);
+    }
+}
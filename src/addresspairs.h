@@ -0,0 +1,70 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef ADDRESSPAIRS_H
+#define ADDRESSPAIRS_H
+
+#include "pch.h"
+
+#define MEMORY_NONE         0
+#define MEMORY_ADDRESS      1           // writes the byte at address
+#define MEMORY_ANY          2           // writes somewhere unknown
+
+// What an instruction does with registers and memory, as far as constant
+// propagation cares. Registers are numbered by each disassembler, up to
+// 32 of them. Anything not described is assumed to be left alone.
+
+struct insneffect {
+    int load = -1;                      // register set to an immediate
+    int loadSize = 0;                   // of the immediate, 1 or 2 bytes
+    quint64 operand = 0;                // relpos of the immediate
+    int copyTo = -1, copyFrom = -1;     // register to register
+    int store = -1;                     // register stored at address
+    int storeSize = 0;
+    int pointer = -1;                   // register used to address memory
+    quint64 address = 0;                // of a store or memory write
+    quint32 clobbered = 0;              // registers changed otherwise
+    int memory = MEMORY_NONE;
+};
+
+// true if inst is one of the space separated mnemonics in list
+bool mnemonicIn(const QString &inst, const char *list);
+
+struct addresspairresult {
+    int pairs;                          // low and high bytes flagged
+    int pointers;                       // word immediates flagged as labels
+    int labels;                         // created for their targets
+};
+
+// One pass over the basic blocks of the current segment, its listing must
+// be up-to-date. Immediates are followed through registers into memory
+// within a block. Two immediate bytes that end up in consecutive zero page
+// locations become a low and high byte pair, if their value is inside a
+// segment or already labelled. A word immediate that is used to address
+// memory, or is stored while it points into a segment, becomes a label.
+// Bytes that already have a flag are left as they are. The counts are
+// added to result.
+
+void resolveAddressPairs(bool generateLocalLabels,
+                         struct addresspairresult *result);
+
+#endif // ADDRESSPAIRS_H
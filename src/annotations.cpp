@@ -0,0 +1,138 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+
+#include "annotations.h"
+#include "symbollibrary.h"
+#include <algorithm>
+
+struct annotation {
+    quint64 offset;
+    quint8 kind;
+    QString text;
+    quint16 target;
+};
+
+static bool byOffset(const struct annotation &a, const struct annotation &b) {
+    return a.offset < b.offset;
+}
+
+// ----------------------------------------------------------------------------
+// BUILD
+
+void AnnotationStore::build(const struct segment &s, quint64 key) {
+    quint64 start = s.start, end = s.end;
+    QVector<struct annotation> all;
+
+    listingKey = key;
+    offsets.clear();
+    kinds.clear();
+    comments.clear();
+    labels.clear();
+    lows.clear();
+    highs.clear();
+
+    for (auto it = s.comments.lowerBound(start);
+                    it != s.comments.constEnd() && it.key() <= end; ++it)
+        all.append({ it.key() - start, ANNOTATION_COMMENT, it.value(), 0 });
+
+    // in order of precedence, the sort is stable
+
+    for (auto it = s.localLabels.lowerBound(start);
+                    it != s.localLabels.constEnd() && it.key() <= end; ++it)
+        all.append({ it.key() - start, ANNOTATION_LABEL | ANNOTATION_LOCAL,
+                     it.value(), 0 });
+
+    for (auto it = qAsConst(globalLabels).lowerBound(start);
+                    it != globalLabels.constEnd() && it.key() <= end; ++it)
+        all.append({ it.key() - start, ANNOTATION_LABEL, it.value(), 0 });
+
+    for (const auto *lib : symbolLibraries.libraries()) {
+        for (int i = lib->lowerBound(start); i < lib->labelCount(); i++) {
+            quint64 address = lib->labelAddress(i);
+            if (address > end)
+                break;
+            all.append({ address - start, ANNOTATION_LABEL, lib->labelName(i), 0 });
+        }
+    }
+
+    for (auto it = s.lowbytes.constBegin(); it != s.lowbytes.constEnd(); ++it)
+        all.append({ it.key(), ANNOTATION_LOW_BYTE, QString(), it.value() });
+    for (auto it = s.highbytes.constBegin(); it != s.highbytes.constEnd(); ++it)
+        all.append({ it.key(), ANNOTATION_HIGH_BYTE, QString(), it.value() });
+
+    std::stable_sort(all.begin(), all.end(), byOffset);
+
+    for (const auto &e : qAsConst(all)) {
+        if (offsets.isEmpty() || offsets.last() != e.offset) {
+            offsets.append(e.offset);
+            kinds.append(0);
+            comments.append(QString());
+            labels.append(QString());
+            lows.append(0);
+            highs.append(0);
+        }
+
+        int last = offsets.size() - 1;
+
+        if (kinds.at(last) & e.kind & ANNOTATION_LABEL)
+            continue;                   // overruled by an earlier one
+        kinds[last] |= e.kind;
+
+        if (e.kind & ANNOTATION_COMMENT)
+            comments[last] = e.text;
+        else if (e.kind & ANNOTATION_LABEL)
+            labels[last] = e.text;
+        else if (e.kind & ANNOTATION_LOW_BYTE)
+            lows[last] = e.target;
+        else
+            highs[last] = e.target;
+    }
+}
+
+// the strings are shared with the maps they were taken from
+
+quint64 AnnotationStore::bytes(void) const {
+    return offsets.capacity() * sizeof(quint64) + kinds.capacity() +
+           (comments.capacity() + labels.capacity()) * sizeof(QString) +
+           (lows.capacity() + highs.capacity()) * sizeof(quint16);
+}
+
+// ----------------------------------------------------------------------------
+// CURSOR
+
+bool AnnotationCursor::at(quint64 offset) {
+    if (!a)
+        return false;
+
+    const QVector<quint64> &offsets = a->offsets;
+    int n = offsets.size();
+
+    if (pos > 0 && offsets.at(pos-1) >= offset)
+        pos = std::lower_bound(offsets.begin(), offsets.end(), offset)
+                                                        - offsets.begin();
+
+    while (pos < n && offsets.at(pos) < offset)
+        pos++;
+
+    return pos < n && offsets.at(pos) == offset;
+}
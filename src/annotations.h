@@ -0,0 +1,79 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+
+#ifndef ANNOTATIONS_H
+#define ANNOTATIONS_H
+
+#include "pch.h"
+
+#define ANNOTATION_COMMENT      0x01
+#define ANNOTATION_LABEL        0x02    // local, global or from a library
+#define ANNOTATION_LOW_BYTE     0x04
+#define ANNOTATION_HIGH_BYTE    0x08
+#define ANNOTATION_LOCAL        0x10    // the label is a local label
+
+// Everything that is attached to the bytes of a segment, as columns sorted
+// by segment offset. The maps of struct segment stay the place where
+// annotations are edited and saved. generateDisassembly() builds the store
+// after it has created the operand labels, and only again when the listing
+// key changes. The generator, the disassembly view and the exporter stream
+// through it in address order.
+
+class AnnotationStore {
+public:
+    void build(const struct segment &s, quint64 key);
+    quint64 key(void) const { return listingKey; }
+    int size(void) const { return offsets.size(); }
+    quint64 bytes(void) const;          // estimated heap use
+
+private:
+    friend class AnnotationCursor;
+
+    quint64 listingKey = 0;
+    QVector<quint64> offsets;
+    QVector<quint8> kinds;
+    QVector<QString> comments;
+    QVector<QString> labels;
+    QVector<quint16> lows, highs;       // the address they are part of
+};
+
+class AnnotationCursor {
+public:
+    explicit AnnotationCursor(const AnnotationStore *store) : a(store) {}
+
+    // true if anything is attached to offset. Offsets are expected to go
+    // up, going back costs a binary search.
+    bool at(quint64 offset);
+
+    quint8 kinds(void) const { return a->kinds.at(pos); }
+    const QString &comment(void) const { return a->comments.at(pos); }
+    const QString &label(void) const { return a->labels.at(pos); }
+    quint16 lowTarget(void) const { return a->lows.at(pos); }
+    quint16 highTarget(void) const { return a->highs.at(pos); }
+
+private:
+    const AnnotationStore *a;
+    int pos = 0;
+};
+
+#endif // ANNOTATIONS_H
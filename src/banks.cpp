@@ -0,0 +1,214 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+
+#include "banks.h"
+#include "hash.h"
+#include "profiler.h"
+#include <cstring>
+
+BankGroups bankGroups;
+
+BankGroups::~BankGroups() {
+    clear();
+}
+
+// +16 to allow reading beyond the end of the last bank, as with segments
+
+int BankGroups::create(const QString &name, quint64 size) {
+    struct bankgroup g;
+
+    g.name = name;
+    g.size = size;
+    g.data      = new quint8[size + 16]();
+    g.datatypes = new quint8[size + 16]();
+    g.flags     = new quint8[size + 16]();
+    g.constants = new quint16[size + 16]();
+    profiler.allocation();
+
+    groups.append(g);
+    return groups.size() - 1;
+}
+
+int BankGroups::createFromImage(const QString &name, const quint8 *image,
+                       const QVector<quint64> &sizes, QVector<quint64> &offsets) {
+    QMultiHash<quint64, int> seen;              // hash --> bank
+    QVector<quint64> position;                  // of each bank in image
+    quint64 pos = 0, total = 0;
+
+    offsets.resize(sizes.size());
+
+    for (int i = 0; i < sizes.size(); i++) {
+        const quint8 *bank = image + pos;
+        quint64 h = xxh64(bank, sizes.at(i));
+        int same = -1;
+
+        for (int j : seen.values(h)) {
+            if (sizes.at(j) == sizes.at(i) &&
+                        !memcmp(image + position.at(j), bank, sizes.at(i))) {
+                same = j;
+                break;
+            }
+        }
+
+        position.append(pos);
+        pos += sizes.at(i);
+
+        if (same >= 0) {
+            offsets[i] = offsets.at(same);
+        } else {
+            seen.insert(h, i);
+            offsets[i] = total;
+            total += sizes.at(i);
+        }
+    }
+
+    int group = create(name, total);
+    quint8 *data = groups[group].data;
+
+    for (int i = 0; i < sizes.size(); i++)
+        memcpy(data + offsets.at(i), image + position.at(i), sizes.at(i));
+
+    return group;
+}
+
+void BankGroups::clear(void) {
+    truncate(0);
+}
+
+// after a failed load, its segments have to be dropped first
+
+void BankGroups::truncate(int size) {
+    while (groups.size() > size) {
+        struct bankgroup &g = groups.last();
+        delete[] g.data;
+        delete[] g.datatypes;
+        delete[] g.flags;
+        delete[] g.constants;
+        groups.removeLast();
+    }
+}
+
+struct segment BankGroups::createBank(int group, int bank, quint64 offset,
+                                      quint64 start, quint64 end) const {
+    const struct bankgroup &g = groups.at(group);
+
+    struct segment segment = {
+        start, end, QString(""),
+        g.data + offset, g.datatypes + offset, g.flags + offset,
+        QMap<quint64, QString>(),
+        g.sharedLabels,
+        QMap<quint64, quint16>(),
+        QMap<quint64, quint16>(),
+        g.constants + offset,
+        group, bank,
+        QList<struct disassembly>(),
+        0,
+        nullptr,
+        nullptr,
+        0, 0, 0
+    };
+    return segment;
+}
+
+void BankGroups::release(struct segment &s) {
+    if (s.bankGroup == BANKGROUP_NONE) {
+        delete[] s.data;
+        delete[] s.datatypes;
+        delete[] s.flags;
+        delete[] s.constants;
+    }
+    s.data = s.datatypes = s.flags = nullptr;
+    s.constants = nullptr;
+}
+
+quint64 BankGroups::offset(const struct segment &s) const {
+    if (!contains(s.bankGroup))
+        return 0;
+    return s.data - groups.at(s.bankGroup).data;
+}
+
+QVector<int> BankGroups::banks(int group) const {
+    QVector<int> list;
+
+    for (int i = 0; i < segments.size(); i++) {
+        if (segments.at(i).bankGroup == group)
+            list.append(i);
+    }
+    return list;
+}
+
+// for the segment table, empty if s is not a bank
+
+QString BankGroups::describe(const struct segment &s) const {
+    if (!contains(s.bankGroup))
+        return QString();
+
+    QString text = QStringLiteral("%1 #%2").arg(groups.at(s.bankGroup).name).arg(s.bank);
+
+    for (const auto &other : segments) {
+        if (other.bankGroup == s.bankGroup && other.data == s.data &&
+                                              other.bank < s.bank) {
+            text += QStringLiteral(" = #%1").arg(other.bank);
+            break;
+        }
+    }
+    return text;
+}
+
+// ---------------------------------------------------------------------------
+
+void BankGroups::shareLabel(int group, quint64 address, const QString &name) {
+    if (!contains(group))
+        return;
+
+    groups[group].sharedLabels.insert(address, name);
+    for (auto &s : segments) {
+        if (s.bankGroup == group)
+            s.localLabels.insert(address, name);
+    }
+}
+
+void BankGroups::unshareLabel(int group, quint64 address) {
+    if (!contains(group) || !groups.at(group).sharedLabels.contains(address))
+        return;
+
+    groups[group].sharedLabels.remove(address);
+    for (auto &s : segments) {
+        if (s.bankGroup == group)
+            s.localLabels.remove(address);
+    }
+}
+
+// a shared label keeps one name in all banks
+
+void BankGroups::renameLabel(int group, quint64 address, const QString &name) {
+    if (contains(group) && groups.at(group).sharedLabels.contains(address))
+        shareLabel(group, address, name);
+}
+
+// when loading a project, the banks already have the labels
+
+void BankGroups::setSharedLabels(int group, const QMap<quint64, QString> &labels) {
+    if (contains(group))
+        groups[group].sharedLabels = labels;
+}
@@ -0,0 +1,87 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+
+#ifndef BANKS_H
+#define BANKS_H
+
+#include "pch.h"
+
+// The banks of a bank-switched cartridge are segments that share one set
+// of buffers. Each bank keeps its own address range, comments and local
+// labels, its data, datatypes, flags and constants point into the backing
+// of its group. Labels can be shared, they are then kept in every bank.
+// Banks with identical contents point at the same part of the backing, so
+// their datatypes and flags are annotated once.
+
+#define BANKGROUP_NONE  -1              // in segment.bankGroup
+
+struct bankgroup {
+    QString name;
+    quint64 size;                       // of the backing buffers
+    quint8 *data;
+    quint8 *datatypes;
+    quint8 *flags;
+    quint16 *constants;
+    QMap<quint64, QString> sharedLabels;
+};
+
+class BankGroups {
+public:
+    ~BankGroups();
+
+    int create(const QString &name, quint64 size);
+
+    // a group for the banks of an image, identical banks are stored once,
+    // offsets receives the offset in the backing of each bank
+    int createFromImage(const QString &name, const quint8 *image,
+                        const QVector<quint64> &sizes, QVector<quint64> &offsets);
+    void clear(void);
+    void truncate(int size);                    // drops the newer groups
+
+    // a new segment viewing size bytes at offset of group's backing
+    struct segment createBank(int group, int bank, quint64 offset,
+                              quint64 start, quint64 end) const;
+
+    // frees the buffers of s, unless they are part of a backing
+    static void release(struct segment &s);
+
+    bool contains(int group) const { return group >= 0 && group < groups.size(); }
+    const struct bankgroup &group(int id) const { return groups.at(id); }
+    int size(void) const { return groups.size(); }
+
+    quint64 offset(const struct segment &s) const;
+    QVector<int> banks(int group) const;        // indices in segments
+    QString describe(const struct segment &s) const;
+
+    void shareLabel(int group, quint64 address, const QString &name);
+    void unshareLabel(int group, quint64 address);
+    void renameLabel(int group, quint64 address, const QString &name);
+    void setSharedLabels(int group, const QMap<quint64, QString> &labels);
+
+private:
+    QVector<struct bankgroup> groups;
+};
+
+extern BankGroups bankGroups;
+
+#endif // BANKS_H
@@ -0,0 +1,266 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#include "bytesearch.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define HAVE_SSE2
+#endif
+
+#define MAX_PATTERN     256
+#define CHUNK_SIZE      (1 << 20)
+
+// ----------------------------------------------------------------------------
+// PATTERN
+
+static int nibble(QChar c) {
+    if (c >= QLatin1Char('0') && c <= QLatin1Char('9'))
+        return c.unicode() - '0';
+    if (c >= QLatin1Char('a') && c <= QLatin1Char('f'))
+        return c.unicode() - 'a' + 10;
+    if (c >= QLatin1Char('A') && c <= QLatin1Char('F'))
+        return c.unicode() - 'A' + 10;
+    if (c == QLatin1Char('?') || c == QLatin1Char('x') || c == QLatin1Char('X'))
+        return -1;
+    return -2;
+}
+
+bool BytePattern::parse(const QString &text, QString *error) {
+    values.clear();
+    masks.clear();
+
+    const QStringList tokens = text.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+
+    for (QString token : tokens) {
+        int maskValue = 0xff;
+        int slash = token.indexOf(QLatin1Char('/'));
+
+        if (slash >= 0) {
+            bool ok;
+            maskValue = token.mid(slash+1).toInt(&ok, 16);
+            if (!ok || maskValue > 0xff || token.size() - slash - 1 != 2) {
+                *error = QStringLiteral("invalid mask in ") + token;
+                return false;
+            }
+            token = token.left(slash);
+        }
+
+        if (token.startsWith(QLatin1Char('$')))
+            token = token.mid(1);
+
+        // longer tokens are taken as a string of bytes, "20ffff"
+
+        if (!token.size() || token.size() & 1 || (slash >= 0 && token.size() != 2)) {
+            *error = QStringLiteral("bytes need two digits: ") + token;
+            return false;
+        }
+
+        for (int i = 0; i < token.size(); i += 2) {
+            int hi = nibble(token.at(i));
+            int lo = nibble(token.at(i+1));
+            if (hi == -2 || lo == -2) {
+                *error = QStringLiteral("not a hex digit or wildcard: ") + token;
+                return false;
+            }
+
+            quint8 m = (hi < 0 ? 0x00 : 0xf0) | (lo < 0 ? 0x00 : 0x0f);
+            quint8 v = (hi < 0 ? 0 : hi << 4) | (lo < 0 ? 0 : lo);
+            m &= maskValue;
+            values.append(v & m);
+            masks.append(m);
+        }
+    }
+
+    if (values.isEmpty()) {
+        *error = QStringLiteral("empty pattern");
+        return false;
+    }
+    if (values.size() > MAX_PATTERN) {
+        *error = QStringLiteral("pattern is longer than %1 bytes").arg(MAX_PATTERN);
+        return false;
+    }
+
+    // the skip table considers every byte that could match at each position,
+    // so wildcards limit the skip distance to what remains after them
+
+    int m = values.size();
+    for (int &s : shift)
+        s = m;
+    for (int j = 0; j < m-1; j++)
+        for (int c = 0; c < 256; c++)
+            if ((c & masks.at(j)) == values.at(j))
+                shift[c] = m - 1 - j;
+
+    int minShift = m;
+    for (int s : shift)
+        if (s < minShift)
+            minShift = s;
+
+    anchor = -1;
+    for (int j = 0; j < m; j++) {
+        if (masks.at(j) == 0xff) {
+            anchor = j;
+            break;
+        }
+    }
+
+    // short patterns or patterns full of wildcards barely skip, a scan for
+    // a byte that must be there is quicker then
+
+    useHorspool = anchor < 0 || minShift >= 4;
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// SEARCH
+
+bool BytePattern::matchesAt(const quint8 *p) const {
+    for (int j = 0; j < values.size(); j++)
+        if ((p[j] & masks.at(j)) != values.at(j))
+            return false;
+    return true;
+}
+
+// First position in [p,end) that holds byte b, or end.
+
+static const quint8 *findByte(const quint8 *p, const quint8 *end, quint8 b) {
+#ifdef HAVE_SSE2
+    const __m128i needle = _mm_set1_epi8((char) b);
+
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *) p);
+        int bits = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if (bits)
+            return p + qCountTrailingZeroBits((quint32) bits);
+        p += 16;
+    }
+    while (p < end && *p != b)
+        p++;
+    return p;
+#else
+    const void *r = memchr(p, b, end - p);
+    return r ? (const quint8 *) r : end;
+#endif
+}
+
+void BytePattern::search(const quint8 *data, quint64 size, quint64 from,
+                         quint64 to, QVector<quint64> &found) const {
+    quint64 m = values.size();
+
+    if (size < m)
+        return;
+    if (to > size - m + 1)
+        to = size - m + 1;
+    if (from >= to)
+        return;
+
+    if (useHorspool) {
+        quint8 lastMask = masks.at(m-1), lastValue = values.at(m-1);
+        for (quint64 i = from; i < to; i += shift[data[i+m-1]]) {
+            if ((data[i+m-1] & lastMask) == lastValue && matchesAt(data + i))
+                found.append(i);
+        }
+        return;
+    }
+
+    const quint8 *p   = data + from + anchor;
+    const quint8 *end = data + to + anchor;
+    quint8 b = values.at(anchor);
+
+    while ((p = findByte(p, end, b)) < end) {
+        const quint8 *start = p - anchor;
+        if (matchesAt(start))
+            found.append(start - data);
+        p++;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// PARALLEL
+
+namespace {
+struct chunk {
+    int segment;
+    quint64 from, to;
+    QVector<quint64> found;
+};
+}
+
+int searchSegments(const BytePattern &pattern,
+                   const std::function<bool(const struct bytematch &)> &found) {
+    QVector<struct chunk> chunks;
+    QList<int> finished;
+    QMutex mutex;
+    QThreadPool pool;
+    QAtomicInt cancel(0);
+    int reported = 0;
+
+    // big segments are cut up, so one huge ROM keeps all cores busy
+
+    for (int i = 0; i < segments.size(); i++) {
+        quint64 size = segments.at(i).end - segments.at(i).start + 1;
+        for (quint64 from = 0; from < size; from += CHUNK_SIZE)
+            chunks.append({ i, from, qMin(from + CHUNK_SIZE, size), {} });
+    }
+
+    for (int c = 0; c < chunks.size(); c++) {
+        pool.start([&, c]() {
+            struct chunk *ch = &chunks[c];
+            const struct segment *s = &segments.at(ch->segment);
+            if (!cancel.loadRelaxed())
+                pattern.search(s->data, s->end - s->start + 1,
+                               ch->from, ch->to, ch->found);
+            QMutexLocker lock(&mutex);
+            finished.append(c);
+        });
+    }
+
+    // hand out results while the pool works, user input is held back so
+    // segments cannot change underneath the workers
+
+    bool done = false;
+    while (!done) {
+        done = pool.waitForDone(20);
+
+        mutex.lock();
+        QList<int> ready = finished;
+        finished.clear();
+        mutex.unlock();
+
+        for (int c : qAsConst(ready)) {
+            for (quint64 offset : qAsConst(chunks.at(c).found)) {
+                if (cancel.loadRelaxed())
+                    break;
+                if (!found({ chunks.at(c).segment, offset }))
+                    cancel.storeRelaxed(1);
+                else
+                    reported++;
+            }
+        }
+
+        QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+    }
+
+    return reported;
+}
@@ -0,0 +1,63 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef BYTESEARCH_H
+#define BYTESEARCH_H
+
+#include "pch.h"
+#include <functional>
+
+// A byte pattern like "20 ?? ff" or "a9 0? 8d". Each byte has a value and
+// a mask. A '?' (or 'x') masks out a nibble, "vv/mm" gives an explicit mask.
+
+class BytePattern {
+public:
+    bool parse(const QString &text, QString *error);
+    int size(void) const { return values.size(); }
+
+    // offsets in [from,to) where a match starts, data holds size bytes
+
+    void search(const quint8 *data, quint64 size, quint64 from, quint64 to,
+                QVector<quint64> &found) const;
+
+    bool matchesAt(const quint8 *p) const;
+
+private:
+    QVector<quint8> values, masks;
+    int anchor;                         // first byte without wildcards
+    int shift[256];                     // Horspool skip on the last byte
+    bool useHorspool;
+};
+
+struct bytematch {
+    int segment;
+    quint64 offset;                     // relative to segment start
+};
+
+// Search all segments on a thread pool. found is called on the calling
+// thread as results come in, in no particular order, and can return false
+// to stop. Returns the number of matches that were reported.
+
+int searchSegments(const BytePattern &pattern,
+                   const std::function<bool(const struct bytematch &)> &found);
+
+#endif // BYTESEARCH_H
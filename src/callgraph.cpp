@@ -0,0 +1,326 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#include "callgraph.h"
+#include "disassembler.h"
+#include "flowgraph.h"
+#include "profiler.h"
+#include "symbollibrary.h"
+#include <algorithm>
+
+CallGraph callGraph;
+
+// ---------------------------------------------------------------------------
+// ONE SEGMENT
+
+// the blocks that can be reached from start, and what they call
+
+static void claim(const FlowGraph *flow, const QSet<int> &entryBlocks,
+                  QVector<int> &owner, int start, int index,
+                  struct routine &r) {
+    QVector<int> work;
+    QVector<int> blocks;
+
+    owner[start] = index;
+    work.append(start);
+
+    while (!work.isEmpty()) {
+        int b = work.takeLast();
+        blocks.append(b);
+
+        for (int e : flow->block(b).out) {
+            const struct flowedge &edge = flow->edge(e);
+
+            if (edge.kind == EDGE_CALL) {
+                r.calls.append(edge.target);
+            } else if (edge.kind != EDGE_INDIRECT && edge.to >= 0) {
+                if (entryBlocks.contains(edge.to) && edge.to != start) {
+                    r.calls.append(edge.target);
+                } else if (owner.at(edge.to) < 0) {
+                    owner[edge.to] = index;
+                    work.append(edge.to);
+                }
+            }
+        }
+    }
+
+    std::sort(blocks.begin(), blocks.end());
+    for (int b : qAsConst(blocks)) {
+        const struct basicblock &block = flow->block(b);
+        if (!r.ranges.isEmpty() && r.ranges.last().second + 1 == block.start)
+            r.ranges.last().second = block.end;
+        else
+            r.ranges.append(qMakePair(block.start, block.end));
+    }
+
+    std::sort(r.calls.begin(), r.calls.end());
+    r.calls.erase(std::unique(r.calls.begin(), r.calls.end()), r.calls.end());
+}
+
+// called routines first, then code that nothing flows into, then what is
+// only reached from code that is left over
+
+void CallGraph::analyse(int segment, const FlowGraph *flow,
+                        struct segmentroutines &out) {
+    QVector<int> owner(flow->size(), -1);
+    QSet<int> entryBlocks;
+
+    out.routines.clear();
+
+    for (quint64 entry : qAsConst(out.entries))
+        entryBlocks.insert(flow->blockStartingAt(entry));
+
+    auto add = [&](int b, bool called) {
+        struct routine r = { segment, flow->block(b).start, {}, {}, {}, {},
+                             called };
+        claim(flow, entryBlocks, owner, b, out.routines.size(), r);
+        out.routines.append(r);
+    };
+
+    for (quint64 entry : qAsConst(out.entries))
+        add(flow->blockStartingAt(entry), true);
+
+    for (int b = 0; b < flow->size(); b++) {
+        bool reached = false;
+
+        if (owner.at(b) >= 0)
+            continue;
+        for (int e : flow->block(b).in)
+            reached |= flow->edge(e).kind != EDGE_CALL;
+        if (!reached)
+            add(b, false);
+    }
+
+    for (int b = 0; b < flow->size(); b++)
+        if (owner.at(b) < 0)
+            add(b, false);
+
+    std::sort(out.routines.begin(), out.routines.end(),
+              [](const struct routine &a, const struct routine &b) {
+                  return a.entry < b.entry;
+              });
+}
+
+// ---------------------------------------------------------------------------
+// ALL SEGMENTS
+
+// call targets, a call stays inside its own segment if it can. Calls into
+// another segment are kept for it until its flow graph is at hand.
+
+void CallGraph::addCalls(int segment) {
+    const struct segment &s = segments.at(segment);
+
+    if (segment == 0) {
+        entries = QVector<QVector<quint64>>(segments.size());
+        perSegment.resize(segments.size());
+        for (const auto &p : qAsConst(pending))
+            delete p.second;
+        pending.clear();
+    }
+
+    if (!s.flow)
+        return;
+
+    for (int e = 0; e < s.flow->edgeCount(); e++) {
+        const struct flowedge &edge = s.flow->edge(e);
+
+        if (edge.kind != EDGE_CALL)
+            continue;
+        if (edge.to >= 0) {
+            entries[segment].append(edge.target);
+            continue;
+        }
+        if (edge.target >= s.start && edge.target <= s.end)
+            continue;               // into data or an instruction
+
+        for (int j = 0; j < segments.size(); j++) {
+            const struct segment &t = segments.at(j);
+            if (j != segment && edge.target >= t.start && edge.target <= t.end)
+                entries[j].append(edge.target);
+        }
+    }
+}
+
+// only a segment with a new flow graph or new call targets is analysed, its
+// graph is copied as the listing cache may drop it before link()
+
+void CallGraph::addRoutines(int segment) {
+    ProfileScope scope("CallGraph::addRoutines");
+    QVector<quint64> list;
+    struct segmentroutines *cached = &perSegment[segment];
+    const FlowGraph *flow = segments.at(segment).flow;
+    quint64 key = flow ? flow->key() : 0;
+
+    if (flow)
+        for (quint64 entry : qAsConst(entries.at(segment)))
+            if (flow->blockStartingAt(entry) >= 0)
+                list.append(entry);
+
+    std::sort(list.begin(), list.end());
+    list.erase(std::unique(list.begin(), list.end()), list.end());
+
+    if (flow && cached->key == key && cached->entries == list)
+        return;
+
+    cached->key = key;
+    cached->entries = list;
+    cached->routines.clear();
+
+    if (flow)
+        pending.append(qMakePair(segment, new FlowGraph(*flow)));
+}
+
+void CallGraph::link(void) {
+    ProfileScope scope("CallGraph::link");
+    QThreadPool pool;
+
+    for (const auto &p : qAsConst(pending)) {
+        int segment = p.first;
+        const FlowGraph *flow = p.second;
+        struct segmentroutines *out = &perSegment[segment];
+        pool.start([segment, flow, out]() {
+            analyse(segment, flow, *out);
+        });
+    }
+    pool.waitForDone();
+
+    for (const auto &p : qAsConst(pending))
+        delete p.second;
+    pending.clear();
+
+    // one list, callers and callees by index
+
+    QHash<quint64, QVector<int>> byEntry;
+
+    routines.clear();
+    firstOfSegment.clear();
+
+    for (int i = 0; i < segments.size(); i++) {
+        firstOfSegment.append(routines.size());
+        for (struct routine r : qAsConst(perSegment.at(i).routines)) {
+            r.segment = i;
+            byEntry[r.entry].append(routines.size());
+            routines.append(r);
+        }
+    }
+    firstOfSegment.append(routines.size());
+
+    for (int r = 0; r < routines.size(); r++) {
+        for (quint64 target : qAsConst(routines.at(r).calls)) {
+            const QVector<int> candidates = byEntry.value(target);
+            bool local = false;
+
+            for (int c : candidates)
+                local |= routines.at(c).segment == routines.at(r).segment;
+
+            for (int c : candidates) {
+                if (local && routines.at(c).segment != routines.at(r).segment)
+                    continue;
+                if (routines.at(r).callees.contains(c))
+                    continue;
+                routines[r].callees.append(c);
+                routines[c].callers.append(r);
+            }
+        }
+    }
+
+    scope.count(PC_LINES, routines.size());
+}
+
+int CallGraph::routineAt(int segment, quint64 address) const {
+    if (segment < 0 || segment + 1 >= firstOfSegment.size())
+        return -1;
+
+    for (int r = firstOfSegment.at(segment); r < firstOfSegment.at(segment+1); r++) {
+        const auto &ranges = routines.at(r).ranges;
+        auto it = std::upper_bound(ranges.constBegin(), ranges.constEnd(), address,
+                        [](quint64 a, const QPair<quint64, quint64> &range) {
+                            return a < range.first;
+                        });
+
+        if (it != ranges.constBegin() && address <= (it - 1)->second)
+            return r;
+    }
+    return -1;
+}
+
+// ---------------------------------------------------------------------------
+// NAMES
+
+// The L labels of call targets are made where the call is disassembled, so
+// they are looked for in the segments of the callers, too.
+
+int CallGraph::nameRoutines(bool generateLocalLabels) const {
+    bool upper = Disassembler && Disassembler->toUpper;
+    int named = 0;
+
+    for (const auto &r : routines) {
+        QString generated = QStringLiteral("L%1").arg(r.entry, 4, 16, QChar('0'));
+        QString name = QStringLiteral("sub_%1").arg(r.entry, 4, 16, QChar('0'));
+        QSet<int> where;
+        bool labelled = symbolLibraries.contains(r.entry);
+        bool renamed = false;
+
+        if (upper) {
+            generated = generated.toUpper();
+            name = name.toUpper();
+        }
+
+        where.insert(r.segment);
+        for (int c : r.callers)
+            where.insert(routines.at(c).segment);
+
+        for (int i : qAsConst(where)) {
+            auto it = segments[i].localLabels.find(r.entry);
+            if (it == segments[i].localLabels.end())
+                continue;
+            if (*it == generated) {
+                *it = name;
+                renamed = true;
+            } else {
+                labelled = true;
+            }
+        }
+
+        auto it = globalLabels.find(r.entry);
+        if (it != globalLabels.end()) {
+            if (*it == generated) {
+                *it = name;
+                renamed = true;
+            } else {
+                labelled = true;
+            }
+        }
+
+        if (!labelled && !renamed) {
+            if (generateLocalLabels)
+                segments[r.segment].localLabels.insert(r.entry, name);
+            else
+                globalLabels.insert(r.entry, name);
+            renamed = true;
+        }
+
+        named += renamed;
+    }
+
+    return named;
+}
@@ -0,0 +1,87 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef CALLGRAPH_H
+#define CALLGRAPH_H
+
+#include "pch.h"
+
+// A subroutine starts at a call target, or at code that nothing flows
+// into, like the code after a return that is not called from anywhere.
+// It is made of the blocks that can be reached from there without a call.
+// A jump or fall through to the start of another routine is a tail call.
+
+struct routine {
+    int segment;
+    quint64 entry;
+    QVector<QPair<quint64, quint64>> ranges;    // first and last bytes, sorted
+    QVector<quint64> calls;             // addresses it calls or tail calls
+    QVector<int> callers, callees;      // routines
+    bool called;                        // false if found after a terminator
+};
+
+// Routines and who calls whom, over all segments. The flow graphs are
+// taken one segment at a time, so the listing cache can drop the others:
+// addCalls() for every segment, starting with 0, then addRoutines() for
+// every segment, each with the listing of that segment up-to-date, and
+// then link(). addRoutines() keeps a copy of the flow graph of a segment
+// that needs to be analysed, link() analyses them in parallel, one segment
+// per thread, before it connects the routines. A segment whose flow graph
+// and call targets did not change since the last time keeps its routines.
+// Calls into another segment go to the segment that has a block there, to
+// all of them if banks overlap.
+
+class CallGraph {
+public:
+    void addCalls(int segment);
+    void addRoutines(int segment);
+    void link(void);
+
+    int size(void) const { return routines.size(); }
+    const struct routine &routine(int i) const { return routines.at(i); }
+
+    int routineAt(int segment, quint64 address) const;  // -1 if none
+
+    // Labels routines without one, or with a generated L label, as sub_.
+    // Returns the number of routines that were named.
+    int nameRoutines(bool generateLocalLabels) const;
+
+private:
+    struct segmentroutines {
+        quint64 key = 0;                // of the flow graph
+        QVector<quint64> entries;       // called, sorted
+        QVector<struct routine> routines;
+    };
+
+    static void analyse(int segment, const FlowGraph *flow,
+                        struct segmentroutines &out);
+
+    QVector<QVector<quint64>> entries;  // call targets, by segment
+    QVector<QPair<int, FlowGraph *>> pending;   // copies to be analysed
+    QVector<struct segmentroutines> perSegment;
+    QVector<struct routine> routines;   // by segment and entry
+    QVector<int> firstOfSegment;        // index in routines, one extra
+};
+
+extern CallGraph callGraph;
+
+#endif // CALLGRAPH_H
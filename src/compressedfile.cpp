@@ -0,0 +1,378 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+
+#include "compressedfile.h"
+#include "loaders.h"
+#include <cstring>
+
+#define CHUNK_SIZE  16384
+
+// ---------------------------------------------------------------------------
+
+InflateDevice::InflateDevice(QIODevice *source, const struct compressedstream &stream) :
+    source(source), stream(stream)
+{
+    setObjectName(stream.name);
+    memset(&strm, 0, sizeof(strm));
+}
+
+InflateDevice::~InflateDevice() {
+    if (zinit)
+        inflateEnd(&strm);
+}
+
+// Streams of unknown size are inflated once to count their bytes, which
+// also rejects corrupted data early. Nothing of it is kept.
+
+bool InflateDevice::open(OpenMode mode) {
+    if (mode & WriteOnly)
+        return false;
+
+    in.resize(CHUNK_SIZE);
+    out.resize(CHUNK_SIZE);
+
+    if (stream.method != COMPRESSION_STORED) {
+        int windowBits = stream.method == COMPRESSION_DEFLATE ? -MAX_WBITS
+                                                              : MAX_WBITS + 32;
+        if (inflateInit2(&strm, windowBits) != Z_OK) {
+            setErrorString(QStringLiteral("Unable to initialize zlib"));
+            return false;
+        }
+        zinit = true;
+    }
+
+    if (!restart())
+        return false;
+
+    if (stream.size < 0) {
+        while (fill())
+            ;
+        if (failed)
+            return false;
+        stream.size = produced;
+        if (!restart())
+            return false;
+    }
+
+    // our own buffers are enough, also keeps ungetChar() simple
+
+    return QIODevice::open(mode | Unbuffered);
+}
+
+void InflateDevice::close() {
+    if (zinit)
+        inflateEnd(&strm);
+    zinit = false;
+    QIODevice::close();
+}
+
+bool InflateDevice::isSequential() const {
+    return false;
+}
+
+qint64 InflateDevice::size() const {
+    return stream.size;
+}
+
+qint64 InflateDevice::writeData(const char *, qint64) {
+    return -1;
+}
+
+bool InflateDevice::restart(void) {
+    if (zinit && inflateReset(&strm) != Z_OK)
+        return false;
+
+    strm.avail_in = 0;
+    consumed = 0;
+    produced = 0;
+    position = 0;
+    outStart = outEnd = 0;
+    finished = failed = false;
+    return true;
+}
+
+// Next piece of uncompressed data into out, false at the end of the
+// stream or on errors. A stream that comes out at another size than it
+// said it has is damaged.
+
+bool InflateDevice::fill(void) {
+    bool more = inflateNext();
+
+    produced += outEnd;
+
+    if (!failed && stream.size >= 0 && (produced > stream.size ||
+                                (finished && produced != stream.size))) {
+        setErrorString(QStringLiteral("%1 is damaged, it does not have the size "
+                                      "it was stored with").arg(stream.name));
+        finished = failed = true;
+        outEnd = 0;
+        more = false;
+    }
+    return more;
+}
+
+// the same, for fill(), which keeps count
+
+bool InflateDevice::inflateNext(void) {
+    if (finished)
+        return false;
+
+    outStart = outEnd = 0;
+
+    if (stream.method == COMPRESSION_STORED) {
+        qint64 n = qMin((qint64) CHUNK_SIZE, stream.csize - consumed);
+        if (n <= 0) {
+            finished = true;
+            return false;
+        }
+        if (!source->seek(stream.offset + consumed) ||
+                (n = source->read(out.data(), n)) <= 0) {
+            setErrorString(QStringLiteral("%1 is truncated").arg(stream.name));
+            finished = failed = true;
+            return false;
+        }
+        consumed += n;
+        outEnd = n;
+        return true;
+    }
+
+    while (!outEnd && !finished) {
+        if (!strm.avail_in) {
+            qint64 n = qMin((qint64) CHUNK_SIZE, stream.csize - consumed);
+            if (n <= 0 || !source->seek(stream.offset + consumed) ||
+                    (n = source->read(in.data(), n)) <= 0) {
+                // the input ended before the end of the deflate stream
+                setErrorString(QStringLiteral("%1 is truncated").arg(stream.name));
+                finished = failed = true;
+                outEnd = 0;
+                break;
+            }
+            consumed += n;
+            strm.next_in = (Bytef *) in.data();
+            strm.avail_in = n;
+        }
+
+        strm.next_out = (Bytef *) out.data();
+        strm.avail_out = CHUNK_SIZE;
+
+        int ret = inflate(&strm, Z_NO_FLUSH);
+
+        outEnd = CHUNK_SIZE - strm.avail_out;
+
+        if (ret == Z_STREAM_END) {
+            finished = true;
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            setErrorString(QStringLiteral("zlib error: %1").arg(ret));
+            finished = failed = true;
+            outEnd = 0;
+        }
+    }
+
+    return outEnd > 0;
+}
+
+qint64 InflateDevice::readData(char *data, qint64 maxSize) {
+    qint64 done = 0;
+
+    while (done < maxSize) {
+        if (outStart == outEnd && !fill())
+            break;
+
+        qint64 n = qMin(maxSize - done, (qint64) (outEnd - outStart));
+        memcpy(data + done, out.constData() + outStart, n);
+        outStart += n;
+        position += n;
+        done += n;
+    }
+
+    if (!done && failed)
+        return -1;
+    return done;
+}
+
+bool InflateDevice::seek(qint64 pos) {
+    if (pos < 0 || pos > stream.size)
+        return false;
+
+    qint64 bufferStart = position - outStart;
+
+    if (pos >= bufferStart && pos <= position + (outEnd - outStart)) {
+        outStart = pos - bufferStart;
+        position = pos;
+    } else {
+        if (pos < position && !restart())
+            return false;
+
+        while (position < pos) {
+            if (outStart == outEnd && !fill())
+                return false;
+
+            qint64 n = qMin(pos - position, (qint64) (outEnd - outStart));
+            outStart += n;
+            position += n;
+        }
+    }
+
+    return QIODevice::seek(pos);
+}
+
+// ---------------------------------------------------------------------------
+// ZIP
+
+#define ZIP_LOCAL_HEADER    0x04034b50
+#define ZIP_CENTRAL_HEADER  0x02014b50
+#define ZIP_END_OF_CENTRAL  0x06054b50
+
+static bool read_zip(QFile &file, QVector<struct compressedstream> &streams) {
+    qint64 filesize = file.size();
+    qint64 tail = qMin(filesize, (qint64) (22 + 65535));   // EOCD + comment
+
+    file.seek(filesize - tail);
+    QByteArray end = file.read(tail);
+    if (end.size() != tail)
+        return false;
+
+    auto *e = (const quint8 *) end.constData();
+    int i;
+
+    for (i = tail - 22; i >= 0; i--) {
+        if ((quint32) LE32(e+i) == ZIP_END_OF_CENTRAL)
+            break;
+    }
+    if (i < 0)
+        return false;
+
+    int entries = LE16(e+i+10);
+    qint64 cdsize = (quint32) LE32(e+i+12);
+    qint64 cdoffset = (quint32) LE32(e+i+16);
+
+    file.seek(cdoffset);
+    QByteArray central = file.read(cdsize);
+    if (central.size() != cdsize)
+        return false;
+
+    auto *c = (const quint8 *) central.constData();
+    qint64 pos = 0;
+
+    for (int n = 0; n < entries && pos + 46 <= cdsize; n++) {
+        const quint8 *h = c + pos;
+        if ((quint32) LE32(h) != ZIP_CENTRAL_HEADER)
+            return false;
+
+        int flags       = LE16(h+8);
+        int method      = LE16(h+10);
+        qint64 csize    = (quint32) LE32(h+20);
+        qint64 size     = (quint32) LE32(h+24);
+        int namelen     = LE16(h+28);
+        int extralen    = LE16(h+30);
+        int commentlen  = LE16(h+32);
+        qint64 local    = (quint32) LE32(h+42);
+
+        if (pos + 46 + namelen > cdsize)
+            return false;
+
+        QString name = QString::fromUtf8((const char *) h + 46, namelen);
+        pos += 46 + namelen + extralen + commentlen;
+
+        // skip directories, encrypted and unsupported members
+
+        if (name.endsWith(QLatin1Char('/')) || (flags & 1) ||
+                (method != COMPRESSION_STORED && method != COMPRESSION_DEFLATE))
+            continue;
+
+        // the data starts after the local header, its extra field can
+        // differ from the central one
+
+        quint8 lh[30];
+        file.seek(local);
+        if (file.read((char *) lh, 30) != 30 || (quint32) LE32(lh) != ZIP_LOCAL_HEADER)
+            return false;
+
+        qint64 offset = local + 30 + LE16(lh+26) + LE16(lh+28);
+
+        streams.append({ name.section(QLatin1Char('/'), -1, -1), method, offset, csize, size });
+    }
+
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+QVector<struct compressedstream> compressedStreams(QFile &file) {
+    QVector<struct compressedstream> streams;
+    qint64 filesize = file.size();
+    quint8 magic[4];
+
+    file.seek(0);
+    if (filesize < 4 || file.read((char *) magic, 4) != 4)
+        return streams;
+
+    if ((quint32) LE32(magic) == ZIP_LOCAL_HEADER) {
+        if (!read_zip(file, streams))
+            streams.clear();
+        return streams;
+    }
+
+    // gzip, or a zlib header with deflate and a valid check value
+
+    bool gzip = magic[0] == 0x1f && magic[1] == 0x8b;
+    bool zlib = (magic[0] & 0x0f) == Z_DEFLATED && (magic[0] >> 4) <= 7 &&
+                BE16(magic) % 31 == 0;
+
+    if (!gzip && !zlib)
+        return streams;
+
+    QFileInfo info(file.fileName());
+    QString name = info.fileName();
+    QString suffix = info.suffix().toLower();
+
+    if (suffix == QLatin1String("gz") || suffix == QLatin1String("z") ||
+            suffix == QLatin1String("zlib"))
+        name.truncate(name.size() - suffix.size() - 1);
+
+    struct compressedstream stream = { name, COMPRESSION_ZLIB, 0, filesize, -1 };
+
+    // gzip keeps the size in its trailer, modulo 4 GB. Only one member is
+    // supported, of more the trailer has the size of the last one only.
+
+    if (gzip) {
+        quint8 isize[4];
+        if (filesize < 18 || !file.seek(filesize - 4) ||
+                file.read((char *) isize, 4) != 4)
+            return streams;
+        stream.size = (quint32) LE32(isize);
+    }
+
+    // a zlib header can occur by chance in plain files, see if it inflates.
+    // That counts its bytes as well, only the size is kept.
+
+    if (zlib) {
+        InflateDevice device(&file, stream);
+        if (!device.open(QIODevice::ReadOnly))
+            return streams;
+        stream.size = device.size();
+    }
+
+    streams.append(stream);
+    return streams;
+}
@@ -0,0 +1,95 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+
+#ifndef COMPRESSEDFILE_H
+#define COMPRESSEDFILE_H
+
+#include "pch.h"
+#include "zlib.h"
+
+// how a stream is stored, STORED and DEFLATE are the zip methods
+
+#define COMPRESSION_STORED      0
+#define COMPRESSION_DEFLATE     8       // raw deflate, zip members
+#define COMPRESSION_ZLIB        0x100   // gzip or zlib wrapped deflate
+
+// one stream inside a compressed file
+
+struct compressedstream {
+    QString name;           // member name, or the file name without .gz
+    int method;             // COMPRESSION_*
+    qint64 offset;          // of the compressed data
+    qint64 csize;           // compressed size
+    qint64 size;            // uncompressed size, -1 if unknown
+};
+
+// Read only, random access view of one stream. Data is inflated on demand
+// through two fixed size buffers, seeking backwards starts over. A stream
+// of unknown size is inflated once when it is opened, to count its bytes.
+// The data has to come out at the size of the stream. The source device is
+// shared, so streams of one file can be read one after the other without
+// reopening it.
+
+class InflateDevice : public QIODevice {
+public:
+    InflateDevice(QIODevice *source, const struct compressedstream &stream);
+    ~InflateDevice() override;
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override;
+    qint64 size() const override;
+    bool seek(qint64 pos) override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    bool restart(void);
+    bool fill(void);
+    bool inflateNext(void);
+
+    QIODevice *source;
+    struct compressedstream stream;
+
+    z_stream strm;
+    bool zinit = false;
+    bool finished = false;
+    bool failed = false;
+
+    QByteArray in, out;
+    int outStart = 0, outEnd = 0;
+    qint64 consumed = 0;        // compressed bytes taken from source
+    qint64 produced = 0;        // uncompressed bytes put in out
+    qint64 position = 0;        // uncompressed position of out[outStart]
+
+    Q_DISABLE_COPY(InflateDevice)
+};
+
+// The streams inside a gzip, zlib or zip file, empty if file is not
+// compressed. file has to be open, its position is undefined afterwards.
+
+extern QVector<struct compressedstream> compressedStreams(QFile &file);
+
+#endif // COMPRESSEDFILE_H
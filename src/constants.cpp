@@ -0,0 +1,161 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#include "constants.h"
+
+ConstantsGroups constantsGroups;
+
+// ----------------------------------------------------------------------------
+// GROUP
+
+static inline quint64 slotOf(quint64 value, int size) {
+    return (value * 0x9e3779b97f4a7c15ULL) >> 32 & (size - 1);
+}
+
+QString ConstantsGroup::find(quint64 value) const {
+    int size = table.size();
+
+    for (quint64 i = slotOf(value, size); ; i = (i + 1) & (size - 1)) {
+        const struct slot &s = table.at(i);
+        if (s.name.isEmpty())
+            return QString();
+        if (s.value == value)
+            return s.name;
+    }
+}
+
+// value is not in the table yet
+
+void ConstantsGroup::place(quint64 value, const QString &name) {
+    int size = table.size();
+    quint64 i = slotOf(value, size);
+
+    while (!table.at(i).name.isEmpty())
+        i = (i + 1) & (size - 1);
+    table[i] = { value, name };
+}
+
+void ConstantsGroup::rebuild(void) {
+    direct.clear();
+    table.clear();
+    wide = !sorted.isEmpty() && sorted.lastKey() > 0xff;
+
+    if (!wide) {
+        if (!sorted.isEmpty())
+            direct.resize(256);
+        for (auto it = sorted.constBegin(); it != sorted.constEnd(); ++it)
+            direct[it.key()] = it.value();
+        return;
+    }
+
+    int size = 16;
+    while (size < sorted.size() * 2)
+        size *= 2;
+    table.resize(size);
+
+    for (auto it = sorted.constBegin(); it != sorted.constEnd(); ++it)
+        place(it.key(), it.value());
+}
+
+void ConstantsGroup::insert(quint64 value, const QString &name) {
+    bool known = sorted.contains(value);
+
+    sorted.insert(value, name);
+
+    if (!wide && value <= 0xff) {
+        if (direct.isEmpty())
+            direct.resize(256);
+        direct[value] = name;
+    } else if (!wide || known || table.size() < sorted.size() * 2) {
+        rebuild();
+    } else {
+        place(value, name);
+    }
+}
+
+void ConstantsGroup::remove(quint64 value) {
+    if (sorted.remove(value))
+        rebuild();
+}
+
+// ----------------------------------------------------------------------------
+// ALL GROUPS
+
+quint16 ConstantsGroups::add(const QString &name) {
+    int id = 1;
+
+    while (id < used.size() && used.at(id))
+        id++;
+    if (id > CONSTANTS_GROUP_MAX)
+        return CONSTANTS_GROUP_NONE;
+
+    insert(id, name);
+    return id;
+}
+
+bool ConstantsGroups::insert(quint16 id, const QString &name) {
+    if (id == CONSTANTS_GROUP_NONE || contains(id))
+        return false;
+
+    if (id >= used.size()) {
+        groups.resize(id + 1);
+        used.resize(id + 1);
+    }
+    groups[id] = ConstantsGroup();
+    groups[id].name = name;
+    used[id] = true;
+    count++;
+    return true;
+}
+
+void ConstantsGroups::remove(quint16 id) {
+    if (!contains(id))
+        return;
+
+    groups[id] = ConstantsGroup();
+    used[id] = false;
+    count--;
+
+    // the id will be handed out again
+
+    for (auto &s : segments) {
+        quint64 size = s.end - s.start + 1;
+        for (quint64 i = 0; i < size; i++)
+            if (s.constants[i] == id)
+                s.constants[i] = CONSTANTS_GROUP_NONE;
+    }
+}
+
+void ConstantsGroups::clear(void) {
+    groups.clear();
+    used.clear();
+    count = 0;
+}
+
+QList<quint16> ConstantsGroups::ids(void) const {
+    QList<quint16> list;
+
+    for (int id = 1; id < used.size(); id++)
+        if (used.at(id))
+            list.append(id);
+    return list;
+}
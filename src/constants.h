@@ -0,0 +1,104 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef CONSTANTS_H
+#define CONSTANTS_H
+
+#include "pch.h"
+
+#define CONSTANTS_GROUP_NONE    0       // in segment.constants[]
+#define CONSTANTS_GROUP_MAX     0xffff
+
+// A group of named values. As long as all values fit in a byte, names are
+// looked up in a 256-entry table. Wider groups use an open addressing hash.
+
+class ConstantsGroup {
+public:
+    QString name;
+
+    void insert(quint64 value, const QString &name);
+    void remove(quint64 value);
+
+    QString value(quint64 value) const {
+        if (!wide)
+            return value < (quint64) direct.size() ? direct.at(value) : QString();
+        return find(value);
+    }
+
+    // sorted by value, for the constants manager, export and save
+    const QMap<quint64, QString> &entries(void) const { return sorted; }
+    bool isEmpty(void) const { return sorted.isEmpty(); }
+
+private:
+    struct slot {
+        quint64 value;
+        QString name;                   // empty if the slot is free
+    };
+
+    QMap<quint64, QString> sorted;
+    QVector<QString> direct;            // 256 entries, or empty
+    QVector<struct slot> table;         // power of two, at most half full
+    bool wide = false;
+
+    QString find(quint64 value) const;
+    void place(quint64 value, const QString &name);
+    void rebuild(void);
+};
+
+// All groups, indexed by their id. Ids are small so a segment can keep one
+// per byte. The id of a deleted group is reused.
+
+class ConstantsGroups {
+public:
+    quint16 add(const QString &name);   // CONSTANTS_GROUP_NONE when full
+    bool insert(quint16 id, const QString &name);
+    void remove(quint16 id);            // also from all segments
+    void clear(void);
+
+    ConstantsGroup *group(quint16 id) {
+        return contains(id) ? &groups[id] : nullptr;
+    }
+    const ConstantsGroup *group(quint16 id) const {
+        return contains(id) ? &groups.at(id) : nullptr;
+    }
+    bool contains(quint16 id) const {
+        return id < used.size() && used.at(id);
+    }
+
+    // the name of value in group id, or empty
+    QString value(quint16 id, quint64 value) const {
+        return contains(id) ? groups.at(id).value(value) : QString();
+    }
+
+    QList<quint16> ids(void) const;     // ascending
+    bool isEmpty(void) const { return count == 0; }
+    int size(void) const { return count; }
+
+private:
+    QVector<ConstantsGroup> groups;     // [0] is never used
+    QVector<bool> used;
+    int count = 0;
+};
+
+extern ConstantsGroups constantsGroups;
+
+#endif // CONSTANTS_H
@@ -22,16 +22,11 @@
 
 #include "addconstantsgroupwindow.h"
 #include "addconstanttogroupwindow.h"
+#include "constants.h"
 #include "constantsmanager.h"
+#include "symbollibrary.h"
 #include "ui_constantsmanager.h"
 
-// Later, add BOTH constantsGroups and nextNewGroup to saved project!
-// nextNewGroup could be derived from last groupID+1, but saving it is
-// eassier.
-
-QMap<quint64, struct constantsGroup> constantsGroups;
-quint64 nextNewGroup = 0;
-
 constantsManager::constantsManager(QWidget *parent) :
     QDialog(parent),
     ui(new Ui::constantsManager)
@@ -90,15 +85,13 @@ void constantsManager::showGroups() {
     t->setRowCount(0);
     t->verticalHeader()->setDefaultAlignment(Qt::AlignRight);
 
-    QMap<quint64, struct constantsGroup>::iterator iter;
     quint64 row;
 
-    for (iter = constantsGroups.begin(); iter != constantsGroups.end(); ++iter) {
+    for (quint16 groupID : constantsGroups.ids()) {
         row = t->rowCount();
         t->setRowCount(row+1);
 
-        quint64 groupID = iter.key();
-        QString groupName = iter.value().name;
+        QString groupName = constantsGroups.group(groupID)->name;
 
         QString vhi = QStringLiteral("%1").arg(groupID);
         t->setVerticalHeaderItem(row, new QTableWidgetItem(vhi));
@@ -131,13 +124,13 @@ void constantsManager::onGroups_itemSelectionChanged() {
         return;
     }
 
-    quint64 groupID = tg->verticalHeaderItem(row)->text().toULongLong();
+    quint16 groupID = tg->verticalHeaderItem(row)->text().toUShort();
 
-    QMap<quint64, QString> *map = constantsGroups[groupID].map;
+    const QMap<quint64, QString> &map = constantsGroups.group(groupID)->entries();
 
-    QMap<quint64, QString>::iterator iter;
+    QMap<quint64, QString>::const_iterator iter;
 
-    for (iter = map->begin(); iter != map->end(); ++iter) {
+    for (iter = map.constBegin(); iter != map.constEnd(); ++iter) {
         row = tv->rowCount();
         tv->setRowCount(row+1);
 
@@ -167,15 +160,16 @@ void constantsManager::onGroups_cellChanged(int row, int column) {
 
     if (! tg->item(row,column)->isSelected()) return; // not a user action
 
-    quint64 groupID = tg->verticalHeaderItem(row)->text().toULongLong();
+    quint16 groupID = tg->verticalHeaderItem(row)->text().toUShort();
+    ConstantsGroup *group = constantsGroups.group(groupID);
 
     item = tg->item(row, column);
     QString contents = item->text();
 
     if (contents.isEmpty()) {
-        item->setText(constantsGroups[groupID].name);
+        item->setText(group->name);
     } else {
-        constantsGroups[groupID].name = contents;
+        group->name = contents;
     }
 }
 
@@ -195,9 +189,8 @@ void constantsManager::onValues_cellChanged(int row, int column) {
     QTableWidgetSelectionRange range = ranges.first();
     quint64 tgrow = range.topRow();
 
-    quint64 groupID = tg->verticalHeaderItem(tgrow)->text().toULongLong();
-
-    QMap<quint64, QString> *map = constantsGroups[groupID].map;
+    quint16 groupID = tg->verticalHeaderItem(tgrow)->text().toUShort();
+    ConstantsGroup *group = constantsGroups.group(groupID);
 
     index = tv->item(row, column-1);
     quint64 value = index->text().toULongLong(nullptr, 16);
@@ -206,9 +199,9 @@ void constantsManager::onValues_cellChanged(int row, int column) {
     QString contents = item->text();
 
     if (contents.isEmpty()) {
-        item->setText(map->value(value));
+        item->setText(group->value(value));
     } else {
-        map->insert(value, contents);
+        group->insert(value, contents);
     }
 }
 
@@ -225,8 +218,8 @@ void constantsManager::actionDeleteGroup(void) {
     QTableWidgetSelectionRange range = ranges.first();
     quint64 tgrow = range.topRow();
 
-    quint64 groupID = t->verticalHeaderItem(tgrow)->text().toULongLong();
-    QString groupName = constantsGroups[groupID].name;
+    quint16 groupID = t->verticalHeaderItem(tgrow)->text().toUShort();
+    QString groupName = constantsGroups.group(groupID)->name;
 
     QMessageBox msg;
     msg.setText("Do you really want to delete " + groupName + "?");
@@ -253,7 +246,7 @@ void constantsManager::actionDeleteValue(void) {
     QTableWidgetSelectionRange range = ranges.first();
     quint64 tgrow = range.topRow();
 
-    quint64 groupID = tg->verticalHeaderItem(tgrow)->text().toULongLong();
+    quint16 groupID = tg->verticalHeaderItem(tgrow)->text().toUShort();
 
     ranges = tv->selectedRanges();
     if (ranges.isEmpty())
@@ -272,9 +265,7 @@ void constantsManager::actionDeleteValue(void) {
     msg.setDefaultButton(QMessageBox::No);
     if(msg.exec() != QMessageBox::Yes) return;
 
-    QMap<quint64, QString> *map = constantsGroups[groupID].map;
-
-    map->remove(value);
+    constantsGroups.group(groupID)->remove(value);
     onGroups_itemSelectionChanged();    // reshow constants with one removed
 }
 
@@ -308,7 +299,7 @@ void constantsManager::onAddValue_clicked(void) {
     QTableWidgetSelectionRange range = ranges.first();
     quint64 tgrow = range.topRow();
 
-    quint64 groupID = t->verticalHeaderItem(tgrow)->text().toULongLong();
+    quint16 groupID = t->verticalHeaderItem(tgrow)->text().toUShort();
 
     if (actgw.constantValue < 0) {
         msg.setText(QStringLiteral("Invalid value specified!"));
@@ -317,8 +308,7 @@ void constantsManager::onAddValue_clicked(void) {
         return;
     }
 
-    QMap<quint64, QString> *map = constantsGroups[groupID].map;
-    map->insert(actgw.constantValue, actgw.constantName);
+    constantsGroups.group(groupID)->insert(actgw.constantValue, actgw.constantName);
     onGroups_itemSelectionChanged();    // reshow constants with new item
 }
 
@@ -329,6 +319,32 @@ void constantsManager::onImport_clicked(void) {
 
     if (name.isEmpty()) return;
 
+    // groups of a compiled symbol library are already sorted, no parsing
+
+    if (SymbolLibrary::isLibrary(name)) {
+        SymbolLibrary lib;
+        QString error;
+
+        if (!lib.open(name, &error)) {
+            QMessageBox::warning(this, QStringLiteral("Import"), error);
+            return;
+        }
+        for (int i = 0; i < lib.groupCount(); i++) {
+            quint16 groupID = constantsGroups.add(lib.groupName(i));
+            if (groupID == CONSTANTS_GROUP_NONE)
+                break;
+
+            QMap<quint64, QString> map;
+            lib.groupEntries(i, &map);
+
+            ConstantsGroup *group = constantsGroups.group(groupID);
+            for (auto it = map.constBegin(); it != map.constEnd(); ++it)
+                group->insert(it.key(), it.value());
+        }
+        showGroups();
+        return;
+    }
+
     QMessageBox msg;
 
     QFile file(name);
@@ -371,14 +387,12 @@ void constantsManager::onImport_clicked(void) {
         groupName = groupName.replace(QStringLiteral("["), QLatin1String(""));
         groupName = groupName.replace(QStringLiteral("]"), QLatin1String(""));
 
-        auto *group = new struct constantsGroup;
+        quint16 groupID = constantsGroups.add(groupName);
 
-        group->name = groupName;
-        group->map = new QMap<quint64, QString>;
-
-        constantsGroups.insert(nextNewGroup, *group);
+        if (groupID == CONSTANTS_GROUP_NONE)
+            goto errout;
 
-        nextNewGroup++;
+        ConstantsGroup *group = constantsGroups.group(groupID);
 
         while (true) {
             quint64 key;
@@ -401,7 +415,7 @@ void constantsManager::onImport_clicked(void) {
             if (value.isEmpty())  // empty line
                 break;
 
-            group->map->insert(key,value);
+            group->insert(key,value);
         }
     }
 
@@ -443,12 +457,13 @@ void constantsManager::onExport_clicked(void) {
 
     QTextStream out(&file);
 
-    for (const auto &group : qAsConst(constantsGroups)) {
-        out << "[" << group.name << "]" << Qt::endl;
+    for (quint16 groupID : constantsGroups.ids()) {
+        const ConstantsGroup *group = constantsGroups.group(groupID);
+        out << "[" << group->name << "]" << Qt::endl;
 
-        QMap<quint64, QString>::iterator iter;
+        QMap<quint64, QString>::const_iterator iter;
 
-        for (iter = group.map->begin(); iter != group.map->end(); ++iter) {
+        for (iter = group->entries().constBegin(); iter != group->entries().constEnd(); ++iter) {
             out << Qt::hex << Qt::showbase << iter.key() << " "
                 << iter.value() << Qt::endl;
         }
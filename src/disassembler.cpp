@@ -21,6 +21,13 @@
 // ---------------------------------------------------------------------------
 
 #include "disassembler.h"
+#include "annotations.h"
+#include "constants.h"
+#include "flowgraph.h"
+#include "listingcache.h"
+#include "profiler.h"
+#include "searchindex.h"
+#include "symbollibrary.h"
 
 class Disassembler *Disassembler;
 
@@ -103,6 +110,31 @@ static inline quint8 cbm_screen_to_ascii(quint8 v) {
     return 255;
 }
 
+quint8 textToAscii(int datatype, quint8 v) {
+    quint8 a;
+
+    switch (datatype) {
+    case DT_ASCII:                a = v;                            break;
+    case DT_ATASCII:              a = atascii_to_ascii(v);          break;
+    case DT_INVERSE_ATASCII:      a = atascii_to_ascii(v-128);      break;
+    case DT_PETSCII:              a = petscii_to_ascii(v);          break;
+    case DT_ANTIC_SCREEN:         a = antic_screen_to_ascii(v);     break;
+    case DT_INVERSE_ANTIC_SCREEN: a = antic_screen_to_ascii(v-128); break;
+    case DT_CBM_SCREEN:           a = cbm_screen_to_ascii(v);       break;
+    default:                      return 255;
+    }
+    return xisprint_ascii(a) ? a : 255;
+}
+
+// ---------------------------------------------------------------------------
+
+int opcodeBytes(const quint8 *p) {
+    if (cputype >= CT_ZILOG_Z80 &&
+            (p[0] == 0xcb || p[0] == 0xdd || p[0] == 0xed || p[0] == 0xfd))
+        return 2;
+    return 1;
+}
+
 // ---------------------------------------------------------------------------
 
 // Side effects:
@@ -122,15 +154,24 @@ void Disassembler::generateDisassembly(bool generateLocalLabels) {
     struct disassembly dis;
     QString hex;
     QString instr;
+    quint8 dir = DIR_NONE;
     int n;
     int perline;
     int prevtype;
     bool labelled;
+    bool annotated;
+    int globals = globalLabels.size();
+
+    ProfileScope scope("generateDisassembly");
+    scope.count(PC_BYTES, size);
 
     initTables();
-    dislist->clear();
 
-    // Check consistency of datatypes
+    // Check consistency of datatypes. This adds labels and changes types and
+    // flags, so it runs before the key of the listing is taken.
+
+    ProfileScope check("generateDisassembly: check");
+    check.count(PC_BYTES, size);
 
     for (quint64 i = 0; i < size; i++) {
         auto type = (enum datatypes)datatypes[i];
@@ -161,6 +202,7 @@ also_wrong:
                                                                 " bytes");
                 msg.exec();
                 datatypes[i] = DT_UNDEFINED_CODE; // Red error
+                dropListing();
                 return;
             }
             // check that all bytes are of the same type
@@ -188,6 +230,7 @@ also_wrong2:
                             QStringLiteral("%1").arg(n) + " bytes");
                 msg.exec();
                 datatypes[i] = DT_UNDEFINED_CODE; // Red error
+                dropListing();
                 return;
             }
             for (int j=1; j<n; j++) {
@@ -250,8 +293,41 @@ also_wrong2:
         }
     }
 
+    check.stop();
+
+    // generating again is a no-op if nothing changed since the listing was
+    // made
+
+    quint64 key = listingCache.key(*s, *this, generateLocalLabels);
+    bool cached = s->listingKey == key && !dislist->isEmpty();
+
+    if (cached || listingCache.fetch(*s, key)) {
+        buildAnnotations(key);
+        buildFlowGraph(key);
+        if (!cached)
+            searchIndex.invalidate(currentSegment);
+        if (globalLabels.size() != globals)
+            searchIndex.invalidate();
+        searchIndex.update(currentSegment);
+        listingCache.use(currentSegment);
+        scope.count(PC_LINES, dislist->size());
+        return;
+    }
+
+    dislist->clear();
+    searchIndex.invalidate(currentSegment);
+
+    // everything that is attached to the bytes, now that all labels exist
+
+    buildAnnotations(key);
+
+    AnnotationCursor annotation(s->annotations);
+
     // Generate disassembly
 
+    ProfileScope emitting("generateDisassembly: emit");
+    emitting.count(PC_BYTES, size);
+
     struct disassembly org = {};
     org.instruction = QStringLiteral(".org ");
     org.arguments = QString(hexPrefix + "%1" + hexSuffix).arg(s->start, 0, 16);
@@ -260,6 +336,7 @@ also_wrong2:
         org.arguments   = org.arguments.toUpper();
     }
     org.changes_pc = true;
+    org.directive = DIR_ORG;
     dislist->append(org);
 
     perline = 0;
@@ -279,6 +356,7 @@ also_wrong2:
                    (quint64) data[i+ 3] << 32 | (quint64) data[i+ 2]<<40 |
                    (quint64) data[i+ 1] << 48 | (quint64) data[i+ 0]<<56;
             instr = QStringLiteral(".xwordbe");
+            dir = DIR_XWORDBE;
             n = 16;
             goto do_directive;
 
@@ -292,6 +370,7 @@ also_wrong2:
                    (quint64) data[i+12] << 32 | (quint64) data[i+13]<<40 |
                    (quint64) data[i+14] << 48 | (quint64) data[i+15]<<56;
             instr = QStringLiteral(".xwordle");
+            dir = DIR_XWORDLE;
             n = 16;
             goto do_directive;
 
@@ -301,6 +380,7 @@ also_wrong2:
                   (quint64) data[i+3] << 32 | (quint64) data[i+2]<<40 |
                   (quint64) data[i+1] << 48 | (quint64) data[i+0]<<56;
             instr = QStringLiteral(".qwordbe");
+            dir = DIR_QWORDBE;
             n = 8;
             goto do_directive;
 
@@ -310,6 +390,7 @@ also_wrong2:
                   (quint64) data[i+4] << 32 | (quint64) data[i+5]<<40 |
                   (quint64) data[i+6] << 48 | (quint64) data[i+7]<<56;
             instr = QStringLiteral(".qwordle");
+            dir = DIR_QWORDLE;
             n = 8;
             goto do_directive;
 
@@ -317,6 +398,7 @@ also_wrong2:
             val = (quint32) data[i+3] <<  0 | (quint32) data[i+2]<<8 |
                   (quint32) data[i+1] << 16 | (quint32) data[i+0]<<24;
             instr = QStringLiteral(".dwordbe");
+            dir = DIR_DWORDBE;
             n = 4;
             goto do_directive;
 
@@ -324,18 +406,21 @@ also_wrong2:
             val = (quint32) data[i+0] <<  0 | (quint32) data[i+1]<<8 |
                   (quint32) data[i+2] << 16 | (quint32) data[i+3]<<24;
             instr = QStringLiteral(".dwordle");
+            dir = DIR_DWORDLE;
             n = 4;
             goto do_directive;
 
         case DT_WORDBE:
             val = (quint16) data[i+1] | (quint16) data[i]<<8;
             instr = QStringLiteral(".wordbe");
+            dir = DIR_WORDBE;
             n = 2;
             goto do_directive;
 
         case DT_WORDLE:
             val = (quint16) data[i] | (quint16) data[i+1]<<8;
             instr = QStringLiteral(".wordle");
+            dir = DIR_WORDLE;
             n = 2;
             goto do_directive;
 
@@ -343,36 +428,41 @@ also_wrong2:
         case DT_UNDEFINED_BYTES:
             val = data[i];
             instr = QStringLiteral(".byte");
+            dir = DIR_BYTE;
             n = 1;
 
 do_directive:
-            if (globalLabels.contains(start+i)
-                || s->localLabels.contains(start+i)) {
-                perline = 0; // always start new directive at label locations
-            }
-            if (s->comments.contains(start+i)) {
-                perline = 0;    // new directive at comment
+            annotated = annotation.at(i);
+
+            // always start new directive at label and comment locations
+
+            if (annotated && annotation.kinds() & (ANNOTATION_LABEL |
+                                                   ANNOTATION_COMMENT)) {
+                perline = 0;
             }
             hex.clear();
             if (s->flags[i] & FLAG_CONSTANT) {
-                quint64 groupID = s->constants.value(start+i);
-                hex = constantsGroups[groupID].map->value(val);
+                hex = constantsGroups.value(s->constants[i], val);
             }
             if (s->flags[i] & FLAG_USE_LABEL) {
                 hex = s->localLabels.value(val);
                 if (hex.isEmpty())
                     hex = globalLabels.value(val);
+                if (hex.isEmpty())
+                    hex = symbolLibraries.value(val);
             }
             if (s->flags[i] & FLAG_HIGH_BYTE || s->flags[i] & FLAG_LOW_BYTE) {
-                quint64 key;
-                if (s->flags[i] & FLAG_HIGH_BYTE)
-                    key = s->highbytes[i];
-                else
-                    key = s->lowbytes[i];
+                quint64 key = 0;
+                if (annotated && s->flags[i] & FLAG_HIGH_BYTE)
+                    key = annotation.highTarget();
+                else if (annotated)
+                    key = annotation.lowTarget();
 
                 hex = s->localLabels.value(key);
                 if (hex.isEmpty())
                     hex = globalLabels.value(key);
+                if (hex.isEmpty())
+                    hex = symbolLibraries.value(key);
                 if (hex.isEmpty())
                     hex = hexPrefix +
                           QStringLiteral("%1").arg(key, 4, 16, (QChar)'0') +
@@ -399,7 +489,7 @@ do_directive:
             if (toUpper)
                 instr = instr.toUpper();
             if (perline <= 0 || prevtype != type) {
-                dis = { start + i, instr, hex, n, false };
+                dis = { start + i, instr, hex, n, false, dir };
                 perline = 8;
                 prevtype = type;
                 dislist->append(dis);
@@ -413,36 +503,43 @@ do_directive:
         case DT_ATASCII:
             val = atascii_to_ascii(data[i]);
             instr = QStringLiteral(".atascii");
+            dir = DIR_ATASCII;
             goto do_string_directive;
 
         case DT_INVERSE_ATASCII:
             val = atascii_to_ascii(data[i]-128);
             instr = QStringLiteral(".invatascii");
+            dir = DIR_INVATASCII;
             goto do_string_directive;
 
         case DT_PETSCII:
             val = petscii_to_ascii(data[i]);
             instr = QStringLiteral(".petscii");
+            dir = DIR_PETSCII;
             goto do_string_directive;
 
         case DT_ANTIC_SCREEN:
             val = antic_screen_to_ascii(data[i]);
             instr = QStringLiteral(".anticscreen");
+            dir = DIR_ANTICSCREEN;
             goto do_string_directive;
 
         case DT_INVERSE_ANTIC_SCREEN:
             val = antic_screen_to_ascii(data[i]-128);
             instr = QStringLiteral(".invanticscreen");
+            dir = DIR_INVANTICSCREEN;
             goto do_string_directive;
 
         case DT_CBM_SCREEN:
             val = cbm_screen_to_ascii(data[i]);
             instr = QStringLiteral(".cbmscreen");
+            dir = DIR_CBMSCREEN;
             goto do_string_directive;
 
         case DT_ASCII:
             val = data[i];
             instr = QStringLiteral(".ascii");
+            dir = DIR_ASCII;
 
 do_string_directive:
             n = 1;
@@ -451,13 +548,12 @@ do_string_directive:
                 instr = instr.toUpper();
 
             // XXX do not start new directive when label contains + or -
-            if (globalLabels.contains(start+i)
-                || segments[currentSegment].localLabels.contains(start+i)
+            if ((annotation.at(i) && annotation.kinds() & (ANNOTATION_LABEL |
+                                                           ANNOTATION_COMMENT))
                 || perline <= 0
-                || prevtype != type
-                || s->comments.contains(start+i)) {
+                || prevtype != type) {
                 // start new directive at label location
-                dis = { start + i, instr, QString("\"\""), n, false };
+                dis = { start + i, instr, QString("\"\""), n, false, dir };
                 perline = 40;
                 prevtype = type;
                 dislist->append(dis);
@@ -482,4 +578,60 @@ do_string_directive:
             break;
         } // switch
     } // for
+
+    emitting.count(PC_LINES, dislist->size());
+    emitting.stop();
+
+    // new global labels show up in the other segments, too
+
+    if (globalLabels.size() != globals)
+        searchIndex.invalidate();
+    searchIndex.update(currentSegment);
+
+    listingCache.store(*s, key);
+    buildFlowGraph(key);
+    listingCache.use(currentSegment);
 };
+
+// after a failed check, there is no listing and nothing derived from it
+
+void Disassembler::dropListing(void) {
+    struct segment *s = &segments[currentSegment];
+
+    s->disassembly.clear();
+    s->listingKey = 0;
+    delete s->flow;
+    s->flow = nullptr;
+    searchIndex.invalidate(currentSegment);
+}
+
+// the key covers all annotations, so the store stays valid as long as the
+// listing it was made for
+
+void Disassembler::buildAnnotations(quint64 key) {
+    struct segment *s = &segments[currentSegment];
+
+    if (!s->annotations)
+        s->annotations = new AnnotationStore;
+    if (s->annotations->key() == key)
+        return;
+
+    ProfileScope scope("generateDisassembly: annotations");
+    s->annotations->build(*s, key);
+    scope.count(PC_LINES, s->annotations->size());
+}
+
+// the graph stays valid as long as the listing it was made from
+
+void Disassembler::buildFlowGraph(quint64 key) {
+    struct segment *s = &segments[currentSegment];
+
+    if (!s->flow)
+        s->flow = new FlowGraph;
+    if (s->flow->key() == key)
+        return;
+
+    ProfileScope scope("generateDisassembly: flow");
+    s->flow->build(*s, *this, key);
+    scope.count(PC_LINES, s->disassembly.size());
+}
@@ -27,12 +27,39 @@
 
 extern class Disassembler *Disassembler;
 
+#define OPERAND_NONE    0
+#define OPERAND_BYTE    1       // also signed displacements
+#define OPERAND_WORD    2       // little-endian
+#define OPERAND_REL     3       // signed byte, relative to the next insn
+
+// An instruction as the disassembler writes it, with its operands taken
+// out as %1 and %2, and the bytes it is made of. Used by the reassembler.
+
+struct insnshape {
+    QString mnemonic;           // lower case
+    QString operands;           // without spaces
+    quint8 bytes[4];            // operand bytes are zero
+    quint8 size;
+    quint8 kinds[2];            // OPERAND_*
+    quint8 offsets[2];          // of the operands in bytes
+};
+
 class Disassembler {
 public:
 	Disassembler() = default;
     void generateDisassembly(bool generateLocalLabels);
     virtual void trace(quint64 address) = 0;
     virtual QString getDescriptionAt(quint64 address) = 0;
+    virtual void instructionShapes(QVector<struct insnshape> &shapes) = 0;
+
+    // FLOW_* of the instruction at relpos in the current segment, target
+    // is set for branches, jumps and calls. The tables must be set up, as
+    // they are during generateDisassembly().
+    virtual int flowAt(quint64 relpos, quint64 *target) = 0;
+
+    // what the same instruction does to registers and memory, for the
+    // constant propagation of addresspairs.h
+    virtual void effectAt(quint64 relpos, struct insneffect &effect) = 0;
 
     QString hexPrefix, hexSuffix;
     quint64 cputype;
@@ -40,6 +67,9 @@ public:
 
 protected:
     virtual void initTables(void) = 0;
+    void buildAnnotations(quint64 key);
+    void buildFlowGraph(quint64 key);
+    void dropListing(void);
     virtual int getInstructionSizeAt(quint64 relpos) = 0;
     virtual void createOperandLabels(quint64 relpos, bool generateLocalLabels) = 0;
     virtual void disassembleInstructionAt(quint64 relpos,
@@ -51,6 +81,9 @@ class Disassembler6502 : public Disassembler {
 public:
     void trace(quint64 address) override;
     QString getDescriptionAt(quint64 address) override;
+    void instructionShapes(QVector<struct insnshape> &shapes) override;
+    int flowAt(quint64 relpos, quint64 *target) override;
+    void effectAt(quint64 relpos, struct insneffect &effect) override;
 
 protected:
     void initTables(void) override;
@@ -64,6 +97,9 @@ class Disassembler8080 : public Disassembler {
 public:
     void trace(quint64 address) override;
     QString getDescriptionAt(quint64 address) override;
+    void instructionShapes(QVector<struct insnshape> &shapes) override;
+    int flowAt(quint64 relpos, quint64 *target) override;
+    void effectAt(quint64 relpos, struct insneffect &effect) override;
 
 protected:
     void initTables(void) override;
@@ -77,6 +113,9 @@ class DisassemblerZ80 : public Disassembler {
 public:
     void trace(quint64 address) override;
     QString getDescriptionAt(quint64 address) override;
+    void instructionShapes(QVector<struct insnshape> &shapes) override;
+    int flowAt(quint64 relpos, quint64 *target) override;
+    void effectAt(quint64 relpos, struct insneffect &effect) override;
 
 protected:
     void initTables(void) override;
@@ -86,4 +125,14 @@ protected:
                                   struct disassembly &dis, int &n) override;
 };
 
+// Leading bytes of the instruction at p that decide its length, i.e. the
+// opcode plus the Z80 prefix if there is one.
+
+int opcodeBytes(const quint8 *p);
+
+// What the string directives show for byte v of a DT_ text type, 255 if it
+// is not printable.
+
+quint8 textToAscii(int datatype, quint8 v);
+
 #endif // DISASSEMBLER_H
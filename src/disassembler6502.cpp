@@ -21,6 +21,10 @@
 // ---------------------------------------------------------------------------
 
 #include "disassembler.h"
+#include "addresspairs.h"
+#include "constants.h"
+#include "flowgraph.h"
+#include "symbollibrary.h"
 
 enum addressing_mode {
 
@@ -1059,7 +1063,8 @@ void Disassembler6502::createOperandLabels(quint64 relpos, bool generateLocalLab
         addr2 = 3 + start + i + addr2 - (addr2>0x7f ? 0x100 : 0);
 
         if ( ! (s->localLabels.contains(addr)
-                || globalLabels.contains(addr))) {
+                || globalLabels.contains(addr)
+                || symbolLibraries.contains(addr))) {
 
             hex = QStringLiteral("L%1").arg(addr,4,16,(QChar)'0');
             if (toUpper)
@@ -1072,7 +1077,8 @@ void Disassembler6502::createOperandLabels(quint64 relpos, bool generateLocalLab
         }
 
         if ( ! (s->localLabels.contains(addr2)
-               || globalLabels.contains(addr2))) {
+               || globalLabels.contains(addr2)
+               || symbolLibraries.contains(addr2))) {
 
             hex = QStringLiteral("L%1").arg(addr2,4,16,(QChar)'0');
             if (toUpper)
@@ -1093,7 +1099,8 @@ void Disassembler6502::createOperandLabels(quint64 relpos, bool generateLocalLab
             addr = 2 + start + i + addr - (addr>0x7f ? 0x100 : 0);
 
         if (s->localLabels.contains(addr)
-           || globalLabels.contains(addr))
+           || globalLabels.contains(addr)
+           || symbolLibraries.contains(addr))
             return;
 
         hex = QStringLiteral("L%1").arg(addr,4,16,(QChar)'0');
@@ -1150,24 +1157,27 @@ void Disassembler6502::disassembleInstructionAt(quint64 relpos,
                 hex = localLabels->value(operand);
             else if (globalLabels.contains(operand))
                 hex = globalLabels.value(operand);
-            else
+            else if (!symbolLibraries.label(operand, &hex))
                 hex = QStringLiteral("$%1").arg(operand, 2, 16, (QChar)'0');
 
             if (localLabels->contains(operand2))
                 hex2 = localLabels->value(operand2);
             else if (globalLabels.contains(operand2))
                 hex2 = globalLabels.value(operand2);
-            else
+            else if (!symbolLibraries.label(operand2, &hex2))
                 hex2 = QStringLiteral("$%1").arg(operand2, 2, 16, (QChar)'0');
 
 
         } else if (can_be_label[m] && (globalLabels.contains(operand)
-                                    || localLabels->contains(operand) )) {
+                                    || localLabels->contains(operand)
+                                    || symbolLibraries.contains(operand))) {
 
             if (localLabels->contains(operand))
                 hex = localLabels->value(operand);
-            else
+            else if (globalLabels.contains(operand))
                 hex = globalLabels.value(operand);
+            else
+                hex = symbolLibraries.value(operand);
 
         } else if (m == MODE_IMM && flags[i+1] & (FLAG_LOW_BYTE|FLAG_HIGH_BYTE)) {
 
@@ -1185,6 +1195,8 @@ void Disassembler6502::disassembleInstructionAt(quint64 relpos,
                 hex = pref + QStringLiteral("%1").arg(localLabels->value(addr));
             else if (globalLabels.contains(addr))
                 hex = pref + QStringLiteral("%1").arg(globalLabels.value(addr));
+            else if (symbolLibraries.contains(addr))
+                hex = pref + symbolLibraries.value(addr);
             else
                 hex = pref + QStringLiteral("$%1").arg(addr, 4, 16, (QChar)'0');
 
@@ -1192,11 +1204,13 @@ void Disassembler6502::disassembleInstructionAt(quint64 relpos,
 
         } else if (m == MODE_IMM && flags[i+1] &  FLAG_CONSTANT) {
 
-            quint64 groupID = s->constants.value(start+i+1);
-            hex = constantsGroups[groupID].map->value(operand);
+            hex = constantsGroups.value(s->constants[i+1], operand);
             if (hex.isEmpty())
                 hex   = QStringLiteral("$%1").arg(operand, 2, 16, (QChar)'0');
 
+        } else if (isizes[m] == 3) {
+            // absolute below $0100 stays $00xx, or it reads as zero page
+            hex   = QStringLiteral("$%1").arg(operand, 4, 16, (QChar)'0');
         } else {
             hex   = QStringLiteral("$%1").arg(operand, 2, 16, (QChar)'0');
         }
@@ -1209,13 +1223,135 @@ void Disassembler6502::disassembleInstructionAt(quint64 relpos,
             temps = QString(fmts[m]).arg(hex, hex2);
         }
     }
-    dis = { start + i, distab[opcode].inst, temps, n,false };
+    dis = { start + i, distab[opcode].inst, temps, n,false,DIR_NONE };
     if (m == MODE_REL || opcode == 0x4c || opcode == 0x6c || opcode == 0x20 ||
             opcode == 0x40 || opcode ==0x60) {
         dis.changes_pc = true;
     }
 }
 
+void Disassembler6502::instructionShapes(QVector<struct insnshape> &shapes) {
+    initTables();
+
+    for (int opcode = 0; opcode < 256; opcode++) {
+        auto m = (enum addressing_mode) distab[opcode].mode;
+        struct insnshape shape = { distab[opcode].inst, fmts[m],
+                                   { (quint8) opcode }, (quint8) isizes[m],
+                                   { OPERAND_NONE }, { 1 } };
+
+        if (shape.mnemonic == QStringLiteral("UNDEFINED"))
+            continue;
+
+        if (shape.size == 1) {
+            shape.operands.clear();     // rol, not rol A
+        } else if (m == MODE_ZP_REL) {
+            shape.kinds[0] = OPERAND_BYTE;
+            shape.kinds[1] = OPERAND_REL;
+            shape.offsets[1] = 2;
+        } else if (m == MODE_REL) {
+            shape.kinds[0] = OPERAND_REL;
+        } else if (shape.size == 2) {
+            shape.kinds[0] = OPERAND_BYTE;
+        } else if (shape.size == 3) {
+            shape.kinds[0] = OPERAND_WORD;
+        }
+        shapes.append(shape);
+    }
+}
+
+int Disassembler6502::flowAt(quint64 relpos, quint64 *target) {
+    struct segment *s = &segments[currentSegment];
+    quint8 *data = s->data;
+    quint8 opcode = data[relpos];
+    auto m = (enum addressing_mode) distab[opcode].mode;
+    QString inst = distab[opcode].inst;
+
+    if (inst == QStringLiteral("UNDEFINED") || inst == QStringLiteral("cim") ||
+            inst == QStringLiteral("stp") || opcode == 0x00)    // brk
+        return FLOW_STOP;
+
+    if (m == MODE_REL) {
+        quint8 d = data[relpos+1];
+        *target = 2 + s->start + relpos + d - (d > 0x7f ? 0x100 : 0);
+        return opcode == 0x80 ? FLOW_JUMP : FLOW_BRANCH;        // bra
+    }
+    if (m == MODE_ZP_REL) {                                     // bbr, bbs
+        quint8 d = data[relpos+2];
+        *target = 3 + s->start + relpos + d - (d > 0x7f ? 0x100 : 0);
+        return FLOW_BRANCH;
+    }
+
+    switch (opcode) {
+    case 0x20:
+        *target = data[relpos+1] | data[relpos+2] << 8;
+        return FLOW_CALL;
+    case 0x4c:
+        *target = data[relpos+1] | data[relpos+2] << 8;
+        return FLOW_JUMP;
+    case 0x6c:
+    case 0x7c:
+        return m == MODE_IND || m == MODE_IND_ABS_X ? FLOW_INDIRECT : FLOW_NEXT;
+    case 0x40:
+    case 0x60:
+        return FLOW_RETURN;
+    default:
+        return FLOW_NEXT;
+    }
+}
+
+// Registers are a, x and y, as 0, 1 and 2. Undocumented opcodes that are
+// not listed may write anywhere.
+
+void Disassembler6502::effectAt(quint64 relpos, struct insneffect &effect) {
+    quint8 *data = segments[currentSegment].data;
+    quint8 opcode = data[relpos];
+    auto m = (enum addressing_mode) distab[opcode].mode;
+    QString inst = distab[opcode].inst;
+    bool direct = m == MODE_ZP || m == MODE_ABS;
+    const QString regs = QStringLiteral("axy");
+
+    effect.address = data[relpos+1] | (m == MODE_ABS ? data[relpos+2] << 8 : 0);
+
+    if (mnemonicIn(inst, "lda ldx ldy")) {
+        int reg = regs.indexOf(inst.at(2));
+        if (m == MODE_IMM) {
+            effect.load = reg;
+            effect.loadSize = 1;
+            effect.operand = relpos + 1;
+        } else {
+            effect.clobbered = 1 << reg;
+        }
+    } else if (mnemonicIn(inst, "sta stx sty")) {
+        if (direct) {
+            effect.store = regs.indexOf(inst.at(2));
+            effect.storeSize = 1;
+        } else {
+            effect.memory = MEMORY_ANY;
+        }
+    } else if (mnemonicIn(inst, "tax tay txa tya")) {
+        effect.copyFrom = regs.indexOf(inst.at(1));
+        effect.copyTo = regs.indexOf(inst.at(2));
+    } else if (mnemonicIn(inst, "inx dex")) {
+        effect.clobbered = 2;
+    } else if (mnemonicIn(inst, "iny dey")) {
+        effect.clobbered = 4;
+    } else if (mnemonicIn(inst, "stz inc dec asl lsr rol ror tsb trb") ||
+               inst.startsWith(QStringLiteral("rmb")) ||
+               inst.startsWith(QStringLiteral("smb"))) {
+        if (m == MODE_ACCU || m == MODE_IMPL)
+            effect.clobbered = 1;
+        else
+            effect.memory = direct ? MEMORY_ADDRESS : MEMORY_ANY;
+    } else if (mnemonicIn(inst, "adc sbc and ora eor pla plx ply plp tsx txs")) {
+        effect.clobbered = 7;
+    } else if (!mnemonicIn(inst, "cmp cpx cpy bit clc sec cli sei cld sed clv nop "
+                                 "pha php phx phy bcc bcs beq bne bmi bpl bvc bvs bra") &&
+               !inst.startsWith(QStringLiteral("bb"))) {
+        effect.clobbered = 7;
+        effect.memory = MEMORY_ANY;
+    }
+}
+
 void Disassembler6502::trace(quint64 address) {
     struct segment *s = &segments[currentSegment];
     quint8 *data = s->data;
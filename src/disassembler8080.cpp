@@ -21,6 +21,10 @@
 // ---------------------------------------------------------------------------
 
 #include "disassembler.h"
+#include "addresspairs.h"
+#include "constants.h"
+#include "flowgraph.h"
+#include "symbollibrary.h"
 
 enum addressing_mode {
     MODE_IMPL = 0,      // single byte instructions, except for RST
@@ -405,7 +409,8 @@ void Disassembler8080::createOperandLabels(quint64 relpos, bool generateLocalLab
     if (m == MODE_ADR || m == MODE_JMP) {
         operand = data[i+1] + (data[i+2]<<8);
 
-        if (  localLabels->contains(operand) || globalLabels.contains(operand))
+        if (  localLabels->contains(operand) || globalLabels.contains(operand)
+           || symbolLibraries.contains(operand))
             return;
 
         temps = QStringLiteral("L%1").arg(operand,4,16,(QChar)'0');
@@ -442,8 +447,7 @@ void Disassembler8080::disassembleInstructionAt(quint64 relpos,
         operand = data[i+1];
 
         if (flags[i+1] & FLAG_CONSTANT) {
-            quint64 groupID = s->constants.value(start+i+1);
-            temps = constantsGroups[groupID].map->value(operand);
+            temps = constantsGroups.value(s->constants[i+1], operand);
         }
 
         if (temps.isEmpty()) {
@@ -457,15 +461,16 @@ void Disassembler8080::disassembleInstructionAt(quint64 relpos,
         operand = data[i+1] + (data[i+2] << 8);
 
         if (flags[i+1] & FLAG_CONSTANT) {
-            quint64 groupID = s->constants.value(start+i+1);
-            temps = constantsGroups[groupID].map->value(operand);
+            temps = constantsGroups.value(s->constants[i+1], operand);
         }
 
         if (temps.isEmpty() && (m != MODE_D16 || flags[i+1] == FLAG_USE_LABEL)) {
             if (localLabels->contains(operand))
                 temps = localLabels->value(operand);
-            else
+            else if (globalLabels.contains(operand))
                 temps = globalLabels.value(operand);
+            else
+                temps = symbolLibraries.value(operand);
         }
 
         if (temps.isEmpty()) {
@@ -475,11 +480,126 @@ void Disassembler8080::disassembleInstructionAt(quint64 relpos,
         }
     }
 
-    dis = { start + i, distab[opcode].inst, temps, n,false };
+    dis = { start + i, distab[opcode].inst, temps, n,false,DIR_NONE };
     if (m == MODE_JMP)
         dis.changes_pc = true;
 }
 
+void Disassembler8080::instructionShapes(QVector<struct insnshape> &shapes) {
+    initTables();
+
+    for (int opcode = 0; opcode < 256; opcode++) {
+        auto m = (enum addressing_mode) distab[opcode].mode;
+        QString inst = QString(distab[opcode].inst).toLower();
+        int space = inst.indexOf(QLatin1Char(' '));
+        struct insnshape shape = { inst, QString(), { (quint8) opcode },
+                                   isizes[m], { OPERAND_NONE }, { 1 } };
+
+        if (inst == QStringLiteral("undefined"))
+            continue;
+
+        if (space >= 0) {
+            shape.mnemonic = inst.left(space);
+            shape.operands = inst.mid(space+1).remove(QLatin1Char(' '));
+        }
+        if (shape.size > 1) {
+            shape.operands += QStringLiteral("%1");
+            shape.kinds[0] = shape.size == 2 ? OPERAND_BYTE : OPERAND_WORD;
+        }
+        shapes.append(shape);
+    }
+}
+
+int Disassembler8080::flowAt(quint64 relpos, quint64 *target) {
+    quint8 *data = segments[currentSegment].data;
+    quint8 opcode = data[relpos];
+    auto m = (enum addressing_mode) distab[opcode].mode;
+
+    if (distab[opcode].inst == QStringLiteral("UNDEFINED") || opcode == 0x76)
+        return FLOW_STOP;                                       // and HLT
+
+    switch (m) {
+    case MODE_JMP:
+        *target = data[relpos+1] | data[relpos+2] << 8;
+        if (opcode == 0xc3)
+            return FLOW_JUMP;
+        if ((opcode & 0xc7) == 0xc2)
+            return FLOW_BRANCH;
+        return FLOW_CALL;                                       // CALL, Ccc
+    case MODE_RST:
+        *target = opcode & 0x38;
+        return FLOW_CALL;
+    case MODE_RET:
+        return opcode == 0xc9 ? FLOW_RETURN : FLOW_RETURN_IF;
+    default:
+        return opcode == 0xe9 ? FLOW_INDIRECT : FLOW_NEXT;      // PCHL
+    }
+}
+
+// Registers are A, BC, DE, HL and SP, as 0, 1, 2, 3 and 6, like the Z80.
+// Only word immediates are followed, there are no byte pairs on the 8080.
+
+static const int pairOfRegister[8] = { 1, 1, 2, 2, 3, 3, -1, 0 };   // B..A
+
+void Disassembler8080::effectAt(quint64 relpos, struct insneffect &effect) {
+    quint8 *data = segments[currentSegment].data;
+    quint8 opcode = data[relpos];
+    int dst = (opcode >> 3) & 7;
+    int src = opcode & 7;
+
+    effect.address = data[relpos+1] | data[relpos+2] << 8;
+
+    switch (opcode) {
+    case 0x01: case 0x11: case 0x21: case 0x31:                 // LXI
+        effect.load = opcode == 0x31 ? 6 : (opcode >> 4) + 1;
+        effect.loadSize = 2;
+        effect.operand = relpos + 1;
+        return;
+    case 0x22:                                                  // SHLD
+        effect.store = 3;
+        effect.storeSize = 2;
+        return;
+    case 0x32:                                                  // STA
+        effect.memory = MEMORY_ADDRESS;
+        return;
+    case 0x02: case 0x12:                                       // STAX
+        effect.pointer = (opcode >> 4) + 1;
+        effect.memory = MEMORY_ANY;
+        return;
+    case 0x0a: case 0x1a:                                       // LDAX
+        effect.pointer = (opcode >> 4) + 1;
+        effect.clobbered = 1;
+        return;
+    case 0x34: case 0x35: case 0x36:                            // INR, DCR, MVI M
+        effect.pointer = 3;
+        effect.memory = MEMORY_ANY;
+        return;
+    case 0xe9:                                                  // PCHL
+        effect.pointer = 3;
+        return;
+    case 0x76:                                                  // HLT
+        return;
+    default:
+        break;
+    }
+
+    if (opcode >= 0x40 && opcode < 0x80) {                      // MOV
+        if (src == 6)
+            effect.pointer = 3;
+        if (dst == 6)
+            effect.memory = MEMORY_ANY;
+        else
+            effect.clobbered = 1 << pairOfRegister[dst];
+    } else if (opcode >= 0x80 && opcode < 0xc0) {               // ALU
+        if (src == 6)
+            effect.pointer = 3;
+        effect.clobbered = 1;
+    } else {
+        effect.clobbered = 0x4f;
+        effect.memory = opcode == 0xe3 ? MEMORY_ANY : MEMORY_NONE;  // XTHL
+    }
+}
+
 void Disassembler8080::trace(quint64 address) {
     struct segment *s = &segments[currentSegment];
     quint8 *data = s->data;
@@ -27,7 +27,10 @@
 // ---------------------------------------------------------------------------
 
 #include "disassembler.h"
+#include "addresspairs.h"
+#include "flowgraph.h"
 #include "frida.h"
+#include "symbollibrary.h"
 
 struct distabitem {
     const char * inst;              // Instruction mnemonic
@@ -1968,7 +1971,41 @@ int DisassemblerZ80::getInstructionSizeAt(quint64 relpos) {
         return item->size;
 }
 
+// The address in the word operand of the instruction at relpos, if it is
+// flagged as label, like the pointers found by resolveAddressPairs()
+
+static bool operandAddress(quint64 relpos, const struct distabitem *item,
+                           quint64 *address) {
+    struct segment *s = &segments[currentSegment];
+    quint64 o = relpos + item->operand_offset;
+
+    if ((item->mode == MODE_NN || item->mode == MODE_MEM_NN) &&
+            s->flags[o] & FLAG_USE_LABEL) {
+        *address = s->data[o] | s->data[o+1] << 8;
+        return true;
+    }
+    return false;
+}
+
 void DisassemblerZ80::createOperandLabels(quint64 relpos, bool generateLocalLabels) {
+    struct segment *s = &segments[currentSegment];
+    quint64 address;
+
+    if (!operandAddress(relpos, get_distabitem_at(relpos), &address))
+        return;
+
+    if (  s->localLabels.contains(address) || globalLabels.contains(address)
+       || symbolLibraries.contains(address))
+        return;
+
+    QString label = QStringLiteral("L%1").arg(address, 4, 16, QChar('0'));
+    if (toUpper)
+        label = label.toUpper();
+
+    if (generateLocalLabels)
+        s->localLabels.insert(address, label);
+    else
+        globalLabels.insert(address, label);
 }
 
 // Labels:
@@ -2015,8 +2052,17 @@ void DisassemblerZ80::disassembleInstructionAt(quint64 relpos, struct disassembl
     }
 
     QString operand_string;
+    quint64 address;
 
-    if (item->mode != MODE_IMP)
+    if (operandAddress(relpos, item, &address)) {
+        operand_string = s->localLabels.value(address);
+        if (operand_string.isEmpty())
+            operand_string = globalLabels.value(address);
+        if (operand_string.isEmpty())
+            operand_string = symbolLibraries.value(address);
+    }
+
+    if (item->mode != MODE_IMP && operand_string.isEmpty())
         operand_string = hexPrefix + QString("%1").arg(operand, 2, 16, QChar('0')) + hexSuffix;
 
     if (operand_string.isEmpty())
@@ -2026,7 +2072,7 @@ void DisassemblerZ80::disassembleInstructionAt(quint64 relpos, struct disassembl
 
     n = item->size;
 
-    dis = { s->start + relpos, item->inst, operand_string, n, false };
+    dis = { s->start + relpos, item->inst, operand_string, n, false, DIR_NONE };
 
     if (item->extmode == EXT_JUMP || item->extmode == EXT_CALL) {   // missing: RETZ etc..
         dis.changes_pc = true;
@@ -2035,6 +2081,174 @@ void DisassemblerZ80::disassembleInstructionAt(quint64 relpos, struct disassembl
     n = item->size;
 }
 
+// The prefix bytes of each table, the opcode goes after them, or at the end
+// for DDCB and FDCB
+
+static const struct {
+    struct distabitem *table;
+    quint8 prefix[2];
+    int prefixSize;
+} tables[] = {
+    { distab_normal, { 0x00, 0x00 }, 0 },
+    { distab_CB,     { 0xcb, 0x00 }, 1 },
+    { distab_DD,     { 0xdd, 0x00 }, 1 },
+    { distab_ED,     { 0xed, 0x00 }, 1 },
+    { distab_FD,     { 0xfd, 0x00 }, 1 },
+    { distab_DDCB,   { 0xdd, 0xcb }, 2 },
+    { distab_FDCB,   { 0xfd, 0xcb }, 2 },
+};
+
+void DisassemblerZ80::instructionShapes(QVector<struct insnshape> &shapes) {
+    initTables();
+
+    for (const auto &t : tables) {
+        for (int opcode = 0; opcode < 256; opcode++) {
+            const struct distabitem *item = &t.table[opcode];
+            struct insnshape shape = { item->inst, QString(item->oper).remove(QLatin1Char(' ')),
+                                       { 0 }, (quint8) item->size,
+                                       { OPERAND_NONE }, { (quint8) item->operand_offset } };
+
+            if (!item->binary)
+                continue;   // invalid instruction
+
+            for (int i = 0; i < t.prefixSize; i++)
+                shape.bytes[i] = t.prefix[i];
+            shape.bytes[t.prefixSize == 2 ? 3 : t.prefixSize] = opcode;
+
+            if (item->mode == MODE_DIS && item->extmode == EXT_JUMP)
+                shape.kinds[0] = OPERAND_REL;
+            else if (item->mode == MODE_DIS || item->mode == MODE_N)
+                shape.kinds[0] = OPERAND_BYTE;
+            else if (item->mode == MODE_NN || item->mode == MODE_MEM_NN)
+                shape.kinds[0] = OPERAND_WORD;
+
+            // ld (ix+d),n
+
+            if (shape.operands.count(QStringLiteral("%1")) == 2) {
+                shape.kinds[1] = OPERAND_BYTE;
+                shape.offsets[1] = shape.offsets[0] + 1;
+            }
+            shapes.append(shape);
+        }
+    }
+}
+
+// conditions show up as "cc," in front of the operand, or as the operand
+// of ret
+
+int DisassemblerZ80::flowAt(quint64 relpos, quint64 *target) {
+    struct segment *s = &segments[currentSegment];
+    quint8 *data = s->data;
+    struct distabitem *item = get_distabitem_at(relpos);
+    QString inst = item->inst;
+    bool conditional = QString(item->oper).contains(QLatin1Char(','));
+
+    if (item->binary == nullptr || inst == QStringLiteral("halt"))
+        return FLOW_STOP;
+
+    if (item->extmode == EXT_JUMP || item->extmode == EXT_CALL) {
+        int o = relpos + item->operand_offset;
+
+        if (item->mode == MODE_IMP)                 // jp (hl), (ix), (iy)
+            return FLOW_INDIRECT;
+
+        if (item->mode == MODE_DIS) {
+            quint8 d = data[o];
+            *target = s->start + relpos + item->size + d - (d > 0x7f ? 0x100 : 0);
+        } else {
+            *target = data[o] | data[o+1] << 8;
+        }
+
+        if (item->extmode == EXT_CALL)
+            return FLOW_CALL;
+        if (conditional || inst == QStringLiteral("djnz"))
+            return FLOW_BRANCH;
+        return FLOW_JUMP;
+    }
+
+    if (inst == QStringLiteral("rst")) {
+        *target = QString(item->oper).left(2).toUInt(nullptr, 16);
+        return FLOW_CALL;
+    }
+    if (inst == QStringLiteral("ret"))
+        return *item->oper ? FLOW_RETURN_IF : FLOW_RETURN;
+    if (inst == QStringLiteral("reti") || inst == QStringLiteral("retn"))
+        return FLOW_RETURN;
+
+    return FLOW_NEXT;
+}
+
+// Registers are A, BC, DE, HL, IX, IY and SP, as 0 to 6. Only the word
+// immediates of ld rr,nn are followed.
+
+static int z80Register(const QString &name) {
+    static const char *names[] = {
+        "a af af'", "b c bc", "d e de", "h l hl", "ix ixh ixl", "iy iyh iyl", "sp"
+    };
+
+    for (int r = 0; r < 7; r++)
+        if (mnemonicIn(name, names[r]))
+            return r;
+    return -1;
+}
+
+void DisassemblerZ80::effectAt(quint64 relpos, struct insneffect &effect) {
+    quint8 *data = segments[currentSegment].data;
+    struct distabitem *item = get_distabitem_at(relpos);
+    QString inst = item->inst;
+    QString oper = item->oper;
+    QString first = oper.section(QStringLiteral(","), 0, 0);
+    QString second = oper.section(QStringLiteral(","), 1, -1);
+    int o = relpos + item->operand_offset;
+    static const char *pointers[] = { "(bc)", "(de)", "(hl)", "(ix", "(iy" };
+
+    effect.address = data[o] | data[o+1] << 8;
+
+    for (int p = 0; p < 5; p++)
+        if (oper.contains(QLatin1String(pointers[p])))
+            effect.pointer = p + 1;
+
+    if (inst == QStringLiteral("ld")) {
+        int to = z80Register(first);
+        int from = z80Register(second);
+
+        if (item->mode == MODE_NN && to > 0) {
+            effect.load = to;
+            effect.loadSize = 2;
+            effect.operand = o;
+        } else if (first == QStringLiteral("(%1)")) {
+            effect.store = from;
+            effect.storeSize = from > 0 ? 2 : 1;
+        } else if (first.startsWith(QLatin1Char('('))) {
+            effect.memory = MEMORY_ANY;
+        } else if (first.size() == 2 && second.size() == 2 && to > 0 && from > 0) {
+            effect.copyTo = to;                 // ld sp,hl
+            effect.copyFrom = from;
+        } else if (to >= 0) {
+            effect.clobbered = 1 << to;
+        }
+        return;
+    }
+
+    if (mnemonicIn(inst, "push cp bit nop di ei scf ccf out im jp jr halt"))
+        return;
+
+    if (mnemonicIn(inst, "inc dec rl rr rlc rrc sla sra sll srl set res add adc "
+                         "sub sbc and or xor neg cpl daa rla rra rlca rrca in pop")) {
+        int r = z80Register(first);
+        if (r < 0)
+            r = z80Register(second);
+        effect.clobbered = 1 << (r < 0 ? 0 : r);
+        if (oper.contains(QLatin1Char('(')) &&
+                !mnemonicIn(inst, "add adc sub sbc and or xor in"))
+            effect.memory = MEMORY_ANY;
+        return;
+    }
+
+    effect.clobbered = 0x7f;                    // ex, exx, block moves, calls
+    effect.memory = MEMORY_ANY;
+}
+
 void DisassemblerZ80::trace(quint64 address) {
     struct segment *s = &segments[currentSegment];
     quint64 relpos = address - s->start;
@@ -0,0 +1,421 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+
+#include "diskimages.h"
+#include "loaders.h"
+
+// ---------------------------------------------------------------------------
+
+DiskImage::~DiskImage() {
+    if (mapped)
+        mapped->unmap((uchar *) image);
+}
+
+bool DiskImage::attach(QIODevice &device, QString *error) {
+    auto *file = qobject_cast<QFile *>(&device);
+
+    imageSize = device.size();
+
+    if (file && imageSize > 0)
+        image = file->map(0, imageSize);
+
+    if (image) {
+        mapped = file;
+    } else {
+        device.seek(0);
+        copy = device.readAll();
+        if (copy.size() != imageSize) {
+            *error = QStringLiteral("Premature end of file!\n");
+            return false;
+        }
+        image = (const quint8 *) copy.constData();
+    }
+
+    return readDirectory(error);
+}
+
+// directory names, anything unprintable becomes an underscore
+
+static QString disk_name(const quint8 *name, int length, quint8 mask, quint8 end) {
+    QString s;
+
+    for (int i = 0; i < length && name[i] != end; i++) {
+        quint8 c = name[i] & mask;
+        s += (c >= 0x20 && c < 0x7f) ? QChar(c) : QChar('_');
+    }
+    return s.trimmed();
+}
+
+// ---------------------------------------------------------------------------
+// ATARI 8-BIT, ATR WITH DOS 2.X
+
+// 1-based, double density disks have three 128 byte boot sectors, which
+// some images pad to 256 bytes
+
+const quint8 *AtariATRImage::sector(int n) const {
+    if (n < 1 || n > sectorCount)
+        return nullptr;
+
+    qint64 offset;
+
+    if (sectorSize == 128 || padded)
+        offset = 16 + (qint64) (n-1) * sectorSize;
+    else if (n <= 3)
+        offset = 16 + (n-1) * 128;
+    else
+        offset = 16 + 3 * 128 + (qint64) (n-4) * 256;
+
+    int size = (sectorSize == 256 && n <= 3) ? 128 : sectorSize;
+
+    if (offset + size > imageSize)
+        return nullptr;
+    return image + offset;
+}
+
+bool AtariATRImage::readDirectory(QString *error) {
+    if (imageSize < 16 + 128 || LE16(image) != 0x0296) {
+        *error = QStringLiteral("ATR header not found!\n");
+        return false;
+    }
+
+    sectorSize = LE16(image+4);
+    if (sectorSize != 128 && sectorSize != 256) {
+        *error = QStringLiteral("Unsupported sector size %1\n").arg(sectorSize);
+        return false;
+    }
+
+    qint64 size = imageSize - 16;
+
+    if (sectorSize == 128) {
+        sectorCount = size / 128;
+    } else {
+        padded = size % 256 == 0;
+        sectorCount = padded ? size / 256 : (size + 3 * 128) / 256;
+    }
+
+    // boot sectors: flags, count, load address, init address
+
+    const quint8 *boot = sector(1);
+    if (boot[1])
+        files.append({ QStringLiteral("[boot]"), FT_RAW_FILE, LE16(boot+2), 1, boot[1] });
+
+    // without a VTOC it is not a DOS disk, booting is all there is
+
+    const quint8 *vtoc = sector(360);
+    if (!vtoc)
+        return true;
+
+    freeSectors = LE16(vtoc+3);
+
+    // 8 directory sectors of 8 entries: flags, count, start, name, extension
+
+    bool end = false;
+
+    for (int n = 361; n <= 368 && !end; n++) {
+        const quint8 *dir = sector(n);
+        if (!dir)
+            break;
+
+        for (int e = 0; e < 8; e++) {
+            const quint8 *entry = dir + e * 16;
+            quint8 flags = entry[0];
+
+            if (!flags) {
+                end = true;         // never used, nothing follows
+                break;
+            }
+            if ((flags & 0x80) || !(flags & 0x40))
+                continue;           // deleted or not in use
+
+            QString name = disk_name(entry+5, 8, 0xff, 0);
+            QString ext  = disk_name(entry+13, 3, 0xff, 0);
+            if (!ext.isEmpty())
+                name += QChar('.') + ext;
+
+            files.append({ name, FT_ATARI8BIT_BINARY, -1, (quint32) LE16(entry+3),
+                           (quint32) LE16(entry+1) });
+        }
+    }
+
+    return true;
+}
+
+// sectors end with the file number and next sector (10 bits) and the
+// number of bytes used
+
+QByteArray AtariATRImage::extract(const struct diskfile &file) const {
+    QByteArray out;
+
+    if (file.address >= 0) {
+        for (quint32 n = 1; n <= file.blocks; n++) {
+            const quint8 *s = sector(n);
+            if (!s)
+                break;
+            out.append((const char *) s, sectorSize == 256 && n > 3 ? 256 : 128);
+        }
+        return out;
+    }
+
+    int n = file.start;
+
+    for (int count = 0; n && count < sectorCount; count++) {
+        const quint8 *s = sector(n);
+        if (!s)
+            break;
+
+        int size = (sectorSize == 256 && n <= 3) ? 128 : sectorSize;
+        int used = s[size-1];
+
+        if (sectorSize == 128)
+            used &= 0x7f;
+        if (used > size - 3)
+            used = size - 3;
+
+        out.append((const char *) s, used);
+        n = (s[size-3] & 0x03) << 8 | s[size-2];
+    }
+
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// COMMODORE 1541, D64
+
+static int sectors_per_track(int track) {
+    if (track <= 17) return 21;
+    if (track <= 24) return 19;
+    if (track <= 30) return 18;
+    return 17;
+}
+
+const quint8 *C64D64Image::sector(int track, int sector) const {
+    if (track < 1 || track > tracks || sector < 0 || sector >= sectors_per_track(track))
+        return nullptr;
+
+    qint64 offset = 0;
+    for (int t = 1; t < track; t++)
+        offset += sectors_per_track(t) * 256;
+    offset += sector * 256;
+
+    return image + offset;
+}
+
+// 35 or 40 tracks, optionally followed by one error byte per sector
+
+bool C64D64Image::readDirectory(QString *error) {
+    if (imageSize < 174848) {
+        *error = QStringLiteral("File is too small for a D64 image\n");
+        return false;
+    }
+    tracks = imageSize >= 196608 ? 40 : 35;
+
+    // the BAM has the first directory sector, the free sectors per track
+    // and the disk name
+
+    const quint8 *bam = sector(18, 0);
+
+    for (int t = 1; t <= 35; t++) {
+        if (t != 18)
+            freeSectors += bam[4 * t];
+    }
+    title = disk_name(bam+0x90, 16, 0x7f, 0xa0);
+
+    int t = bam[0];
+    int s = bam[1];
+
+    for (int count = 0; t && count < 19; count++) {
+        const quint8 *dir = sector(t, s);
+        if (!dir) {
+            *error = QStringLiteral("Broken directory chain\n");
+            return false;
+        }
+
+        for (int e = 0; e < 8; e++) {
+            const quint8 *entry = dir + e * 32;
+
+            // closed PRG files only, the others have no load address
+
+            if (entry[2] != 0x82)
+                continue;
+
+            files.append({ disk_name(entry+5, 16, 0x7f, 0xa0), FT_C64_BINARY, -1,
+                           (quint32) (entry[3] << 8 | entry[4]), (quint32) LE16(entry+30) });
+        }
+
+        t = dir[0];
+        s = dir[1];
+    }
+
+    return true;
+}
+
+// sectors start with the next track and sector, the last one has track 0
+// and the index of its last byte instead
+
+QByteArray C64D64Image::extract(const struct diskfile &file) const {
+    QByteArray out;
+    int t = file.start >> 8;
+    int s = file.start & 0xff;
+
+    for (int count = 0; t && count < 802; count++) {
+        const quint8 *data = sector(t, s);
+        if (!data)
+            break;
+
+        t = data[0];
+        s = data[1];
+
+        if (t)
+            out.append((const char *) data + 2, 254);
+        else if (s >= 2)
+            out.append((const char *) data + 2, s - 1);
+    }
+
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// APPLE ][, DOS 3.3 IN DOS ORDER
+
+const quint8 *Apple2DSKImage::sector(int track, int sector) const {
+    if (track < 0 || track >= 35 || sector < 0 || sector >= 16)
+        return nullptr;
+    return image + (track * 16 + sector) * 256;
+}
+
+bool Apple2DSKImage::readDirectory(QString *error) {
+    if (imageSize != 35 * 16 * 256) {
+        *error = QStringLiteral("Not a 140KB disk image\n");
+        return false;
+    }
+
+    const quint8 *vtoc = sector(17, 0);
+
+    if (vtoc[3] != 3 || vtoc[0x35] != 16) {
+        *error = QStringLiteral("No DOS 3.3 VTOC found (ProDOS order?)\n");
+        return false;
+    }
+
+    // the bitmap has four bytes per track, the first two are used
+
+    for (int t = 0; t < 35; t++) {
+        quint16 bits = vtoc[0x38 + t*4] << 8 | vtoc[0x39 + t*4];
+        for (; bits; bits &= bits - 1)
+            freeSectors++;
+    }
+
+    // the boot sector is loaded at $0800
+
+    files.append({ QStringLiteral("[boot]"), FT_RAW_FILE, 0x0800, 0, 1 });
+
+    // catalog sectors with 7 entries: T/S list, type, name and length
+
+    int t = vtoc[1];
+    int s = vtoc[2];
+
+    for (int count = 0; t && count < 16; count++) {
+        const quint8 *cat = sector(t, s);
+        if (!cat) {
+            *error = QStringLiteral("Broken catalog chain\n");
+            return false;
+        }
+
+        for (int e = 0; e < 7; e++) {
+            const quint8 *entry = cat + 0x0b + e * 35;
+
+            if (entry[0] == 0 || entry[0] == 0xff)
+                continue;           // unused or deleted
+
+            QString name = disk_name(entry+3, 30, 0x7f, 0);
+            quint32 tsl = entry[0] << 8 | entry[1];
+            quint32 blocks = LE16(entry+33);
+
+            // binary files have a header of their own, Applesoft programs
+            // start with their length and run at $0801
+
+            switch (entry[2] & 0x7f) {
+            case 0x04:
+                files.append({ name, FT_APPLE2_DOS33, -1, tsl, blocks });
+                break;
+            case 0x02:
+                files.append({ name, FT_RAW_FILE, 0x07ff, tsl, blocks });
+                break;
+            default:
+                break;
+            }
+        }
+
+        t = cat[1];
+        s = cat[2];
+    }
+
+    return true;
+}
+
+// T/S lists hold up to 122 sectors and link to the next list
+
+QByteArray Apple2DSKImage::extract(const struct diskfile &file) const {
+    QByteArray out;
+
+    if (file.start == 0) {
+        out.append((const char *) sector(0, 0), 256);
+        return out;
+    }
+
+    int t = file.start >> 8;
+    int s = file.start & 0xff;
+    bool end = false;
+
+    for (int count = 0; t && !end && count < 35 * 16; count++) {
+        const quint8 *list = sector(t, s);
+        if (!list)
+            break;
+
+        for (int i = 0; i < 122; i++) {
+            const quint8 *data = sector(list[0x0c + 2*i], list[0x0d + 2*i]);
+            if (!list[0x0c + 2*i] || !data) {
+                end = true;
+                break;
+            }
+            out.append((const char *) data, 256);
+        }
+
+        t = list[1];
+        s = list[2];
+    }
+
+    // cut the last sector to the length in the header
+
+    const auto *header = (const quint8 *) out.constData();
+    int length = -1;
+
+    if (file.type == FT_APPLE2_DOS33 && out.size() >= 4)
+        length = 4 + LE16(header+2);
+    else if (file.address >= 0 && out.size() >= 2)
+        length = 2 + LE16(header);
+
+    if (length >= 0 && length < out.size())
+        out.truncate(length);
+
+    return out;
+}
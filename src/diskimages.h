@@ -0,0 +1,106 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+
+#ifndef DISKIMAGES_H
+#define DISKIMAGES_H
+
+#include "pch.h"
+
+// A file on a disk image. Its contents are only read from the image when
+// it is extracted.
+
+struct diskfile {
+    QString name;
+    enum filetypeid type;   // loader for the contents
+    qint64 address;         // raw contents are loaded here, -1 if they
+                            // have a header of their own
+    quint32 start;          // first sector, track/sector or T/S list
+    quint32 blocks;         // size in sectors, as the directory says
+};
+
+// The image is mapped if the device is a file and read otherwise. Only
+// the directory and the free sector map are parsed when it is attached.
+
+class DiskImage {
+public:
+    DiskImage() = default;
+    virtual ~DiskImage();
+
+    bool attach(QIODevice &device, QString *error);
+    virtual QByteArray extract(const struct diskfile &file) const = 0;
+
+    QString title;
+    int freeSectors = 0;
+    QVector<struct diskfile> files;
+
+protected:
+    virtual bool readDirectory(QString *error) = 0;
+
+    const quint8 *image = nullptr;
+    qint64 imageSize = 0;
+
+private:
+    QFile *mapped = nullptr;
+    QByteArray copy;
+
+    Q_DISABLE_COPY(DiskImage)
+};
+
+class AtariATRImage : public DiskImage {
+public:
+    QByteArray extract(const struct diskfile &file) const override;
+
+protected:
+    bool readDirectory(QString *error) override;
+
+private:
+    const quint8 *sector(int n) const;
+    int sectorSize = 128;
+    int sectorCount = 0;
+    bool padded = false;    // first three sectors are stored as 256 bytes
+};
+
+class C64D64Image : public DiskImage {
+public:
+    QByteArray extract(const struct diskfile &file) const override;
+
+protected:
+    bool readDirectory(QString *error) override;
+
+private:
+    const quint8 *sector(int track, int sector) const;
+    int tracks = 35;
+};
+
+class Apple2DSKImage : public DiskImage {
+public:
+    QByteArray extract(const struct diskfile &file) const override;
+
+protected:
+    bool readDirectory(QString *error) override;
+
+private:
+    const quint8 *sector(int track, int sector) const;
+};
+
+#endif // DISKIMAGES_H
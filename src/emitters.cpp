@@ -0,0 +1,333 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+
+#include "constants.h"
+#include "disassembler.h"
+#include "emitters.h"
+#include "exportassemblywindow.h"
+#include "symbollibrary.h"
+
+// ---------------------------------------------------------------------------
+// DIALECTS
+
+// A directive that is nullptr keeps the name the disassembler gave it, like
+// the instructions do. Numbers in the arguments are rewritten when the hex
+// syntax differs from the one of the disassembler.
+
+#define DIRECTIVES static const char *const directives[DIR_LAST]
+
+struct Verbatim {
+    DIRECTIVES;
+    static constexpr bool convert = false;
+    static constexpr const char *hexPrefix = "$";
+    static constexpr const char *hexSuffix = "";
+    static constexpr bool upperHex = false;
+    static constexpr const char *equPrefix = "";
+    static constexpr const char *equInfix = "=";
+};
+
+struct Mads : Verbatim {
+    DIRECTIVES;
+    static constexpr bool convert = true;
+};
+
+struct Ca65 : Mads {
+    DIRECTIVES;
+};
+
+struct Xa : Mads {
+    DIRECTIVES;
+};
+
+struct Acme : Mads {
+    DIRECTIVES;
+};
+
+struct Tass64 : Mads {
+    DIRECTIVES;
+};
+
+struct Sjasmplus : Mads {
+    DIRECTIVES;
+};
+
+struct Z80asm : Mads {
+    DIRECTIVES;
+    static constexpr const char *equPrefix = "defc ";
+    static constexpr const char *equInfix = " = ";
+};
+
+struct Pasmo : Mads {
+    DIRECTIVES;
+    static constexpr const char *hexPrefix = "";
+    static constexpr const char *hexSuffix = "h";
+    static constexpr const char *equInfix = " equ ";
+};
+
+// in the order of enum directives, from DIR_NONE to DIR_CBMSCREEN
+
+const char *const Verbatim::directives[DIR_LAST] = {};
+
+const char *const Mads::directives[DIR_LAST] = {
+    nullptr, "org", ".byte", ".word", nullptr, ".dword", nullptr,
+    nullptr, nullptr, nullptr, nullptr,
+    nullptr, ".byte", ".byte +128", nullptr, ".sb", ".sb +128", nullptr
+};
+
+const char *const Ca65::directives[DIR_LAST] = {
+    nullptr, ".org", ".byte", ".word", ".dbyt", ".dword", nullptr,
+    nullptr, nullptr, nullptr, nullptr,
+    ".byte", ".byte", nullptr, nullptr, nullptr, nullptr, nullptr
+};
+
+const char *const Xa::directives[DIR_LAST] = {
+    nullptr, "*=", ".byt", ".word", nullptr, nullptr, nullptr,
+    nullptr, nullptr, nullptr, nullptr,
+    ".asc", ".asc", nullptr, nullptr, nullptr, nullptr, nullptr
+};
+
+const char *const Acme::directives[DIR_LAST] = {
+    nullptr, "*=", "!byte", "!word", "!be16", "!le32", "!be32",
+    nullptr, nullptr, nullptr, nullptr,
+    "!text", "!text", nullptr, "!pet", nullptr, nullptr, "!scr"
+};
+
+const char *const Tass64::directives[DIR_LAST] = {
+    nullptr, "*=", ".byte", ".word", nullptr, ".dword", nullptr,
+    nullptr, nullptr, nullptr, nullptr,
+    ".text", ".text", nullptr, nullptr, nullptr, nullptr, nullptr
+};
+
+const char *const Sjasmplus::directives[DIR_LAST] = {
+    nullptr, "org", "db", "dw", nullptr, "dd", nullptr,
+    nullptr, nullptr, nullptr, nullptr,
+    "db", nullptr, nullptr, nullptr, nullptr, nullptr, nullptr
+};
+
+const char *const Z80asm::directives[DIR_LAST] = {
+    nullptr, "org", "defb", "defw", nullptr, "defq", nullptr,
+    nullptr, nullptr, nullptr, nullptr,
+    "defm", nullptr, nullptr, nullptr, nullptr, nullptr, nullptr
+};
+
+const char *const Pasmo::directives[DIR_LAST] = {
+    nullptr, "org", "db", "dw", nullptr, nullptr, nullptr,
+    nullptr, nullptr, nullptr, nullptr,
+    "db", nullptr, nullptr, nullptr, nullptr, nullptr, nullptr
+};
+
+// ---------------------------------------------------------------------------
+// EMITTER
+
+static inline bool isWordChar(QChar c) {
+    return c.isLetterOrNumber() || c == QLatin1Char('_');
+}
+
+static inline bool isHexDigit(QChar c) {
+    ushort u = c.unicode();
+    return (u >= '0' && u <= '9') || (u >= 'a' && u <= 'f') ||
+                                     (u >= 'A' && u <= 'F');
+}
+
+// digits in the case the disassembler prints them
+
+static inline bool isHexNumber(const QChar *p, int n, bool upper) {
+    for (int i = 0; i < n; i++) {
+        ushort u = p[i].unicode();
+        if (!(u >= '0' && u <= '9') && !(upper ? u >= 'A' && u <= 'F'
+                                               : u >= 'a' && u <= 'f'))
+            return false;
+    }
+    return n > 0;
+}
+
+// true if the n characters at p are s
+
+static inline bool matchesAt(const QChar *p, int n, const QString &s) {
+    if (n < s.size())
+        return false;
+    for (int i = 0; i < s.size(); i++)
+        if (p[i] != s.at(i))
+            return false;
+    return true;
+}
+
+template <class D>
+class DialectEmitter : public AssemblyEmitter {
+public:
+    DialectEmitter() : srcPrefix(Disassembler->hexPrefix),
+                       srcSuffix(Disassembler->hexSuffix) {
+        rewrite = D::convert && (srcPrefix != QLatin1String(D::hexPrefix) ||
+                                 srcSuffix.compare(QLatin1String(D::hexSuffix),
+                                                   Qt::CaseInsensitive) ||
+                                 Disassembler->toUpper != D::upperHex);
+
+        // numbers are matched as the disassembler prints them
+
+        upper = Disassembler->toUpper;
+        inPrefix = upper ? srcPrefix.toUpper() : srcPrefix;
+        inSuffix = upper ? srcSuffix.toUpper() : srcSuffix;
+
+        if (rewrite && inPrefix.isEmpty() && !inSuffix.isEmpty())
+            collectNames();
+    }
+
+    void number(QString &out, quint64 value) const override {
+        digits(out, QString::number(value, 16));
+    }
+
+    void equate(QString &out, const QString &name,
+                              const QString &value) const override {
+        out += QLatin1String(D::equPrefix);
+        out += name;
+        out += QLatin1String(D::equInfix);
+        out += value;
+        out += QLatin1Char('\n');
+    }
+
+    void line(QString &out, const struct disassembly &dis) const override {
+        const char *directive = D::directives[dis.directive];
+
+        out += QLatin1String("    ");
+        if (directive)
+            out += QLatin1String(directive);
+        else
+            out += dis.instruction;
+        out += QLatin1Char(' ');
+
+        if (rewrite)
+            arguments(out, dis.arguments);
+        else
+            out += dis.arguments;
+        out += QLatin1Char('\n');
+
+        if (dis.changes_pc)
+            out += QLatin1Char('\n');
+    }
+
+private:
+    QString srcPrefix, srcSuffix;
+    QString inPrefix, inSuffix;
+    QSet<QString> names;                // that look like a number, maybe
+    bool rewrite, upper;
+
+    // Without a prefix, a label like "each" is hex digits and a suffix.
+    // All names an operand can print are kept, so they are never taken
+    // for a number.
+
+    void collectNames(void) {
+        for (const auto &name : qAsConst(globalLabels))
+            names.insert(name);
+        for (const auto &s : qAsConst(segments))
+            for (const auto &name : s.localLabels)
+                names.insert(name);
+        for (const auto *lib : symbolLibraries.libraries())
+            for (int i = 0; i < lib->labelCount(); i++)
+                names.insert(lib->labelName(i));
+        for (quint16 id : constantsGroups.ids())
+            for (const auto &name : constantsGroups.group(id)->entries())
+                names.insert(name);
+    }
+
+    void digits(QString &out, const QString &hex) const {
+        if (!D::convert) {
+            out += srcPrefix;
+            out += Disassembler->toUpper ? hex.toUpper() : hex;
+            out += srcSuffix;
+            return;
+        }
+        if (!*D::hexPrefix && !hex.at(0).isDigit())
+            out += QLatin1Char('0');
+        out += QLatin1String(D::hexPrefix);
+        out += D::upperHex ? hex.toUpper() : hex.toLower();
+        out += QLatin1String(D::hexSuffix);
+    }
+
+    // One pass over the arguments. Strings are copied as they are, and so
+    // are words, unless the disassembler has no hex prefix and the word is
+    // hex digits followed by its suffix and not a name.
+
+    void arguments(QString &out, const QString &in) const {
+        const QChar *p = in.constData();
+        const QChar *end = p + in.size();
+        int plen = inPrefix.size(), slen = inSuffix.size();
+
+        while (p < end) {
+            const QChar *start = p;
+
+            if (*p == QLatin1Char('"') || *p == QLatin1Char('\'')) {
+                QChar quote = *p++;
+                while (p < end && *p != quote)
+                    p++;
+                if (p < end)
+                    p++;
+                out.append(start, p - start);
+                continue;
+            }
+
+            if (plen && matchesAt(p, end - p, inPrefix) &&
+                                    p + plen < end && isHexDigit(p[plen])) {
+                p += plen;
+                start = p;
+                while (p < end && isHexDigit(*p))
+                    p++;
+                digits(out, QString(start, p - start));
+                if (slen && matchesAt(p, end - p, inSuffix))
+                    p += slen;
+                continue;
+            }
+
+            if (isWordChar(*p)) {
+                while (p < end && isWordChar(*p))
+                    p++;
+                int n = p - start - slen;
+                if (!plen && slen && isHexNumber(start, n, upper) &&
+                                     matchesAt(start + n, slen, inSuffix) &&
+                                     !names.contains(QString(start, p - start)))
+                    digits(out, QString(start, n));
+                else
+                    out.append(start, p - start);
+                continue;
+            }
+
+            out += *p++;
+        }
+    }
+};
+
+// ---------------------------------------------------------------------------
+
+AssemblyEmitter *AssemblyEmitter::create(int format) {
+    switch (format) {
+    case ASM_FORMAT_VERBATIM:   return new DialectEmitter<Verbatim>;
+    case ASM_FORMAT_MADS:       return new DialectEmitter<Mads>;
+    case ASM_FORMAT_CA65:       return new DialectEmitter<Ca65>;
+    case ASM_FORMAT_XA:         return new DialectEmitter<Xa>;
+    case ASM_FORMAT_ACME:       return new DialectEmitter<Acme>;
+    case ASM_FORMAT_64TASS:     return new DialectEmitter<Tass64>;
+    case ASM_FORMAT_SJASMPLUS:  return new DialectEmitter<Sjasmplus>;
+    case ASM_FORMAT_Z80ASM:     return new DialectEmitter<Z80asm>;
+    case ASM_FORMAT_PASMO:      return new DialectEmitter<Pasmo>;
+    default:                    return nullptr;
+    }
+}
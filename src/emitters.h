@@ -0,0 +1,48 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+
+#ifndef EMITTERS_H
+#define EMITTERS_H
+
+#include "pch.h"
+#include "frida.h"
+
+// Writes the lines of an exported project in the syntax of one assembler.
+// Each dialect is a table of directives plus its number syntax, compiled
+// into its own specialisation of the emitter in emitters.cpp. Everything is
+// appended to the caller's buffer, so reserve it up front.
+
+class AssemblyEmitter {
+public:
+    virtual ~AssemblyEmitter() = default;
+
+    virtual void number(QString &out, quint64 value) const = 0;
+    virtual void equate(QString &out, const QString &name,
+                                      const QString &value) const = 0;
+    virtual void line(QString &out, const struct disassembly &dis) const = 0;
+
+    // nullptr if format is not one of ASM_FORMAT_*
+    static AssemblyEmitter *create(int format);
+};
+
+#endif // EMITTERS_H
@@ -0,0 +1,122 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#include "disassembler.h"
+#include "emulator.h"
+#include "symbollibrary.h"
+
+Emulator::Emulator() {
+    memset(memory, 0, sizeof(memory));
+    memset(coverage, 0, sizeof(coverage));
+    for (auto &o : owner)
+        o = -1;
+}
+
+// --------------------------------------------------------------------------
+
+// Copy all segments that fall within the 64kB address space. The preferred
+// segment is copied last, so it wins if segments overlap (e.g. banks).
+
+void Emulator::loadMemoryImage(int preferredSegment) {
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < segments.size(); i++) {
+            if ((i == preferredSegment) != (pass == 1))
+                continue;
+
+            const struct segment *s = &segments.at(i);
+            if (s->start > 0xffff)
+                continue;
+
+            quint64 end = s->end > 0xffff ? 0xffff : s->end;
+            for (quint64 a = s->start; a <= end; a++) {
+                memory[a] = s->data[a - s->start];
+                owner[a] = i;
+            }
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+
+// Only undefined bytes are changed. Whatever the user already decided
+// stays as it is.
+
+void Emulator::applyCoverage(bool generateLocalLabels) {
+    codeBytes = dataBytes = labelsAdded = 0;
+
+    for (int a = 0; a < 0x10000; a++) {
+        quint8 c = coverage[a];
+
+        if (!c || owner[a] < 0)
+            continue;
+
+        struct segment *s = &segments[owner[a]];
+        quint8 *dt = &s->datatypes[a - s->start];
+
+        if (c & (COV_EXEC | COV_OPERAND)) {
+            if (*dt == DT_UNDEFINED_BYTES || *dt == DT_UNDEFINED_CODE) {
+                *dt = DT_CODE;
+                codeBytes++;
+            }
+        } else if (c & (COV_READ | COV_WRITE)) {
+            if (*dt == DT_UNDEFINED_BYTES) {
+                *dt = DT_BYTES;
+                dataBytes++;
+            }
+        }
+
+        if (c & COV_TARGET) {
+            if (s->localLabels.contains(a) || globalLabels.contains(a)
+                                       || symbolLibraries.contains(a))
+                continue;
+
+            QString hex = QStringLiteral("L%1").arg(a,4,16,(QChar)'0');
+            if (Disassembler->toUpper)
+                hex = hex.toUpper();
+
+            if (generateLocalLabels)
+                s->localLabels.insert(a, hex);
+            else
+                globalLabels.insert(a, hex);
+            labelsAdded++;
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+
+Emulator *createEmulator(quint32 cputype) {
+    switch (cputype) {
+    case CT_NMOS6502:
+    case CT_NMOS6502UNDEF:
+    case CT_CMOS65C02:
+        return new Emulator6502(cputype);
+    case CT_INTEL_8080:
+    case CT_ZILOG_Z80:
+    case CT_ZILOG_Z80UNDOC:
+    case CT_ZILOG_Z180:
+    case CT_ZILOG_Z180UNDOC:
+        return new EmulatorZ80(cputype);
+    default:
+        return nullptr;
+    }
+}
@@ -0,0 +1,177 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#include "pch.h"
+
+// Coverage bits, one byte per address of the emulated 64kB address space.
+
+#define COV_EXEC        0x01    // first byte of an executed instruction
+#define COV_OPERAND     0x02    // operand byte of an executed instruction
+#define COV_READ        0x04    // read as data
+#define COV_WRITE       0x08    // written as data
+#define COV_TARGET      0x10    // destination of a computed jump
+
+// The memory image is built from the segments. Addresses that are not
+// backed by a segment behave like plain RAM, which is all the I/O stubbing
+// we need to get through init and play routines.
+
+class Emulator {
+public:
+    Emulator();
+    virtual ~Emulator() = default;
+
+    void loadMemoryImage(int preferredSegment);
+    virtual quint64 run(quint16 entry, quint64 maxCycles) = 0;
+    void applyCoverage(bool generateLocalLabels);
+
+    quint64 instructions = 0;
+    bool returned = false;              // entry point returned to its caller
+    QString stop_reason;
+    QString console;                    // output of the CP/M stand-in
+
+    int codeBytes = 0, dataBytes = 0, labelsAdded = 0;
+
+protected:
+    quint8 memory[0x10000];
+    quint8 coverage[0x10000];
+    qint16 owner[0x10000];              // segment index, or -1
+
+    Q_DISABLE_COPY(Emulator)
+};
+
+class Emulator6502 : public Emulator {
+public:
+    explicit Emulator6502(quint32 cputype);
+    quint64 run(quint16 entry, quint64 maxCycles) override;
+
+    quint8 A = 0, X = 0, Y = 0;         // initial registers, set before run()
+
+private:
+    bool cmos, undocumented;
+
+    quint16 PC;
+    quint8 S;
+    quint8 N, Z;                        // last results, N uses bit 7
+    bool C, V, D, I;
+
+    quint32 returns[256];               // JSR return addresses by S
+
+    bool step(quint64 &cycles);
+    bool stepCMOS(quint8 opcode, quint16 address);
+    bool stepUndocumented(quint8 opcode);
+
+    inline quint8 fetch(void);
+    inline quint16 fetch16(void);
+    inline quint8 read(quint16 a);
+    inline void write(quint16 a, quint8 v);
+    inline quint16 readPointer(quint8 zp);
+    inline void push(quint8 v);
+    inline quint8 pull(void);
+
+    inline quint8 getP(bool brk);
+    inline void setP(quint8 p);
+    inline quint8 setNZ(quint8 v);
+
+    void adc(quint8 v);
+    void sbc(quint8 v);
+    void compare(quint8 r, quint8 v);
+    quint8 asl(quint8 v);
+    quint8 lsr(quint8 v);
+    quint8 rol(quint8 v);
+    quint8 ror(quint8 v);
+    void bit(quint8 v);
+    bool branch(bool condition, quint16 address);
+};
+
+class EmulatorZ80 : public Emulator {
+public:
+    explicit EmulatorZ80(quint32 cputype);
+    quint64 run(quint16 entry, quint64 maxCycles) override;
+    void enableCPM(void);
+
+    QMap<QString, QByteArray> disk;     // CP/M files, by NAME.EXT
+
+private:
+    bool i8080, z180;
+    bool cpm = false;
+
+    quint8 A, F, B, C, D, E, H, L;
+    quint16 AF_, BC_, DE_, HL_;
+    quint16 IX, IY, SP, PC;
+    quint8 I, R;
+    bool IFF;
+
+    quint16 initialSP;
+    quint32 returns[0x10000];           // CALL return addresses by SP
+
+    quint16 dma;
+    QStringList searchResults;
+
+    bool step(quint64 &cycles);
+    bool stepCB(int index);
+    bool stepED(quint16 address, quint64 &cycles);
+    bool bdos(void);
+    void bios(int function);
+
+    inline quint8 fetch(void);
+    inline quint16 fetch16(void);
+    inline quint8 read(quint16 a);
+    inline void write(quint16 a, quint8 v);
+    inline quint16 read16(quint16 a);
+    inline void write16(quint16 a, quint16 v);
+    inline void push(quint16 v);
+    inline quint16 pop(void);
+
+    inline quint16 getHL(int index);
+    inline void setHL(int index, quint16 v);
+    quint16 getPair(int p, int index);
+    void setPair(int p, quint16 v, int index);
+    quint8 getReg(int r, int index);
+    void setReg(int r, quint8 v, int index);
+    quint16 memAddress(int index);
+    bool condition(int cc);
+
+    bool jump(quint16 target, quint16 address);
+    void call(quint16 target);
+    bool ret(void);
+
+    void alu(int op, quint8 v);
+    quint8 inc8(quint8 v);
+    quint8 dec8(quint8 v);
+    quint16 add16(quint16 a, quint16 b);
+    void adc16(quint16 v);
+    void sbc16(quint16 v);
+    quint8 rotate(int op, quint8 v);
+    void daa(void);
+
+    QString fcbName(quint16 fcb);
+    QByteArray fcbPattern(quint16 fcb);
+    int readRecord(quint16 fcb, int record);
+    int writeRecord(quint16 fcb, int record);
+};
+
+Emulator *createEmulator(quint32 cputype);
+
+#endif // EMULATOR_H
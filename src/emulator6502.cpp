@@ -0,0 +1,703 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#include "emulator.h"
+
+// Base cycle counts. Page crossing penalties are ignored, we only need
+// the numbers to bound the amount of work, not to be cycle exact.
+
+static const quint8 cycletab[256] = {
+    7,6,2,8,3,3,5,5,3,2,2,2,4,4,6,6,
+    2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7,
+    6,6,2,8,3,3,5,5,4,2,2,2,4,4,6,6,
+    2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7,
+    6,6,2,8,3,3,5,5,3,2,2,2,3,4,6,6,
+    2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7,
+    6,6,2,8,3,3,5,5,4,2,2,2,5,4,6,6,
+    2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7,
+    2,6,2,6,3,3,3,3,2,2,2,2,4,4,4,4,
+    2,6,2,6,4,4,4,4,2,5,2,5,5,5,5,5,
+    2,6,2,6,3,3,3,3,2,2,2,2,4,4,4,4,
+    2,5,2,5,4,4,4,4,2,4,2,4,4,4,4,4,
+    2,6,2,8,3,3,5,5,2,2,2,2,4,4,6,6,
+    2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7,
+    2,6,2,8,3,3,5,5,2,2,2,2,4,4,6,6,
+    2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7
+};
+
+#define NO_RETURN   0xffffffff
+
+// Effective addresses. Each fetches its operand bytes.
+
+#define ZP      (fetch())
+#define ZPX     ((quint8) (fetch() + X))
+#define ZPY     ((quint8) (fetch() + Y))
+#define ABS     (fetch16())
+#define ABSX    ((quint16) (fetch16() + X))
+#define ABSY    ((quint16) (fetch16() + Y))
+#define INDX    (readPointer((quint8) (fetch() + X)))
+#define INDY    ((quint16) (readPointer(fetch()) + Y))
+#define INDZP   (readPointer(fetch()))
+
+// --------------------------------------------------------------------------
+
+Emulator6502::Emulator6502(quint32 cputype) {
+    cmos = cputype == CT_CMOS65C02;
+    undocumented = cputype == CT_NMOS6502UNDEF;
+}
+
+inline quint8 Emulator6502::fetch(void) {
+    coverage[PC] |= COV_OPERAND;
+    return memory[PC++];
+}
+
+inline quint16 Emulator6502::fetch16(void) {
+    quint16 lo = fetch();
+    return lo | fetch() << 8;
+}
+
+inline quint8 Emulator6502::read(quint16 a) {
+    coverage[a] |= COV_READ;
+    return memory[a];
+}
+
+inline void Emulator6502::write(quint16 a, quint8 v) {
+    coverage[a] |= COV_WRITE;
+    memory[a] = v;
+}
+
+inline quint16 Emulator6502::readPointer(quint8 zp) {
+    quint16 lo = read(zp);
+    return lo | read((quint8) (zp + 1)) << 8;
+}
+
+// The stack page is not tracked, it is never interesting as data
+
+inline void Emulator6502::push(quint8 v) {
+    memory[0x100 + S--] = v;
+}
+
+inline quint8 Emulator6502::pull(void) {
+    return memory[0x100 + ++S];
+}
+
+inline quint8 Emulator6502::getP(bool brk) {
+    return (N & 0x80) | (V ? 0x40 : 0) | 0x20 | (brk ? 0x10 : 0) |
+           (D ? 0x08 : 0) | (I ? 0x04 : 0) | (Z ? 0 : 0x02) | (C ? 0x01 : 0);
+}
+
+inline void Emulator6502::setP(quint8 p) {
+    N = p & 0x80;
+    V = p & 0x40;
+    D = p & 0x08;
+    I = p & 0x04;
+    Z = !(p & 0x02);
+    C = p & 0x01;
+}
+
+inline quint8 Emulator6502::setNZ(quint8 v) {
+    N = Z = v;
+    return v;
+}
+
+// --------------------------------------------------------------------------
+
+void Emulator6502::adc(quint8 v) {
+    if (!D) {
+        unsigned int t = A + v + C;
+        V = ~(A ^ v) & (A ^ t) & 0x80;
+        C = t > 0xff;
+        A = setNZ(t);
+        return;
+    }
+
+    unsigned int t = (A & 0x0f) + (v & 0x0f) + C;
+    if (t > 9)
+        t += 6;
+    if (t <= 0x0f)
+        t = (t & 0x0f) + (A & 0xf0) + (v & 0xf0);
+    else
+        t = (t & 0x0f) + (A & 0xf0) + (v & 0xf0) + 0x10;
+
+    Z = A + v + C;                      // NMOS: Z from the binary result
+    N = t;
+    V = ((A ^ t) & 0x80) && !((A ^ v) & 0x80);
+    if ((t & 0x1f0) > 0x90)
+        t += 0x60;
+    C = (t & 0xff0) > 0xf0;
+    A = t;
+
+    if (cmos)
+        setNZ(A);
+}
+
+void Emulator6502::sbc(quint8 v) {
+    unsigned int t = A - v - !C;
+
+    if (!D) {
+        V = (A ^ v) & (A ^ t) & 0x80;
+        C = t < 0x100;
+        A = setNZ(t);
+        return;
+    }
+
+    unsigned int d = (A & 0x0f) - (v & 0x0f) - !C;
+    if (d & 0x10)
+        d = ((d - 6) & 0x0f) | ((A & 0xf0) - (v & 0xf0) - 0x10);
+    else
+        d = (d & 0x0f) | ((A & 0xf0) - (v & 0xf0));
+    if (d & 0x100)
+        d -= 0x60;
+
+    V = (A ^ v) & (A ^ t) & 0x80;
+    C = t < 0x100;
+    setNZ(t);
+    A = d;
+
+    if (cmos)
+        setNZ(A);
+}
+
+void Emulator6502::compare(quint8 r, quint8 v) {
+    C = r >= v;
+    setNZ(r - v);
+}
+
+quint8 Emulator6502::asl(quint8 v) {
+    C = v & 0x80;
+    return setNZ(v << 1);
+}
+
+quint8 Emulator6502::lsr(quint8 v) {
+    C = v & 0x01;
+    return setNZ(v >> 1);
+}
+
+quint8 Emulator6502::rol(quint8 v) {
+    bool c = C;
+    C = v & 0x80;
+    return setNZ(v << 1 | c);
+}
+
+quint8 Emulator6502::ror(quint8 v) {
+    bool c = C;
+    C = v & 0x01;
+    return setNZ(v >> 1 | (c ? 0x80 : 0));
+}
+
+void Emulator6502::bit(quint8 v) {
+    Z = A & v;
+    N = v;
+    V = v & 0x40;
+}
+
+bool Emulator6502::branch(bool condition, quint16 address) {
+    auto offset = (qint8) fetch();
+
+    if (!condition)
+        return true;
+
+    quint16 target = PC + offset;
+    if (target == address) {
+        stop_reason = QStringLiteral("endless loop at $%1").arg(address,4,16,(QChar)'0');
+        return false;
+    }
+    PC = target;
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+quint64 Emulator6502::run(quint16 entry, quint64 maxCycles) {
+    quint64 cycles = 0;
+
+    PC = entry;
+    S = 0xff;
+    setP(0x04);
+    returned = false;
+    stop_reason.clear();
+    for (auto &r : returns)
+        r = NO_RETURN;
+
+    while (cycles < maxCycles) {
+        if (!step(cycles))
+            return cycles;
+    }
+
+    stop_reason = QStringLiteral("cycle budget exhausted");
+    return cycles;
+}
+
+// --------------------------------------------------------------------------
+
+// Documented NMOS instructions, shared by all variants. Returns false when
+// emulation has to stop.
+
+bool Emulator6502::step(quint64 &cycles) {
+    quint16 address = PC;
+    quint16 ea;
+    quint8 opcode;
+
+    coverage[PC] |= COV_EXEC;
+    opcode = memory[PC++];
+    cycles += cycletab[opcode];
+    instructions++;
+
+    switch (opcode) {
+    case 0x09: A = setNZ(A | fetch()); break;
+    case 0x05: A = setNZ(A | read(ZP)); break;
+    case 0x15: A = setNZ(A | read(ZPX)); break;
+    case 0x0d: A = setNZ(A | read(ABS)); break;
+    case 0x1d: A = setNZ(A | read(ABSX)); break;
+    case 0x19: A = setNZ(A | read(ABSY)); break;
+    case 0x01: A = setNZ(A | read(INDX)); break;
+    case 0x11: A = setNZ(A | read(INDY)); break;
+
+    case 0x29: A = setNZ(A & fetch()); break;
+    case 0x25: A = setNZ(A & read(ZP)); break;
+    case 0x35: A = setNZ(A & read(ZPX)); break;
+    case 0x2d: A = setNZ(A & read(ABS)); break;
+    case 0x3d: A = setNZ(A & read(ABSX)); break;
+    case 0x39: A = setNZ(A & read(ABSY)); break;
+    case 0x21: A = setNZ(A & read(INDX)); break;
+    case 0x31: A = setNZ(A & read(INDY)); break;
+
+    case 0x49: A = setNZ(A ^ fetch()); break;
+    case 0x45: A = setNZ(A ^ read(ZP)); break;
+    case 0x55: A = setNZ(A ^ read(ZPX)); break;
+    case 0x4d: A = setNZ(A ^ read(ABS)); break;
+    case 0x5d: A = setNZ(A ^ read(ABSX)); break;
+    case 0x59: A = setNZ(A ^ read(ABSY)); break;
+    case 0x41: A = setNZ(A ^ read(INDX)); break;
+    case 0x51: A = setNZ(A ^ read(INDY)); break;
+
+    case 0x69: adc(fetch()); break;
+    case 0x65: adc(read(ZP)); break;
+    case 0x75: adc(read(ZPX)); break;
+    case 0x6d: adc(read(ABS)); break;
+    case 0x7d: adc(read(ABSX)); break;
+    case 0x79: adc(read(ABSY)); break;
+    case 0x61: adc(read(INDX)); break;
+    case 0x71: adc(read(INDY)); break;
+
+    case 0xe9: sbc(fetch()); break;
+    case 0xe5: sbc(read(ZP)); break;
+    case 0xf5: sbc(read(ZPX)); break;
+    case 0xed: sbc(read(ABS)); break;
+    case 0xfd: sbc(read(ABSX)); break;
+    case 0xf9: sbc(read(ABSY)); break;
+    case 0xe1: sbc(read(INDX)); break;
+    case 0xf1: sbc(read(INDY)); break;
+
+    case 0xc9: compare(A, fetch()); break;
+    case 0xc5: compare(A, read(ZP)); break;
+    case 0xd5: compare(A, read(ZPX)); break;
+    case 0xcd: compare(A, read(ABS)); break;
+    case 0xdd: compare(A, read(ABSX)); break;
+    case 0xd9: compare(A, read(ABSY)); break;
+    case 0xc1: compare(A, read(INDX)); break;
+    case 0xd1: compare(A, read(INDY)); break;
+
+    case 0xe0: compare(X, fetch()); break;
+    case 0xe4: compare(X, read(ZP)); break;
+    case 0xec: compare(X, read(ABS)); break;
+    case 0xc0: compare(Y, fetch()); break;
+    case 0xc4: compare(Y, read(ZP)); break;
+    case 0xcc: compare(Y, read(ABS)); break;
+
+    case 0xa9: A = setNZ(fetch()); break;
+    case 0xa5: A = setNZ(read(ZP)); break;
+    case 0xb5: A = setNZ(read(ZPX)); break;
+    case 0xad: A = setNZ(read(ABS)); break;
+    case 0xbd: A = setNZ(read(ABSX)); break;
+    case 0xb9: A = setNZ(read(ABSY)); break;
+    case 0xa1: A = setNZ(read(INDX)); break;
+    case 0xb1: A = setNZ(read(INDY)); break;
+
+    case 0xa2: X = setNZ(fetch()); break;
+    case 0xa6: X = setNZ(read(ZP)); break;
+    case 0xb6: X = setNZ(read(ZPY)); break;
+    case 0xae: X = setNZ(read(ABS)); break;
+    case 0xbe: X = setNZ(read(ABSY)); break;
+
+    case 0xa0: Y = setNZ(fetch()); break;
+    case 0xa4: Y = setNZ(read(ZP)); break;
+    case 0xb4: Y = setNZ(read(ZPX)); break;
+    case 0xac: Y = setNZ(read(ABS)); break;
+    case 0xbc: Y = setNZ(read(ABSX)); break;
+
+    case 0x85: write(ZP, A); break;
+    case 0x95: write(ZPX, A); break;
+    case 0x8d: write(ABS, A); break;
+    case 0x9d: write(ABSX, A); break;
+    case 0x99: write(ABSY, A); break;
+    case 0x81: write(INDX, A); break;
+    case 0x91: write(INDY, A); break;
+
+    case 0x86: write(ZP, X); break;
+    case 0x96: write(ZPY, X); break;
+    case 0x8e: write(ABS, X); break;
+    case 0x84: write(ZP, Y); break;
+    case 0x94: write(ZPX, Y); break;
+    case 0x8c: write(ABS, Y); break;
+
+    case 0x0a: A = asl(A); break;
+    case 0x06: ea = ZP;   write(ea, asl(read(ea))); break;
+    case 0x16: ea = ZPX;  write(ea, asl(read(ea))); break;
+    case 0x0e: ea = ABS;  write(ea, asl(read(ea))); break;
+    case 0x1e: ea = ABSX; write(ea, asl(read(ea))); break;
+
+    case 0x2a: A = rol(A); break;
+    case 0x26: ea = ZP;   write(ea, rol(read(ea))); break;
+    case 0x36: ea = ZPX;  write(ea, rol(read(ea))); break;
+    case 0x2e: ea = ABS;  write(ea, rol(read(ea))); break;
+    case 0x3e: ea = ABSX; write(ea, rol(read(ea))); break;
+
+    case 0x4a: A = lsr(A); break;
+    case 0x46: ea = ZP;   write(ea, lsr(read(ea))); break;
+    case 0x56: ea = ZPX;  write(ea, lsr(read(ea))); break;
+    case 0x4e: ea = ABS;  write(ea, lsr(read(ea))); break;
+    case 0x5e: ea = ABSX; write(ea, lsr(read(ea))); break;
+
+    case 0x6a: A = ror(A); break;
+    case 0x66: ea = ZP;   write(ea, ror(read(ea))); break;
+    case 0x76: ea = ZPX;  write(ea, ror(read(ea))); break;
+    case 0x6e: ea = ABS;  write(ea, ror(read(ea))); break;
+    case 0x7e: ea = ABSX; write(ea, ror(read(ea))); break;
+
+    case 0xc6: ea = ZP;   write(ea, setNZ(read(ea) - 1)); break;
+    case 0xd6: ea = ZPX;  write(ea, setNZ(read(ea) - 1)); break;
+    case 0xce: ea = ABS;  write(ea, setNZ(read(ea) - 1)); break;
+    case 0xde: ea = ABSX; write(ea, setNZ(read(ea) - 1)); break;
+
+    case 0xe6: ea = ZP;   write(ea, setNZ(read(ea) + 1)); break;
+    case 0xf6: ea = ZPX;  write(ea, setNZ(read(ea) + 1)); break;
+    case 0xee: ea = ABS;  write(ea, setNZ(read(ea) + 1)); break;
+    case 0xfe: ea = ABSX; write(ea, setNZ(read(ea) + 1)); break;
+
+    case 0x24: bit(read(ZP)); break;
+    case 0x2c: bit(read(ABS)); break;
+
+    case 0xca: X = setNZ(X - 1); break;
+    case 0x88: Y = setNZ(Y - 1); break;
+    case 0xe8: X = setNZ(X + 1); break;
+    case 0xc8: Y = setNZ(Y + 1); break;
+
+    case 0xaa: X = setNZ(A); break;
+    case 0x8a: A = setNZ(X); break;
+    case 0xa8: Y = setNZ(A); break;
+    case 0x98: A = setNZ(Y); break;
+    case 0xba: X = setNZ(S); break;
+    case 0x9a: S = X; break;
+
+    case 0x18: C = false; break;
+    case 0x38: C = true;  break;
+    case 0x58: I = false; break;
+    case 0x78: I = true;  break;
+    case 0xb8: V = false; break;
+    case 0xd8: D = false; break;
+    case 0xf8: D = true;  break;
+
+    case 0x48: push(A); break;
+    case 0x68: A = setNZ(pull()); break;
+    case 0x08: push(getP(true)); break;
+    case 0x28: setP(pull()); break;
+
+    case 0xea: break;
+
+    case 0x10: return branch(!(N & 0x80), address);
+    case 0x30: return branch(N & 0x80, address);
+    case 0x50: return branch(!V, address);
+    case 0x70: return branch(V, address);
+    case 0x90: return branch(!C, address);
+    case 0xb0: return branch(C, address);
+    case 0xd0: return branch(Z, address);
+    case 0xf0: return branch(!Z, address);
+
+    case 0x4c:
+        ea = fetch16();
+        if (ea == address) {
+            stop_reason = QStringLiteral("endless loop at $%1").arg(address,4,16,(QChar)'0');
+            return false;
+        }
+        PC = ea;
+        break;
+
+    case 0x6c:
+        ea = fetch16();
+        if (cmos) {
+            PC = read(ea) | read(ea + 1) << 8;
+        } else {            // NMOS does not cross the page boundary
+            PC = read(ea) | read((ea & 0xff00) | ((ea + 1) & 0x00ff)) << 8;
+        }
+        coverage[PC] |= COV_TARGET;
+        break;
+
+    case 0x20:
+        ea = fetch16();
+        push((PC - 1) >> 8);
+        push((PC - 1) & 0xff);
+        returns[S] = (quint16) (PC - 1);
+        PC = ea;
+        break;
+
+    case 0x60: {
+        if (S >= 0xfe) {
+            returned = true;
+            stop_reason = QStringLiteral("returned");
+            return false;
+        }
+        quint8 sp = S;
+        quint16 ret = pull();
+        ret |= pull() << 8;
+        PC = ret + 1;
+        if (returns[sp] != ret)         // RTS used as a jump
+            coverage[PC] |= COV_TARGET;
+        returns[sp] = NO_RETURN;
+        break;
+        }
+
+    case 0x40:
+        if (S >= 0xfd) {
+            returned = true;
+            stop_reason = QStringLiteral("returned");
+            return false;
+        }
+        setP(pull());
+        PC = pull();
+        PC |= pull() << 8;
+        coverage[PC] |= COV_TARGET;
+        break;
+
+    case 0x00:
+        stop_reason = QStringLiteral("BRK at $%1").arg(address,4,16,(QChar)'0');
+        return false;
+
+    default:
+        if (cmos)
+            return stepCMOS(opcode, address);
+        if (undocumented)
+            return stepUndocumented(opcode);
+
+        stop_reason = QStringLiteral("undefined opcode $%1 at $%2")
+                        .arg(opcode,2,16,(QChar)'0').arg(address,4,16,(QChar)'0');
+        return false;
+    }
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+bool Emulator6502::stepCMOS(quint8 opcode, quint16 address) {
+    quint16 ea;
+    quint8 v;
+
+    // rmb0-7 and smb0-7
+
+    if ((opcode & 0x0f) == 0x07) {
+        ea = ZP;
+        v = 1 << ((opcode >> 4) & 7);
+        if (opcode & 0x80)
+            write(ea, read(ea) | v);
+        else
+            write(ea, read(ea) & ~v);
+        return true;
+    }
+
+    // bbr0-7 and bbs0-7
+
+    if ((opcode & 0x0f) == 0x0f) {
+        v = read(ZP) & (1 << ((opcode >> 4) & 7));
+        return branch((opcode & 0x80) ? v : !v, address);
+    }
+
+    switch (opcode) {
+    case 0x12: A = setNZ(A | read(INDZP)); break;
+    case 0x32: A = setNZ(A & read(INDZP)); break;
+    case 0x52: A = setNZ(A ^ read(INDZP)); break;
+    case 0x72: adc(read(INDZP)); break;
+    case 0x92: write(INDZP, A); break;
+    case 0xb2: A = setNZ(read(INDZP)); break;
+    case 0xd2: compare(A, read(INDZP)); break;
+    case 0xf2: sbc(read(INDZP)); break;
+
+    case 0x04: ea = ZP;  v = read(ea); Z = A & v; write(ea, v | A); break;
+    case 0x0c: ea = ABS; v = read(ea); Z = A & v; write(ea, v | A); break;
+    case 0x14: ea = ZP;  v = read(ea); Z = A & v; write(ea, v & ~A); break;
+    case 0x1c: ea = ABS; v = read(ea); Z = A & v; write(ea, v & ~A); break;
+
+    case 0x1a: A = setNZ(A + 1); break;
+    case 0x3a: A = setNZ(A - 1); break;
+
+    case 0x34: bit(read(ZPX)); break;
+    case 0x3c: bit(read(ABSX)); break;
+    case 0x89: Z = A & fetch(); break;
+
+    case 0x5a: push(Y); break;
+    case 0x7a: Y = setNZ(pull()); break;
+    case 0xda: push(X); break;
+    case 0xfa: X = setNZ(pull()); break;
+
+    case 0x64: write(ZP, 0); break;
+    case 0x74: write(ZPX, 0); break;
+    case 0x9c: write(ABS, 0); break;
+    case 0x9e: write(ABSX, 0); break;
+
+    case 0x80: return branch(true, address);
+
+    case 0x7c:
+        ea = ABSX;
+        PC = read(ea) | read(ea + 1) << 8;
+        coverage[PC] |= COV_TARGET;
+        break;
+
+    case 0xcb:
+    case 0xdb:
+        stop_reason = QStringLiteral("WAI/STP at $%1").arg(address,4,16,(QChar)'0');
+        return false;
+
+    default:
+        stop_reason = QStringLiteral("undefined opcode $%1 at $%2")
+                        .arg(opcode,2,16,(QChar)'0').arg(address,4,16,(QChar)'0');
+        return false;
+    }
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+bool Emulator6502::stepUndocumented(quint8 opcode) {
+    quint16 ea, base;
+    quint8 v;
+    quint8 row = opcode >> 5;
+    quint8 col = opcode & 0x1f;
+
+    // aso, rln, lse, rrd, dcp and isb share their addressing modes
+
+    if ((col & 0x03) == 0x03 && col != 0x0b && row != 4 && row != 5) {
+        switch (col) {
+        case 0x03: ea = INDX; break;
+        case 0x07: ea = ZP;   break;
+        case 0x0f: ea = ABS;  break;
+        case 0x13: ea = INDY; break;
+        case 0x17: ea = ZPX;  break;
+        case 0x1b: ea = ABSY; break;
+        default:   ea = ABSX; break;
+        }
+        v = read(ea);
+        switch (row) {
+        case 0: v = asl(v); write(ea, v); A = setNZ(A | v); break;
+        case 1: v = rol(v); write(ea, v); A = setNZ(A & v); break;
+        case 2: v = lsr(v); write(ea, v); A = setNZ(A ^ v); break;
+        case 3: v = ror(v); write(ea, v); adc(v); break;
+        case 6: v--;        write(ea, v); compare(A, v); break;
+        default: v++;       write(ea, v); sbc(v); break;
+        }
+        return true;
+    }
+
+    switch (opcode) {
+    case 0x83: write(INDX, A & X); break;
+    case 0x87: write(ZP, A & X); break;
+    case 0x8f: write(ABS, A & X); break;
+    case 0x97: write(ZPY, A & X); break;
+
+    case 0xa3: A = X = setNZ(read(INDX)); break;
+    case 0xa7: A = X = setNZ(read(ZP)); break;
+    case 0xaf: A = X = setNZ(read(ABS)); break;
+    case 0xb3: A = X = setNZ(read(INDY)); break;
+    case 0xb7: A = X = setNZ(read(ZPY)); break;
+    case 0xbf: A = X = setNZ(read(ABSY)); break;
+
+    case 0x93:
+        base = readPointer(fetch());
+        write(base + Y, A & X & ((base >> 8) + 1));
+        break;
+    case 0x9f:
+        base = fetch16();
+        write(base + Y, A & X & ((base >> 8) + 1));
+        break;
+    case 0x9b:
+        base = fetch16();
+        S = A & X;
+        write(base + Y, S & ((base >> 8) + 1));
+        break;
+    case 0x9c:
+        base = fetch16();
+        write(base + X, Y & ((base >> 8) + 1));
+        break;
+    case 0x9e:
+        base = fetch16();
+        write(base + Y, X & ((base >> 8) + 1));
+        break;
+    case 0xbb:
+        A = X = S = setNZ(read(ABSY) & S);
+        break;
+
+    case 0x0b:
+    case 0x2b:
+        A = setNZ(A & fetch());
+        C = N & 0x80;
+        break;
+    case 0x4b:
+        A = lsr(A & fetch());
+        break;
+    case 0x6b:
+        A &= fetch();
+        A = setNZ(A >> 1 | (C ? 0x80 : 0));
+        C = A & 0x40;
+        V = ((A >> 6) ^ (A >> 5)) & 1;
+        break;
+    case 0x8b:
+        A = setNZ((A | 0xee) & X & fetch());
+        break;
+    case 0xab:
+        A = X = setNZ((A | 0xee) & fetch());
+        break;
+    case 0xcb:
+        v = fetch();
+        C = (A & X) >= v;
+        X = setNZ((A & X) - v);
+        break;
+    case 0xeb:
+        sbc(fetch());
+        break;
+
+    case 0x1a: case 0x3a: case 0x5a: case 0x7a: case 0xda: case 0xfa:
+        break;
+    case 0x80: case 0x82: case 0x89: case 0xc2: case 0xe2:
+    case 0x04: case 0x44: case 0x64:
+    case 0x14: case 0x34: case 0x54: case 0x74: case 0xd4: case 0xf4:
+        fetch();
+        break;
+    case 0x0c:
+    case 0x1c: case 0x3c: case 0x5c: case 0x7c: case 0xdc: case 0xfc:
+        fetch16();
+        break;
+
+    default:            // cim
+        stop_reason = QStringLiteral("CPU jammed by opcode $%1 at $%2")
+                        .arg(opcode,2,16,(QChar)'0').arg(PC-1,4,16,(QChar)'0');
+        return false;
+    }
+    return true;
+}
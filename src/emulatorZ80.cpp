@@ -0,0 +1,1165 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#include "emulator.h"
+
+// Base T-states of the unprefixed opcodes, conditional extras ignored.
+// On the 8080 the Z80 prefixes are alternative jmp/call opcodes.
+
+static const quint8 cycletab[256] = {
+     4,10, 7, 6, 4, 4, 7, 4, 4,11, 7, 6, 4, 4, 7, 4,
+     8,10, 7, 6, 4, 4, 7, 4,12,11, 7, 6, 4, 4, 7, 4,
+     7,10,16, 6, 4, 4, 7, 4, 7,11,16, 6, 4, 4, 7, 4,
+     7,10,13, 6,11,11,10, 4, 7,11,13, 6, 4, 4, 7, 4,
+     4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+     4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+     4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+     7, 7, 7, 7, 7, 7, 4, 7, 4, 4, 4, 4, 4, 4, 7, 4,
+     4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+     4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+     4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+     4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+     5,10,10,10,10,11, 7,11, 5,10,10,10,10,17, 7,11,
+     5,10,10,11,10,11, 7,11, 5, 4,10,11,10,17, 7,11,
+     5,10,10,19,10,11, 7,11, 5, 4,10, 4,10,17, 7,11,
+     5,10,10, 4,10,11, 7,11, 5, 6,10, 4,10,17, 7,11
+};
+
+#define NO_RETURN   0xffffffff
+
+#define FC  0x01
+#define FN  0x02
+#define FP  0x04
+#define FH  0x10
+#define FZ  0x40
+#define FS  0x80
+
+// CP/M stand-in. BDOS is entered through jp $fe06 at $0005, the BIOS jump
+// table lives at $ff00 and warm boot at $0000 jumps to its second entry.
+
+#define BDOS_ENTRY      0xfe06
+#define BIOS_BASE       0xff00
+#define BIOS_ENTRIES    17
+#define CPM_STACK       0xfe00
+
+static inline quint8 sz(quint8 v) {
+    return (v & FS) | (v ? 0 : FZ);
+}
+
+static inline quint8 parity(quint8 v) {
+    v ^= v >> 4;
+    v ^= v >> 2;
+    v ^= v >> 1;
+    return (v & 1) ? 0 : FP;
+}
+
+static inline quint8 szp(quint8 v) {
+    return sz(v) | parity(v);
+}
+
+// --------------------------------------------------------------------------
+
+EmulatorZ80::EmulatorZ80(quint32 cputype) {
+    i8080 = cputype == CT_INTEL_8080;
+    z180 = cputype == CT_ZILOG_Z180 || cputype == CT_ZILOG_Z180UNDOC;
+
+    A = F = B = C = D = E = H = L = 0;
+    AF_ = BC_ = DE_ = HL_ = 0;
+    IX = IY = 0xffff;
+    SP = PC = 0;
+    I = R = 0;
+    IFF = false;
+    dma = 0x0080;
+}
+
+inline quint8 EmulatorZ80::fetch(void) {
+    coverage[PC] |= COV_OPERAND;
+    return memory[PC++];
+}
+
+inline quint16 EmulatorZ80::fetch16(void) {
+    quint16 lo = fetch();
+    return lo | fetch() << 8;
+}
+
+inline quint8 EmulatorZ80::read(quint16 a) {
+    coverage[a] |= COV_READ;
+    return memory[a];
+}
+
+inline void EmulatorZ80::write(quint16 a, quint8 v) {
+    coverage[a] |= COV_WRITE;
+    memory[a] = v;
+}
+
+inline quint16 EmulatorZ80::read16(quint16 a) {
+    quint16 lo = read(a);
+    return lo | read(a + 1) << 8;
+}
+
+inline void EmulatorZ80::write16(quint16 a, quint16 v) {
+    write(a, v);
+    write(a + 1, v >> 8);
+}
+
+// Stack accesses are not tracked as data
+
+inline void EmulatorZ80::push(quint16 v) {
+    memory[--SP] = v >> 8;
+    memory[--SP] = v;
+}
+
+inline quint16 EmulatorZ80::pop(void) {
+    quint16 lo = memory[SP++];
+    return lo | memory[SP++] << 8;
+}
+
+// --------------------------------------------------------------------------
+
+// index 0 is HL, 1 is IX (dd prefix) and 2 is IY (fd prefix)
+
+inline quint16 EmulatorZ80::getHL(int index) {
+    switch (index) {
+    case 1:  return IX;
+    case 2:  return IY;
+    default: return H << 8 | L;
+    }
+}
+
+inline void EmulatorZ80::setHL(int index, quint16 v) {
+    switch (index) {
+    case 1:  IX = v; break;
+    case 2:  IY = v; break;
+    default: H = v >> 8; L = v; break;
+    }
+}
+
+// bc, de, hl, sp
+
+quint16 EmulatorZ80::getPair(int p, int index) {
+    switch (p) {
+    case 0:  return B << 8 | C;
+    case 1:  return D << 8 | E;
+    case 2:  return getHL(index);
+    default: return SP;
+    }
+}
+
+void EmulatorZ80::setPair(int p, quint16 v, int index) {
+    switch (p) {
+    case 0:  B = v >> 8; C = v; break;
+    case 1:  D = v >> 8; E = v; break;
+    case 2:  setHL(index, v); break;
+    default: SP = v; break;
+    }
+}
+
+// b, c, d, e, h, l, -, a. (hl) is handled by the caller.
+
+quint8 EmulatorZ80::getReg(int r, int index) {
+    switch (r) {
+    case 0:  return B;
+    case 1:  return C;
+    case 2:  return D;
+    case 3:  return E;
+    case 4:  return getHL(index) >> 8;
+    case 5:  return getHL(index);
+    default: return A;
+    }
+}
+
+void EmulatorZ80::setReg(int r, quint8 v, int index) {
+    switch (r) {
+    case 0:  B = v; break;
+    case 1:  C = v; break;
+    case 2:  D = v; break;
+    case 3:  E = v; break;
+    case 4:  setHL(index, (getHL(index) & 0x00ff) | v << 8); break;
+    case 5:  setHL(index, (getHL(index) & 0xff00) | v); break;
+    default: A = v; break;
+    }
+}
+
+quint16 EmulatorZ80::memAddress(int index) {
+    if (!index)
+        return H << 8 | L;
+    return getHL(index) + (qint8) fetch();
+}
+
+// nz, z, nc, c, po, pe, p, m
+
+bool EmulatorZ80::condition(int cc) {
+    switch (cc) {
+    case 0:  return !(F & FZ);
+    case 1:  return F & FZ;
+    case 2:  return !(F & FC);
+    case 3:  return F & FC;
+    case 4:  return !(F & FP);
+    case 5:  return F & FP;
+    case 6:  return !(F & FS);
+    default: return F & FS;
+    }
+}
+
+// --------------------------------------------------------------------------
+
+// There is no static labelling for the Z80 yet, so all destinations are
+// recorded, not just the computed ones.
+
+bool EmulatorZ80::jump(quint16 target, quint16 address) {
+    if (target == address) {
+        stop_reason = QStringLiteral("endless loop at $%1").arg(address,4,16,(QChar)'0');
+        return false;
+    }
+    coverage[target] |= COV_TARGET;
+    PC = target;
+    return true;
+}
+
+void EmulatorZ80::call(quint16 target) {
+    push(PC);
+    returns[SP] = PC;
+    coverage[target] |= COV_TARGET;
+    PC = target;
+}
+
+bool EmulatorZ80::ret(void) {
+    if (SP == initialSP) {
+        returned = true;
+        stop_reason = QStringLiteral("returned");
+        return false;
+    }
+    quint16 sp = SP;
+    PC = pop();
+    if (returns[sp] != PC)              // ret used as a jump
+        coverage[PC] |= COV_TARGET;
+    returns[sp] = NO_RETURN;
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+// add, adc, sub, sbc, and, xor, or, cp
+
+void EmulatorZ80::alu(int op, quint8 v) {
+    unsigned int r;
+    int c = (op == 1 || op == 3) ? (F & FC) : 0;
+
+    switch (op) {
+    case 0:
+    case 1:
+        r = A + v + c;
+        F = sz(r) | ((A ^ v ^ r) & FH) | ((r >> 8) & FC);
+        F |= i8080 ? parity(r) : ((A ^ ~v) & (A ^ r) & 0x80) >> 5;
+        A = r;
+        break;
+    case 2:
+    case 3:
+    case 7:
+        r = A - v - c;
+        F = sz(r) | ((A ^ v ^ r) & FH) | ((r >> 8) & FC) | FN;
+        F |= i8080 ? parity(r) : ((A ^ v) & (A ^ r) & 0x80) >> 5;
+        if (op != 7)
+            A = r;
+        break;
+    case 4:
+        A &= v;
+        F = szp(A) | FH;
+        break;
+    case 5:
+        A ^= v;
+        F = szp(A);
+        break;
+    default:
+        A |= v;
+        F = szp(A);
+        break;
+    }
+}
+
+quint8 EmulatorZ80::inc8(quint8 v) {
+    quint8 r = v + 1;
+    F = (F & FC) | sz(r) | ((r & 0x0f) ? 0 : FH);
+    F |= i8080 ? parity(r) : (r == 0x80 ? FP : 0);
+    return r;
+}
+
+quint8 EmulatorZ80::dec8(quint8 v) {
+    quint8 r = v - 1;
+    F = (F & FC) | sz(r) | FN | ((r & 0x0f) == 0x0f ? FH : 0);
+    F |= i8080 ? parity(r) : (r == 0x7f ? FP : 0);
+    return r;
+}
+
+quint16 EmulatorZ80::add16(quint16 a, quint16 b) {
+    quint32 r = a + b;
+    F = (F & (FS | FZ | FP)) | (((a ^ b ^ r) >> 8) & FH) | ((r >> 16) & FC);
+    return r;
+}
+
+void EmulatorZ80::adc16(quint16 v) {
+    quint16 hl = H << 8 | L;
+    quint32 r = hl + v + (F & FC);
+    F = ((r >> 8) & FS) | ((r & 0xffff) ? 0 : FZ) | (((hl ^ v ^ r) >> 8) & FH) |
+        ((r >> 16) & FC) | ((~(hl ^ v) & (hl ^ r) & 0x8000) >> 13);
+    setHL(0, r);
+}
+
+void EmulatorZ80::sbc16(quint16 v) {
+    quint16 hl = H << 8 | L;
+    quint32 r = hl - v - (F & FC);
+    F = ((r >> 8) & FS) | ((r & 0xffff) ? 0 : FZ) | (((hl ^ v ^ r) >> 8) & FH) |
+        ((r >> 16) & FC) | (((hl ^ v) & (hl ^ r) & 0x8000) >> 13) | FN;
+    setHL(0, r);
+}
+
+// rlc, rrc, rl, rr, sla, sra, sll, srl
+
+quint8 EmulatorZ80::rotate(int op, quint8 v) {
+    quint8 c;
+
+    switch (op) {
+    case 0:  c = v >> 7; v = v << 1 | c; break;
+    case 1:  c = v & 1;  v = v >> 1 | c << 7; break;
+    case 2:  c = v >> 7; v = v << 1 | (F & FC); break;
+    case 3:  c = v & 1;  v = v >> 1 | (F & FC) << 7; break;
+    case 4:  c = v >> 7; v = v << 1; break;
+    case 5:  c = v & 1;  v = v >> 1 | (v & 0x80); break;
+    case 6:  c = v >> 7; v = v << 1 | 1; break;
+    default: c = v & 1;  v = v >> 1; break;
+    }
+    F = szp(v) | c;
+    return v;
+}
+
+void EmulatorZ80::daa(void) {
+    quint8 correction = 0;
+    bool c = F & FC;
+    bool h;
+
+    if ((F & FH) || (A & 0x0f) > 9)
+        correction = 0x06;
+    if (c || A > 0x99) {
+        correction |= 0x60;
+        c = true;
+    }
+    if (F & FN) {
+        h = (F & FH) && (A & 0x0f) < 6;
+        A -= correction;
+    } else {
+        h = (A & 0x0f) > 9;
+        A += correction;
+    }
+    F = szp(A) | (h ? FH : 0) | (F & FN) | (c ? FC : 0);
+}
+
+// --------------------------------------------------------------------------
+
+quint64 EmulatorZ80::run(quint16 entry, quint64 maxCycles) {
+    quint64 cycles = 0;
+
+    // Put the stack in the highest free area, or below BDOS for CP/M
+
+    if (cpm) {
+        SP = CPM_STACK;
+    } else {
+        quint32 top = 0x10000;
+        int free = 0;
+        for (int a = 0xffff; a >= 0 && free < 256; a--) {
+            if (owner[a] >= 0) {
+                top = a;
+                free = 0;
+            } else {
+                free++;
+            }
+        }
+        SP = top;
+    }
+
+    initialSP = SP;
+    PC = entry;
+    returned = false;
+    stop_reason.clear();
+    for (auto &r : returns)
+        r = NO_RETURN;
+
+    while (cycles < maxCycles) {
+        if (cpm && PC >= BDOS_ENTRY) {
+            if (PC == BDOS_ENTRY) {
+                cycles += 100;
+                if (!bdos() || !ret())
+                    return cycles;
+                continue;
+            }
+            int function = (PC - BIOS_BASE) / 3;
+            if (PC >= BIOS_BASE && function < BIOS_ENTRIES && !((PC - BIOS_BASE) % 3)) {
+                if (function <= 1) {
+                    returned = true;
+                    stop_reason = QStringLiteral("program exited");
+                    return cycles;
+                }
+                cycles += 100;
+                bios(function);
+                if (!ret())
+                    return cycles;
+                continue;
+            }
+        }
+
+        // Calls into ROM or other code that is not part of the project
+        // return immediately
+
+        if (!cpm && owner[PC] < 0 && !(coverage[PC] & COV_WRITE)) {
+            cycles += 10;
+            if (!ret())
+                return cycles;
+            continue;
+        }
+
+        if (!step(cycles))
+            return cycles;
+    }
+
+    stop_reason = QStringLiteral("cycle budget exhausted");
+    return cycles;
+}
+
+// --------------------------------------------------------------------------
+
+// Opcodes are decoded by their x/y/z/p/q fields:
+//
+//      x = bits 7-6, y = bits 5-3, z = bits 2-0, p = bits 5-4, q = bit 3
+
+bool EmulatorZ80::step(quint64 &cycles) {
+    quint16 address = PC;
+    quint16 ea;
+    quint8 opcode, v;
+    int index = 0;
+
+    coverage[PC] |= COV_EXEC;
+    opcode = memory[PC++];
+    R = (R & 0x80) | ((R + 1) & 0x7f);
+    instructions++;
+
+    if (!i8080) {
+        while (opcode == 0xdd || opcode == 0xfd) {
+            index = opcode == 0xdd ? 1 : 2;
+            cycles += 4;
+            opcode = fetch();
+        }
+        if (opcode == 0xcb) {
+            cycles += index ? 19 : 8;
+            return stepCB(index);
+        }
+        if (opcode == 0xed)
+            return stepED(address, cycles);
+    }
+
+    cycles += cycletab[opcode];
+
+    int x = opcode >> 6;
+    int y = (opcode >> 3) & 7;
+    int z = opcode & 7;
+    int p = y >> 1;
+    int q = y & 1;
+
+    switch (x) {
+    case 0:
+        switch (z) {
+        case 0:
+            if (i8080 || !y)
+                break;
+            switch (y) {
+            case 1: {
+                quint16 t = A << 8 | F;
+                A = AF_ >> 8;
+                F = AF_;
+                AF_ = t;
+                break;
+                }
+            case 2:                     // djnz, may loop to itself
+                v = fetch();
+                if (--B) {
+                    PC += (qint8) v;
+                    coverage[PC] |= COV_TARGET;
+                }
+                break;
+            case 3:
+                v = fetch();
+                return jump(PC + (qint8) v, address);
+            default:
+                v = fetch();
+                if (condition(y - 4))
+                    return jump(PC + (qint8) v, address);
+                break;
+            }
+            break;
+        case 1:
+            if (q)
+                setHL(index, add16(getHL(index), getPair(p, index)));
+            else
+                setPair(p, fetch16(), index);
+            break;
+        case 2:
+            switch (y) {
+            case 0: write(B << 8 | C, A); break;
+            case 1: A = read(B << 8 | C); break;
+            case 2: write(D << 8 | E, A); break;
+            case 3: A = read(D << 8 | E); break;
+            case 4: write16(fetch16(), getHL(index)); break;
+            case 5: setHL(index, read16(fetch16())); break;
+            case 6: write(fetch16(), A); break;
+            default: A = read(fetch16()); break;
+            }
+            break;
+        case 3:
+            setPair(p, getPair(p, index) + (q ? -1 : 1), index);
+            break;
+        case 4:
+            if (y == 6) {
+                ea = memAddress(index);
+                write(ea, inc8(read(ea)));
+            } else {
+                setReg(y, inc8(getReg(y, index)), index);
+            }
+            break;
+        case 5:
+            if (y == 6) {
+                ea = memAddress(index);
+                write(ea, dec8(read(ea)));
+            } else {
+                setReg(y, dec8(getReg(y, index)), index);
+            }
+            break;
+        case 6:
+            if (y == 6) {
+                ea = memAddress(index);
+                write(ea, fetch());
+            } else {
+                setReg(y, fetch(), index);
+            }
+            break;
+        default:
+            switch (y) {
+            case 0:
+                A = A << 1 | A >> 7;
+                F = (F & (FS | FZ | FP)) | (A & FC);
+                break;
+            case 1:
+                F = (F & (FS | FZ | FP)) | (A & FC);
+                A = A >> 1 | A << 7;
+                break;
+            case 2:
+                v = A >> 7;
+                A = A << 1 | (F & FC);
+                F = (F & (FS | FZ | FP)) | v;
+                break;
+            case 3:
+                v = A & 1;
+                A = A >> 1 | (F & FC) << 7;
+                F = (F & (FS | FZ | FP)) | v;
+                break;
+            case 4:
+                daa();
+                break;
+            case 5:
+                A = ~A;
+                F |= FH | FN;
+                break;
+            case 6:
+                F = (F & (FS | FZ | FP)) | FC;
+                break;
+            default:
+                F = (F & (FS | FZ | FP)) | ((F & FC) ? FH : FC);
+                break;
+            }
+            break;
+        }
+        break;
+
+    case 1:
+        if (opcode == 0x76) {
+            stop_reason = QStringLiteral("HALT at $%1").arg(address,4,16,(QChar)'0');
+            return false;
+        }
+        if (y == 6)
+            write(memAddress(index), getReg(z, 0));
+        else if (z == 6)
+            setReg(y, read(memAddress(index)), 0);
+        else
+            setReg(y, getReg(z, index), index);
+        break;
+
+    case 2:
+        alu(y, z == 6 ? read(memAddress(index)) : getReg(z, index));
+        break;
+
+    default:
+        switch (z) {
+        case 0:
+            if (condition(y))
+                return ret();
+            break;
+        case 1:
+            if (!q) {
+                quint16 t = pop();
+                if (p == 3) {
+                    A = t >> 8;
+                    F = t;
+                } else {
+                    setPair(p, t, index);
+                }
+                break;
+            }
+            switch (p) {
+            case 0:
+                return ret();
+            case 1:
+                if (i8080)
+                    return ret();
+                {
+                    quint16 t;
+                    t = B << 8 | C; B = BC_ >> 8; C = BC_; BC_ = t;
+                    t = D << 8 | E; D = DE_ >> 8; E = DE_; DE_ = t;
+                    t = H << 8 | L; H = HL_ >> 8; L = HL_; HL_ = t;
+                }
+                break;
+            case 2:
+                return jump(getHL(index), address);
+            default:
+                SP = getHL(index);
+                break;
+            }
+            break;
+        case 2:
+            ea = fetch16();
+            if (condition(y))
+                return jump(ea, address);
+            break;
+        case 3:
+            switch (y) {
+            case 0:
+            case 1:                     // 8080 only
+                return jump(fetch16(), address);
+            case 2:
+                fetch();                // out (n),a
+                break;
+            case 3:
+                fetch();                // in a,(n)
+                A = 0xff;
+                break;
+            case 4: {
+                quint16 t = memory[SP] | memory[(quint16) (SP + 1)] << 8;
+                memory[SP] = getHL(index);
+                memory[(quint16) (SP + 1)] = getHL(index) >> 8;
+                setHL(index, t);
+                break;
+                }
+            case 5:
+                v = D; D = H; H = v;
+                v = E; E = L; L = v;
+                break;
+            case 6:
+                IFF = false;
+                break;
+            default:
+                IFF = true;
+                break;
+            }
+            break;
+        case 4:
+            ea = fetch16();
+            if (condition(y))
+                call(ea);
+            break;
+        case 5:
+            if (!q) {
+                push(p == 3 ? (A << 8 | F) : getPair(p, index));
+                break;
+            }
+            call(fetch16());            // call, or 8080 alternatives
+            break;
+        case 6:
+            alu(y, fetch());
+            break;
+        default:
+            call(y * 8);
+            break;
+        }
+        break;
+    }
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+// cb and dd cb / fd cb. The indexed forms also copy the result to a
+// register if z is not 6 (undocumented).
+
+bool EmulatorZ80::stepCB(int index) {
+    quint16 ea = 0;
+    quint8 opcode, v;
+
+    if (index)
+        ea = memAddress(index);
+    opcode = fetch();
+
+    int x = opcode >> 6;
+    int y = (opcode >> 3) & 7;
+    int z = opcode & 7;
+    bool indirect = index || z == 6;
+
+    if (indirect) {
+        if (!index)
+            ea = H << 8 | L;
+        v = read(ea);
+    } else {
+        v = getReg(z, 0);
+    }
+
+    switch (x) {
+    case 0:
+        v = rotate(y, v);
+        break;
+    case 1:
+        F = (F & FC) | FH | ((v & (1 << y)) ? 0 : FZ | FP) |
+            ((y == 7 && (v & 0x80)) ? FS : 0);
+        return true;
+    case 2:
+        v &= ~(1 << y);
+        break;
+    default:
+        v |= 1 << y;
+        break;
+    }
+
+    if (indirect) {
+        write(ea, v);
+        if (index && z != 6)
+            setReg(z, v, 0);
+    } else {
+        setReg(z, v, 0);
+    }
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
+bool EmulatorZ80::stepED(quint16 address, quint64 &cycles) {
+    quint8 opcode = fetch();
+    quint8 v;
+
+    int x = opcode >> 6;
+    int y = (opcode >> 3) & 7;
+    int z = opcode & 7;
+    int p = y >> 1;
+    int q = y & 1;
+
+    cycles += 12;
+
+    if (x == 1) {
+        switch (z) {
+        case 0:                         // in r,(c)
+            v = 0xff;
+            F = (F & FC) | szp(v);
+            if (y != 6)
+                setReg(y, v, 0);
+            break;
+        case 1:                         // out (c),r
+            break;
+        case 2:
+            if (q)
+                adc16(getPair(p, 0));
+            else
+                sbc16(getPair(p, 0));
+            break;
+        case 3:
+            if (q)
+                setPair(p, read16(fetch16()), 0);
+            else
+                write16(fetch16(), getPair(p, 0));
+            break;
+        case 4:
+            if (z180 && q) {            // mlt rr
+                quint16 t = getPair(p, 0);
+                setPair(p, (t >> 8) * (t & 0xff), 0);
+            } else if (z180 && y == 4) {    // tst n
+                F = szp(A & fetch()) | FH;
+            } else {                    // neg
+                v = A;
+                A = 0;
+                alu(2, v);
+            }
+            break;
+        case 5:                         // retn, reti
+            return ret();
+        case 6:                         // im
+            break;
+        default:
+            switch (y) {
+            case 0: I = A; break;
+            case 1: R = A; break;
+            case 2:
+                A = I;
+                F = (F & FC) | sz(A) | (IFF ? FP : 0);
+                break;
+            case 3:
+                A = R;
+                F = (F & FC) | sz(A) | (IFF ? FP : 0);
+                break;
+            case 4: {
+                quint16 hl = H << 8 | L;
+                v = read(hl);
+                write(hl, A << 4 | v >> 4);
+                A = (A & 0xf0) | (v & 0x0f);
+                F = (F & FC) | szp(A);
+                break;
+                }
+            case 5: {
+                quint16 hl = H << 8 | L;
+                v = read(hl);
+                write(hl, v << 4 | (A & 0x0f));
+                A = (A & 0xf0) | v >> 4;
+                F = (F & FC) | szp(A);
+                break;
+                }
+            default:
+                break;
+            }
+            break;
+        }
+        return true;
+    }
+
+    // ldi, cpi, ini, outi, ldd, cpd, ind, outd and their repeating forms.
+    // Repeating is done by executing the same instruction again, so the
+    // cycle budget is honoured.
+
+    if (x == 2 && z <= 3 && y >= 4) {
+        int dir = (y & 1) ? -1 : 1;
+        bool repeat = y >= 6;
+        quint16 hl = H << 8 | L;
+        quint16 de = D << 8 | E;
+        quint16 bc = B << 8 | C;
+
+        switch (z) {
+        case 0:
+            write(de, read(hl));
+            hl += dir;
+            de += dir;
+            bc--;
+            F = (F & (FS | FZ | FC)) | (bc ? FP : 0);
+            repeat = repeat && bc;
+            break;
+        case 1: {
+            v = read(hl);
+            quint8 r = A - v;
+            hl += dir;
+            bc--;
+            F = (F & FC) | sz(r) | ((A ^ v ^ r) & FH) | FN | (bc ? FP : 0);
+            repeat = repeat && bc && r;
+            break;
+            }
+        case 2:
+            write(hl, 0xff);
+            hl += dir;
+            bc -= 0x100;
+            F = FN | ((bc >> 8) ? 0 : FZ);
+            repeat = repeat && (bc >> 8);
+            break;
+        default:
+            read(hl);
+            hl += dir;
+            bc -= 0x100;
+            F = FN | ((bc >> 8) ? 0 : FZ);
+            repeat = repeat && (bc >> 8);
+            break;
+        }
+
+        setPair(0, bc, 0);
+        setPair(1, de, 0);
+        setPair(2, hl, 0);
+        if (repeat)
+            PC = address;
+        return true;
+    }
+
+    // Z180 in0, out0 and tst r
+
+    if (z180 && x == 0) {
+        switch (z) {
+        case 0:
+            fetch();
+            v = 0xff;
+            F = (F & FC) | szp(v);
+            if (y != 6)
+                setReg(y, v, 0);
+            break;
+        case 1:
+            fetch();
+            break;
+        case 4:
+            v = y == 6 ? read(H << 8 | L) : getReg(y, 0);
+            F = szp(A & v) | FH;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return true;                        // everything else is a nop
+}
+
+// --------------------------------------------------------------------------
+// CP/M STAND-IN
+
+void EmulatorZ80::enableCPM(void) {
+    cpm = true;
+
+    memory[0x0000] = 0xc3;              // jp wboot
+    memory[0x0001] = (BIOS_BASE + 3) & 0xff;
+    memory[0x0002] = (BIOS_BASE + 3) >> 8;
+    memory[0x0005] = 0xc3;              // jp bdos
+    memory[0x0006] = BDOS_ENTRY & 0xff;
+    memory[0x0007] = BDOS_ENTRY >> 8;
+
+    for (int i = 0x5c; i < 0x80; i++)   // default fcbs, empty
+        memory[i] = 0;
+    for (int i = 0; i < 11; i++)
+        memory[0x5d+i] = memory[0x6d+i] = ' ';
+    memory[0x80] = 0;                   // empty command tail
+    memory[0x81] = 0x0d;
+}
+
+QString EmulatorZ80::fcbName(quint16 fcb) {
+    QString name, ext;
+
+    for (int i = 1; i <= 11; i++) {
+        char c = read(fcb + i) & 0x7f;
+        if (c == ' ')
+            continue;
+        if (i <= 8)
+            name += QChar::fromLatin1(c).toUpper();
+        else
+            ext += QChar::fromLatin1(c).toUpper();
+    }
+    return ext.isEmpty() ? name : name + QStringLiteral(".") + ext;
+}
+
+QByteArray EmulatorZ80::fcbPattern(quint16 fcb) {
+    QByteArray pattern;
+
+    for (int i = 1; i <= 11; i++)
+        pattern += QChar(read(fcb + i) & 0x7f).toUpper().toLatin1();
+    return pattern;
+}
+
+static QByteArray padName(const QString &name) {
+    QStringList parts = name.split(QLatin1Char('.'));
+    QByteArray padded = parts.at(0).leftJustified(8, QLatin1Char(' '), true).toLatin1();
+    padded += parts.value(1).leftJustified(3, QLatin1Char(' '), true).toLatin1();
+    return padded;
+}
+
+int EmulatorZ80::readRecord(quint16 fcb, int record) {
+    QString name = fcbName(fcb);
+
+    if (!disk.contains(name))
+        return 0xff;
+
+    const QByteArray &file = disk[name];
+    if (record * 128 >= file.size())
+        return 1;                       // end of file
+
+    for (int i = 0; i < 128; i++) {
+        int pos = record * 128 + i;
+        write(dma + i, pos < file.size() ? file.at(pos) : 0x1a);
+    }
+    return 0;
+}
+
+int EmulatorZ80::writeRecord(quint16 fcb, int record) {
+    QString name = fcbName(fcb);
+
+    if (!disk.contains(name))
+        return 0xff;
+
+    QByteArray &file = disk[name];
+    if (file.size() < (record + 1) * 128)
+        file.resize((record + 1) * 128);
+
+    for (int i = 0; i < 128; i++)
+        file[record * 128 + i] = read(dma + i);
+    return 0;
+}
+
+// Returns false if the program terminates.
+
+bool EmulatorZ80::bdos(void) {
+    quint16 de = D << 8 | E;
+    quint16 result = 0;
+    int record;
+
+    switch (C) {
+    case 0:                             // system reset
+        returned = true;
+        stop_reason = QStringLiteral("program exited");
+        return false;
+    case 1:                             // console input
+    case 3:                             // reader input
+        result = 0x1a;
+        break;
+    case 2:                             // console output
+    case 4:                             // punch output
+    case 5:                             // list output
+        if (C == 2)
+            console += QChar(E & 0x7f);
+        break;
+    case 6:                             // direct console i/o
+        if (E < 0xfe)
+            console += QChar(E & 0x7f);
+        break;
+    case 9:                             // print string
+        for (int i = 0; i < 0x10000; i++) {
+            quint8 c = read(de + i);
+            if (c == '$')
+                break;
+            console += QChar(c & 0x7f);
+        }
+        break;
+    case 10:                            // read console buffer
+        write(de + 1, 0);
+        break;
+    case 12:                            // return version number
+        result = 0x0022;
+        break;
+    case 15:                            // open file
+        if (disk.contains(fcbName(de))) {
+            write(de + 12, 0);
+            write(de + 32, 0);
+        } else {
+            result = 0xff;
+        }
+        break;
+    case 17:                            // search for first
+    case 18: {                          // search for next
+        if (C == 17) {
+            QByteArray pattern = fcbPattern(de);
+            searchResults.clear();
+            for (auto i = disk.cbegin(); i != disk.cend(); ++i) {
+                QByteArray name = padName(i.key());
+                bool match = true;
+                for (int j = 0; j < 11 && match; j++)
+                    match = pattern.at(j) == '?' || pattern.at(j) == name.at(j);
+                if (match)
+                    searchResults.append(i.key());
+            }
+        }
+        if (searchResults.isEmpty()) {
+            result = 0xff;
+            break;
+        }
+        QByteArray name = padName(searchResults.takeFirst());
+        write(dma, 0);
+        for (int i = 0; i < 31; i++)
+            write(dma + 1 + i, i < 11 ? name.at(i) : 0);
+        break;
+        }
+    case 19:                            // delete file
+        result = disk.remove(fcbName(de)) ? 0 : 0xff;
+        break;
+    case 20:                            // read sequential
+    case 21:                            // write sequential
+        record = read(de + 12) * 128 + read(de + 32);
+        result = C == 20 ? readRecord(de, record) : writeRecord(de, record);
+        if (!result) {
+            record++;
+            write(de + 12, record / 128);
+            write(de + 32, record % 128);
+        }
+        break;
+    case 22:                            // make file
+        disk.insert(fcbName(de), QByteArray());
+        write(de + 12, 0);
+        write(de + 32, 0);
+        break;
+    case 23: {                          // rename file
+        QString from = fcbName(de);
+        QString to = fcbName(de + 16);
+        if (disk.contains(from) && !disk.contains(to))
+            disk.insert(to, disk.take(from));
+        else
+            result = 0xff;
+        break;
+        }
+    case 24:                            // return login vector
+        result = 0x0001;
+        break;
+    case 26:                            // set dma address
+        dma = de;
+        break;
+    case 33:                            // read random
+    case 34:                            // write random
+        record = read(de + 33) | read(de + 34) << 8;
+        result = C == 33 ? readRecord(de, record) : writeRecord(de, record);
+        break;
+    case 35: {                          // compute file size
+        int size = (disk.value(fcbName(de)).size() + 127) / 128;
+        write(de + 33, size);
+        write(de + 34, size >> 8);
+        write(de + 35, 0);
+        break;
+        }
+    case 36:                            // set random record
+        record = read(de + 12) * 128 + read(de + 32);
+        write(de + 33, record);
+        write(de + 34, record >> 8);
+        write(de + 35, 0);
+        break;
+    default:                            // everything else succeeds
+        break;
+    }
+
+    L = A = result;
+    H = B = result >> 8;
+    return true;
+}
+
+// Warm and cold boot are handled by the caller. Disk i/o always succeeds.
+
+void EmulatorZ80::bios(int function) {
+    switch (function) {
+    case 2:                             // const
+        A = 0;
+        break;
+    case 3:                             // conin
+    case 7:                             // reader
+        A = 0x1a;
+        break;
+    case 4:                             // conout
+        console += QChar(C & 0x7f);
+        break;
+    default:
+        A = 0;
+        break;
+    }
+}
@@ -20,8 +20,15 @@
 //
 // ---------------------------------------------------------------------------
 
+#include "annotations.h"
+#include "banks.h"
+#include "constants.h"
+#include "emitters.h"
 #include "exportassembly.h"
 #include "exportassemblywindow.h"
+#include "profiler.h"
+#include "reassembler.h"
+#include "symbollibrary.h"
 
 static int error;
 extern QString errorstring;
@@ -29,127 +36,120 @@ static int asm_format;
 
 // ---------------------------------------------------------------------------
 
-// Output formats
-
-static void mads_assembler(QString *instr) {
-    instr->replace(QStringLiteral(".wordle"), QStringLiteral(".word"));
-    instr->replace(QStringLiteral(".atascii"), QStringLiteral(".byte"));
-    instr->replace(QStringLiteral(".anticscreen"), QStringLiteral(".sb"));
-    instr->replace(QStringLiteral(".invatascii"), QStringLiteral(".byte +128"));
-    instr->replace(QStringLiteral(".invanticscreen"), QStringLiteral(".sb +128"));
-    instr->replace(QStringLiteral(".org"), QStringLiteral("org"));
+static void write_line(QString &out) {
+    out += QLatin1String("; ----------------------------------------------------------");
+    out += QLatin1String("------------------\n");
 }
 
-static void ca65_assembler(QString *instr) {
-    instr->replace(QStringLiteral(".wordle"), QStringLiteral(".word"));
-    instr->replace(QStringLiteral(".ascii"), QStringLiteral(".byte"));
-    instr->replace(QStringLiteral(".atascii"), QStringLiteral(".byte"));
+// comments can span multiple lines
+
+static void write_comment(QString &out, const QString &com) {
+    out += QLatin1String("; ");
+    for (QChar c : com) {
+        out += c;
+        if (c == QLatin1Char('\n'))
+            out += QLatin1String("; ");
+    }
+    out += QLatin1Char('\n');
 }
 
 // ---------------------------------------------------------------------------
 
-static void write_line(QTextStream *out) {
-    *out << "; ----------------------------------------------------------";
-    *out << "------------------\n";
+// true if a label at key is not overruled by local labels and is not within
+// any of the segments address ranges.
+
+static bool is_external(quint64 key) {
+    for (auto & segment : segments) {
+        if (segment.localLabels.contains(key))
+            return false;
+        if ((key >= segment.start) && (key <= segment.end))
+            return false;
+    }
+    return true;
 }
 
 // ---------------------------------------------------------------------------
 
-void export_assembly(QWidget *widget, bool generateLocalLabels) {
-    auto *asw = new exportAssemblyWindow();
-
-    asw->exec();
+// The whole project as source for one of the ASM_FORMAT_* assemblers
 
-    if (asw->result() == QDialog::Rejected) return;
+void write_assembly(QString &out, int format, bool generateLocalLabels) {
+    ProfileScope scope("write_assembly");
+    AssemblyEmitter *emitter = AssemblyEmitter::create(format);
+    QString hex;
 
-    asm_format = asw->asm_format;
+    out.reserve(4096 + globalLabels.size() * 32);
 
-    QString name = QFileDialog::getSaveFileName(widget, QStringLiteral("Export Assembly As..."));
-
-    if (name.isEmpty()) return;
-
-    QFile file(name);
-
-    file.open(QIODevice::WriteOnly);
-    if (!file.isOpen()) {
-        QMessageBox msg;
-        msg.setText("Failed to open " + name + "\n\n" + file.errorString());
-        msg.exec();
-        return;
-    }
-
-    QString hexPrefix = Disassembler->hexPrefix;
-    QString hexSuffix = Disassembler->hexSuffix;
-
-    QTextStream out(&file);
-
-    write_line(&out);
-    out << "\n; Generated by Frida version ";
-    out << FRIDA_VERSION_STRING;
-    out << "\n\n; ";
-    out << QDateTime::currentDateTime().toString();
-    out << "\n\n";
-    write_line(&out);
+    write_line(out);
+    out += QLatin1String("\n; Generated by Frida version ");
+    out += QLatin1String(FRIDA_VERSION_STRING);
+    out += QLatin1String("\n\n; ");
+    out += QDateTime::currentDateTime().toString();
+    out += QLatin1String("\n\n");
+    write_line(out);
 
     if (!constantsGroups.isEmpty()) {
 
-        out << "\n; CONSTANTS\n";
+        out += QLatin1String("\n; CONSTANTS\n");
 
-        for (const auto &group : qAsConst(constantsGroups)) {
-            if (!group.map->isEmpty()) {
-                out << "\n; " << group.name << "\n\n";
+        for (quint16 groupID : constantsGroups.ids()) {
+            const ConstantsGroup *group = constantsGroups.group(groupID);
+            if (!group->isEmpty()) {
+                out += QLatin1String("\n; ") + group->name + QLatin1String("\n\n");
 
-                QMap<quint64, QString>::iterator iter;
+                QMap<quint64, QString>::const_iterator iter;
 
-                for (iter = group.map->begin(); iter != group.map->end(); ++iter) {
-                    out << iter.value() << " = " << iter.key() << "\n";
+                for (iter = group->entries().constBegin(); iter != group->entries().constEnd(); ++iter) {
+                    emitter->equate(out, iter.value(), QString::number(iter.key()));
                 }
             }
         }
     }
 
-    out << "\n; GENERATED LABELS\n\n";
+    out += QLatin1String("\n; GENERATED LABELS\n\n");
 
     QMap<quint64, QString>::const_iterator iter;
 
-    // output all glocal labels that are not overruled by local labels and are
-    // not within any of the segments address ranges.
-    // also omit labels that have +/- math inside them
+    // output all glocal labels that are external to the project, but omit
+    // labels that have +/- math inside them
 
     for(iter = globalLabels.constBegin(); iter != globalLabels.constEnd(); ++iter) {
 
         if (iter.value().contains(QStringLiteral("+")) || iter.value().contains(QStringLiteral("-")))
             continue;
 
-        bool found_local = false;
-        for (auto & segment : segments) {
-            if (segment.localLabels.contains(iter.key())) {
-                found_local = true;
-                break;
-            }
-        }
-        if (found_local)
+        if (!is_external(iter.key()))
             continue;
 
-        bool inside_segment = false;
-        for (auto & segment : segments) {
-            quint64 start = segment.start;
-            quint64 end   = segment.end;
-            quint64 key = iter.key();
-            if ((key >= start) && (key <= end)) {
-                inside_segment = true;
-                break;
-            }
-        }
-        if (inside_segment)
-            continue;
+        hex.clear();
+        emitter->number(hex, iter.key());
+        emitter->equate(out, iter.value(), hex);
+    }
+
+    // same for the attached symbol libraries, skipping what the project or
+    // an earlier library already names, and +/- math like CASINI+1
 
-        out << iter.value() << '=' << hexPrefix;
-        out << QStringLiteral("%1").arg(iter.key(), 0, 16) << hexSuffix << "\n";
+    QSet<quint64> done;
+
+    for (const auto *lib : symbolLibraries.libraries()) {
+        for (int i = 0; i < lib->labelCount(); i++) {
+            quint64 key = lib->labelAddress(i);
+
+            if (globalLabels.contains(key) || done.contains(key) || !is_external(key))
+                continue;
+            done.insert(key);
+
+            QString name = lib->labelName(i);
+            if (name.contains(QStringLiteral("+")) || name.contains(QStringLiteral("-")))
+                continue;
+
+            hex.clear();
+            emitter->number(hex, key);
+            emitter->equate(out, name, hex);
+        }
     }
 
-    out << "\n";
-    write_line(&out);
+    out += QLatin1Char('\n');
+    write_line(out);
 
     // output each segment, starting with its local labels, and then its
     // dissassembly
@@ -162,13 +162,21 @@ void export_assembly(QWidget *widget, bool generateLocalLabels) {
         currentSegment = i;
         Disassembler->generateDisassembly(generateLocalLabels);
 
-        out << "\n; SEGMENT: " << i+1 << "\n\n";
-        out << "; Name    : " << s->name << "\n";
-        out << "; Start   : ";
-        out << hexPrefix << QStringLiteral("%1").arg(s->start, 0, 16) << hexSuffix;
-        out << "\n; End     : ";
-        out << hexPrefix << QStringLiteral("%1").arg(s->end, 0, 16) << hexSuffix;
-        out << "\n\n; LOCAL LABELS\n\n";
+        // about two lines per disassembly line, with room for labels and
+        // comments
+
+        out.reserve(out.size() + 1024 + s->disassembly.size() * 64 +
+                    s->localLabels.size() * 32);
+
+        out += QLatin1String("\n; SEGMENT: ") + QString::number(i+1) + QLatin1String("\n\n");
+        out += QLatin1String("; Name    : ") + s->name + QLatin1Char('\n');
+        if (bankGroups.contains(s->bankGroup))
+            out += QLatin1String("; Bank    : ") + bankGroups.describe(*s) + QLatin1Char('\n');
+        out += QLatin1String("; Start   : ");
+        emitter->number(out, s->start);
+        out += QLatin1String("\n; End     : ");
+        emitter->number(out, s->end);
+        out += QLatin1String("\n\n; LOCAL LABELS\n\n");
 
         // output local labels that are not inside a segment or contain +/-
 
@@ -191,67 +199,98 @@ void export_assembly(QWidget *widget, bool generateLocalLabels) {
             if (inside_segment)
                 continue;
 
-            out << iter.value() << '=' << hexPrefix;
-            out << QStringLiteral("%1").arg(iter.key(), 0, 16) << hexSuffix << "\n";
+            hex.clear();
+            emitter->number(hex, iter.key());
+            emitter->equate(out, iter.value(), hex);
         }
 
-        out << "\n";
+        out += QLatin1Char('\n');
 
         // output disassembly
 
         QList<struct disassembly> *dislist  = &s->disassembly;
         QMap<quint64, QString> *comments     = &s->comments;
-        struct disassembly dis;
+        AnnotationCursor annotation(s->annotations);
         QString com;
+        QString label;
+        quint8 kinds;
 
         qint64 di = 0;
         while (di < dislist->size()) {
-            dis = dislist->at(di);
+            const struct disassembly &dis = dislist->at(di);
 
-            if (comments->contains(dis.address)) {
+            // the .org line gets the comment at address 0, if any
+
+            kinds = 0;
+            if (!di) {
                 com = comments->value(dis.address);
-                com.replace(QStringLiteral("\n"), QStringLiteral("\n; "));
-                out << "; " << com << "\n";
+                if (!com.isEmpty())
+                    kinds = ANNOTATION_COMMENT;
+            } else if (dis.address >= s->start && annotation.at(dis.address - s->start)) {
+                kinds = annotation.kinds();
+                com = annotation.comment();
+                label = annotation.label();
             }
 
-            if (dis.address && (globalLabels.contains(dis.address)
-                || s->localLabels.contains(dis.address))) {
+            if (kinds & ANNOTATION_COMMENT)
+                write_comment(out, com);
 
-                QString label;
-                if (s->localLabels.contains(dis.address))
-                    label = s->localLabels.value(dis.address);
-                else
-                    label = globalLabels.value(dis.address);
+            if (dis.address && kinds & ANNOTATION_LABEL) {
 
                 // we do not print labels with + or -
 
                 if (!label.contains(QChar('+')) && !label.contains(QChar('-'))) {
-                    out << label << "\n";
+                    out += label + QLatin1Char('\n');
                 }
             }
 
-            QString instruction = dis.instruction;
-
-            if (asm_format == ASM_FORMAT_MADS) {
-                mads_assembler(&instruction);
-            } else if (asm_format == ASM_FORMAT_CA65) {
-                ca65_assembler(&instruction);
-            }
-
-            out << "    " << instruction << " " << dis.arguments << "\n";
-
-            if (dis.changes_pc) {
-                out << "\n";
-            }
+            emitter->line(out, dis);
 
             di++;
         }
 
-        out << "\n";
-        write_line(&out);
+        out += QLatin1Char('\n');
+        write_line(out);
     }
 
     currentSegment = saveCurrentSegment;
+    delete emitter;
+
+    scope.count(PC_BYTES, out.size());
+    scope.count(PC_LINES, out.count(QLatin1Char('\n')));
+}
+
+// ---------------------------------------------------------------------------
+
+void export_assembly(QWidget *widget, bool generateLocalLabels) {
+    auto *asw = new exportAssemblyWindow();
+
+    asw->exec();
+
+    if (asw->result() == QDialog::Rejected) return;
+
+    asm_format = asw->asm_format;
+
+    QString name = QFileDialog::getSaveFileName(widget, QStringLiteral("Export Assembly As..."));
+
+    if (name.isEmpty()) return;
+
+    QFile file(name);
+
+    file.open(QIODevice::WriteOnly);
+    if (!file.isOpen()) {
+        QMessageBox msg;
+        msg.setText("Failed to open " + name + "\n\n" + file.errorString());
+        msg.exec();
+        return;
+    }
+
+    ProfileScope scope("export_assembly");
+
+    QString out;
+    write_assembly(out, asm_format, generateLocalLabels);
+
+    file.write(out.toUtf8());
 
     error = file.error();
     errorstring = file.errorString();
@@ -263,8 +302,30 @@ void export_assembly(QWidget *widget, bool generateLocalLabels) {
     if (error != file.NoError) {
         msg.setText("Failed to export " + name + "\n\n" + errorstring);
         msg.exec();
+        return;
+    }
+
+    // check that the source builds the segments again, the verbatim
+    // format is the one the reassembler reads
+
+    if (asm_format != ASM_FORMAT_VERBATIM) {
+        out.clear();
+        write_assembly(out, ASM_FORMAT_VERBATIM, generateLocalLabels);
+    }
+
+    Reassembler reassembler;
+    QString text = "Succesfully exported " + name + "\n";
+
+    QString problem;
+
+    if (!reassembler.assemble(out, &problem)) {
+        text += "\nReassembly failed, " + problem + "\n";
     } else {
-        msg.setText("Succesfully exported " + name + "\n");
-        msg.exec();
+        QStringList report = reassembler.verify();
+        if (!report.isEmpty())
+            text += "\nReassembly differs:\n\n" + report.join(QLatin1Char('\n')) + "\n";
     }
+
+    msg.setText(text);
+    msg.exec();
 }
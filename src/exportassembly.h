@@ -26,5 +26,6 @@
 #include "pch.h"
 
 extern void export_assembly(QWidget *widget, bool generateLocalLabels);
+extern void write_assembly(QString &out, int format, bool generateLocalLabels);
 
 #endif // EXPORTASSEMBLY_H
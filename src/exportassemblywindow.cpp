@@ -42,6 +42,18 @@ void exportAssemblyWindow::accept() {
         asm_format = ASM_FORMAT_MADS;
     else if (ui->ca65_assembler->isChecked())
         asm_format = ASM_FORMAT_CA65;
+    else if (ui->xa_assembler->isChecked())
+        asm_format = ASM_FORMAT_XA;
+    else if (ui->acme_assembler->isChecked())
+        asm_format = ASM_FORMAT_ACME;
+    else if (ui->tass64_assembler->isChecked())
+        asm_format = ASM_FORMAT_64TASS;
+    else if (ui->sjasmplus_assembler->isChecked())
+        asm_format = ASM_FORMAT_SJASMPLUS;
+    else if (ui->z80asm_assembler->isChecked())
+        asm_format = ASM_FORMAT_Z80ASM;
+    else if (ui->pasmo_assembler->isChecked())
+        asm_format = ASM_FORMAT_PASMO;
 
     setResult(QDialog::Accepted);
     hide();
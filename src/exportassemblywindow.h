@@ -50,7 +50,13 @@ private:
 enum {
     ASM_FORMAT_VERBATIM = 0,
     ASM_FORMAT_MADS,
-    ASM_FORMAT_CA65
+    ASM_FORMAT_CA65,
+    ASM_FORMAT_XA,
+    ASM_FORMAT_ACME,
+    ASM_FORMAT_64TASS,
+    ASM_FORMAT_SJASMPLUS,
+    ASM_FORMAT_Z80ASM,
+    ASM_FORMAT_PASMO
 };
 
 #endif // EXPORTASSEMBLYWINDOW_H
@@ -23,18 +23,38 @@
 #include "frida.h"
 
 QVector<struct filetype> filetypes = {
-{ "Raw",                                            FT_RAW_FILE },
-{ "Atari 8-bit Binary (.XEX)",                      FT_ATARI8BIT_BINARY },
-{ "Atari 8-bit Slight Atari Player (.SAP)",         FT_ATARI8BIT_SAP },
-{ "Atari 8-bit Cartridge (.CAR)" ,                  FT_ATARI8BIT_CAR },
-{ "Commodore PET/VIC-20/C16/C64/C128 Binary (.PRG)",FT_C64_BINARY },
-{ "Commodore C64 PSID/RSID (.SID)",                 FT_C64_PSID },
-{ "Atari 2600 2K/4K ROM (.A26)",                    FT_ATARI2600_2K4K },
-{ "Oric Tape File (.TAP)",                          FT_ORIC_TAP },
-{ "Apple ][ DOS3.3 4-byte header",                  FT_APPLE2_DOS33 },
-{ "Apple ][ ProDOS AppleSingle",                    FT_APPLE2_APPLESINGLE },
-{ "Nintendo NES Song File (.NSF)",                  FT_NES_SONG_FILE },
-{ "CP/M Binary at 0100H (.COM)",                    FT_CPM_BINARY },
-{ "BBC Micro, Electron, Master UEF Tape (.UEF)",    FT_BBC_UEF_TAPE },
-{ "ZX Spectrum Tape File (.TAP)",                   FT_ZX_SPECTRUM_TAP },
+{ "Raw",                                            FT_RAW_FILE,
+    "bin;raw;rom",      FONT_NORMAL,    CT_NMOS6502 },
+{ "Atari 8-bit Binary (.XEX)",                      FT_ATARI8BIT_BINARY,
+    "xex;com;exe;obx",  FONT_ATARI8BIT, CT_NMOS6502 },
+{ "Atari 8-bit Slight Atari Player (.SAP)",         FT_ATARI8BIT_SAP,
+    "sap",              FONT_ATARI8BIT, CT_NMOS6502 },
+{ "Atari 8-bit Cartridge (.CAR)" ,                  FT_ATARI8BIT_CAR,
+    "car;rom;bin",      FONT_ATARI8BIT, CT_NMOS6502 },
+{ "Atari 8-bit Disk Image (.ATR)",                  FT_ATARI8BIT_ATR,
+    "atr",              FONT_ATARI8BIT, CT_NMOS6502 },
+{ "Commodore PET/VIC-20/C16/C64/C128 Binary (.PRG)",FT_C64_BINARY,
+    "prg",              FONT_C64,       CT_NMOS6502 },
+{ "Commodore C64 PSID/RSID (.SID)",                 FT_C64_PSID,
+    "sid;psid",         FONT_C64,       CT_NMOS6502 },
+{ "Commodore 1541 Disk Image (.D64)",               FT_C64_D64,
+    "d64",              FONT_C64,       CT_NMOS6502 },
+{ "Atari 2600 2K/4K ROM (.A26)",                    FT_ATARI2600_2K4K,
+    "a26;bin",          FONT_NORMAL,    CT_NMOS6502 },
+{ "Oric Tape File (.TAP)",                          FT_ORIC_TAP,
+    "tap",              FONT_NORMAL,    CT_NMOS6502 },
+{ "Apple ][ DOS3.3 4-byte header",                  FT_APPLE2_DOS33,
+    "bin",              FONT_NORMAL,    CT_NMOS6502 },
+{ "Apple ][ ProDOS AppleSingle",                    FT_APPLE2_APPLESINGLE,
+    "as;applesingle",   FONT_NORMAL,    CT_NMOS6502 },
+{ "Apple ][ DOS3.3 Disk Image (.DSK)",              FT_APPLE2_DSK,
+    "dsk;do",           FONT_NORMAL,    CT_NMOS6502 },
+{ "Nintendo NES Song File (.NSF)",                  FT_NES_SONG_FILE,
+    "nsf",              FONT_NORMAL,    CT_NMOS6502 },
+{ "CP/M Binary at 0100H (.COM)",                    FT_CPM_BINARY,
+    "com",              FONT_NORMAL,    CT_INTEL_8080 },
+{ "BBC Micro, Electron, Master UEF Tape (.UEF)",    FT_BBC_UEF_TAPE,
+    "uef",              FONT_NORMAL,    CT_NMOS6502 },
+{ "ZX Spectrum Tape File (.TAP)",                   FT_ZX_SPECTRUM_TAP,
+    "tap",              FONT_NORMAL,    CT_ZILOG_Z80 },
 };
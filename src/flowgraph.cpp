@@ -0,0 +1,220 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#include "disassembler.h"
+#include "flowgraph.h"
+#include <algorithm>
+
+struct flowinsn {
+    int line;
+    quint64 address, size;
+    quint64 target;
+    int kind;                           // FLOW_*
+};
+
+// ---------------------------------------------------------------------------
+// BUILD
+
+void FlowGraph::build(const struct segment &s, class Disassembler &dis,
+                      quint64 key) {
+    const QList<struct disassembly> &lines = s.disassembly;
+    quint64 size = s.end - s.start + 1;
+    QVector<bool> leader(size);
+    QVector<struct flowinsn> insns;
+    QVector<struct flowinsn> ends;      // the last instruction of each block
+
+    blocks.clear();
+    edges.clear();
+    listingKey = key;
+
+    // the instructions of the listing, skipping .org and directives
+
+    for (int i = 1; i < lines.size(); i++) {
+        const struct disassembly &d = lines.at(i);
+        quint64 o = d.address - s.start;
+
+        if (d.address < s.start || o >= size)
+            continue;
+        if (s.datatypes[o] != DT_CODE && s.datatypes[o] != DT_UNDEFINED_CODE)
+            continue;
+
+        struct flowinsn insn = { i, d.address, (quint64) d.size, 0, FLOW_NEXT };
+        insn.kind = dis.flowAt(o, &insn.target);
+
+        if ((insn.kind == FLOW_BRANCH || insn.kind == FLOW_JUMP ||
+             insn.kind == FLOW_CALL) &&
+                insn.target >= s.start && insn.target <= s.end)
+            leader[insn.target - s.start] = true;
+
+        insns.append(insn);
+    }
+
+    // a new block at targets, after gaps and after changes of flow
+
+    quint64 next = 0;
+    bool ended = true;
+
+    for (const auto &insn : qAsConst(insns)) {
+        if (ended || insn.address != next || leader.at(insn.address - s.start)) {
+            struct basicblock b = { insn.address, 0, 0, insn.line, 0, {}, {} };
+            blocks.append(b);
+            ends.append(insn);
+        }
+
+        struct basicblock &b = blocks.last();
+        b.end = insn.address + insn.size - 1;
+        b.last = insn.address;
+        b.lines = insn.line - b.firstLine + 1;
+        ends.last() = insn;
+
+        next = insn.address + insn.size;
+        ended = insn.kind != FLOW_NEXT;
+    }
+
+    for (int b = 0; b < blocks.size(); b++) {
+        const struct flowinsn &insn = ends.at(b);
+
+        switch (insn.kind) {
+        case FLOW_BRANCH:   addEdge(b, insn.target, EDGE_CONDITIONAL);  break;
+        case FLOW_JUMP:     addEdge(b, insn.target, EDGE_JUMP);         break;
+        case FLOW_CALL:     addEdge(b, insn.target, EDGE_CALL);         break;
+        case FLOW_INDIRECT: addEdge(b, 0, EDGE_INDIRECT);               break;
+        default:            break;
+        }
+
+        if (insn.kind == FLOW_NEXT || insn.kind == FLOW_BRANCH ||
+                insn.kind == FLOW_CALL || insn.kind == FLOW_RETURN_IF)
+            addEdge(b, insn.address + insn.size, EDGE_FALLTHROUGH);
+    }
+}
+
+void FlowGraph::addEdge(int from, quint64 target, quint8 kind) {
+    struct flowedge e = { from, -1, target, kind };
+
+    if (kind != EDGE_INDIRECT)
+        e.to = blockStartingAt(target);
+
+    blocks[from].out.append(edges.size());
+    if (e.to >= 0)
+        blocks[e.to].in.append(edges.size());
+    edges.append(e);
+}
+
+// ---------------------------------------------------------------------------
+// QUERIES
+
+int FlowGraph::blockAt(quint64 address) const {
+    auto it = std::upper_bound(blocks.constBegin(), blocks.constEnd(), address,
+                    [](quint64 a, const struct basicblock &b) {
+                        return a < b.start;
+                    });
+
+    if (it == blocks.constBegin())
+        return -1;
+    --it;
+    return address <= it->end ? it - blocks.constBegin() : -1;
+}
+
+int FlowGraph::blockStartingAt(quint64 address) const {
+    int b = blockAt(address);
+    return b >= 0 && blocks.at(b).start == address ? b : -1;
+}
+
+QVector<quint64> FlowGraph::unresolved(void) const {
+    QVector<quint64> jumps;
+
+    for (const auto &e : edges)
+        if (e.kind == EDGE_INDIRECT)
+            jumps.append(blocks.at(e.from).last);
+    return jumps;
+}
+
+quint64 FlowGraph::bytes(void) const {
+    quint64 n = blocks.capacity() * sizeof(struct basicblock) +
+                edges.capacity() * sizeof(struct flowedge);
+
+    for (const auto &b : blocks)
+        n += (b.out.capacity() + b.in.capacity()) * sizeof(int);
+    return n;
+}
+
+// ---------------------------------------------------------------------------
+// GRAPHVIZ
+
+static const char *edgeStyles[] = {
+    "",                                 // EDGE_FALLTHROUGH
+    " [color=darkgreen]",
+    " [style=bold]",
+    " [style=dashed]",
+    " [color=red]"
+};
+
+QString FlowGraph::dot(const struct segment &s) const {
+    QString out;
+    QSet<quint64> outside;
+
+    out += QLatin1String("digraph \"") + s.name + QLatin1String("\" {\n");
+    out += QLatin1String("    node [shape=box, fontname=\"monospace\"];\n");
+
+    for (int b = 0; b < blocks.size(); b++) {
+        const struct basicblock &block = blocks.at(b);
+        QString label = s.localLabels.value(block.start);
+
+        if (label.isEmpty())
+            label = globalLabels.value(block.start);
+        if (!label.isEmpty())
+            label += QLatin1String("\\n");
+
+        out += QStringLiteral("    b%1 [label=\"%2%3-%4\"];\n").arg(b)
+                    .arg(label)
+                    .arg(block.start, 4, 16, QChar('0'))
+                    .arg(block.end, 4, 16, QChar('0'));
+    }
+
+    for (const auto &e : edges) {
+        QString to;
+
+        if (e.kind == EDGE_INDIRECT) {
+            to = QStringLiteral("i%1").arg(e.from);
+            out += QLatin1String("    ") + to +
+                   QLatin1String(" [label=\"?\", shape=plaintext];\n");
+        } else if (e.to < 0) {
+            QString hex = QStringLiteral("%1").arg(e.target, 4, 16, QChar('0'));
+            QString label = globalLabels.value(e.target, hex);
+
+            to = QStringLiteral("a") + hex;
+            if (!outside.contains(e.target)) {
+                outside.insert(e.target);
+                out += QLatin1String("    ") + to + QLatin1String(" [label=\"") +
+                       label + QLatin1String("\", shape=plaintext];\n");
+            }
+        } else {
+            to = QStringLiteral("b%1").arg(e.to);
+        }
+
+        out += QStringLiteral("    b%1 -> ").arg(e.from) + to +
+               QLatin1String(edgeStyles[e.kind]) + QLatin1String(";\n");
+    }
+
+    out += QLatin1String("}\n");
+    return out;
+}
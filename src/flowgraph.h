@@ -0,0 +1,98 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef FLOWGRAPH_H
+#define FLOWGRAPH_H
+
+#include "pch.h"
+
+// How an instruction passes on control, as told by Disassembler::flowAt()
+
+enum flowkind {
+    FLOW_NEXT = 0,                      // on to the next instruction
+    FLOW_BRANCH,                        // to the target, or the next one
+    FLOW_JUMP,                          // to the target
+    FLOW_CALL,                          // to the target, and back after it
+    FLOW_RETURN,
+    FLOW_RETURN_IF,                     // returns, or the next instruction
+    FLOW_INDIRECT,                      // to an address known at run time
+    FLOW_STOP                           // brk, halt, undefined opcodes
+};
+
+enum edgekind {
+    EDGE_FALLTHROUGH = 0,
+    EDGE_CONDITIONAL,                   // the taken side of a branch
+    EDGE_JUMP,
+    EDGE_CALL,
+    EDGE_INDIRECT                       // unresolved, the target is unknown
+};
+
+struct flowedge {
+    int from, to;                       // blocks, to is -1 if unknown or
+                                        // not the start of a block here
+    quint64 target;                     // address control goes to
+    quint8 kind;                        // EDGE_*
+};
+
+// Instructions that only run one after another. A block ends before a
+// branch target and after anything that is not FLOW_NEXT, calls included,
+// so the call sites are the ends of blocks.
+
+struct basicblock {
+    quint64 start, end;                 // first and last byte
+    quint64 last;                       // address of the last instruction
+    int firstLine, lines;               // in the listing of the segment
+    QVector<int> out, in;               // edges
+};
+
+// Basic blocks and control flow of the code of one segment. Like the
+// annotations, generateDisassembly() builds the graph with the listing,
+// and keeps it as long as the listing has the same key, see
+// listingcache.h. Blocks are sorted by address.
+
+class FlowGraph {
+public:
+    void build(const struct segment &s, class Disassembler &dis, quint64 key);
+    quint64 key(void) const { return listingKey; }
+    quint64 bytes(void) const;          // estimated heap use
+
+    int size(void) const { return blocks.size(); }
+    const struct basicblock &block(int i) const { return blocks.at(i); }
+    int edgeCount(void) const { return edges.size(); }
+    const struct flowedge &edge(int i) const { return edges.at(i); }
+
+    int blockAt(quint64 address) const;         // -1 if not in a block
+    int blockStartingAt(quint64 address) const;
+    QVector<quint64> unresolved(void) const;    // indirect jumps
+
+    // Graphviz source, one node per block, named by their labels
+    QString dot(const struct segment &s) const;
+
+private:
+    void addEdge(int from, quint64 target, quint8 kind);
+
+    QVector<struct basicblock> blocks;
+    QVector<struct flowedge> edges;
+    quint64 listingKey = 0;
+};
+
+#endif // FLOWGRAPH_H
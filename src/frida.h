@@ -56,6 +56,18 @@ extern const QVector<struct cputype> cputypes;
 
 // --------------------------------------------------------------------------
 
+enum fonts {
+    FONT_NORMAL = 0,
+    FONT_ATARI8BIT,
+    FONT_C64,
+    FONT_LAST
+};
+
+extern enum fonts altfont;
+extern QFont globalFont;
+
+// --------------------------------------------------------------------------
+
 // leave space for other file types, don't change values after v1.0 is released
 
 enum filetypeid {
@@ -63,39 +75,36 @@ enum filetypeid {
     FT_ATARI8BIT_BINARY     = 0x10,
     FT_ATARI8BIT_SAP        = 0x11,
     FT_ATARI8BIT_CAR        = 0x12,
+    FT_ATARI8BIT_ATR        = 0x13,
     FT_C64_BINARY           = 0x20,
     FT_C64_PSID             = 0x21,
+    FT_C64_D64              = 0x22,
     FT_ATARI2600_2K4K       = 0x30,
     FT_ORIC_TAP             = 0x40,
     FT_APPLE2_DOS33         = 0x50,
     FT_APPLE2_APPLESINGLE   = 0x51,
+    FT_APPLE2_DSK           = 0x52,
     FT_NES_SONG_FILE        = 0x60,
     FT_CPM_BINARY           = 0x70,
     FT_BBC_UEF_TAPE         = 0x80,
     FT_ZX_SPECTRUM_TAP      = 0x90,
 };
 
+// extensions is a ';' separated list used to break ties between probes,
+// font and cputype are what a new project of this type starts with
+
 struct filetype {
     QString name;
     enum filetypeid id;
+    const char *extensions;
+    enum fonts font;
+    enum cputypeid cputype;
 };
 
 extern QVector<struct filetype> filetypes;
 
 // --------------------------------------------------------------------------
 
-enum fonts {
-    FONT_NORMAL = 0,
-    FONT_ATARI8BIT,
-    FONT_C64,
-    FONT_LAST
-};
-
-extern enum fonts altfont;
-extern QFont globalFont;
-
-// --------------------------------------------------------------------------
-
 enum datatypes {
     DT_UNDEFINED_BYTES,
     DT_BYTES,
@@ -121,12 +130,38 @@ enum datatypes {
 
 // --------------------------------------------------------------------------
 
+// What a line of the disassembly is, so the assembly exporter can pick the
+// directive of its dialect without looking at the text.
+
+enum directives {
+    DIR_NONE = 0,       // an instruction
+    DIR_ORG,
+    DIR_BYTE,
+    DIR_WORDLE,
+    DIR_WORDBE,
+    DIR_DWORDLE,
+    DIR_DWORDBE,
+    DIR_QWORDLE,
+    DIR_QWORDBE,
+    DIR_XWORDLE,
+    DIR_XWORDBE,
+    DIR_ASCII,
+    DIR_ATASCII,
+    DIR_INVATASCII,
+    DIR_PETSCII,
+    DIR_ANTICSCREEN,
+    DIR_INVANTICSCREEN,
+    DIR_CBMSCREEN,
+    DIR_LAST
+};
+
 struct disassembly {
     quint64 address;
     QString instruction;
     QString arguments;
     int size;           // number of bytes "consumed" incl. instruction
     bool changes_pc;
+    quint8 directive;   // enum directives
 //    quint64 opcode;
 //    quint64 operand_address;
 //    quint64 operand_offset;
@@ -134,6 +169,9 @@ struct disassembly {
 
 // --------------------------------------------------------------------------
 
+class AnnotationStore;
+class FlowGraph;
+
 struct segment {
     quint64 start, end;
     QString name;
@@ -147,12 +185,21 @@ struct segment {
     QMap<quint64, quint16> lowbytes;
     QMap<quint64, quint16> highbytes;
 
-// maps addresses to constantsGroups
-    QMap<quint64, quint64> constants;
+// per byte, the constantsGroups id of FLAG_CONSTANT bytes
+    quint16 *constants;                 // same size as data[]
+
+// banks of one cartridge share their buffers, see banks.h
+    qint32 bankGroup;                   // BANKGROUP_NONE if they are its own
+    qint32 bank;
 
 // everything below is not saved as part of the project
     QList<struct disassembly> disassembly;
     int scrollbarValue;
+    AnnotationStore *annotations;       // built with the disassembly
+    FlowGraph *flow;                    // same, see flowgraph.h
+    quint64 listingKey;                 // of the disassembly, see listingcache.h
+    quint64 listingUsed;                // when it was last generated or shown
+    quint64 listingBytes;               // estimated size of the listing
 };
 
 extern QVector<struct segment> segments;      // currently in main.cpp
@@ -166,16 +213,6 @@ extern QSettings settings;
 
 // --------------------------------------------------------------------------
 
-struct constantsGroup {
-    QString name;
-    QMap<quint64, QString> *map;
-};
-
-extern QMap<quint64, struct constantsGroup> constantsGroups;
-extern quint64 nextNewGroup;
-
-// --------------------------------------------------------------------------
-
 // Even though these look like bitmasks, they are not. Only one of them can
 // be active at a time.
 
@@ -26,11 +26,19 @@ macx* {
 SOURCES += \
     addconstantsgroupwindow.cpp \
     addconstanttogroupwindow.cpp \
+    compressedfile.cpp \
+    constants.cpp \
     constantsmanager.cpp \
+    diskimages.cpp \
     disassembler8080.cpp \
     disassemblerZ80.cpp \
+    emulator.cpp \
+    emitters.cpp \
+    emulator6502.cpp \
+    emulatorZ80.cpp \
     exportassembly.cpp \
     exportassemblywindow.cpp \
+    flowgraph.cpp \
     jumptowindow.cpp \
     loaderatari8bitcar.cpp \
     loaders.cpp \
@@ -38,16 +46,32 @@ SOURCES += \
     main.cpp\
     loadsaveproject.cpp \
     mainwindow.cpp \
+    memoryusage.cpp \
     filetypes.cpp \
     cputypes.cpp \
     disassembler6502.cpp \
     disassembler.cpp \
     commentwindow.cpp \
     labelswindow.cpp \
+    listingcache.cpp \
     addlabelwindow.cpp \
+    addresspairs.cpp \
+    annotations.cpp \
+    banks.cpp \
+    bytesearch.cpp \
+    callgraph.cpp \
     changesegmentwindow.cpp \
+    hash.cpp \
     lowhighbytewindow.cpp \
+    portproject.cpp \
+    profiler.cpp \
+    projectsections.cpp \
+    reassembler.cpp \
+    searchindex.cpp \
     selectcartridgewindow.cpp \
+    selectdiskfilewindow.cpp \
+    signatures.cpp \
+    symbollibrary.cpp \
     selectconstantsgoupwindow.cpp \
     startdialog.cpp
 
@@ -56,24 +80,46 @@ HEADERS += \
     addconstanttogroupwindow.h \
     architecture.h \
     compiler.h \
+    compressedfile.h \
+    constants.h \
     constantsmanager.h \
+    emulator.h \
+    emitters.h \
     exportassembly.h \
     exportassemblywindow.h \
+    flowgraph.h \
     jumptowindow.h \
     loaderatari8bitcar.h \
     loaders.h \
     lowandhighbytepairswindow.h \
     mainwindow.h \
+    memoryusage.h \
     frida.h \
     disassembler.h \
+    diskimages.h \
     commentwindow.h \
     labelswindow.h \
+    listingcache.h \
     addlabelwindow.h \
+    addresspairs.h \
+    annotations.h \
+    banks.h \
+    bytesearch.h \
+    callgraph.h \
     changesegmentwindow.h \
+    hash.h \
     loadsaveproject.h \
     lowhighbytewindow.h \
     platform.h \
+    portproject.h \
+    profiler.h \
+    projectsections.h \
+    reassembler.h \
+    searchindex.h \
     selectcartridgewindow.h \
+    selectdiskfilewindow.h \
+    signatures.h \
+    symbollibrary.h \
     selectconstantsgoupwindow.h \
     startdialog.h
 
@@ -91,6 +137,7 @@ FORMS += \
     changesegmentwindow.ui \
     lowhighbytewindow.ui \
     selectcartridgewindow.ui \
+    selectdiskfilewindow.ui \
     selectconstantsgoupwindow.ui \
     startdialog.ui
 
@@ -0,0 +1,111 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#include "hash.h"
+
+// XXH64, see https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+
+static const quint64 PRIME64_1 = 0x9e3779b185ebca87ULL;
+static const quint64 PRIME64_2 = 0xc2b2ae3d27d4eb4fULL;
+static const quint64 PRIME64_3 = 0x165667b19e3779f9ULL;
+static const quint64 PRIME64_4 = 0x85ebca77c2b2ae63ULL;
+static const quint64 PRIME64_5 = 0x27d4eb2f165667c5ULL;
+
+static inline quint64 rotl64(quint64 x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline quint64 read64(const quint8 *p) {
+    quint64 v = 0;
+    for (int i = 7; i >= 0; i--)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static inline quint32 read32(const quint8 *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((quint32) p[3] << 24);
+}
+
+static inline quint64 round64(quint64 acc, quint64 input) {
+    acc += input * PRIME64_2;
+    acc  = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline quint64 merge64(quint64 acc, quint64 val) {
+    acc ^= round64(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+quint64 xxh64(const quint8 *data, quint64 size, quint64 seed) {
+    const quint8 *p = data;
+    const quint8 *end = data + size;
+    quint64 h;
+
+    if (size >= 32) {
+        quint64 v1 = seed + PRIME64_1 + PRIME64_2;
+        quint64 v2 = seed + PRIME64_2;
+        quint64 v3 = seed;
+        quint64 v4 = seed - PRIME64_1;
+
+        while (p + 32 <= end) {
+            v1 = round64(v1, read64(p));
+            v2 = round64(v2, read64(p + 8));
+            v3 = round64(v3, read64(p + 16));
+            v4 = round64(v4, read64(p + 24));
+            p += 32;
+        }
+
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = merge64(h, v1);
+        h = merge64(h, v2);
+        h = merge64(h, v3);
+        h = merge64(h, v4);
+    } else {
+        h = seed + PRIME64_5;
+    }
+
+    h += size;
+
+    while (p + 8 <= end) {
+        h ^= round64(0, read64(p));
+        h  = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= (quint64) read32(p) * PRIME64_1;
+        h  = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= *p * PRIME64_5;
+        h  = rotl64(h, 11) * PRIME64_1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
@@ -21,7 +21,9 @@
 // ---------------------------------------------------------------------------
 
 #include "addlabelwindow.h"
+#include "banks.h"
 #include "labelswindow.h"
+#include "symbollibrary.h"
 #include "ui_labelswindow.h"
 
 labelswindow::labelswindow(QWidget *parent) :
@@ -37,8 +39,12 @@ labelswindow::labelswindow(QWidget *parent) :
 
     t = ui->tableLocalLabels;
     t->addAction(ui->actionChange_To_Global_Label);
+    t->addAction(ui->actionShare_With_Banks);
     t->addAction(ui->actionDelete_Label);
 
+    ui->actionShare_With_Banks->setEnabled(
+                    segments[currentSegment].bankGroup != BANKGROUP_NONE);
+
     connect(ui->tableGlobalLabels, &QTableWidget::cellChanged,
             this, &labelswindow::onTableGlobalLabels_cellChanged);
     connect(ui->tableLocalLabels, &QTableWidget::cellChanged,
@@ -52,6 +58,12 @@ labelswindow::labelswindow(QWidget *parent) :
             this, &labelswindow::onExportButton_clicked);
     connect(ui->importButton, &QPushButton::clicked,
             this, &labelswindow::onImportButton_clicked);
+    connect(ui->compileButton, &QPushButton::clicked,
+            this, &labelswindow::onCompileButton_clicked);
+    connect(ui->attachButton, &QPushButton::clicked,
+            this, &labelswindow::onAttachButton_clicked);
+    connect(ui->detachButton, &QPushButton::clicked,
+            this, &labelswindow::onDetachButton_clicked);
 
     showGlobalLabels();
     showLocalLabels();
@@ -144,6 +156,7 @@ void labelswindow::onTableLocalLabels_cellChanged(int row, int column) {
     }
 
     s->localLabels.insert(address, label);
+    bankGroups.renameLabel(s->bankGroup, address, label);
     showLocalLabels();
     t->setFocus();
     t->setCurrentCell(row, 1);
@@ -189,6 +202,7 @@ void labelswindow::actionChange_To_Global_Label() {
     get_contents(t, row, &label, &address);
 
     segments[currentSegment].localLabels.remove(address);
+    bankGroups.unshareLabel(segments[currentSegment].bankGroup, address);
     globalLabels.insert(address, label);
     showGlobalLabels();
     showLocalLabels();
@@ -234,9 +248,31 @@ void labelswindow::actionDelete_Label() {
     if(msg.exec() != QMessageBox::Yes) return;
 
     labels->remove(address);
+    if (t == ui->tableLocalLabels)
+        bankGroups.unshareLabel(segments[currentSegment].bankGroup, address);
     showLabels(t, labels);
 }
 
+//-----------------------------------------------------------------------------
+// SHARE LABEL WITH ALL BANKS OF A CARTRIDGE
+
+void labelswindow::actionShare_With_Banks() {
+    QTableWidget *t = ui->tableLocalLabels;
+    QString label;
+    quint64 address;
+    QList<QTableWidgetSelectionRange> Ranges = t->selectedRanges();
+
+    if (Ranges.isEmpty()) return;
+
+    int row = Ranges.at(0).topRow();
+
+    get_contents(t, row, &label, &address);
+
+    bankGroups.shareLabel(segments[currentSegment].bankGroup, address, label);
+    t->setFocus();
+    t->setCurrentCell(row, 1);
+}
+
 void labelswindow::onAddLabelButton_clicked() {
     addLabelWindow alw;
     alw.exec();
@@ -330,3 +366,65 @@ void labelswindow::onImportButton_clicked() {
     msg.exec();
     showGlobalLabels();
 }
+
+//-----------------------------------------------------------------------------
+// SYMBOL LIBRARIES
+
+void labelswindow::onCompileButton_clicked() {
+    const QStringList sources = QFileDialog::getOpenFileNames(this,
+                        QStringLiteral("Compile labels and constants from..."),
+                        QString(),
+                        QStringLiteral("Labels and Constants (*.labels *.constants);;All Files (*)"));
+
+    if (sources.isEmpty()) return;
+
+    QString name = QFileDialog::getSaveFileName(this,
+                        QStringLiteral("Save symbol library as..."),
+                        QString(),
+                        QStringLiteral("Symbol Libraries (*.fridalib)"));
+
+    if (name.isEmpty()) return;
+
+    QString error;
+    if (!SymbolLibrary::compile(sources, name, &error)) {
+        QMessageBox::warning(this, QStringLiteral("Compile Library"), error);
+        return;
+    }
+
+    QMessageBox::information(this, QStringLiteral("Compile Library"),
+                             QStringLiteral("Compiled ") + name);
+}
+
+// Attached libraries are not copied into the project. Their labels are
+// looked up while rendering, after the local and global labels. New ones
+// are added after the ones already attached.
+
+void labelswindow::onAttachButton_clicked() {
+    const QStringList names = QFileDialog::getOpenFileNames(this,
+                        QStringLiteral("Attach symbol libraries"),
+                        QString(),
+                        QStringLiteral("Symbol Libraries (*.fridalib)"));
+
+    if (names.isEmpty())
+        return;
+
+    QString error;
+    const QStringList attached = symbolLibraries.fileNames();
+    for (const auto &name : names) {
+        if (attached.contains(name))
+            continue;
+        if (!symbolLibraries.attach(name, &error)) {
+            QMessageBox::warning(this, QStringLiteral("Attach Libraries"), error);
+            return;
+        }
+    }
+}
+
+void labelswindow::onDetachButton_clicked() {
+    if (symbolLibraries.libraries().isEmpty())
+        return;
+
+    if (QMessageBox::question(this, QStringLiteral("Detach Libraries"),
+                QStringLiteral("Detach all symbol libraries?")) == QMessageBox::Yes)
+        symbolLibraries.clear();
+}
@@ -41,6 +41,7 @@ private Q_SLOTS:
     void actionChange_To_Local_Label();
     void actionChange_To_Global_Label();
     void actionDelete_Label();
+    void actionShare_With_Banks();
 
     void onTableGlobalLabels_cellChanged(int row, int column);
     void onTableLocalLabels_cellChanged(int row, int column);
@@ -49,6 +50,9 @@ private Q_SLOTS:
     void onAddLabelButton_clicked();
     void onExportButton_clicked();
     void onImportButton_clicked();
+    void onCompileButton_clicked();
+    void onAttachButton_clicked();
+    void onDetachButton_clicked();
 
 private:
     Ui::labelswindow *ui;
@@ -0,0 +1,272 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#include "annotations.h"
+#include "banks.h"
+#include "constants.h"
+#include "disassembler.h"
+#include "flowgraph.h"
+#include "hash.h"
+#include "listingcache.h"
+#include "memoryusage.h"
+#include "projectsections.h"
+#include "symbollibrary.h"
+#include <algorithm>
+
+ListingCache listingCache;
+
+ListingCache::ListingCache() :
+    maxBytes(LISTING_CACHE_LIMIT * 1024 * 1024), clock(0) {
+}
+
+void ListingCache::setDirectory(const QString &dir) {
+    directory = dir;
+}
+
+QString ListingCache::fileName(quint64 key) const {
+    return directory + QStringLiteral("/%1.listing").arg(key, 16, 16, QChar('0'));
+}
+
+// ---------------------------------------------------------------------------
+// KEY
+
+static quint64 hashBytes(quint64 h, const void *data, quint64 size) {
+    return xxh64((const quint8 *) data, size, h);
+}
+
+static quint64 hashString(quint64 h, const QString &s) {
+    h = hashBytes(h, s.constData(), s.size() * sizeof(QChar));
+    return hashBytes(h, "", 1);                 // separator
+}
+
+static quint64 hashMap(quint64 h, const QMap<quint64, QString> &map) {
+    for (auto it = map.constBegin(); it != map.constEnd(); ++it) {
+        quint64 key = it.key();
+        h = hashBytes(h, &key, sizeof(key));
+        h = hashString(h, it.value());
+    }
+    return hashBytes(h, "", 1);
+}
+
+static quint64 hashMap(quint64 h, const QMap<quint64, quint16> &map) {
+    QVector<quint64> pairs;
+
+    pairs.reserve(map.size() * 2);
+    for (auto it = map.constBegin(); it != map.constEnd(); ++it) {
+        pairs.append(it.key());
+        pairs.append(it.value());
+    }
+    h = hashBytes(h, pairs.constData(), pairs.size() * sizeof(quint64));
+    return hashBytes(h, "", 1);
+}
+
+quint64 ListingCache::key(const struct segment &s, const class Disassembler &dis,
+                          bool generateLocalLabels) const {
+    quint64 size = s.end - s.start + 1;
+    quint64 h = hashBytes(0, &s.start, sizeof(s.start));
+
+    h = hashBytes(h, &size, sizeof(size));
+    h = hashBytes(h, s.data, size);
+    h = hashBytes(h, s.datatypes, size);
+    h = hashBytes(h, s.flags, size);
+    h = hashBytes(h, s.constants, size * sizeof(quint16));
+
+    h = hashMap(h, s.comments);                 // they start new lines
+    h = hashMap(h, s.localLabels);
+    h = hashMap(h, s.lowbytes);
+    h = hashMap(h, s.highbytes);
+    h = hashMap(h, globalLabels);
+
+    for (quint16 id : constantsGroups.ids()) {
+        h = hashBytes(h, &id, sizeof(id));
+        h = hashMap(h, constantsGroups.group(id)->entries());
+    }
+    for (const auto *library : symbolLibraries.libraries()) {
+        quint64 stamp = library->stamp();
+        h = hashString(h, library->fileName());
+        h = hashBytes(h, &stamp, sizeof(stamp));
+    }
+
+    quint64 options[3] = { dis.cputype, dis.toUpper, generateLocalLabels };
+    h = hashBytes(h, options, sizeof(options));
+    h = hashString(h, dis.hexPrefix);
+    h = hashString(h, dis.hexSuffix);
+    return h;
+}
+
+// ---------------------------------------------------------------------------
+// FETCH AND STORE
+
+bool ListingCache::fetch(struct segment &s, quint64 key) {
+    if (directory.isEmpty() || s.end - s.start + 1 < LISTING_CACHE_MIN_SIZE)
+        return false;
+
+    QFile file(fileName(key));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    StringPool pool;
+    QByteArray data;
+    QString error;
+    quint32 id;
+
+    if (!readSection(file, &id, &data, &error) || id != SECTION_STRINGS)
+        return false;
+    SectionDecoder strings(data, &pool);
+    if (!pool.decode(strings))
+        return false;
+
+    if (!readSection(file, &id, &data, &error) || id != SECTION_LISTING)
+        return false;
+
+    SectionDecoder dec(data, &pool);
+    QList<struct disassembly> list;
+
+    if (dec.varint() != key)
+        return false;
+
+    quint64 n = dec.varint();
+    list.reserve(n);
+
+    while (dec.ok && n--) {
+        struct disassembly dis;
+        dis.address     = s.start + dec.varint();
+        dis.instruction = dec.string();
+        dis.arguments   = dec.string();
+        dis.size        = dec.varint();
+        quint64 bits    = dec.varint();
+        dis.changes_pc  = bits & 1;
+        dis.directive   = bits >> 1;
+        list.append(dis);
+    }
+
+    if (!dec.ok)
+        return false;
+
+    s.disassembly = list;
+    s.listingKey = key;
+    return true;
+}
+
+// a changed segment no longer needs the file of its previous listing
+
+void ListingCache::store(struct segment &s, quint64 key) {
+    quint64 previous = s.listingKey;
+
+    s.listingKey = key;
+
+    if (directory.isEmpty() || s.end - s.start + 1 < LISTING_CACHE_MIN_SIZE)
+        return;
+
+    if (previous && previous != key) {
+        bool used = false;
+        for (const auto &other : qAsConst(segments))
+            used |= other.listingKey == previous;
+        if (!used)
+            QFile::remove(fileName(previous));
+    }
+
+    QString name = fileName(key);
+    if (QFile::exists(name) || !QDir().mkpath(directory))
+        return;
+
+    StringPool pool;
+    SectionEncoder enc(&pool);
+
+    enc.varint(key);
+    enc.varint(s.disassembly.size());
+    for (const auto &dis : qAsConst(s.disassembly)) {
+        enc.varint(dis.address - s.start);
+        enc.string(dis.instruction);
+        enc.string(dis.arguments);
+        enc.varint(dis.size);
+        enc.varint(dis.changes_pc | dis.directive << 1);
+    }
+
+    SectionEncoder strings(&pool);
+    pool.encode(strings);
+
+    // written under another name first, a half written file is never used
+
+    QFile file(name + QStringLiteral(".tmp"));
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    bool ok = writeSection(file, SECTION_STRINGS, strings.buffer) &&
+              writeSection(file, SECTION_LISTING, enc.buffer) &&
+              writeSection(file, SECTION_END, QByteArray());
+    file.close();
+
+    if (!ok || !file.rename(name))
+        file.remove();
+}
+
+// ---------------------------------------------------------------------------
+// LIMIT
+
+void ListingCache::setLimit(quint64 bytes) {
+    maxBytes = bytes;
+}
+
+void ListingCache::use(int segment) {
+    struct segment &s = segments[segment];
+
+    s.listingUsed = ++clock;
+    s.listingBytes = listingBytes(s);
+    evict(segment);
+}
+
+// least recently used first, the listing of keep always stays
+
+void ListingCache::evict(int keep) {
+    quint64 total = 0;
+    QVector<QPair<quint64, int>> order;
+
+    for (int i = 0; i < segments.size(); i++) {
+        const struct segment &s = segments.at(i);
+        if (s.disassembly.isEmpty())
+            continue;
+        total += s.listingBytes;
+        if (i != keep)
+            order.append(qMakePair(s.listingUsed, i));
+    }
+
+    if (total <= maxBytes)
+        return;
+
+    std::sort(order.begin(), order.end());
+
+    for (const auto &entry : qAsConst(order)) {
+        struct segment &s = segments[entry.second];
+
+        total -= s.listingBytes;
+        s.disassembly = QList<struct disassembly>();     // frees, clear() may not
+        s.listingBytes = 0;
+        delete s.annotations;
+        s.annotations = nullptr;
+        delete s.flow;
+        s.flow = nullptr;
+
+        if (total <= maxBytes)
+            break;
+    }
+}
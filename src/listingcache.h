@@ -0,0 +1,73 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef LISTINGCACHE_H
+#define LISTINGCACHE_H
+
+#include "pch.h"
+
+// Generated disassembly, keyed by a hash of everything it is made from:
+// the bytes, datatypes, flags and constants of the segment, its comments,
+// the labels it can refer to, the constants groups and the syntax of the
+// disassembler.
+// A segment remembers the key of its listing, so switching back to an
+// unchanged segment costs one hash. With a project file, larger listings
+// are also kept in a directory next to it and survive reopening.
+// Listings in memory are capped. When they grow beyond the limit, those
+// of the segments used longest ago are dropped, and the next
+// generateDisassembly() of such a segment reads or generates it again.
+
+#define LISTING_CACHE_MIN_SIZE  0x1000  // smaller segments are not written
+#define LISTING_CACHE_LIMIT     256     // MiB of listings kept in memory
+
+class ListingCache {
+public:
+    ListingCache();
+
+    void setDirectory(const QString &dir);      // empty for memory only
+
+    quint64 key(const struct segment &s, const class Disassembler &dis,
+                bool generateLocalLabels) const;
+
+    // reads s.disassembly from the directory, if it has a listing for key
+    bool fetch(struct segment &s, quint64 key);
+    void store(struct segment &s, quint64 key);
+
+    void setLimit(quint64 bytes);
+    quint64 limit(void) const { return maxBytes; }
+
+    // marks the listing of segment as the most recently used, and drops
+    // others while over the limit
+    void use(int segment);
+
+private:
+    QString fileName(quint64 key) const;
+    void evict(int keep);
+
+    QString directory;
+    quint64 maxBytes;
+    quint64 clock;
+};
+
+extern ListingCache listingCache;
+
+#endif // LISTINGCACHE_H
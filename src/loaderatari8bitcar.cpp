@@ -22,6 +22,7 @@
 
 // Based on: https://github.com/atari800/atari800/blob/master/DOC/cart.txt
 
+#include "banks.h"
 #include "loaderatari8bitcar.h"
 #include "loaders.h"
 #include "selectcartridgewindow.h"
@@ -511,7 +512,26 @@ struct cartridge_info cartridges[CARTRIDGE_LAST] = {
 
 // ---------------------------------------------------------------------------
 
-bool LoaderAtari8bitCar::Load(QFile& file) {
+// a CART header with a known type, or a headerless dump of the right size,
+// which needs the user to pick the type and is therefore a last resort
+
+int LoaderAtari8bitCar::probe(const quint8 *data, qint64 size, qint64 filesize) const {
+    if (size >= 16 && memcmp(data, "CART", 4) == 0) {
+        quint32 cartype = BE32(data+4);
+
+        if (cartype == 0 || cartype >= CARTRIDGE_LAST)
+            return PROBE_MAYBE;         // Load will say which
+        return PROBE_SURE;
+    }
+
+    for (quint64 a = 1; a < CARTRIDGE_LAST; a++) {
+        if (cartridges[a].blocks && cartridges[a].size_in_kB*1024 == filesize)
+            return PROBE_FALLBACK;
+    }
+    return PROBE_NONE;
+}
+
+bool LoaderAtari8bitCar::Load(QIODevice &file) {
     quint8 header[16];
     quint32 cartype;
     struct segment s;
@@ -569,7 +589,29 @@ bool LoaderAtari8bitCar::Load(QFile& file) {
         return false;
     }
 
+    // more than one bank share a single backing, in which identical banks
+    // are stored once
+
     int bank = 0;
+    QVector<quint64> sizes, offsets;
+    quint64 total = 0;
+    int group = BANKGROUP_NONE;
+
+    for (int i = 0; blocks[i].count; i++) {
+        for (int j = 0; j < blocks[i].count; j++)
+            sizes.append(blocks[i].size);
+        total += (quint64) blocks[i].count * blocks[i].size;
+    }
+
+    if (sizes.size() > 1) {
+        QByteArray image = file.read(total);
+        if ((quint64) image.size() != total) {
+            this->error_message = QStringLiteral("Premature end of file reached.");
+            return false;
+        }
+        group = bankGroups.createFromImage(carinfo->description,
+                        (const quint8 *) image.constData(), sizes, offsets);
+    }
 
     for (int i = 0; blocks[i].count; i++) {
 
@@ -578,12 +620,17 @@ bool LoaderAtari8bitCar::Load(QFile& file) {
         quint16 end_address = start_address + size - 1;
 
         for (int j = 0; j < blocks[i].count; j++) {
-            s = createEmptySegment(start_address, end_address);
-            s.name = QStringLiteral("Bank %1").arg(bank++);
-            if (file.read((char *) s.data, size) != size) {
-                this->error_message = QStringLiteral("Premature end of file reached.");
-                return false;
+            if (group == BANKGROUP_NONE) {
+                s = createEmptySegment(start_address, end_address);
+                if (file.read((char *) s.data, size) != size) {
+                    this->error_message = QStringLiteral("Premature end of file reached.");
+                    return false;
+                }
+            } else {
+                s = bankGroups.createBank(group, bank, offsets.at(bank),
+                                          start_address, end_address);
             }
+            s.name = QStringLiteral("Bank %1").arg(bank++);
 
             if (blocks[i].start_vector) {
                 quint16 start_offset = blocks[i].start_vector - blocks[i].start_address;
@@ -20,23 +20,33 @@
 //
 // ---------------------------------------------------------------------------
 
+#include "banks.h"
+#include "compressedfile.h"
+#include "diskimages.h"
 #include "loaders.h"
-#include "zlib.h"
+#include "profiler.h"
+#include "selectdiskfilewindow.h"
 #include <cstring>
 
 // note on zeroed memory:
 // new char[size]   is similar to malloc()
 // new char[size]() is similar to calloc()
 
-void Loader::genericComment(QFile& file, struct segment *segment) {
+// streams inside compressed files carry their name as object name
+
+void Loader::genericComment(QIODevice& file, struct segment *segment) {
+    auto *filedevice = qobject_cast<QFileDevice *>(&file);
+    QString name = filedevice ? filedevice->fileName() : file.objectName();
+
     segment->comments.insert(0,
         QStringLiteral("\n") +
-        QStringLiteral("Disassembled from: ") + file.fileName().section(QStringLiteral("/"),-1,-1) +
+        QStringLiteral("Disassembled from: ") + name.section(QStringLiteral("/"),-1,-1) +
         QStringLiteral("\n"));
 }
 
 struct segment Loader::createEmptySegment(quint64 start, quint64 end) {
     quint64 size = end - start + 1 +16;     // +16 to allow reading beyond end for speed during disassembly
+    profiler.allocation();
      struct segment segment = {
          start, end, QString(""),
          new quint8[size](), new quint8[size](), new quint8[size](),
@@ -44,14 +54,22 @@ struct segment Loader::createEmptySegment(quint64 start, quint64 end) {
          QMap<quint64, QString>(),
          QMap<quint64, quint16>(),
          QMap<quint64, quint16>(),
-         QMap<quint64, quint64>(),
+         new quint16[size](),
+         BANKGROUP_NONE, 0,
          QList<struct disassembly>(),
-         0
+         0,
+         nullptr,
+         nullptr,
+         0, 0, 0
      };
      return segment;
 }
 
-bool LoaderRaw::Load(QFile& file) {
+int LoaderRaw::probe(const quint8 *, qint64, qint64 filesize) const {
+    return filesize > 0 ? PROBE_FALLBACK : PROBE_NONE;
+}
+
+bool LoaderRaw::Load(QIODevice &file) {
     quint64 size = file.size();
     struct segment segment = createEmptySegment(0, size-1);
     if ((quint64)file.read((char*)segment.data, size) != size)
@@ -66,7 +84,23 @@ bool LoaderRaw::Load(QFile& file) {
 // ---------------------------------------------------------------------------
 // ATARI 8-BIT
 
-bool LoaderAtari8bitBinary::Load(QFile& file) {
+// 0xffff, followed by the first start and end address
+
+int LoaderAtari8bitBinary::probe(const quint8 *data, qint64 size, qint64 filesize) const {
+    if (size < 7 || LE16(data) != 0xffff)
+        return PROBE_NONE;
+
+    quint16 start = LE16(data+2);
+    quint16 end   = LE16(data+4);
+
+    if (start > end || start == 0xffff)
+        return PROBE_NONE;
+    if (end - start + 1 > filesize - 6)
+        return PROBE_MAYBE;             // truncated, Load will complain
+    return PROBE_LIKELY;
+}
+
+bool LoaderAtari8bitBinary::Load(QIODevice &file) {
     quint8 tmp[2];
     quint64 ffff;
     quint64 start;
@@ -134,7 +168,13 @@ bool LoaderAtari8bitBinary::Load(QFile& file) {
     return true;
 }
 
-bool LoaderAtari8bitSAP::Load(QFile& file) {
+int LoaderAtari8bitSAP::probe(const quint8 *data, qint64 size, qint64) const {
+    if (size >= 5 && memcmp(data, "SAP\x0d\x0a", 5) == 0)
+        return PROBE_SURE;
+    return PROBE_NONE;
+}
+
+bool LoaderAtari8bitSAP::Load(QIODevice &file) {
     quint8 tmp[5];
     unsigned int init;
     unsigned int play;
@@ -202,7 +242,30 @@ bool LoaderAtari8bitSAP::Load(QFile& file) {
 // ----------------------------------------------------------------------------
 // COMMODORE C64
 
-bool LoaderC64Binary::Load(QFile& file) {
+// a two byte load address, the usual BASIC starts are a good sign
+
+int LoaderC64Binary::probe(const quint8 *data, qint64 size, qint64 filesize) const {
+    if (size < 3)
+        return PROBE_NONE;
+
+    quint16 start = LE16(data);
+
+    if (start + filesize - 2 > 0x10000)
+        return PROBE_NONE;
+
+    switch (start) {
+    case 0x0401:                        // PET
+    case 0x0801:                        // C64
+    case 0x1001:                        // VIC-20, C16, Plus/4
+    case 0x1201:                        // VIC-20 +8K
+    case 0x1c01:                        // C128
+        return PROBE_LIKELY;
+    default:
+        return PROBE_FALLBACK;
+    }
+}
+
+bool LoaderC64Binary::Load(QIODevice &file) {
     quint8 tmp[2];
     quint64 start;
     quint64 end;
@@ -246,7 +309,13 @@ bool LoaderC64Binary::Load(QFile& file) {
     return true;
 }
 
-bool LoaderC64PSID::Load(QFile &file) {
+int LoaderC64PSID::probe(const quint8 *data, qint64 size, qint64) const {
+    if (size >= 4 && (data[0] == 'P' || data[0] == 'R') && memcmp(data+1, "SID", 3) == 0)
+        return PROBE_SURE;
+    return PROBE_NONE;
+}
+
+bool LoaderC64PSID::Load(QIODevice &file) {
     quint8 tmp[4];
     quint64 start = 0;
     quint64 end;
@@ -309,7 +378,20 @@ bool LoaderC64PSID::Load(QFile &file) {
 // ----------------------------------------------------------------------------
 // ATARI 2600
 
-bool LoaderAtari2600ROM2K4K::Load(QFile &file) {
+// only the size and a reset vector that points into the ROM
+
+int LoaderAtari2600ROM2K4K::probe(const quint8 *data, qint64 size, qint64 filesize) const {
+    if ((filesize != 2048 && filesize != 4096) || size != filesize)
+        return PROBE_NONE;
+
+    quint16 init = LE16(data+size-4);
+
+    if (init & 0x1000)                  // the cartridge is selected by A12
+        return PROBE_LIKELY;
+    return PROBE_MAYBE;
+}
+
+bool LoaderAtari2600ROM2K4K::Load(QIODevice &file) {
     quint64 size;
     quint16 start;
     quint16 end;
@@ -349,7 +431,25 @@ bool LoaderAtari2600ROM2K4K::Load(QFile &file) {
 // ----------------------------------------------------------------------------
 // ORIC 1 / ATMOS
 
-bool LoaderOricTap::Load(QFile &file) {
+// synchronisation bytes, $24 and a header with end >= start
+
+int LoaderOricTap::probe(const quint8 *data, qint64 size, qint64) const {
+    qint64 i = 0;
+
+    while (i < size && data[i] == 0x16)
+        i++;
+
+    if (i < 3 || i + 10 > size || data[i] != 0x24)
+        return PROBE_NONE;
+
+    const quint8 *header = data + i + 1;
+
+    if (BE16(header+4) < BE16(header+6))
+        return PROBE_MAYBE;
+    return PROBE_LIKELY;
+}
+
+bool LoaderOricTap::Load(QIODevice &file) {
     char c;
     quint8 data[9];
     quint64 start;
@@ -403,7 +503,20 @@ bool LoaderOricTap::Load(QFile &file) {
 // ----------------------------------------------------------------------------
 // APPLE ][
 
-bool LoaderApple2DOS33::Load(QFile &file) {
+// start and length, the length has to match the file
+
+int LoaderApple2DOS33::probe(const quint8 *data, qint64 size, qint64 filesize) const {
+    if (size < 5)
+        return PROBE_NONE;
+
+    quint16 length = LE16(data+2);
+
+    if (length && length == filesize - 4 && LE16(data) + length <= 0x10000)
+        return PROBE_LIKELY;
+    return PROBE_NONE;
+}
+
+bool LoaderApple2DOS33::Load(QIODevice &file) {
     quint8 tmp[4];
     quint16 start;
     quint16 end;
@@ -429,7 +542,13 @@ bool LoaderApple2DOS33::Load(QFile &file) {
     return true;
 };
 
-bool LoaderApple2AppleSingle::Load(QFile &file) {
+int LoaderApple2AppleSingle::probe(const quint8 *data, qint64 size, qint64) const {
+    if (size >= 8 && BE32(data) == 0x00051600 && BE32(data+4) == 0x00020000)
+        return PROBE_SURE;
+    return PROBE_NONE;
+}
+
+bool LoaderApple2AppleSingle::Load(QIODevice &file) {
     quint8 tmp[12];
     quint16 numentries;
     quint16 start;
@@ -515,7 +634,13 @@ bool LoaderApple2AppleSingle::Load(QFile &file) {
 // ----------------------------------------------------------------------------
 // NINTENDO NES
 
-bool LoaderNESSongFile::Load(QFile &file) {
+int LoaderNESSongFile::probe(const quint8 *data, qint64 size, qint64) const {
+    if (size >= 5 && memcmp(data, "NESM\x1a", 5) == 0)
+        return PROBE_SURE;
+    return PROBE_NONE;
+}
+
+bool LoaderNESSongFile::Load(QIODevice &file) {
     quint8 tmp[8];
     quint64 start;
     quint64 end;
@@ -574,94 +699,52 @@ bool LoaderNESSongFile::Load(QFile &file) {
 // ----------------------------------------------------------------------------
 // CP/M
 
-bool LoaderCPMBinary::Load(QFile &file) {
+// there is no header, the file name has to tell
+
+int LoaderCPMBinary::probe(const quint8 *, qint64, qint64 filesize) const {
+    if (filesize > 0 && filesize <= 0x10000 - 0x0100)
+        return PROBE_FALLBACK;
+    return PROBE_NONE;
+}
+
+bool LoaderCPMBinary::Load(QIODevice &file) {
     LoaderRaw raw;
     if (!raw.Load(file))
         return false;
 
-    segments[0].start += 0x0100;
-    segments[0].end   += 0x0100;
+    segments.last().start += 0x0100;
+    segments.last().end   += 0x0100;
 
-    globalLabels.insert(segments[0].start, QStringLiteral("RUN"));
+    globalLabels.insert(segments.last().start, QStringLiteral("RUN"));
     return true;
 }
 
 // ----------------------------------------------------------------------------
 // BBC MICRO, ELECTRON AND MASTER
 
-bool LoaderBBCUEFTape::Load(QFile &file) {
-    QByteArray compressed;
+int LoaderBBCUEFTape::probe(const quint8 *data, qint64 size, qint64) const {
+    if (size >= 10 && memcmp(data, "UEF File!", 10) == 0)
+        return PROBE_SURE;
+    return PROBE_NONE;
+}
+
+// gzip'd files are inflated by the InflateDevice before they get here
+
+bool LoaderBBCUEFTape::Load(QIODevice &file) {
     QByteArray uncompressed;
     QByteArray temporary;
     bool segmentInProgress = false;
     struct segment segment;
 
-    compressed.resize(file.size());
-    if (file.read(compressed.data(), file.size()) != file.size()) {
+    uncompressed = file.readAll();
+    if (uncompressed.size() != file.size()) {
         this->error_message = QStringLiteral("Read error!\n");
         return false;
     }
 
-    auto *raw = (quint8 *)compressed.data();
-
-    if (raw[0] != 0x1f && raw[1] != 0x8b) {
-        uncompressed = compressed;
-        goto skip_decompression;        // avoid useless indentation
-    }
-
-    // Decompress gzipped file
-
-    static const int CHUNK_SIZE = 1024;
-    char out[CHUNK_SIZE];
-    int ret;
-    z_stream strm;
-
-    strm.zalloc = Z_NULL;
-    strm.zfree  = Z_NULL;
-    strm.opaque = Z_NULL;
-    strm.avail_in = compressed.size();
-    strm.next_in = (Bytef*)(compressed.data());
-
-    ret = inflateInit2(&strm, 15 + 32);
-    if (ret != Z_OK) {
-        this->error_message = QStringLiteral("Unable to decompress gzip'd UEF file\n");
-        return false;
-    }
-
-    do {
-        strm.avail_out = CHUNK_SIZE;
-        strm.next_out = (Bytef*)(out);
-
-        ret = inflate(&strm, Z_NO_FLUSH);
-
-        switch (ret) {
-        case Z_NEED_DICT:
-            ret = Z_DATA_ERROR;
-            [[fallthrough]];
-        case Z_DATA_ERROR:
-            [[fallthrough]];
-        case Z_MEM_ERROR:
-            this->error_message = QStringLiteral("Unable to decompress gzip'd UEF file\n");
-            this->error_message += QStringLiteral("zlib error: %1\n").arg(ret);
-            inflateEnd(&strm);
-            return false;
-        default:
-            ;
-        }
-
-        uncompressed.append(out, CHUNK_SIZE - strm.avail_out);
-
-    } while (strm.avail_out == 0);
-
-    inflateEnd(&strm);
-
-skip_decompression:
-    raw = (quint8 *) uncompressed.data();
+    auto *raw = (quint8 *) uncompressed.data();
     quint8 *endraw = raw + uncompressed.size() - 1;
 
-    qDebug() << "filesize: " << file.size();
-    qDebug() << "size: " << uncompressed.size();
-
     // 12 bytes: zero terminated string (10 bytes), version minor, verion major
 
     if (raw + 12 > endraw) {
@@ -833,7 +916,40 @@ static const char * const typenames[4] = {
     "Binary Code: "
 };
 
-bool LoaderZXSpectrumTape::Load(QFile &file) {
+// walk the blocks that are completely within data, each ends with the XOR
+// of the flag and the data bytes
+
+int LoaderZXSpectrumTape::probe(const quint8 *data, qint64 size, qint64) const {
+    qint64 pos = 0;
+    int verified = 0;
+
+    while (pos + 2 <= size) {
+        quint16 length = LE16(data+pos);
+        pos += 2;
+
+        if (length < 2)
+            return verified ? PROBE_LIKELY : PROBE_NONE;    // zero padding
+        if (pos + length > size)
+            break;
+
+        quint8 check = 0;
+        for (int i = 0; i < length - 1; i++)
+            check ^= data[pos+i];
+
+        if (check != data[pos+length-1])
+            return PROBE_NONE;
+
+        if (data[pos] == 0 && (length != 19 || data[pos+1] > 3))
+            return PROBE_NONE;      // malformed header block
+
+        verified++;
+        pos += length;
+    }
+
+    return verified ? PROBE_LIKELY : PROBE_NONE;
+}
+
+bool LoaderZXSpectrumTape::Load(QIODevice &file) {
     quint8 c;
     quint8 d;
     quint8 flag;
@@ -932,7 +1048,8 @@ bool LoaderZXSpectrumTape::Load(QFile &file) {
             return false;
         }
 
-        if (file.error() != file.NoError) {
+        auto *filedevice = qobject_cast<QFileDevice *>(&file);
+        if (filedevice && filedevice->error() != QFileDevice::NoError) {
             this->error_message = QStringLiteral("Read error!\n");
             return false;
         }
@@ -942,3 +1059,249 @@ bool LoaderZXSpectrumTape::Load(QFile &file) {
 }
 
 // ----------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+// DISK IMAGES
+
+// Only the directory is read up front. With more than one file the user
+// chooses, unless the loader is not interactive, then all files are taken.
+// Every chosen file is extracted and loaded on its own.
+
+bool LoaderDiskImage::Load(QIODevice &file) {
+    DiskImage *image = createImage();
+    QVector<struct diskfile> chosen;
+
+    if (!image->attach(file, &this->error_message)) {
+        delete image;
+        return false;
+    }
+
+    if (image->files.size() == 1 || !interactive) {
+        chosen = image->files;
+    } else if (!image->files.isEmpty()) {
+        selectdiskfilewindow sdw(nullptr, image);
+        if (sdw.exec() == QDialog::Accepted)
+            chosen = sdw.chosen;
+    }
+
+    if (chosen.isEmpty()) {
+        this->error_message = image->files.isEmpty() ? QStringLiteral("No files found on disk image\n")
+                                                     : QStringLiteral("No file selected\n");
+        delete image;
+        return false;
+    }
+
+    for (const auto &entry : qAsConst(chosen)) {
+        QByteArray contents = image->extract(entry);
+
+        if (contents.isEmpty()) {
+            this->error_message = entry.name + QStringLiteral(": file is empty\n");
+            delete image;
+            return false;
+        }
+
+        QBuffer buffer(&contents);
+        buffer.setObjectName(entry.name);
+        buffer.open(QIODevice::ReadOnly);
+
+        int first = segments.size();
+        Loader *loader = createLoader(entry.type);
+        bool loaded = loader->Load(buffer);
+
+        if (!loaded)
+            this->error_message = entry.name + QStringLiteral(": ") + loader->error_message;
+        delete loader;
+
+        if (!loaded || segments.size() == first) {
+            delete image;
+            return loaded;
+        }
+
+        // raw contents (boot sectors) are moved to where they are loaded
+
+        if (entry.address >= 0) {
+            segments.last().start += entry.address;
+            segments.last().end   += entry.address;
+        }
+
+        for (int i = first; i < segments.size(); i++) {
+            if (segments[i].name.isEmpty())
+                segments[i].name = segments.size() - first == 1 ? entry.name
+                                 : QStringLiteral("%1 %2").arg(entry.name).arg(i - first);
+        }
+    }
+
+    delete image;
+    return true;
+}
+
+int LoaderAtari8bitATR::probe(const quint8 *data, qint64 size, qint64) const {
+    if (size >= 16 && LE16(data) == 0x0296)
+        return PROBE_SURE;
+    return PROBE_NONE;
+}
+
+DiskImage *LoaderAtari8bitATR::createImage(void) const {
+    return new AtariATRImage();
+}
+
+// 35 or 40 tracks, with or without error bytes, is distinctive enough
+
+int LoaderC64D64::probe(const quint8 *, qint64, qint64 filesize) const {
+    switch (filesize) {
+    case 174848:
+    case 175531:
+    case 196608:
+    case 197376:
+        return PROBE_LIKELY;
+    default:
+        return PROBE_NONE;
+    }
+}
+
+DiskImage *LoaderC64D64::createImage(void) const {
+    return new C64D64Image();
+}
+
+// ProDOS order images have the same size, Load tells them apart
+
+int LoaderApple2DSK::probe(const quint8 *, qint64, qint64 filesize) const {
+    return filesize == 35 * 16 * 256 ? PROBE_MAYBE : PROBE_NONE;
+}
+
+DiskImage *LoaderApple2DSK::createImage(void) const {
+    return new Apple2DSKImage();
+}
+
+// ----------------------------------------------------------------------------
+// REGISTRY
+
+Loader *createLoader(enum filetypeid id) {
+    switch(id) {
+    case FT_RAW_FILE:           return new LoaderRaw();
+    case FT_ATARI8BIT_BINARY:   return new LoaderAtari8bitBinary();
+    case FT_ATARI8BIT_SAP:      return new LoaderAtari8bitSAP();
+    case FT_ATARI8BIT_CAR:      return new LoaderAtari8bitCar();
+    case FT_ATARI8BIT_ATR:      return new LoaderAtari8bitATR();
+    case FT_C64_BINARY:         return new LoaderC64Binary();
+    case FT_C64_PSID:           return new LoaderC64PSID();
+    case FT_C64_D64:            return new LoaderC64D64();
+    case FT_ATARI2600_2K4K:     return new LoaderAtari2600ROM2K4K();
+    case FT_ORIC_TAP:           return new LoaderOricTap();
+    case FT_APPLE2_DOS33:       return new LoaderApple2DOS33();
+    case FT_APPLE2_APPLESINGLE: return new LoaderApple2AppleSingle();
+    case FT_APPLE2_DSK:         return new LoaderApple2DSK();
+    case FT_NES_SONG_FILE:      return new LoaderNESSongFile();
+    case FT_CPM_BINARY:         return new LoaderCPMBinary();
+    case FT_BBC_UEF_TAPE:       return new LoaderBBCUEFTape();
+    case FT_ZX_SPECTRUM_TAP:    return new LoaderZXSpectrumTape();
+    default:                    return nullptr;
+    }
+}
+
+static bool hasExtension(const struct filetype &type, const QString &suffix) {
+    const QStringList list = QString::fromLatin1(type.extensions).split(QLatin1Char(';'));
+    return list.contains(suffix);
+}
+
+// Equal scores are decided by the file extension, and then by the order
+// of the filetypes table.
+
+static QVector<struct loadercandidate> rank(const quint8 *data, qint64 size,
+                                            qint64 filesize, const QString &name) {
+    QVector<struct loadercandidate> candidates;
+    QString suffix = QFileInfo(name).suffix().toLower();
+    QVector<bool> extension;
+
+    for (int i = 0; i < filetypes.size(); i++) {
+        Loader *loader = createLoader(filetypes.at(i).id);
+        if (!loader)
+            continue;
+
+        int score = loader->probe(data, size, filesize);
+        delete loader;
+
+        if (score == PROBE_NONE)
+            continue;
+
+        candidates.append({ i, score });
+        extension.append(hasExtension(filetypes.at(i), suffix));
+    }
+
+    // insertion sort, keeps the table order for equal ranks
+
+    for (int i = 1; i < candidates.size(); i++) {
+        struct loadercandidate c = candidates.at(i);
+        bool e = extension.at(i);
+        int j = i - 1;
+
+        while (j >= 0 && (candidates.at(j).score < c.score ||
+                          (candidates.at(j).score == c.score && !extension.at(j) && e))) {
+            candidates[j+1] = candidates.at(j);
+            extension[j+1] = extension.at(j);
+            j--;
+        }
+        candidates[j+1] = c;
+        extension[j+1] = e;
+    }
+
+    return candidates;
+}
+
+// All probes look at the same mapped (or read, if mapping fails) start of
+// the file. file has to be open, its position is left at the start.
+
+QVector<struct loadercandidate> probeFile(QFile& file) {
+    QVector<struct loadercandidate> candidates;
+    qint64 filesize = file.size();
+    qint64 size = qMin(filesize, (qint64) PROBE_SIZE);
+    QByteArray buffer;
+
+    QVector<struct compressedstream> streams = compressedStreams(file);
+    file.seek(0);
+
+    if (!streams.isEmpty()) {
+        InflateDevice device(&file, streams.at(0));
+        if (device.open(QIODevice::ReadOnly))
+            candidates = probeDevice(device, streams.at(0).name);
+        file.seek(0);
+        return candidates;
+    }
+
+    if (size <= 0)
+        return candidates;
+
+    const quint8 *data = file.map(0, size);
+    if (!data) {
+        buffer = file.read(size);
+        if (buffer.size() != size)
+            return candidates;
+        data = (const quint8 *) buffer.constData();
+    }
+
+    candidates = rank(data, size, filesize, file.fileName());
+
+    if (buffer.isEmpty())
+        file.unmap((uchar *) data);
+    file.seek(0);
+
+    return candidates;
+}
+
+// Same for any device, its position is left at the start.
+
+QVector<struct loadercandidate> probeDevice(QIODevice& device, const QString &name) {
+    QVector<struct loadercandidate> candidates;
+    qint64 filesize = device.size();
+    qint64 size = qMin(filesize, (qint64) PROBE_SIZE);
+
+    if (size <= 0 || !device.seek(0))
+        return candidates;
+
+    QByteArray buffer = device.read(size);
+    if (buffer.size() == size)
+        candidates = rank((const quint8 *) buffer.constData(), size, filesize, name);
+
+    device.seek(0);
+    return candidates;
+}
@@ -30,85 +30,168 @@
 #define LE32(x) ((x)[3]<<24 | (x)[2]<<16 | (x)[1]<<8 | (x)[0])
 #define BE32(x) ((x)[0]<<24 | (x)[1]<<16 | (x)[2]<<8 | (x)[3])
 
+// how sure a probe is that it can load a file, candidates are ranked by it
+
+#define PROBE_NONE      0       // definitely not
+#define PROBE_FALLBACK  1       // anything goes (raw, CP/M)
+#define PROBE_MAYBE     2       // size or layout fits
+#define PROBE_LIKELY    3       // header is consistent
+#define PROBE_SURE      4       // magic number
+
+#define PROBE_SIZE      4096    // the probes see at most this much of a file
+
 class Loader {
 public:
 	Loader() = default;
     virtual ~Loader() = default;
-    virtual bool Load(QFile& file) = 0;
+    virtual bool Load(QIODevice &file) = 0;
+
+    // cheap check on the first few KB of a file, size is what is in data,
+    // filesize the size of the whole file
+
+    virtual int probe(const quint8 *data, qint64 size, qint64 filesize) const = 0;
+
     static struct segment createEmptySegment(quint64 start, quint64 end);
-    static void genericComment(QFile& file, struct segment *segment);
+    static void genericComment(QIODevice& file, struct segment *segment);
     QString error_message;
+    bool interactive = true;    // may ask the user, otherwise takes defaults
 	Q_DISABLE_COPY(Loader)
 };
 
 class LoaderRaw : public Loader {
 public:
-    bool Load(QFile& file) override;
+    bool Load(QIODevice &file) override;
+    int probe(const quint8 *data, qint64 size, qint64 filesize) const override;
 };
 
 class LoaderAtari8bitBinary : public Loader {
 public:
-    bool Load(QFile& file) override;
+    bool Load(QIODevice &file) override;
+    int probe(const quint8 *data, qint64 size, qint64 filesize) const override;
 };
 
 class LoaderAtari8bitSAP : public Loader {
 public:
-    bool Load(QFile& file) override;
+    bool Load(QIODevice &file) override;
+    int probe(const quint8 *data, qint64 size, qint64 filesize) const override;
 };
 
 class LoaderAtari8bitCar : public Loader {
 public:
-    bool Load(QFile& file) override;
+    bool Load(QIODevice &file) override;
+    int probe(const quint8 *data, qint64 size, qint64 filesize) const override;
 };
 
 class LoaderC64Binary : public Loader {
 public:
-    bool Load(QFile& file) override;
+    bool Load(QIODevice &file) override;
+    int probe(const quint8 *data, qint64 size, qint64 filesize) const override;
 };
 
 class LoaderC64PSID : public Loader {
 public:
-    bool Load(QFile& file) override;
+    bool Load(QIODevice &file) override;
+    int probe(const quint8 *data, qint64 size, qint64 filesize) const override;
 };
 
 class LoaderAtari2600ROM2K4K : public Loader {
 public:
-    bool Load(QFile& file) override;
+    bool Load(QIODevice &file) override;
+    int probe(const quint8 *data, qint64 size, qint64 filesize) const override;
 };
 
 class LoaderOricTap : public Loader {
 public:
-    bool Load(QFile &file) override;
+    bool Load(QIODevice &file) override;
+    int probe(const quint8 *data, qint64 size, qint64 filesize) const override;
 };
 
 class LoaderApple2DOS33 : public Loader {
 public:
-    bool Load(QFile &file) override;
+    bool Load(QIODevice &file) override;
+    int probe(const quint8 *data, qint64 size, qint64 filesize) const override;
 };
 
 class LoaderApple2AppleSingle : public Loader {
 public:
-    bool Load(QFile &file) override;
+    bool Load(QIODevice &file) override;
+    int probe(const quint8 *data, qint64 size, qint64 filesize) const override;
 };
 
 class LoaderNESSongFile : public Loader {
 public:
-    bool Load(QFile &file) override;
+    bool Load(QIODevice &file) override;
+    int probe(const quint8 *data, qint64 size, qint64 filesize) const override;
 };
 
 class LoaderCPMBinary : public Loader {
 public:
-    bool Load(QFile &file) override;
+    bool Load(QIODevice &file) override;
+    int probe(const quint8 *data, qint64 size, qint64 filesize) const override;
 };
 
 class LoaderBBCUEFTape : public Loader {
 public:
-    bool Load(QFile &file) override;
+    bool Load(QIODevice &file) override;
+    int probe(const quint8 *data, qint64 size, qint64 filesize) const override;
 };
 
 class LoaderZXSpectrumTape : public Loader {
 public:
-    bool Load(QFile &file) override;
+    bool Load(QIODevice &file) override;
+    int probe(const quint8 *data, qint64 size, qint64 filesize) const override;
+};
+
+// Disk images list their files, the chosen ones are extracted and loaded
+// with the loader for their contents. Without asking, all files are chosen.
+
+class DiskImage;
+
+class LoaderDiskImage : public Loader {
+public:
+    bool Load(QIODevice &file) override;
+
+protected:
+    virtual DiskImage *createImage(void) const = 0;
+};
+
+class LoaderAtari8bitATR : public LoaderDiskImage {
+public:
+    int probe(const quint8 *data, qint64 size, qint64 filesize) const override;
+
+protected:
+    DiskImage *createImage(void) const override;
 };
 
+class LoaderC64D64 : public LoaderDiskImage {
+public:
+    int probe(const quint8 *data, qint64 size, qint64 filesize) const override;
+
+protected:
+    DiskImage *createImage(void) const override;
+};
+
+class LoaderApple2DSK : public LoaderDiskImage {
+public:
+    int probe(const quint8 *data, qint64 size, qint64 filesize) const override;
+
+protected:
+    DiskImage *createImage(void) const override;
+};
+
+// ---------------------------------------------------------------------------
+
+struct loadercandidate {
+    int filetype;       // index into filetypes
+    int score;          // PROBE_*
+};
+
+// all loaders that might load the file, best first, compressed files are
+// judged by their first stream
+
+extern QVector<struct loadercandidate> probeFile(QFile& file);
+extern QVector<struct loadercandidate> probeDevice(QIODevice& device, const QString &name);
+
+extern Loader *createLoader(enum filetypeid id);
+
 #endif // LOADERS_H
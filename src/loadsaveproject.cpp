@@ -20,8 +20,14 @@
 //
 // ---------------------------------------------------------------------------
 
+#include "banks.h"
+#include "constants.h"
+#include "listingcache.h"
 #include "loaders.h"
 #include "loadsaveproject.h"
+#include "profiler.h"
+#include "projectsections.h"
+#include "symbollibrary.h"
 
 static const char *magic = "FRIDA";
 static char checkmagic[5];
@@ -31,27 +37,172 @@ QString errorstring;
 
 enum {
     FRIDA_FILE_FORMAT_1 = 0,
+    FRIDA_FILE_FORMAT_2,        // compressed sections, see projectsections.h
 };
 
 //-----------------------------------------------------------------------------
 // LOAD PROJECT
 
-bool load_project(QWidget *widget) {
-    QString name = QFileDialog::getOpenFileName(widget, QStringLiteral("Loca Existing Project..."));
+// FRIDA_FILE_FORMAT_2 and up, the sections are read one by one
 
-    if (name.isEmpty()) return false;
+static bool load_segment(SectionDecoder &dec, QString *error) {
+    quint64 start = dec.varint();
+    quint64 end   = dec.varint();
+    QString name  = dec.string();
+    qint32 group  = (qint32) dec.varint() - 1;      // BANKGROUP_NONE is 0
+    qint32 bank   = dec.varint();
+    quint64 offset = dec.varint();
+    bool store    = dec.varint();
 
-    QMessageBox msg;
+    if (!dec.ok || end < start) {
+        *error = QStringLiteral("Segment header is corrupt");
+        return false;
+    }
+
+    quint64 length = end - start + 1;
+    struct segment s;
+
+    if (group == BANKGROUP_NONE) {
+        s = Loader::createEmptySegment(start, end);
+    } else if (bankGroups.contains(group) &&
+               offset + length <= bankGroups.group(group).size) {
+        s = bankGroups.createBank(group, bank, offset, start, end);
+    } else {
+        *error = QStringLiteral("Bank outside of its bank group");
+        return false;
+    }
+
+    s.name = name;
+
+    // an identical bank was stored only once
+
+    if (store) {
+        dec.bytes(s.data, length);
+        dec.plane(s.datatypes, length);
+        dec.plane(s.flags, length);
+
+        QMap<quint64, quint16> constants = dec.words();
+        for (auto it = constants.constBegin(); it != constants.constEnd(); ++it)
+            if (it.key() < length)
+                s.constants[it.key()] = it.value();
+    }
+
+    s.comments    = dec.labels();
+    s.localLabels = dec.labels();
+    s.lowbytes    = dec.words();
+    s.highbytes   = dec.words();
+
+    if (!dec.ok) {
+        BankGroups::release(s);
+        *error = QStringLiteral("Segment %1 is corrupt").arg(segments.size() + 1);
+        return false;
+    }
 
+    segments.append(s);
+    return true;
+}
+
+static bool load_sections(QIODevice &file, QString *error) {
+    StringPool pool;
+    QStringList libraries;
+    QByteArray data;
+    quint32 id;
+
+    while (readSection(file, &id, &data, error)) {
+        SectionDecoder dec(data, &pool);
+
+        switch (id) {
+        case SECTION_END:
+            for (const auto &library : qAsConst(libraries)) {
+                QString liberror;
+                if (!symbolLibraries.attach(library, &liberror)) {
+                    QMessageBox msg;
+                    msg.setText(liberror);
+                    msg.exec();
+                }
+            }
+            return true;
+
+        case SECTION_STRINGS:
+            pool.decode(dec);
+            break;
+
+        case SECTION_HEADER:
+            cputype = dec.varint();
+            altfont = (enum fonts) dec.varint();
+            break;
+
+        case SECTION_BANKGROUPS:
+            for (quint64 n = dec.varint(); dec.ok && n; n--) {
+                QString name = dec.string();
+                quint64 size = dec.varint();
+                QMap<quint64, QString> shared = dec.labels();
+                if (dec.ok)
+                    bankGroups.setSharedLabels(bankGroups.create(name, size), shared);
+            }
+            break;
+
+        case SECTION_SEGMENT:
+            if (!load_segment(dec, error))
+                return false;
+            break;
+
+        case SECTION_GLOBALS:
+            globalLabels = dec.labels();
+            globalNotes  = dec.string();
+            break;
+
+        case SECTION_CONSTANTS:
+            for (quint64 n = dec.varint(); dec.ok && n; n--) {
+                quint16 groupID = dec.varint();
+                QString name = dec.string();
+                QMap<quint64, QString> map = dec.labels();
+
+                if (!dec.ok || !constantsGroups.insert(groupID, name))
+                    continue;
+
+                ConstantsGroup *group = constantsGroups.group(groupID);
+                for (auto it = map.constBegin(); it != map.constEnd(); ++it)
+                    group->insert(it.key(), it.value());
+            }
+            break;
+
+        case SECTION_LIBRARIES:
+            for (quint64 n = dec.varint(); dec.ok && n; n--)
+                libraries.append(dec.string());
+            break;
+
+        default:                        // from a newer version, skip it
+            break;
+        }
+
+        if (!dec.ok) {
+            *error = QStringLiteral("Section %1 is corrupt").arg(id);
+            return false;
+        }
+    }
+    return false;
+}
+
+bool is_project_file(const QString &name) {
+    QFile file(name);
+
+    return file.open(QIODevice::ReadOnly) &&
+           file.read(checkmagic, 5) == 5 && !memcmp(magic, checkmagic, 5);
+}
+
+// without asking anything, for the dialog and the command line
+
+bool load_project_file(const QString &name, QString *failed) {
     QFile file(name);
 
     file.open(QIODevice::ReadOnly);
     if (!file.isOpen()) {
-        msg.setText("Failed to open " + name + "\n" + file.errorString());
-        msg.exec();
+        *failed = "Failed to open " + name + "\n" + file.errorString();
         return false;
     }
 
+    ProfileScope scope("load_project");
     QDataStream in(&file);
 
     in.readRawData(checkmagic, 5);
@@ -64,15 +215,21 @@ bool load_project(QWidget *widget) {
 
     in >> fileformat;
 
-    if (fileformat > FRIDA_FILE_FORMAT_1) {
-        msg.setText("Unable to load " + file.errorString() +
-                    "\nProject is from a newer version of Frida\n");
-        msg.exec();
+    if (fileformat > FRIDA_FILE_FORMAT_2) {
+        *failed = "Unable to load " + name +
+                  "\nProject is from a newer version of Frida\n";
         file.close();
         return false;
     }
 
-    // future: select loader for older file formats
+    if (fileformat >= FRIDA_FILE_FORMAT_2) {
+        error = file.NoError;
+        if (!load_sections(file, &errorstring))
+            error = QFile::ReadError;
+        goto error_out;
+    }
+
+    // FRIDA_FILE_FORMAT_1
 
     in.setVersion(QDataStream::Qt_5_15);
 
@@ -115,24 +272,53 @@ bool load_project(QWidget *widget) {
     in >> numGroups;
 
     for (quint64 i = 0; i<numGroups; i++) {
-        auto *group = new struct constantsGroup;
-        group->map = new QMap<quint64, QString>;
+        QString name;
+        QMap<quint64, QString> map;
 
-        in >> group->name;
-        in >> *group->map;
+        in >> name;
+        in >> map;
 
-        constantsGroups.insert(nextNewGroup, *group);
-        nextNewGroup++;
+        ConstantsGroup *group = constantsGroups.group(constantsGroups.add(name));
+        if (!group)
+            continue;
+        for (auto it = map.constBegin(); it != map.constEnd(); ++it)
+            group->insert(it.key(), it.value());
     }
 
     error = file.error();
     errorstring = file.errorString();
 
 error_out:          // goto here with error and errorstring set.
+    scope.count(PC_BYTES, file.pos());
     file.close();
+    scope.stop();
 
     if (error != file.NoError) {
-        msg.setText("Failed to load " + name + "\n\n" + errorstring);
+        *failed = "Failed to load " + name + "\n\n" + errorstring;
+
+        // no half loaded segments or orphaned bank groups
+
+        for (auto &s : segments)
+            BankGroups::release(s);
+        segments.clear();
+        bankGroups.clear();
+        return false;
+    }
+
+    listingCache.setDirectory(name + QStringLiteral(".cache"));
+    return true;
+}
+
+bool load_project(QWidget *widget) {
+    QString name = QFileDialog::getOpenFileName(widget, QStringLiteral("Loca Existing Project..."));
+
+    if (name.isEmpty()) return false;
+
+    QMessageBox msg;
+    QString failed;
+
+    if (!load_project_file(name, &failed)) {
+        msg.setText(failed);
         msg.exec();
         return false;
     }
@@ -145,6 +331,102 @@ error_out:          // goto here with error and errorstring set.
 //-----------------------------------------------------------------------------
 // SAVE PROJECT
 
+// Sections are encoded first, so the string pool is complete and can be
+// written before the sections that refer to it.
+
+static bool save_sections(QIODevice &file) {
+    StringPool pool;
+    QVector<QPair<quint32, QByteArray>> sections;
+
+    SectionEncoder header(&pool);
+    header.varint(cputype);
+    header.varint(altfont);
+    sections.append(qMakePair((quint32) SECTION_HEADER, header.buffer));
+
+    SectionEncoder banks(&pool);
+    banks.varint(bankGroups.size());
+    for (int i = 0; i < bankGroups.size(); i++) {
+        const struct bankgroup &g = bankGroups.group(i);
+        banks.string(g.name);
+        banks.varint(g.size);
+        banks.labels(g.sharedLabels);
+    }
+    sections.append(qMakePair((quint32) SECTION_BANKGROUPS, banks.buffer));
+
+    QSet<QPair<qint32, quint64>> stored;        // group and offset
+
+    for (const auto &s : qAsConst(segments)) {
+        SectionEncoder enc(&pool);
+        quint64 offset = bankGroups.offset(s);
+        quint64 length = s.end - s.start + 1;
+
+        // banks with identical contents share their backing, store it once
+
+        bool store = s.bankGroup == BANKGROUP_NONE ||
+                     !stored.contains(qMakePair(s.bankGroup, offset));
+        stored.insert(qMakePair(s.bankGroup, offset));
+
+        enc.varint(s.start);
+        enc.varint(s.end);
+        enc.string(s.name);
+        enc.varint(s.bankGroup + 1);
+        enc.varint(s.bank);
+        enc.varint(offset);
+        enc.varint(store);
+
+        if (store) {
+            enc.bytes(s.data, length);
+            enc.plane(s.datatypes, length);
+            enc.plane(s.flags, length);
+
+            QMap<quint64, quint16> constants;
+            for (quint64 j = 0; j < length; j++)
+                if (s.flags[j] == FLAG_CONSTANT && s.constants[j])
+                    constants.insert(constants.constEnd(), j, s.constants[j]);
+            enc.words(constants);
+        }
+
+        enc.labels(s.comments);
+        enc.labels(s.localLabels);
+        enc.words(s.lowbytes);
+        enc.words(s.highbytes);
+        sections.append(qMakePair((quint32) SECTION_SEGMENT, enc.buffer));
+    }
+
+    SectionEncoder globals(&pool);
+    globals.labels(globalLabels);
+    globals.string(globalNotes);
+    sections.append(qMakePair((quint32) SECTION_GLOBALS, globals.buffer));
+
+    SectionEncoder constants(&pool);
+    constants.varint(constantsGroups.size());
+    for (quint16 groupID : constantsGroups.ids()) {
+        const ConstantsGroup *group = constantsGroups.group(groupID);
+        constants.varint(groupID);
+        constants.string(group->name);
+        constants.labels(group->entries());
+    }
+    sections.append(qMakePair((quint32) SECTION_CONSTANTS, constants.buffer));
+
+    SectionEncoder libraries(&pool);
+    const QStringList names = symbolLibraries.fileNames();
+    libraries.varint(names.size());
+    for (const auto &library : names)
+        libraries.string(library);
+    sections.append(qMakePair((quint32) SECTION_LIBRARIES, libraries.buffer));
+
+    SectionEncoder strings(&pool);
+    pool.encode(strings);
+
+    if (!writeSection(file, SECTION_STRINGS, strings.buffer))
+        return false;
+    for (const auto &section : qAsConst(sections)) {
+        if (!writeSection(file, section.first, section.second))
+            return false;
+    }
+    return writeSection(file, SECTION_END, QByteArray());
+}
+
 void save_project(QWidget *widget) {
     QString name = QFileDialog::getSaveFileName(widget, QStringLiteral("Save project as..."));
 
@@ -161,61 +443,31 @@ void save_project(QWidget *widget) {
         return;
     }
 
+    ProfileScope scope("save_project");
     QDataStream out(&file);
 
     out.writeRawData(magic, 5);
-    out << (quint8) FRIDA_FILE_FORMAT_1;
-
-    out.setVersion(QDataStream::Qt_5_15);
-
-    out << cputype;
-
-    qint32 numsegments = segments.size();
-
-    out << numsegments;
-
-    for (int i=0; i<numsegments; i++) {
-        struct segment *s = &segments[i];
-
-        out << s->start << s->end << s->name;
-
-        quint64 length = s->end - s->start + 1;
+    out << (quint8) FRIDA_FILE_FORMAT_2;
 
-        out.writeRawData((const char *) s->data,      length);
-        out.writeRawData((const char *) s->datatypes, length);
-        out.writeRawData((const char *) s->flags,     length);
-
-        out << s->comments;
-        out << s->localLabels;
-        out << s->lowbytes;
-        out << s->highbytes;
-    }
-
-    out << globalLabels;
-    out << globalNotes;
-    out << altfont;
-
-    quint64 numGroups = constantsGroups.size();
-
-    out << numGroups;
-
-    QMap<quint64, struct constantsGroup>::iterator iter;
-
-    for (iter = constantsGroups.begin(); iter != constantsGroups.end(); ++iter) {
-        auto const &group = iter.value();
-        out << group.name;
-        out << *group.map;
-    }
+    bool written = save_sections(file);
 
     error = file.error();
     errorstring = file.errorString();
 
+    if (!written && error == file.NoError) {
+        error = QFile::WriteError;
+        errorstring = QStringLiteral("Unable to compress the project");
+    }
+
+    scope.count(PC_BYTES, file.pos());
     file.close();
+    scope.stop();
 
     if (error != file.NoError) {
         msg.setText("Failed to save " + name + "\n\n" + errorstring);
         msg.exec();
     } else {
+        listingCache.setDirectory(name + QStringLiteral(".cache"));
         msg.setText("Succesfully saved " + name + "\n");
         msg.exec();
     }
@@ -26,6 +26,8 @@
 #include "pch.h"
 
 extern bool load_project(QWidget *widget);
+extern bool load_project_file(const QString &name, QString *failed);
+extern bool is_project_file(const QString &name);
 extern void save_project(QWidget *widget);
 
 #endif // LOADSAVEPROJECT_H
@@ -21,7 +21,9 @@
 // ---------------------------------------------------------------------------
 
 #include "disassembler.h"
+#include "listingcache.h"
 #include "mainwindow.h"
+#include "memoryusage.h"
 #include "startdialog.h"
 #include "ui_mainwindow.h"
 
@@ -87,15 +89,44 @@ int main(int argc, char *argv[])
         settings.setValue(QStringLiteral("Mode"), "light");
     if (!settings.contains(QStringLiteral("Fullscreen")))
         settings.setValue(QStringLiteral("Fullscreen"), "off");
+    if (!settings.contains(QStringLiteral("ListingCacheLimit")))
+        settings.setValue(QStringLiteral("ListingCacheLimit"), LISTING_CACHE_LIMIT);
     settings.sync();
 
+    listingCache.setLimit(settings.value(QStringLiteral("ListingCacheLimit"))
+                                            .toULongLong() * 1024 * 1024);
+
     if (settings.value(QStringLiteral("Mode")) == "dark")
         QApplication::setPalette(dark_palette);
     else
         QApplication::setPalette(light_palette);
 
     StartDialog startdialog;
-    startdialog.exec();
+
+    // a file on the command line is opened right away, a project as it is,
+    // anything else as a new project of the type the loaders detect. With --memory, all segments
+    // are disassembled and the memory use is printed instead.
+
+    QStringList arguments = QApplication::arguments();
+    bool memory = arguments.size() > 1 && arguments.at(1) == QLatin1String("--memory");
+
+    if (memory) {
+        arguments.removeAt(1);
+        if (arguments.size() < 2) {
+            QTextStream(stderr) << "usage: frida --memory file\n";
+            return 1;
+        }
+    }
+
+    if (arguments.size() > 1) {
+        QString error;
+        if (!startdialog.openFile(arguments.at(1), &error)) {
+            QTextStream(stderr) << error << "\n";
+            return 1;
+        }
+    } else {
+        startdialog.exec();
+    }
 
     if (!startdialog.create_new_project && !startdialog.load_existing_project)
         return 0;
@@ -123,6 +154,15 @@ int main(int argc, char *argv[])
 
     Disassembler->cputype = cputype;        // be able to detect variants
 
+    if (memory) {
+        for (currentSegment = 0; currentSegment < segments.size(); currentSegment++)
+            Disassembler->generateDisassembly(true);
+        currentSegment = 0;
+
+        QTextStream(stdout) << memoryReport(memoryUsage({}));
+        return 0;
+    }
+
     MainWindow mainwindow;
     mainwindow.show();
 
@@ -21,18 +21,32 @@
 // ---------------------------------------------------------------------------
 
 #include "addlabelwindow.h"
+#include "addresspairs.h"
+#include "annotations.h"
+#include "banks.h"
+#include "callgraph.h"
 #include "changesegmentwindow.h"
 #include "commentwindow.h"
+#include "constants.h"
 #include "constantsmanager.h"
 #include "disassembler.h"
+#include "emulator.h"
 #include "exportassembly.h"
+#include "flowgraph.h"
 #include "jumptowindow.h"
 #include "labelswindow.h"
+#include "listingcache.h"
 #include "loadsaveproject.h"
 #include "lowandhighbytepairswindow.h"
 #include "lowhighbytewindow.h"
 #include "mainwindow.h"
+#include "memoryusage.h"
+#include "portproject.h"
+#include "profiler.h"
+#include "searchindex.h"
+#include "signatures.h"
 #include "selectconstantsgoupwindow.h"
+#include "symbollibrary.h"
 #include "ui_mainwindow.h"
 
 bool generateLocalLabels = true;
@@ -120,6 +134,8 @@ MainWindow::MainWindow(QWidget *parent) :
             this, &MainWindow::onCheckDark_toggled);
     connect(ui->checkFullscreen, &QCheckBox::toggled,
             this, &MainWindow::onCheckFullscreen_toggled);
+    connect(ui->checkProfile, &QCheckBox::toggled,
+            this, &MainWindow::onCheckProfile_toggled);
 
     connect(ui->tableSegments, &QTableWidget::itemSelectionChanged,
             this, &MainWindow::onTableSegments_itemSelectionChanged);
@@ -140,10 +156,36 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->inputReference, &QLineEdit::returnPressed,
             this, &MainWindow::onReferences_returnPressed);
 
+    // the profile dock only shows when asked for
+
+    ui->dockProfile->hide();
+    ui->tableProfile->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    ui->tableMemory->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    connect(ui->dockProfile, &QDockWidget::visibilityChanged,
+            ui->checkProfile, &QCheckBox::setChecked);
+    connect(ui->profileResetButton, &QPushButton::clicked,
+            this, &MainWindow::onProfileResetButton_clicked);
+    connect(ui->profileTraceButton, &QPushButton::clicked,
+            this, &MainWindow::onProfileTraceButton_clicked);
+    connect(&profileTimer, &QTimer::timeout,
+            this, &MainWindow::showProfile);
+    connect(ui->tabsProfile, &QTabWidget::currentChanged,
+            this, &MainWindow::onTabsProfile_currentChanged);
+
+    ui->spinListingLimit->setValue(listingCache.limit() / (1024 * 1024));
+    connect(ui->spinListingLimit, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &MainWindow::onSpinListingLimit_valueChanged);
+
     t = ui->tableSegments;
     t->horizontalHeader()->setSectionsClickable(false);
+    t->horizontalHeader()->setSectionResizeMode(2, QHeaderView::Stretch);
     t->addAction(ui->actionDelete_Segment);
     t->addAction(ui->actionChange_Start_Address);
+    t->addAction(ui->actionPort_Segment);
+    t->addAction(ui->actionApply_Signatures);
+    t->addAction(ui->actionSave_Flow_Graph);
+    t->addAction(ui->actionFind_Subroutines);
+    t->addAction(ui->actionResolve_Address_Pairs);
     showSegments();
 
     // create context menus for tableHexadecimal and tableASCII
@@ -158,6 +200,8 @@ MainWindow::MainWindow(QWidget *parent) :
         t->setRowCount(0);
 
         t->addAction(ui->actionTrace);
+        t->addAction(ui->actionEmulate);
+        t->addAction(ui->actionSelect_Matches);
         t->addAction(ui->actionSet_To_Byte);
         t->addAction(ui->actionSet_To_Undefined);
         t->addAction(ui->actionSet_To_Code);
@@ -336,6 +380,10 @@ void MainWindow::showSegments(void) {
 
         item = new QTableWidgetItem(s->name);
         t->setItem(i,2, item);
+
+        item = new QTableWidgetItem(bankGroups.describe(*s));
+        item->setFlags(item->flags() & ~Qt::ItemIsEditable);
+        t->setItem(i,3, item);
     }
 }
 
@@ -371,6 +419,8 @@ void MainWindow::actionDelete_Segment() {
     if (!msg.exec()) return;
 
     segments.removeAt(cur);
+    searchIndex.clear();
+    byteMatches.clear();
     if (cur) cur--;
     showSegments();
     ui->tableSegments->selectRow(cur);
@@ -389,11 +439,257 @@ void MainWindow::actionChange_Start_Address() {
         if (!diff) return;
         segments[cur].start += diff;
         segments[cur].end   += diff;
+        searchIndex.clear();
         showSegments();
         ui->tableSegments->selectRow(cur);
     }
 }
 
+// Load a new revision of the binary into the segment and move all labels,
+// comments and datatypes to where their bytes ended up. What could not be
+// matched is listed in the references table.
+
+void MainWindow::actionPort_Segment() {
+    QTableWidget *t = ui->tableSegments;
+    QTableWidget *r = ui->tableReferences;
+    int cur = currentSegment;
+    struct portresult result;
+
+    if (!t->hasFocus()) return;
+
+    QString filename = QFileDialog::getOpenFileName(this,
+                                    QStringLiteral("Port segment to new binary"));
+    if (filename.isEmpty())
+        return;
+
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QMessageBox::warning(this, QStringLiteral("Port"),
+                             QStringLiteral("Unable to open ") + filename);
+        return;
+    }
+    QByteArray image = file.readAll();
+    file.close();
+
+    if (image.isEmpty())
+        return;
+
+    Disassembler->generateDisassembly(generateLocalLabels);
+    portSegment(cur, image, &result);
+
+    searchIndex.clear();
+    byteMatches.clear();
+
+    r->setRowCount(0);
+    r->verticalHeader()->setDefaultAlignment(Qt::AlignRight);
+    r->setColumnWidth(0,32);
+
+    for (const auto &region : qAsConst(result.unmatchedNew)) {
+        QString line = QStringLiteral("new, no match: %1 bytes")
+                                    .arg(region.end - region.start + 1);
+        addRefEntry(r, cur, region.start, line, QString());
+    }
+    for (const auto &region : qAsConst(result.unmatchedOld)) {
+        QString line = QStringLiteral("old %1-%2 not found")
+                                    .arg(region.start, 4, 16, QChar('0'))
+                                    .arg(region.end, 4, 16, QChar('0'));
+        addRefEntry(r, cur, region.position, line, QString());
+    }
+    for (const auto &collision : qAsConst(result.collisions)) {
+        QString line = QStringLiteral("label %1 replaces %2")
+                                    .arg(collision.kept, collision.lost);
+        addRefEntry(r, cur, collision.address, line, collision.lost);
+    }
+
+    QMessageBox::information(this, QStringLiteral("Port"),
+        QStringLiteral("%1 bytes matched, %2 labels and %3 comments carried over, "
+                       "%4 annotations dropped, %5 label collisions")
+            .arg(result.matched).arg(result.labels).arg(result.comments)
+            .arg(result.dropped).arg(result.collisions.size()));
+
+    showSegments();
+    ui->tableSegments->selectRow(cur);
+    Disassembler->generateDisassembly(generateLocalLabels);
+    showHex();
+    showAscii();
+    showDisassembly();
+}
+
+// Generates the listing of each segment in turn and runs pass on it, with
+// the segment current. Only one listing is needed at a time, so the
+// listing cache may drop the others as it goes.
+
+void MainWindow::forEachSegment(const std::function<void(int)> &pass) {
+    int saveCurrent = currentSegment;
+
+    for (int i=0; i<segments.size(); i++) {
+        currentSegment = i;
+        Disassembler->generateDisassembly(generateLocalLabels);
+        pass(i);
+    }
+    currentSegment = saveCurrent;
+}
+
+// Returns the number of labels added, or -1 on error
+
+int MainWindow::applySignatures(const QStringList &files, QString *error) {
+    QVector<struct signaturecode> code(segments.size());
+
+    signatureLibrary.clear();
+    for (const auto &file : files)
+        if (!signatureLibrary.load(file, error))
+            return -1;
+
+    if (!signatureLibrary.size())
+        return 0;
+
+    // the code of each segment is collected while its listing is at hand,
+    // then all segments are scanned in one parallel pass
+
+    forEachSegment([&code](int segment) {
+        signatureLibrary.collect(segment, code[segment]);
+    });
+    const QVector<struct signaturehit> hits = signatureLibrary.scan(code);
+
+    int added = signatureLibrary.apply(hits, generateLocalLabels);
+    if (added)
+        searchIndex.invalidate();
+    return added;
+}
+
+void MainWindow::actionApply_Signatures() {
+    QString error;
+
+    // the dialog starts where the signature files were picked last time
+
+    const QStringList last = settings.value(QStringLiteral("SignatureFiles"))
+                                                            .toStringList();
+    const QStringList files = QFileDialog::getOpenFileNames(this,
+                                    QStringLiteral("Select signature files"),
+                                    last.isEmpty() ? QString() : QFileInfo(last.first()).path(),
+                                    QStringLiteral("Signatures (*.signatures)"));
+    if (files.isEmpty())
+        return;
+
+    settings.setValue(QStringLiteral("SignatureFiles"), files);
+
+    int added = applySignatures(files, &error);
+    if (added < 0) {
+        QMessageBox::warning(this, QStringLiteral("Signatures"), error);
+        return;
+    }
+
+    QMessageBox::information(this, QStringLiteral("Signatures"),
+                QStringLiteral("%1 signatures, %2 routines labelled")
+                .arg(signatureLibrary.size()).arg(added));
+
+    Disassembler->generateDisassembly(generateLocalLabels);
+    showDisassembly();
+}
+
+// Graphviz source of the basic blocks of the current segment, to be shown
+// by dot or any other graph viewer
+
+void MainWindow::actionSave_Flow_Graph() {
+    struct segment *s = &segments[currentSegment];
+
+    Disassembler->generateDisassembly(generateLocalLabels);
+
+    if (!s->flow) return;       // the datatypes check failed
+
+    QString name = QFileDialog::getSaveFileName(this,
+                        QStringLiteral("Save Flow Graph As..."), QString(),
+                        QStringLiteral("Graphviz (*.dot *.gv)"));
+
+    if (name.isEmpty()) return;
+
+    QFile file(name);
+
+    if (!file.open(QIODevice::WriteOnly) ||
+            file.write(s->flow->dot(*s).toUtf8()) < 0) {
+        QMessageBox::warning(this, QStringLiteral("Save Flow Graph"),
+                    QStringLiteral("Failed to save ") + name + "\n\n" + file.errorString());
+        return;
+    }
+
+    QMessageBox::information(this, QStringLiteral("Save Flow Graph"),
+                QStringLiteral("%1 blocks, %2 edges, %3 unresolved jumps")
+                .arg(s->flow->size()).arg(s->flow->edgeCount())
+                .arg(s->flow->unresolved().size()));
+}
+
+// Derives the subroutines of all segments, names the ones without a label
+// and lists them with their callers and callees
+
+void MainWindow::actionFind_Subroutines() {
+    QTableWidget *r = ui->tableReferences;
+
+    // call targets of all segments first, they may be in another one
+
+    forEachSegment([](int segment) {
+        callGraph.addCalls(segment);
+    });
+    forEachSegment([](int segment) {
+        callGraph.addRoutines(segment);
+    });
+    callGraph.link();
+
+    int named = callGraph.nameRoutines(generateLocalLabels);
+    if (named)
+        searchIndex.invalidate();
+
+    r->setRowCount(0);
+    r->verticalHeader()->setDefaultAlignment(Qt::AlignRight);
+    r->setColumnWidth(0,32);
+
+    for (int i = 0; i < callGraph.size(); i++) {
+        const struct routine &routine = callGraph.routine(i);
+        const struct segment &s = segments.at(routine.segment);
+        QString name = s.localLabels.value(routine.entry);
+
+        if (name.isEmpty())
+            name = globalLabels.value(routine.entry);
+        if (name.isEmpty())
+            name = symbolLibraries.value(routine.entry);
+
+        QString line = QStringLiteral("%1: %2 callers, %3 callees%4")
+                            .arg(name).arg(routine.callers.size())
+                            .arg(routine.callees.size())
+                            .arg(routine.called ? QString() : QStringLiteral(", not called"));
+        addRefEntry(r, routine.segment, routine.entry, line, name);
+    }
+
+    QMessageBox::information(this, QStringLiteral("Subroutines"),
+                QStringLiteral("%1 subroutines, %2 named")
+                .arg(callGraph.size()).arg(named));
+
+    Disassembler->generateDisassembly(generateLocalLabels);
+    showDisassembly();
+}
+
+// Follows immediates through registers into memory and flags the low and
+// high byte pairs and pointers it finds in all segments
+
+void MainWindow::actionResolve_Address_Pairs() {
+    struct addresspairresult result = { 0, 0, 0 };
+
+    forEachSegment([&result](int) {
+        resolveAddressPairs(generateLocalLabels, &result);
+    });
+
+    if (result.pairs || result.pointers)
+        searchIndex.invalidate();
+
+    QMessageBox::information(this, QStringLiteral("Address Pairs"),
+                QStringLiteral("%1 address pairs, %2 pointers, %3 labels")
+                .arg(result.pairs).arg(result.pointers).arg(result.labels));
+
+    Disassembler->generateDisassembly(generateLocalLabels);
+    showHex();
+    showAscii();
+    showDisassembly();
+}
+
 void MainWindow::onTableSegments_cellChanged(int row, int column) {
     QTableWidget *t = ui->tableSegments;
 
@@ -407,6 +703,7 @@ void MainWindow::onTableSegments_cellChanged(int row, int column) {
 // RENDER HEX
 
 void MainWindow::showHex(void) {
+    ProfileScope scope("showHex");
     const struct segment *s = &segments.at(currentSegment);
     QTableWidget *t = ui->tableHexadecimal;
 
@@ -414,6 +711,7 @@ void MainWindow::showHex(void) {
     t->verticalHeader()->setDefaultAlignment(Qt::AlignRight);
 
     qint64 size = s->end - s->start + 1;
+    scope.count(PC_BYTES, size);
 
     t->setRowCount(size/8+(size%8?1:0));
 
@@ -442,6 +740,7 @@ void MainWindow::showHex(void) {
 // RENDER ASCII
 
 void MainWindow::showAscii(void) {
+    ProfileScope scope("showAscii");
     const struct segment *s = &segments.at(currentSegment);
     QTableWidget *t = ui->tableASCII;
     QFont font;
@@ -460,6 +759,7 @@ void MainWindow::showAscii(void) {
     t->verticalHeader()->setDefaultAlignment(Qt::AlignRight);
 
     qint64 size = s->end - s->start + 1;
+    scope.count(PC_BYTES, size);
 
     t->setRowCount(size/8+(size%8?1:0));
 
@@ -681,7 +981,10 @@ void MainWindow::actionSet_Flag_Constant_Value(void) {
     if (scgw.exec() != QDialog::Accepted)
         return;
 
-    quint64 groupID = scgw.groupID;
+    quint16 groupID = scgw.groupID;
+
+    if (groupID == CONSTANTS_GROUP_NONE)
+        return;
 
     struct segment *s = &segments[currentSegment];
 
@@ -690,10 +993,9 @@ void MainWindow::actionSet_Flag_Constant_Value(void) {
             for (int y = range.topRow(); y <= range.bottomRow(); y++) {
 
                 int relpos = y*8 + x;
-                quint64 address = s->start + relpos;
 
                 s->flags[relpos] = FLAG_CONSTANT;
-                s->constants.insert(address, groupID);
+                s->constants[relpos] = groupID;
 
             }
         }
@@ -709,32 +1011,52 @@ void MainWindow::actionSet_Flag_Constant_Value(void) {
 // RENDER DISASSEMBLY
 
 void MainWindow::showDisassembly(void) {
+    ProfileScope scope("showDisassembly");
     struct segment *s = &segments[currentSegment];
 //    quint64 start = s->start, end = s->end, size = end - start + 1;
     QTableWidget *t = ui->tableDisassembly;
     QList<struct disassembly> *dislist  = &s->disassembly;
     QMap<quint64, QString> *comments     = &s->comments;
+    AnnotationCursor annotation(s->annotations);
     QTableWidgetItem *item;
     struct disassembly dis;
     QString com;
+    QString label;
+    quint8 kinds;
     int row;
     bool zero_comment_done = false;
 
     t->setRowCount(0);
     t->verticalHeader()->setDefaultAlignment(Qt::AlignRight);
 
+    rowAddresses.clear();
+    rowNumbers.clear();
+    rowAddresses.reserve(dislist->size());
+    rowNumbers.reserve(dislist->size());
+
     qint64 di = 0;
     while (di < dislist->size()) {
         dis = dislist->at(di);
 
-        if (comments->contains(dis.address)) {
+        // the .org line shows the comment at address 0, if any
+
+        kinds = 0;
+        if (!di) {
+            com = comments->value(dis.address);
+            if (!com.isEmpty())
+                kinds = ANNOTATION_COMMENT;
+        } else if (dis.address >= s->start && annotation.at(dis.address - s->start)) {
+            kinds = annotation.kinds();
+            com = annotation.comment();
+            label = annotation.label();
+        }
+
+        if (kinds & ANNOTATION_COMMENT) {
             if (dis.address == 0 && zero_comment_done)
                 goto skip_comment;
             if (dis.address == 0)
                 zero_comment_done = true; // no double comments for raw files
 
-            com = comments->value(dis.address);
-
             row = t->rowCount();
             t->setRowCount(row+1);
             QString hex = QStringLiteral("%1").arg(dis.address, 0, 16, (QChar)'0');
@@ -758,14 +1080,12 @@ void MainWindow::showDisassembly(void) {
 
         skip_comment:
 
-        if (dis.address && (globalLabels.contains(dis.address)
-            || s->localLabels.contains(dis.address))) {
+        if (di) {
+            rowAddresses.append(dis.address);
+            rowNumbers.append(t->rowCount());
+        }
 
-            QString label;
-            if (s->localLabels.contains(dis.address))
-                label = s->localLabels.value(dis.address);
-            else
-                label = globalLabels.value(dis.address);
+        if (dis.address && kinds & ANNOTATION_LABEL) {
 
             // we do not print labels with + or -
 
@@ -777,7 +1097,7 @@ void MainWindow::showDisassembly(void) {
 
                 t->setSpan(row,0,1,3);
                 t->setItem(row, 0, new QTableWidgetItem(label));
-                if (s->localLabels.contains(dis.address))
+                if (kinds & ANNOTATION_LOCAL)
                     t->item(row,0)->setForeground(Qt::darkCyan);
                 else
                     t->item(row,0)->setForeground(Qt::darkMagenta);
@@ -817,6 +1137,8 @@ void MainWindow::showDisassembly(void) {
 
         di++;
     }
+
+    scope.count(PC_LINES, t->rowCount());
 }
 
 // --------------------------------------------------------------------------
@@ -845,17 +1167,11 @@ void MainWindow::linkASCIIHexSelection() {
 // Used same function for both Hex and Ascii Sections
 
 void MainWindow::onHexSectionClicked(int index) {
-    QTableWidget *th = ui->tableHexadecimal;
     QTableWidget *td = ui->tableDisassembly;
-    QString s = th->verticalHeaderItem(index)->text();
-    int n = td->rowCount();
+    int row = rowOfAddress(segments[currentSegment].start + index * 8);
 
-    for (int i=0; i<n; i++) {
-        if (td->verticalHeaderItem(i)->text().toULongLong(nullptr,16) < s.toULongLong(nullptr,16))
-            continue;
-        td->scrollToItem(td->item(i,0), QAbstractItemView::PositionAtCenter);
-        break;
-    }
+    if (row >= 0)
+        td->scrollToItem(td->item(row,0), QAbstractItemView::PositionAtCenter);
 }
 
 // --------------------------------------------------------------------------
@@ -879,7 +1195,101 @@ void MainWindow::actionTrace(void) {
     int pos = y*8 + x;
     pos += segments[currentSegment].start;
 
+    ProfileScope scope("trace");
     Disassembler->trace(pos);
+    scope.stop();
+
+    searchIndex.invalidate();
+    Disassembler->generateDisassembly(generateLocalLabels);
+    showHex();
+    showAscii();
+    showDisassembly();
+}
+
+// --------------------------------------------------------------------------
+// EMULATE
+
+void MainWindow::actionEmulate(void) {
+    QTableWidget *t = ui->tableHexadecimal;
+    QList<QTableWidgetSelectionRange> Ranges = t->selectedRanges();
+    int x = INT_MAX;
+    int y = INT_MAX;
+
+    if (Ranges.isEmpty())
+        return;
+
+    for (const auto & range : Ranges) {
+        if (range.topRow() < y)
+            y = range.topRow();
+        if (range.leftColumn() < x)
+            x = range.leftColumn();
+    }
+    quint64 entry = y*8 + x;
+    entry += segments[currentSegment].start;
+
+    if (entry > 0xffff)
+        return;
+
+    Emulator *emu = createEmulator(cputype);
+    if (!emu) {
+        QMessageBox::warning(this, QStringLiteral("Emulate"),
+                    QStringLiteral("Emulation is not supported for this CPU type"));
+        return;
+    }
+
+    bool ok;
+    int budget = QInputDialog::getInt(this, QStringLiteral("Emulate"),
+                    QStringLiteral("Maximum number of cycles:"),
+                    settings.value(QStringLiteral("EmulatorCycles"), 10000000).toInt(),
+                    1000, INT_MAX, 1000000, &ok);
+    if (!ok) {
+        delete emu;
+        return;
+    }
+    settings.setValue(QStringLiteral("EmulatorCycles"), budget);
+    settings.sync();
+
+    emu->loadMemoryImage(currentSegment);
+
+    // CP/M programs start at $0100 and need BDOS
+
+    auto *z80 = dynamic_cast<EmulatorZ80 *>(emu);
+    if (z80 && entry == 0x0100)
+        z80->enableCPM();
+
+    quint64 cycles = emu->run(entry, budget);
+
+    // Music files (SAP, PSID, NSF) have an init and a play routine. After
+    // init returns, call play once per frame until the budget runs out.
+
+    int frames = 0;
+    QList<quint64> play = globalLabels.keys(QStringLiteral("play"));
+
+    if (emu->returned && globalLabels.value(entry) == QLatin1String("init")
+            && !play.isEmpty() && play.first() <= 0xffff) {
+        while (cycles < (quint64) budget) {
+            cycles += emu->run(play.first(), budget - cycles);
+            if (!emu->returned)
+                break;
+            frames++;
+        }
+    }
+
+    emu->applyCoverage(generateLocalLabels);
+
+    QString msg = QStringLiteral("%1 instructions, %2 cycles").arg(emu->instructions).arg(cycles);
+    if (frames)
+        msg += QStringLiteral(", %1 calls to play").arg(frames);
+    msg += QStringLiteral("\nStopped: %1\n").arg(emu->stop_reason);
+    msg += QStringLiteral("%1 bytes marked as code, %2 as data, %3 labels added")
+            .arg(emu->codeBytes).arg(emu->dataBytes).arg(emu->labelsAdded);
+    if (!emu->console.isEmpty())
+        msg += QStringLiteral("\n\nConsole output:\n") + emu->console.left(2000);
+    delete emu;
+
+    QMessageBox::information(this, QStringLiteral("Emulate"), msg);
+
+    searchIndex.invalidate();
     Disassembler->generateDisassembly(generateLocalLabels);
     showHex();
     showAscii();
@@ -910,6 +1320,8 @@ void MainWindow::actionComment() {
         segments[currentSegment].comments.remove(a);
     else
         segments[currentSegment].comments.insert(a, c);
+    searchIndex.invalidate(currentSegment);
+    Disassembler->generateDisassembly(generateLocalLabels);
     showDisassembly();
 }
 
@@ -919,6 +1331,7 @@ void MainWindow::actionComment() {
 void MainWindow::onConstantsButton_clicked() {
     constantsManager cm;
     cm.exec();
+    searchIndex.invalidate();
     Disassembler->generateDisassembly(generateLocalLabels);
     showHex();
     showAscii();
@@ -928,6 +1341,7 @@ void MainWindow::onConstantsButton_clicked() {
 void MainWindow::onLabelsButton_clicked() {
     labelswindow lw;
     lw.exec();
+    searchIndex.invalidate();
     Disassembler->generateDisassembly(generateLocalLabels);
     showHex();
     showAscii();
@@ -956,6 +1370,7 @@ void MainWindow::onExportAsmButton_clicked() {
 void MainWindow::actionAdd_Label(void) {
     addLabelWindow alw;
     alw.exec();
+    searchIndex.invalidate();
     Disassembler->generateDisassembly(generateLocalLabels);
     showDisassembly();
 }
@@ -989,6 +1404,117 @@ void MainWindow::onCheckFullscreen_toggled() {
     settings.sync();
 }
 
+// ----------------------------------------------------------------------------
+// PROFILE
+
+void MainWindow::onCheckProfile_toggled() {
+    if (ui->checkProfile->isChecked()) {
+        ui->dockProfile->show();
+        profileShown = 0;
+        showProfile();
+        profileTimer.start(500);
+    } else {
+        ui->dockProfile->hide();
+        profileTimer.stop();
+    }
+}
+
+void MainWindow::showProfile(void) {
+    if (profiler.generation() == profileShown && profileShown)
+        return;
+    profileShown = profiler.generation();
+
+    if (ui->tabsProfile->currentWidget() == ui->tabMemory) {
+        showMemory();
+        return;
+    }
+
+    QTableWidget *t = ui->tableProfile;
+    const QMap<QByteArray, struct profilestats> &stats = profiler.stats();
+    int row = 0;
+
+    t->setRowCount(stats.size());
+
+    for (auto it = stats.constBegin(); it != stats.constEnd(); ++it, row++) {
+        const struct profilestats &ps = it.value();
+        QString values[7] = {
+            QString::fromLatin1(it.key()),
+            QString::number(ps.calls),
+            QString::number(ps.total / 1e6, 'f', 2),
+            QString::number(ps.max / 1e6, 'f', 2),
+            QString::number(ps.counters[PC_BYTES]),
+            QString::number(ps.counters[PC_LINES]),
+            QString::number(ps.counters[PC_ALLOCATIONS]),
+        };
+
+        for (int c = 0; c < 7; c++) {
+            auto *item = new QTableWidgetItem(values[c]);
+            if (c)
+                item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            t->setItem(row, c, item);
+        }
+    }
+}
+
+// walks all maps and table items, only while the memory tab is shown
+
+void MainWindow::showMemory(void) {
+    QTableWidget *t = ui->tableMemory;
+    const QVector<struct memoryusage> usage = memoryUsage({
+                        ui->tableSegments, ui->tableHexadecimal, ui->tableASCII,
+                        ui->tableDisassembly, ui->tableReferences,
+                        ui->tableProfile });
+    struct memoryusage sum = { QStringLiteral("Total"), {} };
+
+    for (const auto &u : usage)
+        for (int k = 0; k < MK_LAST; k++)
+            sum.bytes[k] += u.bytes[k];
+
+    t->setRowCount(usage.size() + 1);
+
+    for (int row = 0; row <= usage.size(); row++) {
+        const struct memoryusage &u = row < usage.size() ? usage.at(row) : sum;
+
+        t->setItem(row, 0, new QTableWidgetItem(u.name));
+        for (int k = 0; k <= MK_LAST; k++) {
+            quint64 bytes = k < MK_LAST ? u.bytes[k] : u.total();
+            auto *item = new QTableWidgetItem(QString::number(bytes));
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            t->setItem(row, k + 1, item);
+        }
+    }
+}
+
+void MainWindow::onSpinListingLimit_valueChanged(int mib) {
+    listingCache.setLimit((quint64) mib * 1024 * 1024);
+    settings.setValue(QStringLiteral("ListingCacheLimit"), mib);
+    settings.sync();
+}
+
+void MainWindow::onTabsProfile_currentChanged() {
+    profileShown = 0;
+    showProfile();
+}
+
+void MainWindow::onProfileResetButton_clicked() {
+    profiler.reset();
+    profileShown = 0;
+    showProfile();
+}
+
+void MainWindow::onProfileTraceButton_clicked() {
+    QString name = QFileDialog::getSaveFileName(this,
+                        QStringLiteral("Save Trace As..."), QString(),
+                        QStringLiteral("Trace Events (*.json)"));
+
+    if (name.isEmpty()) return;
+
+    QString error;
+    if (!profiler.writeTrace(name, &error))
+        QMessageBox::warning(this, QStringLiteral("Save Trace"),
+                             QStringLiteral("Failed to save ") + name + "\n\n" + error);
+}
+
 // ----------------------------------------------------------------------------
 // TABLE DISASSEMBLY
 
@@ -1017,17 +1543,21 @@ void MainWindow::onTableDisassembly_cellChanged(int row, int column) {
 
         if (txt.isEmpty())
             txt = globalLabels.value(address);
+        if (txt.isEmpty())
+            txt = symbolLibraries.value(address);
 
         t->item(row,column)->setText(txt);
 
         return;
     }
 
-    if (s->localLabels.contains(address))
+    if (s->localLabels.contains(address)) {
         s->localLabels.insert(address, label);
-    else if (globalLabels.contains(address))
+        bankGroups.renameLabel(s->bankGroup, address, label);
+    } else              // renaming a library label overrides it
         globalLabels.insert(address,label);
 
+    searchIndex.invalidate();
     Disassembler->generateDisassembly(generateLocalLabels);
     showDisassembly();
 }
@@ -1036,16 +1566,12 @@ void MainWindow::onDisassemblySectionClicked(int index) {
     QTableWidget *th = ui->tableHexadecimal;
     QTableWidget *td = ui->tableDisassembly;
     QString s = td->verticalHeaderItem(index)->text();
-    int n = th->rowCount();
+    quint64 a = s.toULongLong(nullptr,16);
 
-    for (int i=0; i<n; i++) {
-        if (th->verticalHeaderItem(i)->text().toULongLong(nullptr,16) < s.toULongLong(nullptr,16))
-            continue;
-        th->scrollToItem(th->item(i,0), QAbstractItemView::PositionAtCenter);
-        break;
-    }
+    if (a >= segments[currentSegment].start && a <= segments[currentSegment].end)
+        th->scrollToItem(th->item((a - segments[currentSegment].start) / 8, 0),
+                         QAbstractItemView::PositionAtCenter);
 
-    quint64 a = s.toULongLong(nullptr,16);
     quint64 row;
     quint64 column;
     a -= segments[currentSegment].start;
@@ -1165,10 +1691,13 @@ void MainWindow::onTableDisassembly_doubleClicked(const QModelIndex &index) {
         QString hexPrefix = Disassembler->hexPrefix;
         QString hexSuffix = Disassembler->hexSuffix;
 
-        // if no label is found, check for hexPrefixed or hexSuffixed address
+        // if no label is found, check the symbol libraries and then for
+        // a hexPrefixed or hexSuffixed address
 
         if (iter == globalLabels.constEnd()) {
-            if (!hexPrefix.isEmpty() && operand.left(hexPrefix.size()) == hexPrefix) {
+            if (symbolLibraries.address(operand, &addr)) {
+                // found
+            } else if (!hexPrefix.isEmpty() && operand.left(hexPrefix.size()) == hexPrefix) {
                 operand = operand.mid(hexPrefix.size());
                 addr = operand.toULongLong(nullptr,16);
             } else if (!hexSuffix.isEmpty() && operand.right(hexSuffix.size()) == hexSuffix) {
@@ -1222,31 +1751,37 @@ void MainWindow::closeEvent (QCloseEvent *event)
 
 void MainWindow::jumpToSegmentAndAddress(quint64 segment, quint64 address) {
 
-    // jump to segment and scroll disassembly to the right place
+    // jump to segment, the selection handler regenerates the listing
+    // right away
 
-    ui->tableSegments->selectRow(segment);
-
-    QCoreApplication::processEvents(QEventLoop::AllEvents); // direct triggers
-    QCoreApplication::processEvents(QEventLoop::AllEvents); // indirect triggers
+    if ((int) segment != currentSegment)
+        ui->tableSegments->selectRow(segment);
 
     // search row and center
 
     QTableWidget *td = ui->tableDisassembly;
+    int row = rowOfAddress(address);
 
-    for (int row = 0; row < td->rowCount(); row++) {
-        if (td->verticalHeaderItem(row)->text().toULongLong(nullptr,16) < address)
-            continue;
+    if (row < 0)
+        return;
 
-        // found row:
-        if (td->item(row,0)->text() == QStringLiteral(";")) row++; // skip comment
-        td->scrollToItem(td->item(row,0), QAbstractItemView::PositionAtCenter);
-        td->clearSelection();   // if segment is the same, clear selected
-        td->clearFocus();       // and focus
-        td->item(row,0)->setSelected(true);
-        td->setCurrentCell(row,0);
-        td->setFocus();
-        break;
-    }
+    td->scrollToItem(td->item(row,0), QAbstractItemView::PositionAtCenter);
+    td->clearSelection();   // if segment is the same, clear selected
+    td->clearFocus();       // and focus
+    td->item(row,0)->setSelected(true);
+    td->setCurrentCell(row,0);
+    td->setFocus();
+}
+
+// Row of the first line at or above address, past its comment, or -1
+
+int MainWindow::rowOfAddress(quint64 address) const {
+    auto it = std::lower_bound(rowAddresses.constBegin(), rowAddresses.constEnd(),
+                               address);
+
+    if (it == rowAddresses.constEnd())
+        return -1;
+    return rowNumbers.at(it - rowAddresses.constBegin());
 }
 
 // ----------------------------------------------------------------------------
@@ -1259,6 +1794,16 @@ void MainWindow::onTableReferences_doubleClicked(const QModelIndex &index) {
 void MainWindow::onReferencesSectionClicked(int row) {
     QTableWidget *t = ui->tableReferences;
 
+    QVariant kind = t->item(row, 0)->data(Qt::UserRole);
+
+    if (kind.isValid() && kind.toInt() == SK_NOTES) {
+        int line = t->verticalHeaderItem(row)->text().toInt(nullptr, 16);
+        QTextBlock block = ui->plainTextEditNotes->document()->findBlockByNumber(line);
+        ui->plainTextEditNotes->setTextCursor(QTextCursor(block));
+        ui->plainTextEditNotes->setFocus();
+        return;
+    }
+
     int segment = t->item(row, 0)->text().toInt(nullptr, 16);
     quint64 address = t->verticalHeaderItem(row)->text().toULongLong(nullptr, 16);
 
@@ -1318,72 +1863,131 @@ void MainWindow::addRefEntry(QTableWidget *t, quint64 segment, quint64 address,
 }
 
 void MainWindow::onFindButton_clicked(void) {
+    ProfileScope scope("onFindButton_clicked");
     int saveCurrent = currentSegment;
     QTableWidget *t = ui->tableReferences;
     QString what = ui->inputReference->text();
-    quint64 address;
+    QString error;
+
+    if (what.isEmpty())
+        return;
 
-    if (what.size() < 3)    // limit search pattern to at least 3 characters
+    if (ui->checkBytes->isChecked()) {
+        findBytes();
         return;
+    }
 
     t->setRowCount(0);
     t->verticalHeader()->setDefaultAlignment(Qt::AlignRight);
     t->setColumnWidth(0,32);
 
-    // first, check if any of the global labels match and if they are defined
-    // in any segment
-
-    QMap<quint64, QString>::const_iterator iter;
-    for(iter = globalLabels.constBegin(); iter != globalLabels.constEnd(); ++iter) {
-        if (iter.value().contains(what)) {
-            address = iter.key();
-            for (int i=0; i<segments.size(); i++) {
-                struct segment *s = &segments[i];
-                if (address >= s->start && address <= s->end) {
-                    const QString& line = iter.value();
-                    addRefEntry(t, i, address, line, what);
-                }
-            }
-            //break;
+    // only regenerate the segments that changed since the last search,
+    // a second pass picks up global labels created by the first one
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i=0; i<segments.size(); i++) {
+            if (!searchIndex.isStale(i))
+                continue;
+            currentSegment = i;
+            Disassembler->generateDisassembly(generateLocalLabels);
         }
     }
+    currentSegment = saveCurrent;
 
-    //second, find local labels in each segment
+    searchIndex.updateNotes(ui->plainTextEditNotes->toPlainText());
 
-    for (int seg = 0; seg < segments.size(); seg ++) {
+    const QList<struct searchhit> hits = searchIndex.find(what,
+                                            ui->checkRegex->isChecked(),
+                                            ui->checkWholeWord->isChecked(),
+                                            &error);
+    if (!error.isEmpty()) {
+        QMessageBox::warning(this, QStringLiteral("Find"), error);
+        return;
+    }
 
-        struct segment *s = &segments[seg];
-        QMap<quint64, QString> *localLabels = &s->localLabels;
+    scope.count(PC_LINES, hits.size());
 
-        for(iter = localLabels->constBegin(); iter != localLabels->constEnd(); ++iter) {
-            if (iter.value().contains(what)) {
-                address = iter.key();
-                if (address >= s->start && address <= s->end) {
-                    const QString& line = iter.value();
-                    addRefEntry(t, seg, address, line, what);
-                    //break;
-                }
-            }
-        }
+    // the kind of hit is kept with the row, notes have a line number
+    // instead of a segment and an address
+
+    for (const auto &hit : hits) {
+        bool notes = hit.kind == SK_NOTES;
+        addRefEntry(t, notes ? 0 : hit.segment, hit.address, hit.line,
+                    hit.highlight);
+
+        QTableWidgetItem *item = t->item(t->rowCount()-1, 0);
+        item->setData(Qt::UserRole, hit.kind);
+        if (notes)
+            item->setText(QStringLiteral("notes"));
     }
+}
 
-    // third, find in disassembly of each segment
+// Matches are added as the search threads deliver them. The table is capped,
+// but all matches are kept for Select Matches.
 
-    for (int i=0; i<segments.size(); i++) {
-        struct segment *s = &segments[i];
+#define MAX_BYTE_MATCH_ROWS 10000
 
-        currentSegment = i;
-        Disassembler->generateDisassembly(generateLocalLabels);
+void MainWindow::findBytes(void) {
+    QTableWidget *t = ui->tableReferences;
+    BytePattern pattern;
+    QString error;
 
-        for (const auto &disitem : qAsConst(s->disassembly)) {
-            if (disitem.arguments.contains(what)) {
-                QString line = disitem.instruction + QStringLiteral(" ") + disitem.arguments;
-                addRefEntry(t, i, disitem.address, line, what);
-            }
-        }
+    if (!pattern.parse(ui->inputReference->text(), &error)) {
+        QMessageBox::warning(this, QStringLiteral("Find Bytes"), error);
+        return;
     }
 
-    currentSegment = saveCurrent;
+    t->setRowCount(0);
+    t->verticalHeader()->setDefaultAlignment(Qt::AlignRight);
+    t->setColumnWidth(0,32);
+
+    byteMatches.clear();
+    byteMatchSize = pattern.size();
+
+    searchSegments(pattern, [&](const struct bytematch &match) {
+        const struct segment *s = &segments.at(match.segment);
+
+        byteMatches.append(match);
+        if (t->rowCount() >= MAX_BYTE_MATCH_ROWS)
+            return true;
+
+        QString line;
+        for (int i = 0; i < byteMatchSize; i++)
+            line += QStringLiteral("%1 ").arg(s->data[match.offset+i], 2, 16, QChar('0'));
+        line.chop(1);
+
+        addRefEntry(t, match.segment, s->start + match.offset, line, line);
+        return true;
+    });
+
+    if (byteMatches.size() > t->rowCount())
+        QMessageBox::information(this, QStringLiteral("Find Bytes"),
+                    QStringLiteral("%1 matches, only the first %2 are listed")
+                    .arg(byteMatches.size()).arg(t->rowCount()));
+}
+
+// Select the bytes of all matches in the current segment, so they can be
+// set to a datatype in one go.
+
+void MainWindow::actionSelect_Matches(void) {
+    QTableWidget *t = ui->tableHexadecimal;
+
+    t->clearSelection();
+
+    for (const auto &match : qAsConst(byteMatches)) {
+        if (match.segment != currentSegment)
+            continue;
+
+        quint64 pos = match.offset;
+        quint64 end = match.offset + byteMatchSize;
+        while (pos < end) {
+            int y = pos / 8;
+            int x = pos % 8;
+            int last = qMin((quint64) 7, x + end - pos - 1);
+            t->setRangeSelected(QTableWidgetSelectionRange(y, x, y, last), true);
+            pos += last - x + 1;
+        }
+    }
 }
 
 // ----------------------------------------------------------------------------
@@ -1483,6 +2087,7 @@ void MainWindow::actionLowAndHighBytePairs(void) {
         }
     }
 
+    searchIndex.invalidate();
     Disassembler->generateDisassembly(generateLocalLabels);
     showDisassembly();
     showHex();
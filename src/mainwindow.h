@@ -24,6 +24,8 @@
 #define MAINWINDOW_H
 
 #include "pch.h"
+#include "bytesearch.h"
+#include <functional>
 
 namespace Ui {
 class MainWindow;
@@ -75,6 +77,13 @@ public Q_SLOTS:
     void actionAdd_Label(void);
     void actionFind(void);
     void actionLowAndHighBytePairs(void);
+    void actionEmulate(void);
+    void actionSelect_Matches(void);
+    void actionPort_Segment(void);
+    void actionApply_Signatures(void);
+    void actionSave_Flow_Graph(void);
+    void actionFind_Subroutines(void);
+    void actionResolve_Address_Pairs(void);
 
 private Q_SLOTS:
     void linkHexASCIISelection(void);
@@ -93,6 +102,14 @@ private Q_SLOTS:
     void onCheckLocalLabels_toggled();
     void onCheckDark_toggled();
     void onCheckFullscreen_toggled();
+    void onCheckProfile_toggled();
+
+    void onProfileResetButton_clicked();
+    void onProfileTraceButton_clicked();
+    void onTabsProfile_currentChanged();
+    void onSpinListingLimit_valueChanged(int mib);
+    void showProfile(void);
+    void showMemory(void);
 
     void onTableSegments_itemSelectionChanged();
     void onTableSegments_cellChanged(int row, int column);
@@ -104,6 +121,7 @@ private Q_SLOTS:
 
     void onReferences_returnPressed();
     void onFindButton_clicked();
+    void findBytes(void);
 
     static void rememberValue(int value);
     static void addRefEntry(QTableWidget *t, quint64 segment, quint64 address,
@@ -115,6 +133,21 @@ private:
     void Set_To_Foo(const QList<QTableWidgetSelectionRange>& ranges, quint8 datatype);
     void Set_Flag(const QList<QTableWidgetSelectionRange>& ranges, quint8 flag);
     void Set_Flag_Low_or_High_Byte(bool bLow);
+    int applySignatures(const QStringList &files, QString *error);
+    void forEachSegment(const std::function<void(int)> &pass);
+
+    QVector<struct bytematch> byteMatches;  // of the last byte search
+    int byteMatchSize = 0;
+
+    // filled by showDisassembly(), ascending addresses of the lines after
+    // .org and the row of their label or instruction
+
+    QVector<quint64> rowAddresses;
+    QVector<int> rowNumbers;
+    int rowOfAddress(quint64 address) const;
+
+    QTimer profileTimer;                // refreshes the profile dock
+    quint64 profileShown = 0;           // profiler generation in the dock
 };
 
 #endif // MAINWINDOW_H
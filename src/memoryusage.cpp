@@ -0,0 +1,182 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#include "annotations.h"
+#include "banks.h"
+#include "constants.h"
+#include "flowgraph.h"
+#include "memoryusage.h"
+
+const char *memoryKindNames[MK_LAST] = {
+    "Planes", "Constants", "Labels", "Comments", "Byte Pairs", "Listing",
+    "Annotations", "Views"
+};
+
+// allocator bookkeeping of a heap block, and a map node without its
+// key and value: three pointers and the color
+
+static const quint64 HEAP_BLOCK = 2 * sizeof(void *);
+static const quint64 MAP_NODE = HEAP_BLOCK + 4 * sizeof(void *);
+
+quint64 memoryusage::total(void) const {
+    quint64 sum = 0;
+    for (quint64 b : bytes)
+        sum += b;
+    return sum;
+}
+
+// static strings, like most instructions, have no capacity
+
+static quint64 stringBytes(const QString &s) {
+    if (!s.capacity())
+        return 0;
+    return HEAP_BLOCK + 3 * sizeof(void *) + (s.capacity() + 1) * sizeof(QChar);
+}
+
+static quint64 mapBytes(const QMap<quint64, QString> &map) {
+    quint64 bytes = map.size() * (MAP_NODE + sizeof(quint64) + sizeof(QString));
+
+    for (const auto &value : map)
+        bytes += stringBytes(value);
+    return bytes;
+}
+
+static quint64 mapBytes(const QMap<quint64, quint16> &map) {
+    return map.size() * (MAP_NODE + sizeof(quint64) + sizeof(quint64));
+}
+
+// ---------------------------------------------------------------------------
+
+quint64 listingBytes(const struct segment &s) {
+
+    // a Qt 5 QList holds pointers to its large elements
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    quint64 bytes = s.disassembly.size() *
+                    (sizeof(void *) + HEAP_BLOCK + sizeof(struct disassembly));
+#else
+    quint64 bytes = s.disassembly.size() * sizeof(struct disassembly);
+#endif
+    for (const auto &dis : s.disassembly)
+        bytes += stringBytes(dis.instruction) + stringBytes(dis.arguments);
+    if (s.flow)
+        bytes += sizeof(FlowGraph) + s.flow->bytes();
+    return bytes;
+}
+
+QVector<struct memoryusage> memoryUsage(const QList<QTableWidget *> &views) {
+    QVector<struct memoryusage> usage;
+
+    for (const auto &s : qAsConst(segments)) {
+        struct memoryusage u = { s.name, {} };
+        quint64 size = s.end - s.start + 1 + 16;
+
+        // banks are views on the backing of their group
+
+        if (s.bankGroup == BANKGROUP_NONE) {
+            u.bytes[MK_PLANES]    = 3 * (HEAP_BLOCK + size);
+            u.bytes[MK_CONSTANTS] = HEAP_BLOCK + size * sizeof(quint16);
+        }
+
+        u.bytes[MK_LABELS]    = mapBytes(s.localLabels);
+        u.bytes[MK_COMMENTS]  = mapBytes(s.comments);
+        u.bytes[MK_BYTEPAIRS] = mapBytes(s.lowbytes) + mapBytes(s.highbytes);
+
+        u.bytes[MK_LISTING]   = listingBytes(s);
+
+        if (s.annotations)
+            u.bytes[MK_ANNOTATIONS] = sizeof(AnnotationStore) + s.annotations->bytes();
+
+        usage.append(u);
+    }
+
+    for (int i = 0; i < bankGroups.size(); i++) {
+        const struct bankgroup &g = bankGroups.group(i);
+        struct memoryusage u = { QStringLiteral("Bank group: ") + g.name, {} };
+
+        u.bytes[MK_PLANES]    = 3 * (HEAP_BLOCK + g.size + 16);
+        u.bytes[MK_CONSTANTS] = HEAP_BLOCK + (g.size + 16) * sizeof(quint16);
+        u.bytes[MK_LABELS]    = mapBytes(g.sharedLabels);
+        usage.append(u);
+    }
+
+    struct memoryusage global = { QStringLiteral("Global labels"), {} };
+    global.bytes[MK_LABELS] = mapBytes(globalLabels);
+    usage.append(global);
+
+    struct memoryusage constants = { QStringLiteral("Constants groups"), {} };
+    for (quint16 id : constantsGroups.ids())
+        constants.bytes[MK_CONSTANTS] += mapBytes(constantsGroups.group(id)->entries());
+    usage.append(constants);
+
+    if (views.isEmpty())
+        return usage;
+
+    // an item keeps its data as a vector of role and QVariant
+
+    struct memoryusage items = { QStringLiteral("Views"), {} };
+    for (const auto *t : views) {
+        for (int row = 0; row < t->rowCount(); row++) {
+            for (int column = 0; column < t->columnCount(); column++) {
+                const QTableWidgetItem *item = t->item(row, column);
+                if (!item)
+                    continue;
+                items.bytes[MK_VIEWS] += HEAP_BLOCK + sizeof(QTableWidgetItem) +
+                                         HEAP_BLOCK + 4 * (sizeof(int) + sizeof(QVariant)) +
+                                         stringBytes(item->text());
+            }
+        }
+    }
+    usage.append(items);
+
+    return usage;
+}
+
+// ---------------------------------------------------------------------------
+
+QString memoryReport(const QVector<struct memoryusage> &usage) {
+    struct memoryusage sum = { QStringLiteral("Total"), {} };
+    QString out;
+    QTextStream text(&out);
+
+    text << qSetFieldWidth(24) << Qt::left << QStringLiteral("Name") << Qt::right;
+    for (const char *name : memoryKindNames)
+        text << qSetFieldWidth(12) << name;
+    text << qSetFieldWidth(12) << QStringLiteral("Total") << qSetFieldWidth(0) << "\n";
+
+    QVector<struct memoryusage> rows = usage;
+
+    for (const auto &u : usage)
+        for (int k = 0; k < MK_LAST; k++)
+            sum.bytes[k] += u.bytes[k];
+    rows.append(sum);
+
+    for (const auto &u : qAsConst(rows)) {
+        text << qSetFieldWidth(24) << Qt::left << u.name.left(23) << Qt::right;
+        for (quint64 b : u.bytes)
+            text << qSetFieldWidth(12) << b;
+        text << qSetFieldWidth(12) << u.total() << qSetFieldWidth(0) << "\n";
+    }
+
+    text.flush();
+    return out;
+}
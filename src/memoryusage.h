@@ -0,0 +1,64 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include "pch.h"
+
+// Estimated heap use of the project, per segment and per structure. Map
+// nodes and strings are estimated from their sizes, strings that are
+// shared between structures are counted for each of them.
+
+enum memorykind {
+    MK_PLANES,                          // data, datatypes and flags
+    MK_CONSTANTS,                       // plane of segments, groups' entries
+    MK_LABELS,
+    MK_COMMENTS,
+    MK_BYTEPAIRS,                       // lowbytes and highbytes
+    MK_LISTING,                         // generated disassembly, flow graph
+    MK_ANNOTATIONS,
+    MK_VIEWS,                           // table widget items
+    MK_LAST
+};
+
+extern const char *memoryKindNames[MK_LAST];
+
+struct memoryusage {
+    QString name;
+    quint64 bytes[MK_LAST];
+
+    quint64 total(void) const;
+};
+
+// generated disassembly and flow graph of one segment, also used to cap
+// the listing cache
+quint64 listingBytes(const struct segment &s);
+
+// a row for each segment, bank group and global structure, views are the
+// tables of the main window, if any
+QVector<struct memoryusage> memoryUsage(const QList<QTableWidget *> &views);
+
+// as text, with a row of totals, for the command line
+QString memoryReport(const QVector<struct memoryusage> &usage);
+
+#endif // MEMORYUSAGE_H
@@ -2,28 +2,43 @@
 #define PCH_H
 #include <QApplication>
 #include <QBrush>
+#include <QBuffer>
 #include <QComboBox>
 #include <QDataStream>
 #include <QDateTime>
 #include <QDebug>
 #include <QDialog>
+#include <QDir>
+#include <QDragEnterEvent>
+#include <QDropEvent>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QFontDatabase>
 #include <QHash>
+#include <QInputDialog>
 #include <QMainWindow>
 #include <QMap>
 #include <QMenu>
+#include <QMimeData>
 #include <QMessageBox>
+#include <QMutex>
 #include <QPushButton>
 #include <QRegularExpression>
 #include <QScrollBar>
+#include <QSet>
 #include <QSettings>
 #include <QString>
 #include <QTableWidget>
 #include <QTableWidgetSelectionRange>
+#include <QTextBlock>
+#include <QTextCursor>
 #include <QTextStream>
+#include <QThreadPool>
+#include <QTimer>
+#include <QUrl>
+#include <QtEndian>
 #include <QWidget>
 #include "frida.h"
 #endif
@@ -0,0 +1,424 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#include "portproject.h"
+#include "annotations.h"
+#include "flowgraph.h"
+#include "banks.h"
+#include "disassembler.h"
+#include "loaders.h"
+#include <algorithm>
+
+#define ANCHOR_SIZE     8
+#define HASH_BASE       0x100000001b3ULL
+
+// ----------------------------------------------------------------------------
+// ANCHORS
+
+// Windows whose hash occurs exactly once, by hash. Windows of a single
+// repeated byte (fills, empty tables) are useless as anchors.
+
+static QHash<quint64, qint64> uniqueWindows(const quint8 *p, quint64 size) {
+    QHash<quint64, qint64> windows;
+    quint64 h = 0, top = 1;
+
+    if (size < ANCHOR_SIZE)
+        return windows;
+
+    for (int i = 1; i < ANCHOR_SIZE; i++)
+        top *= HASH_BASE;
+    for (int i = 0; i < ANCHOR_SIZE; i++)
+        h = h * HASH_BASE + p[i];
+
+    windows.reserve(size);
+    for (quint64 i = 0; ; i++) {
+        bool flat = p[i] == p[i+ANCHOR_SIZE-1] &&
+                    !memcmp(p + i, p + i + 1, ANCHOR_SIZE - 1);
+        if (!flat) {
+            auto it = windows.find(h);
+            if (it == windows.end())
+                windows.insert(h, i);
+            else
+                it.value() = -1;
+        }
+        if (i + ANCHOR_SIZE >= size)
+            break;
+        h = (h - p[i] * top) * HASH_BASE + p[i+ANCHOR_SIZE];
+    }
+    return windows;
+}
+
+struct anchor {
+    qint64 o, n;
+};
+
+// Longest chain of anchors that is increasing in both images, so blocks
+// that swapped places do not drag everything in between along.
+
+static QVector<struct anchor> chainAnchors(QVector<struct anchor> &anchors) {
+    QVector<int> tails, prev(anchors.size());
+    QVector<struct anchor> chain;
+
+    std::sort(anchors.begin(), anchors.end(),
+              [](const struct anchor &a, const struct anchor &b) {
+                  return a.o < b.o; });
+
+    for (int i = 0; i < anchors.size(); i++) {
+        auto pos = std::lower_bound(tails.begin(), tails.end(), anchors.at(i).n,
+                        [&anchors](int t, qint64 n) {
+                            return anchors.at(t).n < n; });
+        int k = pos - tails.begin();
+        prev[i] = k ? tails.at(k-1) : -1;
+        if (k == tails.size())
+            tails.append(i);
+        else
+            tails[k] = i;
+    }
+
+    for (int i = tails.isEmpty() ? -1 : tails.last(); i >= 0; i = prev.at(i))
+        chain.prepend(anchors.at(i));
+    return chain;
+}
+
+// ----------------------------------------------------------------------------
+// ALIGNMENT
+
+QVector<qint64> alignImages(const quint8 *old, quint64 oldSize,
+                            const quint8 *neu, quint64 newSize,
+                            const QVector<quint8> &instructionSizes) {
+    QVector<qint64> map(oldSize, -1);
+    QVector<bool> used(newSize, false);
+
+    auto link = [&](quint64 o, quint64 n) {
+        map[o] = n;
+        used[n] = true;
+    };
+
+    // 1. identical windows that are unique in both images
+
+    QHash<quint64, qint64> oldWindows = uniqueWindows(old, oldSize);
+    QHash<quint64, qint64> newWindows = uniqueWindows(neu, newSize);
+    QVector<struct anchor> anchors;
+
+    for (auto it = oldWindows.constBegin(); it != oldWindows.constEnd(); ++it) {
+        qint64 o = it.value();
+        qint64 n = newWindows.value(it.key(), -1);
+        if (o >= 0 && n >= 0 && !memcmp(old + o, neu + n, ANCHOR_SIZE))
+            anchors.append({ o, n });
+    }
+
+    const QVector<struct anchor> chain = chainAnchors(anchors);
+
+    // 2. grow the anchors byte by byte, up to the next anchor
+
+    for (int a = 0; a < chain.size(); a++) {
+        quint64 o = chain.at(a).o, n = chain.at(a).n;
+        quint64 oLimit = a+1 < chain.size() ? chain.at(a+1).o : oldSize;
+        quint64 nLimit = a+1 < chain.size() ? chain.at(a+1).n : newSize;
+
+        if (map.at(o) >= 0)
+            continue;               // already covered by the previous anchor
+
+        while (o < oLimit && n < nLimit && old[o] == neu[n] &&
+                                            map.at(o) < 0 && !used.at(n)) {
+            link(o, n);
+            o++, n++;
+        }
+
+        o = chain.at(a).o, n = chain.at(a).n;
+        while (o > 0 && n > 0 && old[o-1] == neu[n-1] &&
+                                        map.at(o-1) < 0 && !used.at(n-1)) {
+            o--, n--;
+            link(o, n);
+        }
+    }
+
+    // 3. the gaps in between, bounded by matched bytes on both sides
+
+    QVector<qint64> instructionAt(oldSize + 1, -1);     // start, by end
+    for (quint64 o = 0; o < oldSize; o++)
+        if (instructionSizes.at(o) && o + instructionSizes.at(o) <= oldSize)
+            instructionAt[o + instructionSizes.at(o)] = o;
+
+    auto sameOpcode = [&](quint64 o, quint64 n, int size) {
+        int k = qMin(opcodeBytes(old + o), size);
+        return !memcmp(old + o, neu + n, k);
+    };
+
+    quint64 o1 = 0;
+    while (o1 < oldSize) {
+        if (map.at(o1) >= 0) {
+            o1++;
+            continue;
+        }
+
+        quint64 o2 = o1;
+        while (o2 < oldSize && map.at(o2) < 0)
+            o2++;
+
+        quint64 n1 = o1 ? map.at(o1-1) + 1 : 0;
+        quint64 n2 = o2 < oldSize ? map.at(o2) : newSize;
+
+        if (n2 < n1) {
+            o1 = o2;
+            continue;
+        }
+
+        // walk forward and backward as long as the opcodes agree
+
+        quint64 o = o1, n = n1;
+        while (o < o2 && instructionSizes.at(o) &&
+                    o + instructionSizes.at(o) <= o2 &&
+                    n + instructionSizes.at(o) <= n2 &&
+                    sameOpcode(o, n, instructionSizes.at(o))) {
+            for (int k = 0; k < instructionSizes.at(o); k++)
+                link(o+k, n+k);
+            n += instructionSizes.at(o);
+            o += instructionSizes.at(o);
+        }
+        quint64 fo = o, fn = n;
+
+        o = o2, n = n2;
+        while (o > fo && instructionAt.at(o) >= (qint64) fo) {
+            quint64 s = instructionAt.at(o);
+            quint64 size = o - s;
+            if (n < fn + size || !sameOpcode(s, n - size, size))
+                break;
+            for (quint64 k = 0; k < size; k++)
+                link(s+k, n-size+k);
+            o = s;
+            n -= size;
+        }
+
+        // what is left is a patch if it kept its size
+
+        if (o - fo == n - fn) {
+            for (quint64 k = 0; k < o - fo; k++)
+                link(fo+k, fn+k);
+        }
+
+        o1 = o2;
+    }
+
+    return map;
+}
+
+// ----------------------------------------------------------------------------
+// CARRY OVER
+
+static int dataWidth(quint8 datatype) {
+    switch (datatype) {
+    case DT_WORDLE:  case DT_WORDBE:  return 2;
+    case DT_DWORDLE: case DT_DWORDBE: return 4;
+    case DT_QWORDLE: case DT_QWORDBE: return 8;
+    case DT_XWORDLE: case DT_XWORDBE: return 16;
+    default:                          return 1;
+    }
+}
+
+// with map, regions of the old data get the position after the last byte
+// before them that was found, otherwise they are in the new data already
+
+static void addRegions(QList<struct portregion> &list, const QVector<bool> &hit,
+                       quint64 start, const QVector<qint64> *map = nullptr,
+                       quint64 newSize = 0) {
+    for (int i = 0; i < hit.size(); ) {
+        if (hit.at(i)) {
+            i++;
+            continue;
+        }
+        int j = i;
+        while (j < hit.size() && !hit.at(j))
+            j++;
+
+        quint64 position = start + i;
+        if (map)
+            position = start + qMin<quint64>(i ? map->at(i-1) + 1 : 0,
+                                             newSize ? newSize - 1 : 0);
+
+        list.append({ start + i, start + j - 1, position });
+        i = j;
+    }
+}
+
+template <typename T, typename F>
+static void moveMap(const QMap<quint64, T> &from, QMap<quint64, T> &to,
+                    F move, struct portresult *result, int *count) {
+    for (auto it = from.constBegin(); it != from.constEnd(); ++it) {
+        bool ok;
+        quint64 a = move(it.key(), &ok);
+        if (!ok) {
+            result->dropped++;
+            continue;
+        }
+        to.insert(a, it.value());
+        if (count)
+            (*count)++;
+    }
+}
+
+void portSegment(int segment, const QByteArray &image,
+                 struct portresult *result) {
+    struct segment *s = &segments[segment];
+    quint64 start = s->start;
+    quint64 oldSize = s->end - s->start + 1;
+    quint64 newSize = image.size();
+
+    QVector<quint8> instructionSizes(oldSize, 0);
+    for (const auto &d : qAsConst(s->disassembly)) {
+        quint64 o = d.address - start;
+        if (d.address < start || o >= oldSize)
+            continue;
+        if (s->datatypes[o] == DT_CODE || s->datatypes[o] == DT_UNDEFINED_CODE)
+            instructionSizes[o] = d.size;
+    }
+
+    struct segment ns = Loader::createEmptySegment(start, start + newSize - 1);
+    memcpy(ns.data, image.constData(), newSize);
+    ns.name = s->name;
+    ns.scrollbarValue = 0;
+
+    const QVector<qint64> map = alignImages(s->data, oldSize, ns.data, newSize,
+                                            instructionSizes);
+
+    result->matched = 0;
+    result->labels = result->comments = result->dropped = 0;
+    result->unmatchedOld.clear();
+    result->unmatchedNew.clear();
+    result->collisions.clear();
+
+    QVector<bool> oldHit(oldSize, false), newHit(newSize, false);
+
+    // datatypes, flags and constants, code is only kept for complete
+    // instructions that still start with the same opcode
+
+    for (quint64 o = 0; o < oldSize; o++) {
+        if (map.at(o) < 0)
+            continue;
+        quint64 n = map.at(o);
+        quint8 dt = s->datatypes[o];
+        oldHit[o] = newHit[n] = true;
+        result->matched++;
+        if (dt != DT_CODE && dt != DT_UNDEFINED_CODE)
+            ns.datatypes[n] = dt;
+        ns.flags[n] = s->flags[o];
+        ns.constants[n] = s->constants[o];
+    }
+
+    for (quint64 o = 0; o < oldSize; o++) {
+        int size = instructionSizes.at(o);
+        if (!size || map.at(o) < 0)
+            continue;
+
+        quint64 n = map.at(o);
+        bool whole = n + size <= newSize && s->data[o] == ns.data[n];
+        for (int k = 1; whole && k < size; k++)
+            whole = map.at(o+k) == (qint64) (n+k);
+        if (whole && size >= 2 && opcodeBytes(s->data + o) == 2)
+            whole = s->data[o+1] == ns.data[n+1];
+
+        if (!whole)
+            continue;
+        for (int k = 0; k < size; k++)
+            ns.datatypes[n+k] = s->datatypes[o];
+    }
+
+    // multi-byte data that got torn apart becomes undefined
+
+    for (quint64 n = 0; n < newSize; ) {
+        quint8 dt = ns.datatypes[n];
+        int width = dataWidth(dt);
+        bool whole = n + width <= newSize;
+        for (int k = 1; whole && k < width; k++)
+            whole = ns.datatypes[n+k] == dt;
+        if (width > 1 && !whole) {
+            ns.datatypes[n] = DT_UNDEFINED_BYTES;
+            n++;
+        } else {
+            n += width;
+        }
+    }
+
+    // annotations keyed by address, outside the segment they stay put
+
+    auto move = [&](quint64 address, bool *ok) -> quint64 {
+        *ok = true;
+        if (address < start || address > s->end)
+            return address;
+        qint64 n = map.at(address - start);
+        *ok = n >= 0;
+        return start + n;
+    };
+
+    moveMap(s->localLabels, ns.localLabels, move, result, &result->labels);
+    moveMap(s->comments, ns.comments, move, result, &result->comments);
+
+    // global labels in this segment move, if they can. One that stays put
+    // because its bytes are gone can be in the way of one that moved, the
+    // moved one wins and both are reported.
+
+    QMap<quint64, QString> globals, stayed;
+    for (auto it = globalLabels.constBegin(); it != globalLabels.constEnd(); ++it) {
+        bool ok;
+        quint64 a = move(it.key(), &ok);
+        if (!ok) {
+            stayed.insert(it.key(), it.value());
+            continue;
+        }
+        globals.insert(a, it.value());
+        if (it.key() >= start && it.key() <= s->end)
+            result->labels++;
+    }
+    for (auto it = stayed.constBegin(); it != stayed.constEnd(); ++it) {
+        if (globals.contains(it.key())) {
+            result->collisions.append({ it.key(), globals.value(it.key()), it.value() });
+            result->dropped++;
+        } else {
+            globals.insert(it.key(), it.value());
+        }
+    }
+    globalLabels = globals;
+
+    // low and high bytes are keyed by offset and point to an address
+
+    for (int pass = 0; pass < 2; pass++) {
+        const QMap<quint64, quint16> &from = pass ? s->highbytes : s->lowbytes;
+        QMap<quint64, quint16> &to = pass ? ns.highbytes : ns.lowbytes;
+        for (auto it = from.constBegin(); it != from.constEnd(); ++it) {
+            bool ok;
+            if (it.key() >= oldSize || map.at(it.key()) < 0) {
+                result->dropped++;
+                continue;
+            }
+            quint64 target = move(it.value(), &ok);
+            to.insert(map.at(it.key()), ok ? target : it.value());
+        }
+    }
+
+    addRegions(result->unmatchedOld, oldHit, start, &map, newSize);
+    addRegions(result->unmatchedNew, newHit, start);
+
+    BankGroups::release(*s);            // a ported bank leaves its group
+    delete s->annotations;
+    delete s->flow;
+    *s = ns;
+}
@@ -0,0 +1,63 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef PORTPROJECT_H
+#define PORTPROJECT_H
+
+#include "pch.h"
+
+struct portregion {
+    quint64 start, end;                 // absolute, inclusive
+    quint64 position;                   // where it is, or was, in the new data
+};
+
+// a global label that moved onto the address of another one
+struct portcollision {
+    quint64 address;                    // in the new data
+    QString kept, lost;
+};
+
+struct portresult {
+    quint64 matched;                    // bytes of the old data that were found
+    QList<struct portregion> unmatchedOld, unmatchedNew;
+    QList<struct portcollision> collisions;
+    int labels, comments;               // carried over
+    int dropped;                        // annotations without a new address
+};
+
+// Map every offset of old onto new, or -1. Identical stretches are found
+// through unique rolling-hash anchors. The gaps in between are matched
+// instruction by instruction, where only the opcodes have to be equal,
+// because operands change when the code around them moves.
+
+QVector<qint64> alignImages(const quint8 *old, quint64 oldSize,
+                            const quint8 *neu, quint64 newSize,
+                            const QVector<quint8> &instructionSizes);
+
+// Replace the data of a segment by a new revision. The start address stays
+// the same and all annotations move along to where their bytes ended up.
+// The disassembly of the segment must be up-to-date.
+
+void portSegment(int segment, const QByteArray &image,
+                 struct portresult *result);
+
+#endif // PORTPROJECT_H
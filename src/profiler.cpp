@@ -0,0 +1,126 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#include "profiler.h"
+
+Profiler profiler;
+
+Profiler::Profiler() {
+    clock.start();
+}
+
+void Profiler::record(const char *name, qint64 start, qint64 duration,
+                      const qint64 *counters) {
+    struct profilestats &s = totals[QByteArray(name)];
+
+    s.calls++;
+    s.total += duration;
+    if (duration > s.max)
+        s.max = duration;
+    for (int i = 0; i < PC_LAST; i++)
+        s.counters[i] += counters[i];
+
+    if (events.size() >= PROFILE_MAX_EVENTS) {
+        dropped++;
+        return;
+    }
+
+    struct profileevent e = { name, start, duration, {} };
+    for (int i = 0; i < PC_LAST; i++)
+        e.counters[i] = counters[i];
+    events.append(e);
+}
+
+void Profiler::reset(void) {
+    totals.clear();
+    events.clear();
+    dropped = 0;
+}
+
+// ---------------------------------------------------------------------------
+// CHROME TRACE EVENTS
+
+bool Profiler::writeTrace(const QString &name, QString *error) const {
+    static const char *counterNames[PC_LAST] = { "bytes", "lines", "allocations" };
+
+    QFile file(name);
+
+    if (!file.open(QIODevice::WriteOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+
+    // timestamps are in microseconds, names are string literals and need
+    // no escaping
+
+    QByteArray out;
+    out.reserve(64 + events.size() * 128);
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    for (int i = 0; i < events.size(); i++) {
+        const struct profileevent &e = events.at(i);
+
+        out += "{\"name\":\"";
+        out += e.name;
+        out += "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":";
+        out += QByteArray::number(e.start / 1000.0, 'f', 3);
+        out += ",\"dur\":";
+        out += QByteArray::number(e.duration / 1000.0, 'f', 3);
+        out += ",\"args\":{";
+        for (int c = 0; c < PC_LAST; c++) {
+            if (c)
+                out += ',';
+            out += '"';
+            out += counterNames[c];
+            out += "\":";
+            out += QByteArray::number(e.counters[c]);
+        }
+        out += "}}";
+        if (i + 1 < events.size())
+            out += ',';
+        out += '\n';
+    }
+    out += "]}\n";
+
+    if (file.write(out) != out.size()) {
+        *error = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+ProfileScope::ProfileScope(const char *name) :
+    name(name),
+    start(profiler.now()),
+    allocations(profiler.allocationCount()) {
+}
+
+void ProfileScope::stop(void) {
+    if (!running)
+        return;
+    running = false;
+
+    counters[PC_ALLOCATIONS] += profiler.allocationCount() - allocations;
+    profiler.record(name, start, profiler.now() - start, counters);
+}
@@ -0,0 +1,100 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "pch.h"
+
+// Timings of the hot paths. A ProfileScope measures from its construction
+// to its destruction, or to stop(), and adds what it counted. Totals per
+// scope name are shown in the profile dock, the separate events can be
+// saved as Chrome trace-event JSON (chrome://tracing, Perfetto).
+
+enum profilecounter {
+    PC_BYTES,                           // processed
+    PC_LINES,                           // emitted
+    PC_ALLOCATIONS,                     // of segment and bank buffers
+    PC_LAST
+};
+
+#define PROFILE_MAX_EVENTS  100000      // later events only count in totals
+
+struct profilestats {
+    quint64 calls;
+    qint64 total, max;                  // nanoseconds
+    qint64 counters[PC_LAST];
+};
+
+struct profileevent {
+    const char *name;
+    qint64 start, duration;             // nanoseconds
+    qint64 counters[PC_LAST];
+};
+
+class Profiler {
+public:
+    Profiler();
+
+    qint64 now(void) const { return clock.nsecsElapsed(); }
+    void record(const char *name, qint64 start, qint64 duration,
+                const qint64 *counters);
+    void reset(void);
+
+    // counts into every scope that is running
+    void allocation(void) { allocations++; }
+    quint64 allocationCount(void) const { return allocations; }
+
+    const QMap<QByteArray, struct profilestats> &stats(void) const { return totals; }
+    quint64 generation(void) const { return events.size() + dropped; }
+
+    bool writeTrace(const QString &name, QString *error) const;
+
+private:
+    QElapsedTimer clock;
+    QMap<QByteArray, struct profilestats> totals;
+    QVector<struct profileevent> events;
+    quint64 dropped = 0;
+    quint64 allocations = 0;
+};
+
+extern Profiler profiler;
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char *name);
+    ~ProfileScope() { stop(); }
+
+    void count(enum profilecounter counter, qint64 n) { counters[counter] += n; }
+    void stop(void);
+
+private:
+    const char *name;
+    qint64 start;
+    quint64 allocations;
+    qint64 counters[PC_LAST] = {};
+    bool running = true;
+
+    Q_DISABLE_COPY(ProfileScope)
+};
+
+#endif // PROFILER_H
@@ -0,0 +1,262 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#include "projectsections.h"
+#include "zlib.h"
+#include <cstring>
+
+// ---------------------------------------------------------------------------
+// STRING POOL
+
+quint64 StringPool::index(const QString &s) {
+    auto it = indices.constFind(s);
+    if (it != indices.constEnd())
+        return it.value();
+
+    quint64 i = strings.size();
+    indices.insert(s, i);
+    strings.append(s);
+    return i;
+}
+
+QString StringPool::at(quint64 index, bool *ok) const {
+    if (index >= (quint64) strings.size()) {
+        *ok = false;
+        return QString();
+    }
+    return strings.at(index);
+}
+
+void StringPool::encode(SectionEncoder &enc) const {
+    enc.varint(strings.size());
+    for (const auto &s : strings) {
+        QByteArray utf8 = s.toUtf8();
+        enc.varint(utf8.size());
+        enc.bytes((const quint8 *) utf8.constData(), utf8.size());
+    }
+}
+
+bool StringPool::decode(SectionDecoder &dec) {
+    quint64 n = dec.varint();
+
+    strings.clear();
+    while (dec.ok && n--) {
+        quint64 size = dec.varint();
+        if (!dec.ok || size > 0x7fffffff)
+            return false;
+        QByteArray utf8((int) size, '\0');
+        dec.bytes((quint8 *) utf8.data(), size);
+        strings.append(QString::fromUtf8(utf8));
+    }
+    return dec.ok;
+}
+
+// ---------------------------------------------------------------------------
+// ENCODER
+
+void SectionEncoder::varint(quint64 value) {
+    while (value >= 0x80) {
+        buffer.append((char) (value | 0x80));
+        value >>= 7;
+    }
+    buffer.append((char) value);
+}
+
+void SectionEncoder::bytes(const quint8 *data, quint64 size) {
+    buffer.append((const char *) data, size);
+}
+
+void SectionEncoder::string(const QString &s) {
+    varint(pool->index(s));
+}
+
+// runs of equal bytes, as run length and value
+
+void SectionEncoder::plane(const quint8 *data, quint64 size) {
+    quint64 i = 0;
+
+    while (i < size) {
+        quint64 run = 1;
+        while (i + run < size && data[i + run] == data[i])
+            run++;
+        varint(run);
+        buffer.append((char) data[i]);
+        i += run;
+    }
+}
+
+void SectionEncoder::labels(const QMap<quint64, QString> &map) {
+    quint64 prev = 0;
+
+    varint(map.size());
+    for (auto it = map.constBegin(); it != map.constEnd(); ++it) {
+        varint(it.key() - prev);
+        string(it.value());
+        prev = it.key();
+    }
+}
+
+void SectionEncoder::words(const QMap<quint64, quint16> &map) {
+    quint64 prev = 0;
+
+    varint(map.size());
+    for (auto it = map.constBegin(); it != map.constEnd(); ++it) {
+        varint(it.key() - prev);
+        varint(it.value());
+        prev = it.key();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// DECODER
+
+quint64 SectionDecoder::varint(void) {
+    quint64 value = 0;
+
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= buffer.size()) {
+            ok = false;
+            return 0;
+        }
+        quint8 c = buffer.at(pos++);
+        value |= (quint64) (c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return value;
+    }
+    ok = false;
+    return 0;
+}
+
+void SectionDecoder::bytes(quint8 *data, quint64 size) {
+    if (size > (quint64) (buffer.size() - pos)) {
+        ok = false;
+        return;
+    }
+    memcpy(data, buffer.constData() + pos, size);
+    pos += size;
+}
+
+QString SectionDecoder::string(void) {
+    quint64 i = varint();
+    return ok ? pool->at(i, &ok) : QString();
+}
+
+void SectionDecoder::plane(quint8 *data, quint64 size) {
+    quint64 i = 0;
+
+    while (ok && i < size) {
+        quint64 run = varint();
+        if (!ok || !run || run > size - i || pos >= buffer.size()) {
+            ok = false;
+            return;
+        }
+        memset(data + i, (quint8) buffer.at(pos++), run);
+        i += run;
+    }
+}
+
+QMap<quint64, QString> SectionDecoder::labels(void) {
+    QMap<quint64, QString> map;
+    quint64 n = varint(), key = 0;
+
+    while (ok && n--) {
+        key += varint();
+        QString s = string();
+        if (ok)
+            map.insert(map.constEnd(), key, s);     // keys are ascending
+    }
+    return map;
+}
+
+QMap<quint64, quint16> SectionDecoder::words(void) {
+    QMap<quint64, quint16> map;
+    quint64 n = varint(), key = 0;
+
+    while (ok && n--) {
+        key += varint();
+        quint16 value = varint();
+        if (ok)
+            map.insert(map.constEnd(), key, value);
+    }
+    return map;
+}
+
+// ---------------------------------------------------------------------------
+// SECTIONS
+
+static void put32(quint8 *p, quint32 v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static quint32 get32(const quint8 *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((quint32) p[3] << 24);
+}
+
+// the planes are already run-length encoded, the fastest level suffices
+
+bool writeSection(QIODevice &file, quint32 id, const QByteArray &data) {
+    uLongf csize = compressBound(data.size());
+    QByteArray out(12 + csize, '\0');
+    quint8 *p = (quint8 *) out.data();
+
+    if (compress2(p + 12, &csize, (const Bytef *) data.constData(),
+                  data.size(), Z_BEST_SPEED) != Z_OK)
+        return false;
+
+    put32(p, id);
+    put32(p + 4, csize);
+    put32(p + 8, data.size());
+
+    return file.write(out.constData(), 12 + csize) == (qint64) (12 + csize);
+}
+
+bool readSection(QIODevice &file, quint32 *id, QByteArray *data, QString *error) {
+    quint8 head[12];
+
+    if (file.read((char *) head, 12) != 12) {
+        *error = QStringLiteral("Premature end of file reached");
+        return false;
+    }
+
+    *id = get32(head);
+    quint32 csize = get32(head + 4);
+    uLongf size = get32(head + 8);
+
+    QByteArray in = file.read(csize);
+    if ((quint32) in.size() != csize || size > 0x7fffffff) {
+        *error = QStringLiteral("Premature end of file reached");
+        return false;
+    }
+
+    data->resize(size);
+    if (!size)
+        return true;
+    if (uncompress((Bytef *) data->data(), &size, (const Bytef *) in.constData(),
+                   csize) != Z_OK || size != (uLongf) data->size()) {
+        *error = QStringLiteral("Section %1 is corrupt").arg(*id);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,106 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef PROJECTSECTIONS_H
+#define PROJECTSECTIONS_H
+
+#include "pch.h"
+
+// A project file from FRIDA_FILE_FORMAT_2 on is a sequence of sections,
+// each compressed on its own:
+//
+//      quint32 id, quint32 compressed size, quint32 size, zlib data
+//
+// Integers are varints, keys of maps are deltas to the previous key and
+// strings are indices in the string pool, which is the first section.
+// Datatypes and flags are run-length encoded. Sections with an unknown
+// id are skipped.
+
+enum sectionid {
+    SECTION_END = 0,
+    SECTION_STRINGS,
+    SECTION_HEADER,
+    SECTION_BANKGROUPS,
+    SECTION_SEGMENT,                    // one for each segment
+    SECTION_GLOBALS,
+    SECTION_CONSTANTS,
+    SECTION_LIBRARIES,
+    SECTION_LISTING,                    // in listing cache files
+};
+
+class StringPool {
+public:
+    quint64 index(const QString &s);
+    QString at(quint64 index, bool *ok) const;
+
+    void encode(class SectionEncoder &enc) const;
+    bool decode(class SectionDecoder &dec);
+
+private:
+    QHash<QString, quint64> indices;
+    QStringList strings;
+};
+
+class SectionEncoder {
+public:
+    explicit SectionEncoder(StringPool *pool) : pool(pool) {}
+
+    void varint(quint64 value);
+    void bytes(const quint8 *data, quint64 size);
+    void string(const QString &s);
+    void plane(const quint8 *data, quint64 size);
+    void labels(const QMap<quint64, QString> &map);
+    void words(const QMap<quint64, quint16> &map);
+
+    QByteArray buffer;
+
+private:
+    StringPool *pool;
+};
+
+// all getters return zero or empty and clear ok when running out of data
+
+class SectionDecoder {
+public:
+    SectionDecoder(const QByteArray &buffer, const StringPool *pool)
+        : buffer(buffer), pool(pool) {}
+
+    quint64 varint(void);
+    void bytes(quint8 *data, quint64 size);
+    QString string(void);
+    void plane(quint8 *data, quint64 size);
+    QMap<quint64, QString> labels(void);
+    QMap<quint64, quint16> words(void);
+
+    bool atEnd(void) const { return pos >= buffer.size(); }
+    bool ok = true;
+
+private:
+    const QByteArray &buffer;
+    const StringPool *pool;
+    int pos = 0;
+};
+
+bool writeSection(QIODevice &file, quint32 id, const QByteArray &data);
+bool readSection(QIODevice &file, quint32 *id, QByteArray *data, QString *error);
+
+#endif // PROJECTSECTIONS_H
@@ -0,0 +1,728 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+
+#include "reassembler.h"
+
+#define STMT_LABEL      0
+#define STMT_EQUATE     1
+#define STMT_ORG        2
+#define STMT_DIRECTIVE  3
+#define STMT_INSN       4
+
+static const struct {
+    const char *name;
+    int directive;
+} directiveNames[] = {
+    { ".byte",           DIR_BYTE },
+    { ".wordle",         DIR_WORDLE },
+    { ".wordbe",         DIR_WORDBE },
+    { ".dwordle",        DIR_DWORDLE },
+    { ".dwordbe",        DIR_DWORDBE },
+    { ".qwordle",        DIR_QWORDLE },
+    { ".qwordbe",        DIR_QWORDBE },
+    { ".xwordle",        DIR_XWORDLE },
+    { ".xwordbe",        DIR_XWORDBE },
+    { ".ascii",          DIR_ASCII },
+    { ".atascii",        DIR_ATASCII },
+    { ".invatascii",     DIR_INVATASCII },
+    { ".petscii",        DIR_PETSCII },
+    { ".anticscreen",    DIR_ANTICSCREEN },
+    { ".invanticscreen", DIR_INVANTICSCREEN },
+    { ".cbmscreen",      DIR_CBMSCREEN },
+};
+
+static int directiveOf(const QString &name) {
+    for (const auto &d : directiveNames)
+        if (name == QLatin1String(d.name))
+            return d.directive;
+    return DIR_NONE;
+}
+
+// the DT_ type the disassembler converted a string directive from
+
+static int textTypeOf(int directive) {
+    switch (directive) {
+    case DIR_ASCII:             return DT_ASCII;
+    case DIR_ATASCII:           return DT_ATASCII;
+    case DIR_INVATASCII:        return DT_INVERSE_ATASCII;
+    case DIR_PETSCII:           return DT_PETSCII;
+    case DIR_ANTICSCREEN:       return DT_ANTIC_SCREEN;
+    case DIR_INVANTICSCREEN:    return DT_INVERSE_ANTIC_SCREEN;
+    case DIR_CBMSCREEN:         return DT_CBM_SCREEN;
+    default:                    return -1;
+    }
+}
+
+static inline bool isCapture(const QString &s, int i) {
+    return s.at(i) == QLatin1Char('%') && i+1 < s.size() && s.at(i+1).isDigit();
+}
+
+static int literalLength(const QString &tmpl) {
+    int n = tmpl.size();
+    for (int i = 0; i < tmpl.size(); i++)
+        if (isCapture(tmpl, i))
+            n -= 2;
+    return n;
+}
+
+// Matches the lower case text against an operand template, and returns the
+// expressions at the places of %1 and %2 from the original text.
+
+static bool matchTemplate(const QString &tmpl, const QString &lower,
+                          const QString &text, QStringList *captures) {
+    int t = 0, p = 0;
+
+    while (t < tmpl.size()) {
+        if (!isCapture(tmpl, t)) {
+            if (p >= lower.size() || tmpl.at(t) != lower.at(p))
+                return false;
+            t++;
+            p++;
+            continue;
+        }
+
+        t += 2;
+        int u = t;
+        while (u < tmpl.size() && !isCapture(tmpl, u))
+            u++;
+        QString literal = tmpl.mid(t, u-t);
+
+        int q;
+        if (u == tmpl.size()) {         // the rest must end the text
+            q = lower.size() - literal.size();
+            if (q <= p || lower.mid(q) != literal)
+                return false;
+        } else {
+            q = lower.indexOf(literal, p+1);
+            if (q < 0)
+                return false;
+        }
+        captures->append(text.mid(p, q-p));
+        p = q;
+    }
+
+    return p == lower.size();
+}
+
+// split at the commas that are not inside parentheses or quotes
+
+static QStringList splitValues(const QString &text) {
+    QStringList values;
+    int depth = 0, start = 0;
+    bool quoted = false;
+
+    for (int i = 0; i < text.size(); i++) {
+        QChar c = text.at(i);
+        if (c == QLatin1Char('"'))
+            quoted = !quoted;
+        else if (quoted)
+            continue;
+        else if (c == QLatin1Char('('))
+            depth++;
+        else if (c == QLatin1Char(')'))
+            depth--;
+        else if (c == QLatin1Char(',') && !depth) {
+            values.append(text.mid(start, i-start).trimmed());
+            start = i+1;
+        }
+    }
+    values.append(text.mid(start).trimmed());
+    return values;
+}
+
+// the digits of a number written as $12 or 12h, empty for anything else
+
+static QString hexDigits(const QString &value) {
+    QString digits = value.trimmed();
+
+    if (digits.startsWith(QLatin1Char('$')))
+        digits.remove(0, 1);
+    else if (digits.endsWith(QLatin1Char('h')) || digits.endsWith(QLatin1Char('H')))
+        digits.chop(1);
+    else
+        return QString();
+
+    for (QChar c : qAsConst(digits))
+        if (!isxdigit(c.toLatin1()))
+            return QString();
+    return digits;
+}
+
+static inline bool fitsByte(quint64 v) {
+    return v <= 0xff || v >= 0xffffffffffffff80ULL;     // or -128..-1
+}
+
+// ---------------------------------------------------------------------------
+
+Reassembler::Reassembler() {
+    Disassembler->instructionShapes(shapes);
+
+    for (int i = 0; i < shapes.size(); i++) {
+        shapes[i].operands = shapes[i].operands.toLower();
+        byMnemonic[shapes[i].mnemonic.toLower()].append(i);
+    }
+
+    // the most specific templates first, so ($12),y is not taken as an
+    // expression in parentheses, and the smallest encoding first
+
+    for (auto &list : byMnemonic) {
+        std::stable_sort(list.begin(), list.end(), [this](int a, int b) {
+            int la = literalLength(shapes.at(a).operands);
+            int lb = literalLength(shapes.at(b).operands);
+            if (la != lb)
+                return la > lb;
+            return shapes.at(a).size < shapes.at(b).size;
+        });
+    }
+
+    memset(fromAscii, 255, sizeof(fromAscii));
+    for (int type = 0; type < DT_LAST; type++) {
+        for (int v = 0; v < 256; v++) {
+            quint8 a = textToAscii(type, v);
+            if (a != 255 && fromAscii[type][a] == 255)
+                fromAscii[type][a] = v;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// PARSE
+
+bool Reassembler::parse(const QString &source,
+                        QVector<struct statement> &program, QString *error) {
+    QStringList lines = source.split(QLatin1Char('\n'));
+
+    for (int n = 0; n < lines.size(); n++) {
+        QString line = lines.at(n);
+
+        // strings are not escaped, a " inside one is written as it is. The
+        // exporter puts comments on lines of their own, so a string runs
+        // from the first to the last quote on its line.
+
+        int first = line.indexOf(QLatin1Char('"'));
+        int last = line.lastIndexOf(QLatin1Char('"'));
+
+        for (int i = 0; i < line.size(); i++) {
+            if (first >= 0 && i >= first && i <= last)
+                continue;
+            if (line.at(i) == QLatin1Char(';')) {
+                line.truncate(i);
+                break;
+            }
+        }
+        if (line.trimmed().isEmpty())
+            continue;
+
+        struct statement st = { n+1, STMT_INSN, QString(), QString(), -1 };
+
+        if (!line.at(0).isSpace()) {
+            int equals = line.indexOf(QLatin1Char('='));
+            if (equals >= 0) {
+                st.kind = STMT_EQUATE;
+                st.name = line.left(equals).trimmed();
+                st.text = line.mid(equals+1).trimmed();
+            } else {
+                st.kind = STMT_LABEL;
+                st.name = line.trimmed();
+            }
+            names.insert(st.name);
+        } else {
+            line = line.trimmed();
+            int space = 0;
+            while (space < line.size() && !line.at(space).isSpace())
+                space++;
+            st.name = line.left(space).toLower();
+            st.text = line.mid(space).trimmed();
+
+            if (st.name == QStringLiteral(".org"))
+                st.kind = STMT_ORG;
+            else if (directiveOf(st.name) != DIR_NONE)
+                st.kind = STMT_DIRECTIVE;
+            else if (!byMnemonic.contains(st.name)) {
+                *error = QStringLiteral("line %1: unknown instruction %2")
+                                                    .arg(n+1).arg(st.name);
+                return false;
+            }
+        }
+        program.append(st);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// ASSEMBLE
+
+bool Reassembler::assemble(const QString &source, QString *error) {
+    QVector<struct statement> program;
+
+    symbols.clear();
+    names.clear();
+    if (!parse(source, program, error))
+        return false;
+
+    // pass 1 decides the size of everything, pass 2 writes it
+
+    return pass(program, false, error) && pass(program, true, error);
+}
+
+bool Reassembler::pass(QVector<struct statement> &program, bool final,
+                       QString *error) {
+    chunks.clear();
+
+    for (auto &st : program) {
+        struct chunk *c = chunks.isEmpty() ? nullptr : &chunks.last();
+        QString where = QStringLiteral("line %1: ").arg(st.line);
+        quint64 value;
+        bool known;
+
+        if (st.kind == STMT_ORG || st.kind == STMT_EQUATE) {
+            if (!evaluate(st.text, &value, &known, error)) {
+                *error = where + *error;
+                return false;
+            }
+            if (!known) {
+                *error = where + QStringLiteral("value must be known");
+                return false;
+            }
+            if (st.kind == STMT_ORG)
+                chunks.append({ value, QByteArray() });
+            else
+                symbols.insert(st.name, value);
+            continue;
+        }
+
+        if (!c) {
+            *error = where + QStringLiteral("missing .org");
+            return false;
+        }
+
+        quint64 pc = c->start + c->data.size();
+
+        switch (st.kind) {
+        case STMT_LABEL:
+            if (!final && symbols.contains(st.name) && symbols.value(st.name) != pc) {
+                *error = where + QStringLiteral("%1 is defined twice").arg(st.name);
+                return false;
+            }
+            symbols.insert(st.name, pc);
+            break;
+        case STMT_DIRECTIVE:
+            if (!directive(st, final, &c->data, error)) {
+                *error = where + *error;
+                return false;
+            }
+            break;
+        case STMT_INSN:
+            if (!instruction(st, pc, final, &c->data, error)) {
+                *error = where + *error;
+                return false;
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+bool Reassembler::instruction(struct statement &st, quint64 pc, bool final,
+                              QByteArray *out, QString *error) {
+    QString text = st.text;
+    text.remove(QLatin1Char(' '));
+    QString lower = text.toLower();
+    QStringList captures;
+
+    // pass 1 picks the shape, pass 2 sticks to it so nothing moves
+
+    if (final) {
+        matchTemplate(shapes.at(st.shape).operands, lower, text, &captures);
+    } else {
+        int literal = -1, fitting = -1, widest = -1;
+        QStringList widestCaptures;
+
+        for (int c : byMnemonic.value(st.name)) {
+            const struct insnshape &shape = shapes.at(c);
+            QStringList caps;
+            bool fits = true, valid = true;
+
+            if (literal >= 0 && literalLength(shape.operands) != literal)
+                break;
+            if (!matchTemplate(shape.operands, lower, text, &caps))
+                continue;
+
+            for (int i = 0; i < caps.size() && valid; i++) {
+                quint64 v;
+                bool known;
+                QString ignored;
+
+                // $0012 was an absolute operand in the listing, keep it
+                // one, it is not a zero page operand written long
+
+                valid = i < 2 && evaluate(caps.at(i), &v, &known, &ignored);
+                if (valid && shape.kinds[i] == OPERAND_BYTE)
+                    fits = fits && known && fitsByte(v) &&
+                           hexDigits(caps.at(i)).size() < 4;
+            }
+            if (!valid)
+                continue;
+
+            literal = literalLength(shape.operands);
+            if (fits && fitting < 0) {
+                fitting = c;
+                captures = caps;
+            }
+            if (widest < 0 || shape.size > shapes.at(widest).size) {
+                widest = c;
+                widestCaptures = caps;
+            }
+        }
+
+        if (widest < 0) {
+            *error = QStringLiteral("cannot assemble %1 %2").arg(st.name, st.text);
+            return false;
+        }
+        if (fitting < 0)
+            captures = widestCaptures;
+        st.shape = fitting >= 0 ? fitting : widest;
+    }
+
+    const struct insnshape &shape = shapes.at(st.shape);
+    QByteArray bytes((const char *) shape.bytes, shape.size);
+
+    for (int i = 0; i < 2 && shape.kinds[i] != OPERAND_NONE; i++) {
+        int offset = shape.offsets[i];
+        quint64 v;
+        bool known;
+
+        if (i >= captures.size()) {
+            *error = QStringLiteral("missing operand");
+            return false;
+        }
+        if (!evaluate(captures.at(i), &v, &known, error))
+            return false;
+        if (!known && final) {
+            *error = QStringLiteral("undefined label in ") + captures.at(i);
+            return false;
+        }
+
+        if (shape.kinds[i] == OPERAND_REL)
+            v -= pc + shape.size;
+
+        switch (shape.kinds[i]) {
+        case OPERAND_REL:
+            if (final && v > 0x7f && v < 0xffffffffffffff80ULL) {
+                *error = QStringLiteral("branch to %1 out of range").arg(captures.at(i));
+                return false;
+            }
+            bytes[offset] = v;
+            break;
+        case OPERAND_BYTE:
+            if (final && !fitsByte(v)) {
+                *error = captures.at(i) + QStringLiteral(" does not fit in a byte");
+                return false;
+            }
+            bytes[offset] = v;
+            break;
+        case OPERAND_WORD:
+            if (final && v > 0xffff) {
+                *error = captures.at(i) + QStringLiteral(" does not fit in a word");
+                return false;
+            }
+            bytes[offset] = v;
+            bytes[offset+1] = v >> 8;
+            break;
+        }
+    }
+
+    out->append(bytes);
+    return true;
+}
+
+bool Reassembler::directive(const struct statement &st, bool final,
+                            QByteArray *out, QString *error) {
+    int dir = directiveOf(st.name);
+    int type = textTypeOf(dir);
+
+    if (type >= 0) {
+        int first = st.text.indexOf(QLatin1Char('"'));
+        int last = st.text.lastIndexOf(QLatin1Char('"'));
+
+        if (first < 0 || last <= first) {
+            *error = QStringLiteral("missing string");
+            return false;
+        }
+        for (int i = first+1; i < last; i++) {
+            ushort c = st.text.at(i).unicode();
+            if (c > 255 || fromAscii[type][c] == 255) {
+                *error = QStringLiteral("cannot encode '%1' as %2")
+                                        .arg(st.text.at(i)).arg(st.name);
+                return false;
+            }
+            out->append((char) fromAscii[type][c]);
+        }
+        return true;
+    }
+
+    int size;
+    bool be = false;
+
+    switch (dir) {
+    case DIR_BYTE:      size =  1;              break;
+    case DIR_WORDBE:    be = true;  /* fall through */
+    case DIR_WORDLE:    size =  2;              break;
+    case DIR_DWORDBE:   be = true;  /* fall through */
+    case DIR_DWORDLE:   size =  4;              break;
+    case DIR_QWORDBE:   be = true;  /* fall through */
+    case DIR_QWORDLE:   size =  8;              break;
+    case DIR_XWORDBE:   be = true;  /* fall through */
+    default:            size = 16;              break;
+    }
+
+    for (const QString &value : splitValues(st.text)) {
+        quint64 low, high = 0;
+        bool known;
+
+        // 128-bit numbers are only written out in full, $ or h alike
+
+        QString digits = hexDigits(value);
+
+        if (size == 16 && digits.size() > 16) {
+            bool ok1, ok2;
+            high = digits.left(digits.size()-16).toULongLong(&ok1, 16);
+            low = digits.right(16).toULongLong(&ok2, 16);
+            if (!ok1 || !ok2) {
+                *error = value + QStringLiteral(" is not a number");
+                return false;
+            }
+            known = true;
+        } else if (!evaluate(value, &low, &known, error)) {
+            return false;
+        }
+
+        if (final && !known) {
+            *error = QStringLiteral("undefined label in ") + value;
+            return false;
+        }
+        if (final && size < 8 && (low >> (size*8)) &&
+                                 !(size == 1 && fitsByte(low))) {
+            *error = value + QStringLiteral(" does not fit in %1").arg(st.name);
+            return false;
+        }
+
+        // as the disassembler reads them, the high half of an xword comes
+        // first in big-endian and last in little-endian
+
+        quint8 bytes[16];
+        for (int i = 0; i < 8 && i < size; i++) {
+            bytes[i] = low >> (i*8);
+            if (size == 16)
+                bytes[i+8] = high >> (i*8);
+        }
+        if (be)
+            std::reverse(bytes, bytes + size);
+        out->append((const char *) bytes, size);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// EXPRESSIONS
+
+// Labels, $hex, hex with an H suffix, %binary and decimal numbers, combined
+// with + and -, < and > for the low and high byte, and parentheses.
+
+namespace {
+
+struct Parser {
+    const QString &s;
+    const QHash<QString, quint64> &symbols;
+    const QSet<QString> &names;
+    int pos;
+    bool known;
+    QString error;
+
+    bool expression(quint64 *v);
+    bool term(quint64 *v);
+    bool number(const QString &word, quint64 *v);
+
+    bool at(char c) {
+        while (pos < s.size() && s.at(pos).isSpace())
+            pos++;
+        return pos < s.size() && s.at(pos) == QLatin1Char(c);
+    }
+};
+
+static inline bool isSymbolChar(QChar c) {
+    return c.isLetterOrNumber() || c == QLatin1Char('_') ||
+           c == QLatin1Char('.') || c == QLatin1Char('@') || c == QLatin1Char('?');
+}
+
+bool Parser::expression(quint64 *v) {
+    if (!term(v))
+        return false;
+    while (at('+') || at('-')) {
+        bool minus = at('-');
+        quint64 w;
+        pos++;
+        if (!term(&w))
+            return false;
+        *v = minus ? *v - w : *v + w;
+    }
+    return true;
+}
+
+bool Parser::term(quint64 *v) {
+    if (at('<') || at('>') || at('-')) {
+        QChar op = s.at(pos++);
+        if (!term(v))
+            return false;
+        if (op == QLatin1Char('<'))
+            *v &= 0xff;
+        else if (op == QLatin1Char('>'))
+            *v = (*v >> 8) & 0xff;
+        else
+            *v = -*v;
+        return true;
+    }
+
+    if (at('(')) {
+        pos++;
+        if (!expression(v))
+            return false;
+        if (!at(')')) {
+            error = QStringLiteral("missing )");
+            return false;
+        }
+        pos++;
+        return true;
+    }
+
+    if (at('$') || at('%')) {
+        int base = s.at(pos++) == QLatin1Char('$') ? 16 : 2;
+        int start = pos;
+        while (pos < s.size() && s.at(pos).isLetterOrNumber())
+            pos++;
+        bool ok;
+        *v = s.mid(start, pos-start).toULongLong(&ok, base);
+        if (!ok)
+            error = s.mid(start-1, pos-start+1) + QStringLiteral(" is not a number");
+        return ok;
+    }
+
+    int start = pos;
+    while (pos < s.size() && isSymbolChar(s.at(pos)))
+        pos++;
+    QString word = s.mid(start, pos-start);
+
+    if (word.isEmpty()) {
+        error = QStringLiteral("syntax error in ") + s;
+        return false;
+    }
+    if (symbols.contains(word)) {
+        *v = symbols.value(word);
+        return true;
+    }
+    // a label like dah is not $da before it is defined
+    if (!names.contains(word) && number(word, v))
+        return true;
+    if (word.at(0).isDigit()) {
+        error = word + QStringLiteral(" is not a number");
+        return false;
+    }
+
+    *v = 0;                     // forward reference or undefined
+    known = false;
+    return true;
+}
+
+bool Parser::number(const QString &word, quint64 *v) {
+    bool ok;
+
+    if (word.at(0).isDigit()) {
+        *v = word.toULongLong(&ok, 10);
+        if (ok)
+            return true;
+    }
+    if (word.size() > 1 && word.endsWith(QStringLiteral("h")))
+        *v = word.left(word.size()-1).toULongLong(&ok, 16);
+    else if (word.size() > 1 && word.endsWith(QStringLiteral("H")))
+        *v = word.left(word.size()-1).toULongLong(&ok, 16);
+    else
+        return false;
+    return ok;
+}
+
+} // namespace
+
+bool Reassembler::evaluate(const QString &expr, quint64 *value, bool *known,
+                           QString *error) const {
+    Parser p = { expr, symbols, names, 0, true, QString() };
+
+    bool ok = p.expression(value);
+
+    while (ok && p.pos < expr.size() && expr.at(p.pos).isSpace())
+        p.pos++;
+    if (!ok || p.pos < expr.size()) {
+        *error = p.error.isEmpty() ? QStringLiteral("syntax error in ") + expr : p.error;
+        return false;
+    }
+    *known = p.known;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// VERIFY
+
+QStringList Reassembler::verify(void) const {
+    QStringList report;
+    QString prefix = Disassembler->hexPrefix, suffix = Disassembler->hexSuffix;
+
+    if (chunks.size() != segments.size())
+        report.append(QStringLiteral("%1 segments, but %2 .org lines")
+                                    .arg(segments.size()).arg(chunks.size()));
+
+    for (int i = 0; i < segments.size() && i < chunks.size(); i++) {
+        const struct segment *s = &segments.at(i);
+        const struct chunk *c = &chunks.at(i);
+        quint64 size = s->end - s->start + 1;
+        QString which = QStringLiteral("Segment %1 (%2): ").arg(i+1).arg(s->name);
+
+        if (c->start != s->start) {
+            report.append(which + QStringLiteral("assembled at %1%2%3")
+                                  .arg(prefix).arg(c->start, 4, 16, QChar('0')).arg(suffix));
+            continue;
+        }
+
+        quint64 n = qMin<quint64>(size, c->data.size());
+        const char *data = c->data.constData();
+        quint64 j = 0;
+        while (j < n && (quint8) data[j] == s->data[j])
+            j++;
+
+        if (j < n)
+            report.append(which + QStringLiteral("first difference at %1%2%3")
+                                  .arg(prefix).arg(s->start + j, 4, 16, QChar('0')).arg(suffix));
+        else if ((quint64) c->data.size() != size)
+            report.append(which + QStringLiteral("%1 bytes instead of %2")
+                                  .arg(c->data.size()).arg(size));
+    }
+    return report;
+}
@@ -0,0 +1,87 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+
+#ifndef REASSEMBLER_H
+#define REASSEMBLER_H
+
+#include "pch.h"
+#include "disassembler.h"
+
+// Assembles what export_assembly() writes in its verbatim format, for the
+// CPU of the project, to check that the exported source rebuilds the
+// segments byte for byte. Each .org starts a new chunk of output, which the
+// exporter writes once per segment.
+//
+// Like most assemblers, zero page or 8-bit operands are used when the value
+// is known and fits, and forward references get the widest operand. A
+// number written with four or more digits, like $0012, keeps the wide
+// operand the listing printed it with.
+
+class Reassembler {
+public:
+    Reassembler();
+
+    bool assemble(const QString &source, QString *error);
+
+    int chunkCount(void) const { return chunks.size(); }
+    quint64 chunkStart(int chunk) const { return chunks.at(chunk).start; }
+    const QByteArray &chunkData(int chunk) const { return chunks.at(chunk).data; }
+
+    // Compares the chunks with the segments. Returns one line for each
+    // segment that differs, with its first mismatching address.
+    QStringList verify(void) const;
+
+private:
+    struct chunk {
+        quint64 start;
+        QByteArray data;
+    };
+
+    struct statement {
+        int line;
+        int kind;               // STMT_*
+        QString name;           // label, equate, mnemonic or directive
+        QString text;           // what follows it
+        int shape;              // index in shapes, picked during pass 1
+    };
+
+    QVector<struct insnshape> shapes;
+    QHash<QString, QVector<int>> byMnemonic;   // most specific first
+    QHash<QString, quint64> symbols;
+    QSet<QString> names;        // all labels and equates, never numbers
+    QVector<struct chunk> chunks;
+    quint8 fromAscii[DT_LAST][256];
+
+    bool parse(const QString &source, QVector<struct statement> &program,
+               QString *error);
+    bool pass(QVector<struct statement> &program, bool final, QString *error);
+    bool instruction(struct statement &st, quint64 pc, bool final,
+                     QByteArray *out, QString *error);
+    bool directive(const struct statement &st, bool final, QByteArray *out,
+                   QString *error);
+
+    bool evaluate(const QString &expr, quint64 *value, bool *known,
+                  QString *error) const;
+};
+
+#endif // REASSEMBLER_H
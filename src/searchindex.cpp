@@ -0,0 +1,481 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#include "searchindex.h"
+#include <algorithm>
+
+SearchIndex searchIndex;
+
+static inline quint64 trigram(const QString &text, int i) {
+    return (quint64) text.at(i).unicode() << 32 |
+           (quint64) text.at(i+1).unicode() << 16 |
+           (quint64) text.at(i+2).unicode();
+}
+
+static void trigrams(const QString &text, QVector<quint64> &out) {
+    out.clear();
+    for (int i = 0; i + 3 <= text.size(); i++)
+        out.append(trigram(text, i));
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+static inline bool isWordChar(QChar c) {
+    return c.isLetterOrNumber() || c == QLatin1Char('_');
+}
+
+// ----------------------------------------------------------------------------
+// MAINTENANCE
+
+// Ids only ever grow until the next compaction, so appending keeps every
+// posting list sorted.
+
+int SearchIndex::addEntry(enum searchkind kind, int segment, quint64 address,
+                          const QString &text, const QString &context) {
+    int id = entries.size();
+    entries.append({ kind, segment, address, text, context, true });
+
+    QVector<quint64> grams;
+    trigrams(text, grams);
+    for (quint64 g : qAsConst(grams))
+        postings[g].append(id);
+
+    return id;
+}
+
+// Removed entries stay in the posting lists until they outnumber the live
+// ones. Queries skip them.
+
+void SearchIndex::removeEntry(int id) {
+    entries[id].alive = false;
+    dead++;
+}
+
+void SearchIndex::compact(void) {
+    QVector<int> remap(entries.size(), -1);
+    QVector<struct entry> live;
+
+    live.reserve(entries.size() - dead);
+    for (int i = 0; i < entries.size(); i++) {
+        if (!entries.at(i).alive)
+            continue;
+        remap[i] = live.size();
+        live.append(entries.at(i));
+    }
+
+    for (auto &list : postings) {
+        int n = 0;
+        for (int id : qAsConst(list))
+            if (remap.at(id) >= 0)
+                list[n++] = remap.at(id);
+        list.resize(n);
+    }
+
+    for (auto it = postings.begin(); it != postings.end(); ) {
+        if (it.value().isEmpty())
+            it = postings.erase(it);
+        else
+            ++it;
+    }
+
+    auto fix = [&remap](QHash<quint64, int> &ids) {
+        for (auto &id : ids)
+            id = remap.at(id);
+    };
+
+    fix(globalIds);
+    fix(noteIds);
+    for (auto &s : perSegment) {
+        fix(s.labels);
+        fix(s.comments);
+        fix(s.operands);
+    }
+
+    entries = live;
+    dead = 0;
+}
+
+// Bring ids in line with map. Unchanged texts keep their entry.
+
+void SearchIndex::sync(QHash<quint64, int> &ids,
+                       const QMap<quint64, QString> &map,
+                       enum searchkind kind, int segment) {
+    for (auto it = ids.begin(); it != ids.end(); ) {
+        auto m = map.constFind(it.key());
+        if (m == map.constEnd() || entries.at(it.value()).text != m.value()) {
+            removeEntry(it.value());
+            it = ids.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto m = map.constBegin(); m != map.constEnd(); ++m) {
+        if (!ids.contains(m.key()))
+            ids.insert(m.key(), addEntry(kind, segment, m.key(), m.value(),
+                                         QString()));
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void SearchIndex::update(int segment) {
+    if (segment < 0 || segment >= segments.size())
+        return;
+
+    if (perSegment.size() < segments.size())
+        perSegment.resize(segments.size());
+
+    const struct segment *s = &segments.at(segment);
+    struct segmentIds *ids = &perSegment[segment];
+
+    sync(ids->labels, s->localLabels, SK_LOCAL_LABEL, segment);
+    sync(ids->comments, s->comments, SK_COMMENT, segment);
+
+    // the first line is the .org directive, it does not have an address
+
+    QHash<quint64, int> &ops = ids->operands;
+    QHash<quint64, int> seen;
+
+    seen.reserve(s->disassembly.size());
+    for (int i = 1; i < s->disassembly.size(); i++) {
+        const struct disassembly &d = s->disassembly.at(i);
+        if (d.arguments.isEmpty())
+            continue;
+
+        int id = ops.value(d.address, -1);
+        if (id >= 0) {
+            const struct entry &e = entries.at(id);
+            if (e.text == d.arguments && e.context == d.instruction) {
+                seen.insert(d.address, id);
+                continue;
+            }
+        }
+        seen.insert(d.address, addEntry(SK_OPERAND, segment, d.address,
+                                        d.arguments, d.instruction));
+    }
+
+    for (auto it = ops.constBegin(); it != ops.constEnd(); ++it) {
+        if (seen.value(it.key(), -1) != it.value())
+            removeEntry(it.value());
+    }
+    ops = seen;
+
+    ids->stale = false;
+
+    if (globalsStale) {
+        sync(globalIds, globalLabels, SK_GLOBAL_LABEL, -1);
+        globalsStale = false;
+    }
+
+    if (dead > 4096 && dead > entries.size() / 2)
+        compact();
+}
+
+void SearchIndex::updateNotes(const QString &notes) {
+    QMap<quint64, QString> lines;
+    const QStringList list = notes.split(QLatin1Char('\n'));
+
+    for (int i = 0; i < list.size(); i++)
+        if (!list.at(i).isEmpty())
+            lines.insert(i, list.at(i));
+
+    sync(noteIds, lines, SK_NOTES, -1);
+}
+
+void SearchIndex::invalidate(void) {
+    for (auto &s : perSegment)
+        s.stale = true;
+    globalsStale = true;
+}
+
+void SearchIndex::invalidate(int segment) {
+    if (segment >= 0 && segment < perSegment.size())
+        perSegment[segment].stale = true;
+}
+
+void SearchIndex::clear(void) {
+    entries.clear();
+    postings.clear();
+    globalIds.clear();
+    noteIds.clear();
+    perSegment.clear();
+    globalsStale = true;
+    dead = 0;
+}
+
+bool SearchIndex::isStale(int segment) const {
+    if (segment >= perSegment.size())
+        return true;
+    return perSegment.at(segment).stale || globalsStale;
+}
+
+// ----------------------------------------------------------------------------
+// QUERY
+
+// Literal runs every match of pattern must contain. Anything that is not
+// a plain sequence of (escaped) characters ends a run. Alternation or
+// lookaround makes nothing required, in which case the list is empty.
+
+QStringList SearchIndex::requiredLiterals(const QString &pattern) {
+    QStringList result;
+    QString run;
+    int depth = 0;
+
+    if (pattern.contains(QLatin1Char('|')) ||
+            pattern.contains(QStringLiteral("(?")))
+        return result;
+
+    auto endRun = [&]() {
+        if (run.size() >= 3)
+            result.append(run);
+        run.clear();
+    };
+
+    auto isQuantifier = [](QChar q) {
+        return q == QLatin1Char('*') || q == QLatin1Char('?') ||
+               q == QLatin1Char('{');
+    };
+
+    // i points at a quantifier, move it to its last character
+
+    auto skipQuantifier = [&pattern](int &i) {
+        if (pattern.at(i) == QLatin1Char('{'))
+            while (i + 1 < pattern.size() && pattern.at(i) != QLatin1Char('}'))
+                i++;
+    };
+
+    for (int i = 0; i < pattern.size(); i++) {
+        QChar c = pattern.at(i);
+        QChar next = i + 1 < pattern.size() ? pattern.at(i+1) : QChar();
+
+        // a quantified character is optional or repeated, drop it
+
+        if (c != QLatin1Char('\\') && (isQuantifier(next) ||
+                (next == QLatin1Char('+') && c == QLatin1Char(')')))) {
+            endRun();
+            if (c == QLatin1Char(')'))
+                depth--;
+            i++;
+            skipQuantifier(i);
+            continue;
+        }
+
+        switch (c.unicode()) {
+        case '\\':
+            if (next.isNull())
+                break;
+            if (next.isLetterOrNumber()) {
+                // classes are fine, anything with arguments is not worth it
+                if (!QStringLiteral("dDwWsSbB").contains(next))
+                    return QStringList();
+                endRun();
+                i++;
+            } else if (i + 2 < pattern.size() && isQuantifier(pattern.at(i+2))) {
+                endRun();
+                i += 2;
+                skipQuantifier(i);
+            } else {
+                if (depth)
+                    endRun();
+                else
+                    run.append(next);
+                i++;
+            }
+            break;
+        case '(':
+            endRun();
+            depth++;
+            break;
+        case ')':
+            endRun();
+            depth--;
+            break;
+        case '[':
+            endRun();
+            while (i < pattern.size() && pattern.at(i) != QLatin1Char(']')) {
+                if (pattern.at(i) == QLatin1Char('\\'))
+                    i++;
+                i++;
+            }
+            break;
+        case '{':
+            endRun();
+            skipQuantifier(i);
+            break;
+        case '.': case '^': case '$': case '+': case '*': case '?': case '}':
+            endRun();
+            break;
+        default:
+            if (depth)
+                endRun();
+            else
+                run.append(c);
+            break;
+        }
+    }
+    endRun();
+
+    return result;
+}
+
+// Entries that contain all trigrams of all literals. Without any trigram to
+// go on, *all is set and the caller has to look at every entry.
+
+QVector<int> SearchIndex::candidates(const QStringList &literals, bool *all) {
+    QVector<quint64> grams, g;
+    QVector<const QVector<int> *> lists;
+    QVector<int> result;
+
+    for (const auto &literal : literals) {
+        trigrams(literal, g);
+        grams += g;
+    }
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+
+    *all = grams.isEmpty();
+    if (*all)
+        return result;
+
+    for (quint64 gram : qAsConst(grams)) {
+        auto it = postings.constFind(gram);
+        if (it == postings.constEnd())
+            return result;
+        lists.append(&it.value());
+    }
+
+    std::sort(lists.begin(), lists.end(),
+              [](const QVector<int> *a, const QVector<int> *b) {
+                  return a->size() < b->size(); });
+
+    result = *lists.at(0);
+    for (int l = 1; l < lists.size() && !result.isEmpty(); l++) {
+        const QVector<int> &other = *lists.at(l);
+        int n = 0, j = 0;
+        for (int id : qAsConst(result)) {
+            while (j < other.size() && other.at(j) < id)
+                j++;
+            if (j == other.size())
+                break;
+            if (other.at(j) == id)
+                result[n++] = id;
+        }
+        result.resize(n);
+    }
+
+    return result;
+}
+
+bool SearchIndex::matches(const QString &text, const QString &what,
+                          bool wholeWord) {
+    int from = 0, pos;
+
+    while ((pos = text.indexOf(what, from)) >= 0) {
+        if (!wholeWord)
+            return true;
+
+        int end = pos + what.size();
+        if ((pos == 0 || !isWordChar(text.at(pos-1))) &&
+                (end == text.size() || !isWordChar(text.at(end))))
+            return true;
+
+        from = pos + 1;
+    }
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+
+QList<struct searchhit> SearchIndex::find(const QString &what, bool regex,
+                                          bool wholeWord, QString *error) {
+    QList<struct searchhit> hits;
+    QRegularExpression re;
+    QVector<int> ids;
+    bool all;
+
+    if (regex) {
+        re.setPattern(wholeWord ? QStringLiteral("\\b(?:%1)\\b").arg(what)
+                                : what);
+        if (!re.isValid()) {
+            *error = re.errorString();
+            return hits;
+        }
+        ids = candidates(requiredLiterals(what), &all);
+    } else {
+        ids = candidates(QStringList(what), &all);
+    }
+
+    if (all) {
+        ids.resize(entries.size());
+        for (int i = 0; i < ids.size(); i++)
+            ids[i] = i;
+    }
+
+    for (int id : qAsConst(ids)) {
+        const struct entry &e = entries.at(id);
+        QString highlight = what;
+
+        if (!e.alive)
+            continue;
+
+        if (regex) {
+            QRegularExpressionMatch m = re.match(e.text);
+            if (!m.hasMatch())
+                continue;
+            highlight = m.captured(0);
+        } else if (!matches(e.text, what, wholeWord)) {
+            continue;
+        }
+
+        QString line = e.context.isEmpty() ? e.text
+                                           : e.context + QStringLiteral(" ") + e.text;
+
+        if (e.kind == SK_GLOBAL_LABEL) {
+            for (int i = 0; i < segments.size(); i++) {
+                const struct segment *s = &segments.at(i);
+                if (e.address >= s->start && e.address <= s->end)
+                    hits.append({ e.kind, i, e.address, line, highlight });
+            }
+            continue;
+        }
+
+        if (e.kind == SK_LOCAL_LABEL) {
+            const struct segment *s = &segments.at(e.segment);
+            if (e.address < s->start || e.address > s->end)
+                continue;
+        }
+
+        hits.append({ e.kind, e.segment, e.address, line, highlight });
+    }
+
+    std::sort(hits.begin(), hits.end(),
+              [](const struct searchhit &a, const struct searchhit &b) {
+                  if (a.kind != b.kind)
+                      return a.kind < b.kind;
+                  if (a.segment != b.segment)
+                      return a.segment < b.segment;
+                  return a.address < b.address;
+              });
+
+    return hits;
+}
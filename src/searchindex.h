@@ -0,0 +1,102 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include "pch.h"
+
+// Order of the results in the references table
+
+enum searchkind {
+    SK_GLOBAL_LABEL,
+    SK_LOCAL_LABEL,
+    SK_OPERAND,
+    SK_COMMENT,
+    SK_NOTES
+};
+
+struct searchhit {
+    enum searchkind kind;
+    int segment;
+    quint64 address;                    // line number for notes
+    QString line;
+    QString highlight;
+};
+
+// Trigram index over labels, comments, notes and the rendered operands of
+// all segments. A segment is refreshed by diffing its lines against what
+// was indexed before, so only the lines that changed are tokenized again.
+// Segments that might have changed are marked stale and need to be
+// regenerated before searching.
+
+class SearchIndex {
+public:
+    void update(int segment);           // call after generateDisassembly
+    void updateNotes(const QString &notes);
+    void invalidate(void);              // global labels or constants changed
+    void invalidate(int segment);
+    void clear(void);                   // segments were deleted or moved
+    bool isStale(int segment) const;
+
+    QList<struct searchhit> find(const QString &what, bool regex,
+                                 bool wholeWord, QString *error);
+
+private:
+    struct entry {
+        enum searchkind kind;
+        int segment;
+        quint64 address;
+        QString text;                   // the searchable part
+        QString context;                // shown in front of it, not searched
+        bool alive;
+    };
+
+    struct segmentIds {
+        QHash<quint64, int> labels, comments, operands;
+        bool stale = true;
+    };
+
+    QVector<struct entry> entries;
+    QHash<quint64, QVector<int>> postings;  // trigram --> sorted entry ids
+    int dead = 0;
+
+    QHash<quint64, int> globalIds;
+    QHash<quint64, int> noteIds;
+    QVector<struct segmentIds> perSegment;
+    bool globalsStale = true;
+
+    int addEntry(enum searchkind kind, int segment, quint64 address,
+                 const QString &text, const QString &context);
+    void removeEntry(int id);
+    void sync(QHash<quint64, int> &ids, const QMap<quint64, QString> &map,
+              enum searchkind kind, int segment);
+    void compact(void);
+    QVector<int> candidates(const QStringList &literals, bool *all);
+    static bool matches(const QString &text, const QString &what,
+                        bool wholeWord);
+    static QStringList requiredLiterals(const QString &pattern);
+};
+
+extern SearchIndex searchIndex;
+
+#endif // SEARCHINDEX_H
@@ -20,6 +20,7 @@
 //
 // ---------------------------------------------------------------------------
 
+#include "constants.h"
 #include "selectconstantsgoupwindow.h"
 #include "ui_selectconstantsgoupwindow.h"
 
@@ -35,14 +36,11 @@ selectConstantsGoupWindow::selectConstantsGoupWindow(QWidget *parent) :
 
     t->setRowCount(0);
 
-    QMap<quint64, struct constantsGroup>::iterator iter;
-
-    for (iter = constantsGroups.begin(); iter != constantsGroups.end(); ++iter) {
+    for (quint16 groupID : constantsGroups.ids()) {
         row = t->rowCount();
         t->setRowCount(row+1);
 
-        quint64 groupID = iter.key();
-        QString groupName = iter.value().name;
+        QString groupName = constantsGroups.group(groupID)->name;
 
         QString vhi = QStringLiteral("%1").arg(groupID);
         t->setVerticalHeaderItem(row, new QTableWidgetItem(vhi));
@@ -72,7 +70,7 @@ void selectConstantsGoupWindow::accept() {
         QTableWidgetSelectionRange r = ranges.first();
         qint64 row = r.topRow();
 
-        groupID = t->verticalHeaderItem(row)->text().toULongLong();
+        groupID = t->verticalHeaderItem(row)->text().toUShort();
     }
 
     setResult(QDialog::Accepted);
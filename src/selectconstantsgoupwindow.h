@@ -37,7 +37,7 @@ public:
     explicit selectConstantsGoupWindow(QWidget *parent = nullptr);
     ~selectConstantsGoupWindow() override;
 
-    quint64 groupID{};
+    quint16 groupID{};
 
 public Q_SLOTS:
     void accept() override;
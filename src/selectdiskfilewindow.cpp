@@ -0,0 +1,72 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+
+#include "selectdiskfilewindow.h"
+#include "ui_selectdiskfilewindow.h"
+
+selectdiskfilewindow::selectdiskfilewindow(QWidget *parent, const DiskImage *image) :
+    QDialog(parent),
+    ui(new Ui::selectdiskfilewindow),
+    image(image)
+{
+    ui->setupUi(this);
+
+    QString title = image->title.isEmpty() ? QStringLiteral("Disk image")
+                                           : QStringLiteral("Disk \"%1\"").arg(image->title);
+    ui->labelDisk->setText(QStringLiteral("%1, %2 free sectors").arg(title).arg(image->freeSectors));
+
+    QTableWidget *t = ui->tableFiles;
+    t->setColumnCount(2);
+    t->setRowCount(image->files.size());
+
+    for (int row = 0; row < image->files.size(); row++) {
+        const struct diskfile &file = image->files.at(row);
+
+        t->setItem(row, 0, new QTableWidgetItem(file.name));
+        t->setItem(row, 1, new QTableWidgetItem(QStringLiteral("%1").arg(file.blocks)));
+    }
+
+    t->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    t->resizeColumnToContents(1);
+    t->setCurrentCell(0,0);
+    t->setFocus();
+}
+
+selectdiskfilewindow::~selectdiskfilewindow()
+{
+    delete ui;
+}
+
+void selectdiskfilewindow::accept() {
+    QTableWidget *t = ui->tableFiles;
+    const QList<QTableWidgetSelectionRange> ranges = t->selectedRanges();
+
+    chosen.clear();
+    for (const auto &range : ranges) {
+        for (int row = range.topRow(); row <= range.bottomRow(); row++)
+            chosen.append(image->files.at(row));
+    }
+
+    setResult(QDialog::Accepted);
+    hide();
+}
@@ -0,0 +1,269 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#include "disassembler.h"
+#include "signatures.h"
+
+SignatureLibrary signatureLibrary;
+
+// The key only looks at the length and the opcode of each instruction, so
+// it is the same no matter where the routine was assembled to.
+
+static inline quint64 keyAdd(quint64 key, int size, const quint8 *opcode) {
+    int n = qMin(opcodeBytes(opcode), size);
+
+    key = (key ^ size) * 0x100000001b3ULL;
+    for (int i = 0; i < n; i++)
+        key = (key ^ opcode[i]) * 0x100000001b3ULL;
+    return key;
+}
+
+#define KEY_SEED 0xcbf29ce484222325ULL
+
+static bool familyMatches(const QString &family) {
+    if (family == QStringLiteral("6502"))
+        return cputype < CT_INTEL_8080;
+    if (family == QStringLiteral("8080"))       // runs on a Z80, too
+        return cputype >= CT_INTEL_8080;
+    if (family == QStringLiteral("z80"))
+        return cputype >= CT_ZILOG_Z80;
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+// LOAD
+
+bool SignatureLibrary::load(const QString &filename, QString *error) {
+    QFile file(filename);
+    bool wanted = false;
+    int lineno = 0;
+
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        *error = QStringLiteral("Failed to open ") + filename;
+        return false;
+    }
+
+    QTextStream in(&file);
+
+    while (!in.atEnd()) {
+        QString line = in.readLine();
+        QString comment;
+        lineno++;
+
+        int semicolon = line.indexOf(QLatin1Char(';'));
+        if (semicolon >= 0) {
+            comment = line.mid(semicolon+1).trimmed();
+            line = line.left(semicolon);
+        }
+        line = line.trimmed();
+
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#')))
+            continue;
+
+        if (line.startsWith(QLatin1Char('['))) {
+            wanted = familyMatches(line.mid(1, line.size()-2).toLower());
+            continue;
+        }
+        if (!wanted)
+            continue;
+
+        QStringList tokens = line.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+        QString name = tokens.takeFirst();
+        struct signature sig = { name, comment, BytePattern() };
+        QString where = QStringLiteral("%1:%2: ").arg(filename).arg(lineno);
+        quint64 key = KEY_SEED;
+
+        if (tokens.size() < SIGNATURE_KEY_INSNS) {
+            *error = where + QStringLiteral("a signature needs at least %1 instructions")
+                                                    .arg(SIGNATURE_KEY_INSNS);
+            return false;
+        }
+
+        for (int i = 0; i < SIGNATURE_KEY_INSNS; i++) {
+            const QString &insn = tokens.at(i);
+            quint8 opcode[2];
+            bool ok0, ok1 = true;
+
+            opcode[0] = insn.mid(0, 2).toUInt(&ok0, 16);
+            if (insn.size() >= 4)
+                opcode[1] = insn.mid(2, 2).toUInt(&ok1, 16);
+            if (!ok0 || (!ok1 && opcodeBytes(opcode) == 2)) {
+                *error = where + QStringLiteral("opcodes cannot be wildcards");
+                return false;
+            }
+            key = keyAdd(key, insn.size() / 2, opcode);
+        }
+
+        if (!sig.pattern.parse(tokens.join(QLatin1Char(' ')), error)) {
+            *error = where + *error;
+            return false;
+        }
+
+        index[key].append(signatures.size());
+        signatures.append(sig);
+    }
+
+    return true;
+}
+
+void SignatureLibrary::clear(void) {
+    signatures.clear();
+    index.clear();
+}
+
+// ----------------------------------------------------------------------------
+// SCAN
+
+// runs of consecutive instructions, skip .org. Runs that are too short to
+// hold a key are left out.
+
+void SignatureLibrary::collect(int segment, struct signaturecode &code) const {
+    const struct segment *s = &segments.at(segment);
+    const QList<struct disassembly> &lines = s->disassembly;
+
+    code.offsets.clear();
+    code.sizes.clear();
+    code.runs.clear();
+
+    if (signatures.isEmpty())
+        return;
+
+    int first = 1;
+    while (first < lines.size()) {
+        int last = first;
+        quint64 next = lines.at(first).address;
+
+        while (last < lines.size() && lines.at(last).address == next &&
+                    next >= s->start && next <= s->end &&
+                    s->datatypes[next - s->start] == DT_CODE) {
+            next += lines.at(last).size;
+            last++;
+        }
+        if (last == first) {
+            first++;
+            continue;
+        }
+
+        if (last - first >= SIGNATURE_KEY_INSNS) {
+            code.runs.append(code.offsets.size());
+            for (int i = first; i < last; i++) {
+                code.offsets.append(lines.at(i).address - s->start);
+                code.sizes.append(lines.at(i).size);
+            }
+        }
+
+        first = last;
+    }
+}
+
+void SignatureLibrary::scanSegment(int segment, const struct signaturecode &code,
+                                   QVector<struct signaturehit> &hits) const {
+    const struct segment *s = &segments.at(segment);
+    quint64 size = s->end - s->start + 1;
+
+    for (int r = 0; r < code.runs.size(); r++) {
+        int first = code.runs.at(r);
+        int last = r+1 < code.runs.size() ? code.runs.at(r+1)
+                                          : code.offsets.size();
+
+        for (int i = first; i + SIGNATURE_KEY_INSNS <= last; i++) {
+            quint64 key = KEY_SEED;
+            for (int k = i; k < i + SIGNATURE_KEY_INSNS; k++)
+                key = keyAdd(key, code.sizes.at(k), s->data + code.offsets.at(k));
+
+            auto it = index.constFind(key);
+            if (it == index.constEnd())
+                continue;
+
+            quint64 offset = code.offsets.at(i);
+            for (int sig : it.value()) {
+                const BytePattern &p = signatures.at(sig).pattern;
+                if (offset + p.size() <= size && p.matchesAt(s->data + offset))
+                    hits.append({ segment, s->start + offset, sig });
+            }
+        }
+    }
+}
+
+QVector<struct signaturehit> SignatureLibrary::scan(
+                        const QVector<struct signaturecode> &code) const {
+    QVector<QVector<struct signaturehit>> perSegment(code.size());
+    QVector<struct signaturehit> hits;
+    QThreadPool pool;
+
+    for (int i = 0; i < code.size(); i++) {
+        const struct signaturecode *in = &code.at(i);
+        QVector<struct signaturehit> *out = &perSegment[i];
+        if (in->runs.isEmpty())
+            continue;
+        pool.start([this, i, in, out]() {
+            scanSegment(i, *in, *out);
+        });
+    }
+    pool.waitForDone();
+
+    for (const auto &list : qAsConst(perSegment))
+        hits += list;
+    return hits;
+}
+
+// ----------------------------------------------------------------------------
+// APPLY
+
+// Existing labels and comments win. A routine that is found more than once
+// gets numbered names.
+
+int SignatureLibrary::apply(const QVector<struct signaturehit> &hits,
+                            bool generateLocalLabels) const {
+    QSet<QString> used;
+    int added = 0;
+
+    for (const auto &label : qAsConst(globalLabels))
+        used.insert(label);
+    for (const auto &s : qAsConst(segments))
+        for (const auto &label : qAsConst(s.localLabels))
+            used.insert(label);
+
+    for (const auto &hit : hits) {
+        struct segment *s = &segments[hit.segment];
+        const struct signature &sig = signatures.at(hit.signature);
+
+        if (!s->localLabels.contains(hit.address) &&
+                                !globalLabels.contains(hit.address)) {
+            QString name = sig.name;
+            for (int n = 1; used.contains(name); n++)
+                name = sig.name + QStringLiteral("_%1").arg(n);
+            used.insert(name);
+
+            if (generateLocalLabels)
+                s->localLabels.insert(hit.address, name);
+            else
+                globalLabels.insert(hit.address, name);
+            added++;
+        }
+
+        if (!sig.comment.isEmpty() && !s->comments.contains(hit.address))
+            s->comments.insert(hit.address, sig.comment);
+    }
+
+    return added;
+}
@@ -0,0 +1,87 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef SIGNATURES_H
+#define SIGNATURES_H
+
+#include "pch.h"
+#include "bytesearch.h"
+
+// Signature files (*.signatures) have one routine per line:
+//
+//   [6502]
+//   clear_page  a900 a8 91?? c8 d0fb   ; clear 256 bytes at (ptr)
+//
+// A [section] selects the CPU family (6502, 8080 or z80) of the lines that
+// follow. Instructions are separated by spaces, ?? marks a relocatable
+// operand byte. Everything after ';' becomes the comment.
+
+#define SIGNATURE_KEY_INSNS 4           // instructions that form the hash key
+
+struct signature {
+    QString name, comment;
+    BytePattern pattern;
+};
+
+// The instructions of the DT_CODE runs of one segment, all that a scan
+// needs of its listing. They are collected one segment at a time, so the
+// listing cache can drop the listings in the meantime.
+
+struct signaturecode {
+    QVector<quint32> offsets;           // instruction starts, in the segment
+    QVector<quint8> sizes;
+    QVector<int> runs;                  // index of the first of each run
+};
+
+struct signaturehit {
+    int segment;
+    quint64 address;
+    int signature;
+};
+
+class SignatureLibrary {
+public:
+    bool load(const QString &filename, QString *error);
+    void clear(void);
+    int size(void) const { return signatures.size(); }
+
+    // the DT_CODE runs of one segment, its disassembly has to be up-to-date
+    void collect(int segment, struct signaturecode &code) const;
+
+    // all segments in parallel, one per thread, code is by segment
+    QVector<struct signaturehit> scan(const QVector<struct signaturecode> &code) const;
+
+    // returns the number of labels added
+    int apply(const QVector<struct signaturehit> &hits,
+              bool generateLocalLabels) const;
+
+private:
+    QVector<struct signature> signatures;
+    QHash<quint64, QVector<int>> index;     // opcode key --> signatures
+
+    void scanSegment(int segment, const struct signaturecode &code,
+                     QVector<struct signaturehit> &hits) const;
+};
+
+extern SignatureLibrary signatureLibrary;
+
+#endif // SIGNATURES_H
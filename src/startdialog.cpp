@@ -21,11 +21,14 @@
 // ---------------------------------------------------------------------------
 
 #include "architecture.h"
+#include "banks.h"
 #include "compiler.h"
+#include "compressedfile.h"
 #include "disassembler.h"
 #include "loaders.h"
 #include "loadsaveproject.h"
 #include "platform.h"
+#include "profiler.h"
 #include "startdialog.h"
 #include "ui_startdialog.h"
 
@@ -42,7 +45,7 @@ QString QtVersionString;
 QString DateTimeString;
 
 quint32 filetype, cputype;
-Loader *Loader;
+Loader *Loader = nullptr;
 
 StartDialog::StartDialog(QWidget *parent) :
     QDialog(parent),
@@ -92,16 +95,39 @@ StartDialog::~StartDialog()
     delete ui;
 }
 
+// select the best guess for the file type and its cpu in the combo boxes
+
 void StartDialog::onButtonBrowseFileDisasm_clicked()
 {
-    QString file = QFileDialog::getOpenFileName();
-    if (!file.isEmpty())
-        ui->lineFileDisasm->setText(file);
+    QString name = QFileDialog::getOpenFileName();
+    if (name.isEmpty())
+        return;
+
+    ui->lineFileDisasm->setText(name);
+
+    QFile file(name);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QVector<struct loadercandidate> candidates = probeFile(file);
+    file.close();
+
+    if (candidates.isEmpty())
+        return;
+
+    const struct filetype &type = filetypes.at(candidates.at(0).filetype);
+
+    ui->comboFileType->setCurrentIndex(candidates.at(0).filetype);
+    for (int i = 0; i < cputypes.size(); i++) {
+        if (cputypes.at(i).id == type.cputype)
+            ui->comboCPUType->setCurrentIndex(i);
+    }
 }
 
 void StartDialog::onButtonLoadExistingProject_clicked()
 {
     segments.clear();
+    bankGroups.clear();
     load_existing_project = load_project(this);
     if (load_existing_project) close();
 }
@@ -109,6 +135,7 @@ void StartDialog::onButtonLoadExistingProject_clicked()
 void StartDialog::onButtonNewProject_clicked()
 {
     QMessageBox msg;
+    QString error;
 
     if (ui->lineFileDisasm->text().isEmpty()) {
         msg.setText(QStringLiteral("Some fields are left empty!"));
@@ -116,98 +143,90 @@ void StartDialog::onButtonNewProject_clicked()
         return;
     }
 
+    // retrieve cputype from table as index is not necessarily the same
+    // there can be holes in the enumeration
+
+    if (!loadFile(ui->lineFileDisasm->text(), ui->comboFileType->currentIndex(),
+                  cputypes.at(ui->comboCPUType->currentIndex()).id, true, &error)) {
+        msg.setText(error);
+        msg.exec();
+        return;
+    }
 
-    FileToDisassemble.clear();
-    FileToDisassemble.append(ui->lineFileDisasm->text());
+    create_new_project = true;
+    close();
+}
+
+// ---------------------------------------------------------------------------
 
-    filetype = ui->comboFileType->currentIndex();
+// Load name into segments, as filetypes[type] or detected if type < 0. The
+// streams of a compressed file are loaded one after the other. On success
+// the globals are set up for a new project, cpu < 0 takes the default of
+// the (first) file type. Unless interactive, loaders do not ask anything.
+
+bool StartDialog::loadFile(const QString &name, int type, int cpu,
+                           bool interactive, QString *error)
+{
+    FileToDisassemble = name;
 
     // Open file
 
     QFile file(FileToDisassemble);
     file.open(QIODevice::ReadOnly);
     if (!file.isOpen()) {
-        msg.setText("Failed to open " + FileToDisassemble);
-        msg.exec();
-        return;
+        *error = "Failed to open " + FileToDisassemble;
+        return false;
     }
 
-    // Select Loader type
-
-    switch(filetypes.at(filetype).id) {
-    case FT_RAW_FILE:
-        Loader = new LoaderRaw();
-        break;
-    case FT_ATARI8BIT_BINARY:
-        Loader = new LoaderAtari8bitBinary();
-        altfont = FONT_ATARI8BIT;
-        break;
-    case FT_ATARI8BIT_SAP:
-        Loader = new LoaderAtari8bitSAP();
-        altfont = FONT_ATARI8BIT;
-        break;
-    case FT_ATARI8BIT_CAR:
-        Loader = new LoaderAtari8bitCar();
-        altfont = FONT_ATARI8BIT;
-        break;
-    case FT_C64_BINARY:
-        Loader = new LoaderC64Binary();
-        altfont = FONT_C64;
-        break;
-    case FT_C64_PSID:
-        Loader = new LoaderC64PSID();
-        altfont = FONT_C64;
-        break;
-    case FT_ATARI2600_2K4K:
-        Loader = new LoaderAtari2600ROM2K4K();
-         break;
-    case FT_ORIC_TAP:
-        Loader = new LoaderOricTap();
-        break;
-    case FT_APPLE2_DOS33:
-        Loader = new LoaderApple2DOS33();
-        break;
-    case FT_APPLE2_APPLESINGLE:
-        Loader = new LoaderApple2AppleSingle();
-        break;
-    case FT_NES_SONG_FILE:
-        Loader = new LoaderNESSongFile();
-        break;
-    case FT_CPM_BINARY:
-        Loader = new LoaderCPMBinary();
-        break;
-    case FT_BBC_UEF_TAPE:
-        Loader = new LoaderBBCUEFTape();
-        break;
-    case FT_ZX_SPECTRUM_TAP:
-        Loader = new LoaderZXSpectrumTape();
-        break;
-    default:
-        msg.setText(QStringLiteral("Unknown filetype! (this shouldn't happen)"));
-        msg.exec();
-        return;
+    segments.clear();
+    bankGroups.clear();
+
+    QVector<struct compressedstream> streams = compressedStreams(file);
+    file.seek(0);
+
+    int firstType = -1;
+
+    if (streams.isEmpty()) {
+        if (!loadDevice(file, FileToDisassemble, type, interactive, error))
+            return false;
+        firstType = filetype;
     }
 
-    segments.clear();
+    for (const auto &stream : streams) {
+        InflateDevice device(&file, stream);
 
-    if (!Loader->Load(file)) {
-        QString text = QString("Failed to load " + FileToDisassemble + "\n\n");
-        if (Loader->error_message.isEmpty()) {
-            text += QStringLiteral("File type mismatch or corrupted file!\n");
-        } else {
-            text += Loader->error_message;
+        if (!device.open(QIODevice::ReadOnly)) {
+            *error = "Failed to decompress " + stream.name + " from " +
+                     FileToDisassemble + "\n\n" + device.errorString();
+            return false;
+        }
+
+        int first = segments.size();
+
+        if (!loadDevice(device, stream.name, type, interactive, error))
+            return false;
+        if (firstType < 0)
+            firstType = filetype;
+
+        // tell the members of an archive apart
+
+        if (streams.size() > 1) {
+            for (int i = first; i < segments.size(); i++) {
+                if (!segments[i].name.isEmpty())
+                    continue;
+                if (segments.size() - first == 1)
+                    segments[i].name = stream.name;
+                else
+                    segments[i].name = QStringLiteral("%1 %2").arg(stream.name).arg(i - first);
+            }
         }
-        msg.setText(text);
-        msg.exec();
-        return;
     }
 
     file.close();
 
     if (segments.empty()) {
-        msg.setText("File contains no segments (" + FileToDisassemble + ")");
-        msg.exec();
-        return;
+        *error = "File contains no segments (" + FileToDisassemble + ")";
+        return false;
     }
 
     // name empty segments
@@ -217,11 +236,128 @@ void StartDialog::onButtonNewProject_clicked()
             segments[i].name = QString(QStringLiteral("Segment %1")).arg(i);
     }
 
-    // retrieve cputype from table as index is not necessarily the same
-    // there can be holes in the enumeration
+    filetype = firstType;
+    altfont = filetypes.at(filetype).font;
+    cputype = cpu < 0 ? filetypes.at(filetype).cputype : cpu;
+    return true;
+}
+
+// Load one file or stream, appending to segments. With type < 0 the
+// candidates are tried best first and the first that loads wins. Sets
+// filetype to the type that was used.
+
+bool StartDialog::loadDevice(QIODevice &device, const QString &name, int type,
+                             bool interactive, QString *error)
+{
+    QVector<int> types;
+
+    if (type >= 0) {
+        types.append(type);
+    } else {
+        for (const auto &candidate : probeDevice(device, name))
+            types.append(candidate.filetype);
+    }
+
+    if (types.isEmpty()) {
+        *error = "Unable to detect the file type of " + name;
+        return false;
+    }
+
+    // report why the best candidate failed, not the last one
+
+    QString first;
+    int count = segments.size();
+    int groups = bankGroups.size();
+
+    for (int t : types) {
+        class Loader *loader = createLoader(filetypes.at(t).id);
+
+        if (!loader) {
+            *error = QStringLiteral("Unknown filetype! (this shouldn't happen)");
+            return false;
+        }
+        loader->interactive = interactive;
+
+        device.seek(0);
+
+        ProfileScope scope("Loader::Load");
+        bool loaded = loader->Load(device);
+        scope.count(PC_BYTES, device.pos());
+        scope.stop();
+
+        if (loaded) {
+            delete Loader;
+            Loader = loader;
+            filetype = t;
+            return true;
+        }
+
+        if (first.isEmpty()) {
+            first = QString("Failed to load " + name + "\n\n");
+            if (loader->error_message.isEmpty()) {
+                first += QStringLiteral("File type mismatch or corrupted file!\n");
+            } else {
+                first += loader->error_message;
+            }
+        }
+
+        // a loader may have created banks before it failed
+
+        delete loader;
+        for (int i = count; i < segments.size(); i++)
+            BankGroups::release(segments[i]);
+        segments.resize(count);
+        bankGroups.truncate(groups);
+    }
 
-    cputype =  cputypes.at(ui->comboCPUType->currentIndex()).id;
+    *error = first;
+    return false;
+}
+
+// Open a file without asking anything, for the command line and drag and
+// drop. Frida projects are loaded as such, anything else is a new project.
+// A disk image with more than one file loads all of them.
+
+bool StartDialog::openFile(const QString &name, QString *error)
+{
+    if (is_project_file(name)) {
+        segments.clear();
+        bankGroups.clear();
+        load_existing_project = load_project_file(name, error);
+        return load_existing_project;
+    }
+
+    if (!loadFile(name, -1, -1, false, error))
+        return false;
 
     create_new_project = true;
-    close();
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+void StartDialog::dragEnterEvent(QDragEnterEvent *event)
+{
+    if (event->mimeData()->hasUrls() && event->mimeData()->urls().size() == 1 &&
+        event->mimeData()->urls().at(0).isLocalFile())
+        event->acceptProposedAction();
+}
+
+void StartDialog::dropEvent(QDropEvent *event)
+{
+    QString name = event->mimeData()->urls().at(0).toLocalFile();
+    QString error;
+
+    event->acceptProposedAction();
+
+    if (openFile(name, &error)) {
+        close();
+        return;
+    }
+
+    ui->lineFileDisasm->setText(name);
+
+    QMessageBox msg;
+    msg.setText(error);
+    msg.exec();
 }
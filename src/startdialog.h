@@ -40,6 +40,12 @@ public:
     bool load_existing_project = false;
     bool create_new_project    = false;
 
+    bool openFile(const QString &name, QString *error);
+
+protected:
+    void dragEnterEvent(QDragEnterEvent *event) override;
+    void dropEvent(QDropEvent *event) override;
+
 private Q_SLOTS:
     void onButtonBrowseFileDisasm_clicked();
     void onButtonLoadExistingProject_clicked();
@@ -47,6 +53,10 @@ private Q_SLOTS:
 
 private:
     Ui::StartDialog *ui;
+    bool loadFile(const QString &name, int type, int cpu, bool interactive,
+                  QString *error);
+    bool loadDevice(QIODevice &device, const QString &name, int type,
+                    bool interactive, QString *error);
 };
 
 #endif // STARTDIALOG_H
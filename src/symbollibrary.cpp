@@ -0,0 +1,353 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#include "symbollibrary.h"
+#include "hash.h"
+
+SymbolLibraries symbolLibraries;
+
+#define HEADER_SIZE 64
+#define RECORD_SIZE 16          // labels, groups and entries alike
+
+static inline quint32 get32(const uchar *p) {
+    return qFromLittleEndian<quint32>(p);
+}
+
+static inline quint64 get64(const uchar *p) {
+    return qFromLittleEndian<quint64>(p);
+}
+
+// ----------------------------------------------------------------------------
+// OPEN
+
+bool SymbolLibrary::open(const QString &filename, QString *error) {
+    file.setFileName(filename);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = QStringLiteral("Failed to open ") + filename + QStringLiteral("\n")
+                                                    + file.errorString();
+        return false;
+    }
+
+    size = file.size();
+    if (size >= HEADER_SIZE)
+        base = file.map(0, size);
+
+    if (!base || memcmp(base, SYMBOL_LIBRARY_MAGIC, 8) != 0) {
+        *error = filename + QStringLiteral(" is not a symbol library");
+        return false;
+    }
+    if (get32(base + 8) > SYMBOL_LIBRARY_VERSION) {
+        *error = filename + QStringLiteral(" is from a newer version of Frida");
+        return false;
+    }
+
+    numLabels   = get32(base + 12);
+    numGroups   = get32(base + 16);
+    numEntries  = get32(base + 20);
+    labels      = get64(base + 24);
+    groups      = get64(base + 32);
+    entries     = get64(base + 40);
+    strings     = get64(base + 48);
+    stringsSize = get64(base + 56);
+
+    if (labels  + (quint64) numLabels  * RECORD_SIZE > size ||
+        groups  + (quint64) numGroups  * RECORD_SIZE > size ||
+        entries + (quint64) numEntries * RECORD_SIZE > size ||
+        strings + stringsSize > size) {
+        *error = filename + QStringLiteral(" is truncated");
+        return false;
+    }
+
+    for (quint32 i = 0; i < numGroups; i++) {
+        const uchar *g = base + groups + i * RECORD_SIZE;
+        if ((quint64) get32(g + 8) + get32(g + 12) > numEntries) {
+            *error = filename + QStringLiteral(" is corrupt");
+            return false;
+        }
+    }
+
+    // listings are cached by it, a rebuilt library changes them. The size
+    // and time are enough, hashing the contents would read every page.
+
+    quint64 stamp[2] = { size, (quint64) QFileInfo(file).lastModified()
+                                                        .toMSecsSinceEpoch() };
+    fileStamp = xxh64((const quint8 *) stamp, sizeof(stamp));
+    return true;
+}
+
+bool SymbolLibrary::isLibrary(const QString &filename) {
+    QFile file(filename);
+    char magic[8];
+
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    return file.read(magic, 8) == 8 && !memcmp(magic, SYMBOL_LIBRARY_MAGIC, 8);
+}
+
+// ----------------------------------------------------------------------------
+// LOOKUP
+
+// ref points to a { quint32 name, length; } pair
+
+QString SymbolLibrary::string(const uchar *ref) const {
+    quint64 offset = get32(ref), length = get32(ref + 4);
+
+    if (offset + length > stringsSize)
+        return QString();
+    return QString::fromUtf8((const char *) base + strings + offset, length);
+}
+
+int SymbolLibrary::lowerBound(quint64 address) const {
+    const uchar *table = base + labels;
+    quint32 lo = 0, hi = numLabels;
+
+    while (lo < hi) {
+        quint32 mid = lo + (hi - lo) / 2;
+        if (get64(table + mid * RECORD_SIZE) < address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+int SymbolLibrary::find(quint64 address) const {
+    quint32 i = lowerBound(address);
+
+    if (i < numLabels && labelAddress(i) == address)
+        return i;
+    return -1;
+}
+
+bool SymbolLibrary::label(quint64 address, QString *name) const {
+    int i = find(address);
+
+    if (i < 0)
+        return false;
+    *name = labelName(i);
+    return true;
+}
+
+quint64 SymbolLibrary::labelAddress(int i) const {
+    return get64(base + labels + i * RECORD_SIZE);
+}
+
+QString SymbolLibrary::labelName(int i) const {
+    return string(base + labels + i * RECORD_SIZE + 8);
+}
+
+QString SymbolLibrary::groupName(int group) const {
+    return string(base + groups + group * RECORD_SIZE);
+}
+
+void SymbolLibrary::groupEntries(int group, QMap<quint64, QString> *map) const {
+    const uchar *g = base + groups + group * RECORD_SIZE;
+    quint32 first = get32(g + 8), count = get32(g + 12);
+
+    for (quint32 i = first; i < first + count; i++) {
+        const uchar *e = base + entries + i * RECORD_SIZE;
+        map->insert(get64(e), string(e + 8));
+    }
+}
+
+// ----------------------------------------------------------------------------
+// COMPILE
+
+struct libgroup {
+    QString name;
+    QMap<quint64, QString> map;
+};
+
+// Same syntax as the Import buttons of the labels window and the constants
+// manager accept, one "value name" pair per line.
+
+static bool parseSource(const QString &filename,
+                        QMap<quint64, QString> &labels,
+                        QList<struct libgroup> &groups, QString *error) {
+    QFile file(filename);
+    QMap<quint64, QString> *current = nullptr;
+    bool constants = false, first = true;
+    int lineno = 0;
+
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        *error = QStringLiteral("Failed to open ") + filename;
+        return false;
+    }
+
+    QTextStream in(&file);
+
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        lineno++;
+
+        if (line.isEmpty())
+            continue;
+
+        if (first) {
+            constants = line.startsWith(QLatin1Char('['));
+            first = false;
+        }
+
+        if (constants && line.startsWith(QLatin1Char('['))) {
+            if (line == QStringLiteral("[]"))
+                break;
+            groups.append({ line.mid(1, line.size()-2), QMap<quint64, QString>() });
+            current = &groups.last().map;
+            continue;
+        }
+
+        QStringList tokens = line.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+        bool ok;
+        quint64 value = tokens.at(0).toULongLong(&ok, 0);
+
+        if (!ok || tokens.size() < 2) {
+            *error = QStringLiteral("%1:%2: expected a value and a name")
+                                                .arg(filename).arg(lineno);
+            return false;
+        }
+
+        if (constants)
+            current->insert(value, tokens.at(1));
+        else
+            labels.insert(value, tokens.at(1));
+    }
+
+    return true;
+}
+
+static inline void put32(QByteArray &out, quint32 v) {
+    uchar buf[4];
+    qToLittleEndian<quint32>(v, buf);
+    out.append((const char *) buf, 4);
+}
+
+static inline void put64(QByteArray &out, quint64 v) {
+    uchar buf[8];
+    qToLittleEndian<quint64>(v, buf);
+    out.append((const char *) buf, 8);
+}
+
+static void putString(QByteArray &out, QByteArray &pool, const QString &s) {
+    QByteArray utf8 = s.toUtf8();
+    put32(out, pool.size());
+    put32(out, utf8.size());
+    pool += utf8;
+}
+
+bool SymbolLibrary::compile(const QStringList &sources, const QString &output,
+                            QString *error) {
+    QMap<quint64, QString> labels;
+    QList<struct libgroup> groups;
+
+    for (const auto &source : sources)
+        if (!parseSource(source, labels, groups, error))
+            return false;
+
+    QByteArray labelTable, groupTable, entryTable, pool;
+    quint32 numEntries = 0;
+
+    QMap<quint64, QString>::const_iterator iter;
+
+    for (iter = labels.constBegin(); iter != labels.constEnd(); ++iter) {
+        put64(labelTable, iter.key());
+        putString(labelTable, pool, iter.value());
+    }
+
+    for (const auto &group : qAsConst(groups)) {
+        putString(groupTable, pool, group.name);
+        put32(groupTable, numEntries);
+        put32(groupTable, group.map.size());
+
+        for (iter = group.map.constBegin(); iter != group.map.constEnd(); ++iter) {
+            put64(entryTable, iter.key());
+            putString(entryTable, pool, iter.value());
+            numEntries++;
+        }
+    }
+
+    QByteArray out(SYMBOL_LIBRARY_MAGIC, 8);
+    quint64 offset = HEADER_SIZE;
+
+    put32(out, SYMBOL_LIBRARY_VERSION);
+    put32(out, labels.size());
+    put32(out, groups.size());
+    put32(out, numEntries);
+    put64(out, offset);
+    put64(out, offset += labelTable.size());
+    put64(out, offset += groupTable.size());
+    put64(out, offset += entryTable.size());
+    put64(out, pool.size());
+
+    out += labelTable;
+    out += groupTable;
+    out += entryTable;
+    out += pool;
+
+    QFile file(output);
+    if (!file.open(QIODevice::WriteOnly) || file.write(out) != out.size()) {
+        *error = QStringLiteral("Failed to write ") + output + QStringLiteral("\n")
+                                                    + file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// ATTACHED LIBRARIES
+
+bool SymbolLibraries::attach(const QString &filename, QString *error) {
+    auto *lib = new SymbolLibrary;
+
+    if (!lib->open(filename, error)) {
+        delete lib;
+        return false;
+    }
+    list.append(lib);
+    return true;
+}
+
+void SymbolLibraries::clear(void) {
+    qDeleteAll(list);
+    list.clear();
+}
+
+QStringList SymbolLibraries::fileNames(void) const {
+    QStringList names;
+
+    for (const auto *lib : list)
+        names.append(lib->fileName());
+    return names;
+}
+
+bool SymbolLibraries::address(const QString &name, quint64 *address) const {
+    for (const auto *lib : list) {
+        for (int i = 0; i < lib->labelCount(); i++) {
+            if (lib->labelName(i) == name) {
+                *address = lib->labelAddress(i);
+                return true;
+            }
+        }
+    }
+    return false;
+}
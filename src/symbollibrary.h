@@ -0,0 +1,120 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of:
+//
+// FRIDA - FRee Interactive DisAssembler
+// Copyright (C) 2017,2023 Ivo van Poorten
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; ONLY version 2 of the License.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef SYMBOLLIBRARY_H
+#define SYMBOLLIBRARY_H
+
+#include "pch.h"
+
+// A symbol library (*.fridalib) is compiled from .labels and .constants
+// text files. It is memory mapped and never parsed, lookups are a binary
+// search. All numbers are little-endian.
+//
+//   header     "FRIDALIB", version, counts and offsets (64 bytes)
+//   labels     { quint64 address; quint32 name, length; } sorted by address
+//   groups     { quint32 name, length, first, count; }
+//   entries    { quint64 value; quint32 name, length; } sorted per group
+//   strings    UTF-8, not terminated
+
+#define SYMBOL_LIBRARY_MAGIC    "FRIDALIB"
+#define SYMBOL_LIBRARY_VERSION  1
+
+class SymbolLibrary {
+public:
+    SymbolLibrary() = default;
+    SymbolLibrary(const SymbolLibrary &) = delete;
+    SymbolLibrary &operator=(const SymbolLibrary &) = delete;
+
+    bool open(const QString &filename, QString *error);
+    QString fileName(void) const { return file.fileName(); }
+    quint64 stamp(void) const { return fileStamp; }     // size and time
+
+    bool contains(quint64 address) const { return find(address) >= 0; }
+    int lowerBound(quint64 address) const;  // first label at or above
+    bool label(quint64 address, QString *name) const;
+    int labelCount(void) const { return numLabels; }
+    quint64 labelAddress(int i) const;
+    QString labelName(int i) const;
+
+    int groupCount(void) const { return numGroups; }
+    QString groupName(int group) const;
+    void groupEntries(int group, QMap<quint64, QString> *map) const;
+
+    static bool isLibrary(const QString &filename);
+
+    // sources are .labels files and/or .constants files, recognized by
+    // their first line
+    static bool compile(const QStringList &sources, const QString &output,
+                        QString *error);
+
+private:
+    QFile file;
+    const uchar *base = nullptr;
+    quint64 size = 0;
+    quint32 numLabels = 0, numGroups = 0, numEntries = 0;
+    quint64 labels = 0, groups = 0, entries = 0, strings = 0, stringsSize = 0;
+    quint64 fileStamp = 0;
+
+    int find(quint64 address) const;
+    QString string(const uchar *ref) const;
+};
+
+// The libraries that are attached to the project. They are saved by file
+// name only. The first library that knows an address wins.
+
+class SymbolLibraries {
+public:
+    ~SymbolLibraries() { clear(); }
+
+    bool attach(const QString &filename, QString *error);
+    void clear(void);
+    QStringList fileNames(void) const;
+    const QList<SymbolLibrary *> &libraries(void) const { return list; }
+
+    bool label(quint64 address, QString *name) const {
+        for (const auto *lib : list)
+            if (lib->label(address, name))
+                return true;
+        return false;
+    }
+    bool contains(quint64 address) const {
+        for (const auto *lib : list)
+            if (lib->contains(address))
+                return true;
+        return false;
+    }
+    QString value(quint64 address) const {
+        QString name;
+        label(address, &name);
+        return name;
+    }
+
+    // reverse lookup, this is a linear scan
+    bool address(const QString &name, quint64 *address) const;
+
+private:
+    QList<SymbolLibrary *> list;
+};
+
+extern SymbolLibraries symbolLibraries;
+
+#endif // SYMBOLLIBRARY_H